@@ -9,11 +9,30 @@
 
 // External inclusions
 #include <stddef.h> // NULL
-#include <stdio.h>  // printf
+#include <stdio.h>  // printf, fprintf
+#include <stdlib.h> // atoi
 #include <string.h> // strcmp
 
 // Internal inclusions
+#include "music2_archive.h"
+#include "music2_bench.h"
+#include "music2_cache.h"
+#include "music2_checkpoint.h"
+#include "music2_container.h"
+#include "music2_corpus.h"
+#include "music2_deadline.h"
+#include "music2_estimate.h"
+#include "music2_events.h"
+#include "music2_gate.h"
 #include "music2_general2.h"
+#include "music2_header.h"
+#include "music2_memo.h"
+#include "music2_meter.h"
+#include "music2_push.h"
+#include "music2_rans.h"
+#include "music2_search.h"
+#include "music2_stats.h"
+#include "music2_trace.h"
 
 
 //*******************************************************
@@ -27,11 +46,111 @@ const char* STR_HELP =
 "    music.exe -v                   Print example of visual style of output\n"
 "    music.exe -vb                  Print example of visual style of output along with source bytes\n"
 "    music.exe -v[b] <type>         Print example of a specific byte group type\n"
-"                                   where type = clef, key, time, note, beam, rest, text, or barline\n"
+"                                   where type = clef, key, time, note, beam, rest, text, barline, or repeat\n"
 "    music.exe <filepath>           Read a file and print music on a continuous staff\n"
 "    music.exe <filepath> <width>   Read a file and print music with a maximum page width (min 5, max 255)\n"
-"    music.exe -p <count>           Test performance by repeatedly constructing the example from option -v\n"
-"    music.exe -p <count> <type>    Test performance by repeatedly constructing the example from option -v <type>\n";
+"    music.exe <filepath> <width> <first> <last>\n"
+"                                   Read a file and print only staves <first> to <last> (counting from 1)\n"
+"    music.exe -lw <filepath> <min width> <max width>\n"
+"                                   Read a file once and print it at every width from <min width> to <max width>\n"
+"    music.exe -cw <filepath> <outpath> [<chunk size>]\n"
+"                                   Write a copy of a file in the container format, which splits the music into\n"
+"                                   checksummed chunks of <chunk size> byte groups (default 4096) that are read in\n"
+"                                   parallel. Options that read files accept either format.\n"
+"    music.exe -ab <dirpath> <archive>\n"
+"                                   Write an archive holding every file in a directory, each named by its file name\n"
+"    music.exe -al <archive>        List the songs in an archive\n"
+"    music.exe -ar <archive> <name> [<width>]\n"
+"                                   Print one song from an archive\n"
+"    music.exe -rw <filepath> <outpath>\n"
+"                                   Write a compressed copy of a file. Options that read files accept it.\n"
+"    music.exe -rb <count>          Report compression ratio and decoding speed on <count> generated songs\n"
+"    music.exe -hw <filepath> <outpath>\n"
+"                                   Write a copy of a file with a header holding its noteblock count and rendered\n"
+"                                   size, which lets it be printed without over-allocating. Options that read files\n"
+"                                   accept it.\n"
+"    music.exe -hi <filepath>       Print a file's header and check it against the file\n"
+"    music.exe -ib <filepath> [<interval>]\n"
+"                                   Write a checkpoint index of a large file to <filepath>.m2i, with a checkpoint\n"
+"                                   every <interval> byte groups (default 256)\n"
+"    music.exe -is <filepath> <noteblock> <count> [<width>]\n"
+"                                   Use a file's checkpoint index to print <count> noteblocks starting at\n"
+"                                   <noteblock> (counting from 0) without reading the file before them\n"
+"    music.exe -g <outpath> <size> [<profile>] [<seed>]\n"
+"                                   Write a generated file of about <size> bytes (suffix K, M, or G allowed) for\n"
+"                                   benchmarks, where profile = typical, dense, repetitive, or adversarial, optionally\n"
+"                                   followed by changes such as typical,nb=60,dyn=20 - percent of notes beamed (nb),\n"
+"                                   rests (rest), tied (tie), or with dynamics text (dyn); longest beamed run (run);\n"
+"                                   key and time changes per 1000 measures (key, time); percent of measures\n"
+"                                   repeated (rep)\n"
+"    music.exe -p <count>           Test performance by repeatedly constructing the example from option -v, timing\n"
+"                                   parsing, drawing, and freeing separately (min, median, 99th percentile)\n"
+"    music.exe -p <count> <type>    Test performance by repeatedly constructing the example from option -v <type>\n"
+"    music.exe -p <count> <filepath> [<width>]\n"
+"                                   Test performance by repeatedly printing a file\n"
+"    music.exe -pm [<rounds>] [<function>]\n"
+"                                   Time each function that makes or draws a noteblock on every input its encoding\n"
+"                                   allows, on its own, in ns per call over <rounds> rounds (default 5)\n"
+"    music.exe -ps [<max size>] [<profile>]\n"
+"                                   Print CSV of the time, peak memory, and allocations to print generated files of\n"
+"                                   1K, 4K, 16K, ... up to <max size> (default 16M) at widths 5 to 255 and\n"
+"                                   continuous. Profiles are as for option -g.\n"
+"    music.exe -tw <dirpath>        Write golden files of every example and some generated files printed at several\n"
+"                                   widths, and a baseline of the time each stage of printing them takes\n"
+"    music.exe -tc <dirpath> [<tolerance>]\n"
+"                                   Check printing against the golden files and baseline from option -tw, exiting\n"
+"                                   with status 1 if any output differs or any stage is over <tolerance> percent\n"
+"                                   (default 10), and over 3 times its spread in the baseline, slower. Files in\n"
+"                                   <dirpath>/cases are checked too.\n"
+"    music.exe -ws <dirpath> [<iterations>] [<seed>]\n"
+"                                   Search <iterations> (default 5000) mutated inputs for those that take the most\n"
+"                                   time and memory per byte to print, writing the worst to <dirpath>. Use a gate\n"
+"                                   directory's cases subdirectory to add them to options -tw and -tc.\n"
+"    music.exe -dl <filepath> <width> <milliseconds> [<token>]\n"
+"                                   Print the staves of a file that can be rendered within <milliseconds> (0 for no\n"
+"                                   limit), or until Ctrl+C. If any are left, print a token to carry on from where\n"
+"                                   it stopped without parsing the file up to there again, and exit with status 75\n"
+"    music.exe -pp <filepath> [<chunk size>] [<width>]\n"
+"                                   Print a file read <chunk size> bytes at a time (default 4096) and parsed as the\n"
+"                                   pieces arrive, as a network service would, with byte groups split between them\n"
+"    music.exe -ev <filepath>       Print what each noteblock of a file is (note, rest, clef, and so on) and its\n"
+"                                   pitch, duration, and other details, one per line, without drawing them\n"
+"    music.exe -mc <path> [<path> ...]\n"
+"                                   Check that the notes and rests of each measure add up to the time signature, in\n"
+"                                   files and in every song of archives, printing the location of any that don't.\n"
+"                                   Exits with status 1 if any don't or a file can't be checked to the end.\n"
+"    music.exe -es <filepath> [<width>]\n"
+"                                   Estimate the noteblocks, staves, bytes printed, memory, and time to print a file\n"
+"                                   from its byte groups, without drawing them\n"
+"    music.exe -ec <outpath>        Measure what each type of byte group costs to print on this machine, and write\n"
+"                                   it as a cost model for --cost-model\n"
+"  Options that can be added to any of the above:\n"
+"    --cache <dirpath>              Reuse music rendered earlier from the same file bytes and width, storing it in\n"
+"                                   a cache directory (created if needed)\n"
+"    --cache-size <megabytes>       Limit the cache directory to this size, deleting least recently used music\n"
+"                                   first (default 64)\n"
+"    --cache-stats                  After the above, print cache hit, miss, store, and eviction counts\n"
+"    --memo                         Copy measures already drawn with the same bytes, rather than drawing every\n"
+"                                   measure. Faster for repetitive music, but for one thread at a time.\n"
+"    --memo-stats                   After the above, print how many measures were copied rather than drawn\n"
+"    --progress                     While reading a file with a header, print how much has been parsed\n"
+"    --trace <filepath>             Write a timeline of reading, parsing, each staff, and printing, and of each\n"
+"                                   file, chunk, or thread in options that do several, as a Chrome trace-event\n"
+"                                   file for chrome://tracing or ui.perfetto.dev\n"
+"    --stats                        After the above, print the byte groups parsed by type, the noteblocks, bytes\n"
+"                                   allocated, staves, and bytes printed, the parse error if any, and the time\n"
+"                                   spent reading, parsing, converting to text, and freeing, except for renders\n"
+"                                   on threads for --threads\n"
+"    --budget-ms <milliseconds>     Before printing a file, estimate it as option -es does, and if printing it is\n"
+"                                   estimated to take longer, don't: exit with status 1\n"
+"    --budget-mb <megabytes>        As above, for the memory printing a file is estimated to take\n"
+"    --defer                        With a budget, exit with status 75 (try again later) rather than 1\n"
+"    --cost-model <filepath>        Estimate with a cost model from option -ec rather than the built-in one\n"
+"    --format <text|json|csv>       Print option -p or -pm results in this format (default text)\n"
+"    --threads <count>              With option -p, render on 1 to <count> threads at once and print each thread\n"
+"                                   count's throughput and latency, without the memo (see --memo)\n"
+"    --counters                     With option -p or -pm, also print cycles, instructions, branch misses, and cache\n"
+"                                   misses (Linux; software counts such as page faults where the processor has none)\n";
 
 // File encoding
 const char* STR_ENCODING =
@@ -117,7 +236,57 @@ const char* STR_ENCODING =
 "  Clef (1 byte):\n"
 "    Elsewhere in these descriptions, pitch names assume treble clef, but here you can draw a different clef.\n"
 "    Bits 1-6: Always 100000\n"
-"    Bits 7-8: Type - Treble (0), bass (1), percussion (2)\n";
+"    Bits 7-8: Type - Treble (0), bass (1), percussion (2)\n"
+"  Repeat (2 bytes):\n"
+"    Adds copies of the previous noteblocks again, exactly as drawn, including their dynamics text, so a\n"
+"    repeated measure or phrase takes 2 bytes. Invalid if there are fewer noteblocks than it copies.\n"
+"    Byte groups after it behave as if the copied byte groups came again, so for example dynamics text can't\n"
+"    follow if the last copied noteblock already has some.\n"
+"    Bits 1-8:  Always 00001100\n"
+"    Bits 9-16: Number of noteblocks to copy - 1 to 255, counting back from the most recent\n";
+
+
+
+//**************************************************
+// Options that can be added to any other arguments
+//**************************************************
+
+// If an option is present, remove it from the argument list. The remaining arguments keep their order.
+int take_option_flag (
+    int*        pArgc,  // Pointer to count of command-line argument strings. Decreased if option is found.
+    char*       argv[], // Array of command-line argument strings. Shifted if option is found.
+    const char* option  // Option to look for, such as "--cache-stats".
+    // Returns 1 if the option was present, otherwise 0.
+){
+    for (int i = 1; i < *pArgc; ++i) {
+        if (strcmp (argv[i], option) == 0) {
+            for (int j = i; j + 1 < *pArgc; ++j) { argv[j] = argv[j + 1]; }
+            --(*pArgc);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+
+// If an option and the value following it are present, remove both from the argument list.
+// The remaining arguments keep their order.
+char* take_option_value (
+    int*        pArgc,  // Pointer to count of command-line argument strings. Decreased if option is found.
+    char*       argv[], // Array of command-line argument strings. Shifted if option is found.
+    const char* option  // Option to look for, such as "--cache".
+    // Returns the value following the option, or NULL if the option was absent or last.
+){
+    for (int i = 1; i + 1 < *pArgc; ++i) {
+        if (strcmp (argv[i], option) == 0) {
+            char* value = argv[i + 1];
+            for (int j = i; j + 2 < *pArgc; ++j) { argv[j] = argv[j + 2]; }
+            *pArgc -= 2;
+            return value;
+        }
+    }
+    return NULL;
+}
 
 
 
@@ -130,6 +299,38 @@ int main (
     int   argc,  // Count of command-line argument strings, including program name
     char* argv[] // Array of command-line argument strings (first actual argument is argv[1])
 ){
+    int exitStatus = 0;
+
+    // Options that can be added to any other arguments
+    char* cacheDirStr = take_option_value (&argc, argv, "--cache");
+    char* cacheSizeStr = take_option_value (&argc, argv, "--cache-size");
+    char* formatStr = take_option_value (&argc, argv, "--format");
+    char* threadsStr = take_option_value (&argc, argv, "--threads");
+    char* traceFileStr = take_option_value (&argc, argv, "--trace");
+    char* costModelStr = take_option_value (&argc, argv, "--cost-model");
+    char* budgetMsStr = take_option_value (&argc, argv, "--budget-ms");
+    char* budgetMbStr = take_option_value (&argc, argv, "--budget-mb");
+    int defers = take_option_flag (&argc, argv, "--defer");
+    int showCacheStats = take_option_flag (&argc, argv, "--cache-stats");
+    int showMemoStats = take_option_flag (&argc, argv, "--memo-stats");
+    int showStats = take_option_flag (&argc, argv, "--stats");
+    stats_set_enabled (showStats);
+    if (take_option_flag (&argc, argv, "--memo")) { memo_set_enabled (1); }
+    if (take_option_flag (&argc, argv, "--progress")) { header_set_progress (1); }
+    if (take_option_flag (&argc, argv, "--counters")) { bench_set_counters (1); }
+    if (traceFileStr != NULL) { trace_start (traceFileStr); }
+    if (costModelStr != NULL && !estimate_load_model (costModelStr)) return 0;
+    if ((budgetMsStr != NULL || budgetMbStr != NULL) && !estimate_set_budget (budgetMsStr, budgetMbStr, defers)) {
+        return 0;
+    }
+    if (cacheDirStr != NULL) {
+        int cacheSizeMB = (cacheSizeStr == NULL) ? 0 : atoi (cacheSizeStr); // 0 means default
+        if (cacheSizeMB < 0 || !cache_configure (cacheDirStr, (unsigned long long)cacheSizeMB * 1024 * 1024)) {
+            printf ("  Unable to use cache directory %s\n", cacheDirStr);
+            return 0;
+        }
+    }
+
     if ((argc == 2 || argc == 3) && (strcmp (argv[1], "-v") == 0 || strcmp (argv[1], "-vb") == 0)) {
         char* typeArg = (argc == 2) ? NULL : argv[2];
         int showBytes = (strcmp (argv[1], "-vb") == 0);
@@ -144,18 +345,135 @@ int main (
     else if (argc == 2 && strcmp (argv[1], "-h") == 0) {
         printf (STR_HELP);
     }
+    else if ((argc >= 2 && argc <= 4) && strcmp (argv[1], "-pm") == 0) {
+        char* roundsArg = (argc >= 3) ? argv[2] : NULL;
+        char* functionArg = (argc == 4) ? argv[3] : NULL;
+        test_microbenchmarks (roundsArg, functionArg, formatStr);
+    }
+    else if ((argc >= 2 && argc <= 4) && strcmp (argv[1], "-ps") == 0) {
+        char* maxSizeArg = (argc >= 3) ? argv[2] : NULL;
+        char* profileArg = (argc == 4) ? argv[3] : NULL;
+        test_scaling (maxSizeArg, profileArg);
+    }
     else if (argc == 2) {
-        try_read_file (argv[1], NULL);
+        exitStatus = estimate_has_budget () ? try_admit_file (argv[1], NULL) : 0;
+        if (exitStatus == 0) {
+            unsigned long long traceNs = trace_begin ();
+            try_read_file (argv[1], NULL);
+            trace_end ("try_read_file", traceNs, -1);
+        }
+    }
+    else if (argc == 4 && strcmp (argv[1], "-ab") == 0) {
+        try_build_archive (argv[2], argv[3]);
+    }
+    else if (argc == 3 && strcmp (argv[1], "-al") == 0) {
+        try_list_archive (argv[2]);
+    }
+    else if ((argc == 4 || argc == 5) && strcmp (argv[1], "-ar") == 0) {
+        char* widthArg = (argc == 4) ? NULL : argv[4];
+        try_read_archive_song (argv[2], argv[3], widthArg);
+    }
+    else if ((argc == 4 || argc == 5) && strcmp (argv[1], "-cw") == 0) {
+        char* chunkSizeArg = (argc == 4) ? NULL : argv[4];
+        try_write_container (argv[2], argv[3], chunkSizeArg);
     }
-    else if ((argc == 3 || argc == 4) && strcmp (argv[1], "-p") == 0) {
-        char* typeArg = (argc == 3) ? NULL : argv[3];
-        test_performance (argv[2], typeArg);
+    else if (argc == 4 && strcmp (argv[1], "-hw") == 0) {
+        try_write_header (argv[2], argv[3]);
+    }
+    else if (argc == 3 && strcmp (argv[1], "-hi") == 0) {
+        try_show_header (argv[2]);
+    }
+    else if (argc == 4 && strcmp (argv[1], "-rw") == 0) {
+        try_write_compressed (argv[2], argv[3]);
+    }
+    else if (argc == 3 && strcmp (argv[1], "-rb") == 0) {
+        test_compression (argv[2]);
+    }
+    else if ((argc == 3 || argc == 4) && strcmp (argv[1], "-ib") == 0) {
+        char* intervalArg = (argc == 3) ? NULL : argv[3];
+        try_build_checkpoint_index (argv[2], intervalArg);
+    }
+    else if ((argc == 5 || argc == 6) && strcmp (argv[1], "-is") == 0) {
+        char* widthArg = (argc == 5) ? NULL : argv[5];
+        try_read_file_from_checkpoint (argv[2], argv[3], argv[4], widthArg);
+    }
+    else if ((argc >= 4 && argc <= 6) && strcmp (argv[1], "-g") == 0) {
+        char* profileArg = (argc >= 5) ? argv[4] : NULL;
+        char* seedArg = (argc == 6) ? argv[5] : NULL;
+        try_generate_corpus (argv[2], argv[3], profileArg, seedArg);
+    }
+    else if ((argc >= 3 && argc <= 5) && strcmp (argv[1], "-p") == 0) {
+        char* inputArg = (argc == 3) ? NULL : argv[3];
+        char* widthArg = (argc == 5) ? argv[4] : NULL;
+        test_performance (argv[2], inputArg, widthArg, formatStr, threadsStr);
+    }
+    else if (argc == 3 && strcmp (argv[1], "-tw") == 0) {
+        try_write_gate (argv[2]);
+    }
+    else if ((argc == 3 || argc == 4) && strcmp (argv[1], "-tc") == 0) {
+        char* toleranceArg = (argc == 4) ? argv[3] : NULL;
+        exitStatus = test_gate (argv[2], toleranceArg);
+    }
+    else if ((argc >= 3 && argc <= 5) && strcmp (argv[1], "-ws") == 0) {
+        char* iterationsArg = (argc >= 4) ? argv[3] : NULL;
+        char* seedArg = (argc == 5) ? argv[4] : NULL;
+        try_search_worst_case (argv[2], iterationsArg, seedArg);
+    }
+    else if ((argc == 5 || argc == 6) && strcmp (argv[1], "-dl") == 0) {
+        char* tokenArg = (argc == 6) ? argv[5] : NULL;
+        exitStatus = try_read_file_deadline (argv[2], argv[3], argv[4], tokenArg);
+    }
+    else if ((argc >= 3 && argc <= 5) && strcmp (argv[1], "-pp") == 0) {
+        char* chunkSizeArg = (argc >= 4) ? argv[3] : NULL;
+        char* widthArg = (argc == 5) ? argv[4] : NULL;
+        try_read_file_push (argv[2], chunkSizeArg, widthArg);
+    }
+    else if (argc == 5 && strcmp (argv[1], "-lw") == 0) {
+        try_read_file_widths (argv[2], argv[3], argv[4]);
+    }
+    else if (argc == 3 && strcmp (argv[1], "-ev") == 0) {
+        try_print_events (argv[2]);
+    }
+    else if (argc >= 3 && strcmp (argv[1], "-mc") == 0) {
+        exitStatus = try_check_measures (argc - 2, argv + 2);
+    }
+    else if ((argc == 3 || argc == 4) && strcmp (argv[1], "-es") == 0) {
+        char* widthArg = (argc == 4) ? argv[3] : NULL;
+        try_estimate_file (argv[2], widthArg);
+    }
+    else if (argc == 3 && strcmp (argv[1], "-ec") == 0) {
+        try_calibrate_estimate (argv[2]);
     }
     else if (argc == 3) {
-        try_read_file (argv[1], argv[2]);
+        exitStatus = estimate_has_budget () ? try_admit_file (argv[1], argv[2]) : 0;
+        if (exitStatus == 0) {
+            unsigned long long traceNs = trace_begin ();
+            try_read_file (argv[1], argv[2]);
+            trace_end ("try_read_file", traceNs, -1);
+        }
+    }
+    else if (argc == 5) {
+        try_read_file_staves (argv[1], argv[2], argv[3], argv[4]);
     }
     else {
         printf (STR_HELP);
     }
-    return 0;
+
+    if (showCacheStats) {
+        struct cache_stats stats = cache_get_stats ();
+        // stderr, so the counts don't mix with printed music
+        fprintf (stderr, "  Cache: %llu hits, %llu misses, %llu stores, %llu evictions, %llu errors\n",
+            stats.hits, stats.misses, stats.stores, stats.evictions, stats.errors);
+    }
+    if (showMemoStats) {
+        struct memo_stats stats = memo_get_stats ();
+        fprintf (stderr,
+            "  Measure memo: %llu lookups, %llu hits, %llu noteblocks copied, %llu stores, %llu replaced\n",
+            stats.lookups, stats.hits, stats.noteblocks, stats.stores, stats.replaced);
+    }
+    if (showStats) {
+        stats_print ();
+    }
+    trace_finish ();
+    return exitStatus;
 }
@@ -0,0 +1,415 @@
+//*****************************************************************************************************
+// music2_archive.c
+// This file contains an archive format for storing many songs in one file. Encoded songs are tiny (often
+// tens of bytes), so as separate files, file system overhead costs far more than the songs themselves.
+// An archive holds a directory of song names sorted by name, a hash table over the names, the names
+// themselves, and the songs' encoded bytes, one after another. It is mapped into memory read-only and
+// used in place: finding a song is one hash and usually one name comparison, and its bytes are passed
+// straight to the renderer, so nothing is read or copied that rendering from memory wouldn't need.
+//*****************************************************************************************************
+
+
+// External inclusions
+#include <stddef.h> // NULL, size_t
+#include <stdio.h>  // printf, fopen_s, fread, fwrite, remove, snprintf
+#include <stdlib.h> // malloc, calloc, realloc, free, qsort
+#include <string.h> // memcmp, memcpy, strcmp, strlen
+
+// Internal inclusions
+#include "music2_container.h"
+#include "music2_general2.h"
+#include "music2_hash.h"
+#include "music2_platform.h"
+#include "music2_trace.h"
+
+
+//*********************
+// Archive file format
+//*********************
+
+// Header (32 bytes):
+//   Bytes 0-3:   ARCHIVE_MAGIC
+//   Bytes 4-7:   ARCHIVE_VERSION
+//   Bytes 8-11:  Count of songs
+//   Bytes 12-15: Count of hash table buckets, a power of 2 greater than the count of songs
+//   Bytes 16-23: Byte offset of the names
+//   Bytes 24-31: Byte offset of the songs' bytes
+// Directory, right after the header, sorted by name (compared byte by byte) (20 bytes per song):
+//   Bytes 0-7:   Byte offset of the song's bytes
+//   Bytes 8-11:  Count of the song's bytes. Plain encoded songs include their terminator.
+//   Bytes 12-15: Offset of the song's name from the start of the names
+//   Bytes 16-19: Length of the song's name, which isn't 0-terminated
+// Hash table, right after the directory (4 bytes per bucket):
+//   Index in the directory plus 1, or 0 for an empty bucket. A name's first bucket is given by the low bits of
+//   hash_bytes of the name; if another name is there, the search continues with the next bucket.
+// Names, then songs' bytes.
+// All numbers are little-endian.
+#define ARCHIVE_MAGIC       ("\x10M2A")
+#define ARCHIVE_VERSION     (1)
+#define ARCHIVE_HEADER_SIZE (32)
+#define ARCHIVE_ENTRY_SIZE  (20)
+
+
+// Count of hash table buckets for some count of songs: a power of 2, at most half full
+unsigned int archive_bucket_count (
+    unsigned int countSongs // Count of songs.
+){
+    unsigned int countBuckets = 16;
+    while (countBuckets < 2 * countSongs) { countBuckets *= 2; }
+    return countBuckets;
+}
+
+
+
+//*********
+// Reading
+//*********
+
+// Whether some bytes start with the archive magic
+int archive_is_archive (
+    const unsigned char* pBytes,    // Pointer to file bytes.
+    size_t               countBytes // Number of file bytes.
+){
+    return countBytes >= 4 && memcmp (pBytes, ARCHIVE_MAGIC, 4) == 0;
+}
+
+
+// An archive mapped into memory. Set by archive_open, released by archive_close.
+struct archive {
+    struct platform_mapping mapping;      // The whole archive file.
+    unsigned int            countSongs;   // Count of songs.
+    unsigned int            countBuckets; // Count of hash table buckets.
+    const unsigned char*    pDirectory;   // Directory within the mapping.
+    const unsigned char*    pBuckets;     // Hash table within the mapping.
+    const unsigned char*    pNames;       // Names within the mapping.
+    size_t                  namesSize;    // Total bytes of names.
+};
+
+
+// Release an archive. Safe to call on an archive archive_open failed to open.
+void archive_close (
+    struct archive* pArchive // Archive to release.
+){
+    platform_unmap_file (&(pArchive->mapping));
+    pArchive->countSongs = 0;
+    pArchive->countBuckets = 0;
+}
+
+
+// Map an archive into memory and check its header.
+int archive_open (
+    const char*     path,    // Path of archive file.
+    struct archive* pArchive // Output param, archive to set. Release with archive_close.
+    // Returns 1 on success, 0 if the file can't be mapped or isn't a well-formed archive.
+){
+    pArchive->countSongs = 0;
+    pArchive->countBuckets = 0;
+    if (!platform_map_file (path, &(pArchive->mapping))) return 0;
+    const unsigned char* pBytes = pArchive->mapping.pBytes;
+    size_t size = pArchive->mapping.size;
+    if (size < ARCHIVE_HEADER_SIZE || memcmp (pBytes, ARCHIVE_MAGIC, 4) != 0
+        || le_get32 (pBytes + 4) != ARCHIVE_VERSION) {
+        archive_close (pArchive);
+        return 0;
+    }
+    unsigned long long countSongs = le_get32 (pBytes + 8);
+    unsigned long long countBuckets = le_get32 (pBytes + 12);
+    unsigned long long namesOffset = le_get64 (pBytes + 16);
+    unsigned long long songsOffset = le_get64 (pBytes + 24);
+    if (countBuckets <= countSongs || (countBuckets & (countBuckets - 1)) != 0
+        || namesOffset != ARCHIVE_HEADER_SIZE + (countSongs * ARCHIVE_ENTRY_SIZE) + (countBuckets * 4)
+        || songsOffset < namesOffset || songsOffset > size) {
+        archive_close (pArchive);
+        return 0;
+    }
+    pArchive->countSongs = (unsigned int)countSongs;
+    pArchive->countBuckets = (unsigned int)countBuckets;
+    pArchive->pDirectory = pBytes + ARCHIVE_HEADER_SIZE;
+    pArchive->pBuckets = pArchive->pDirectory + (countSongs * ARCHIVE_ENTRY_SIZE);
+    pArchive->pNames = pBytes + namesOffset;
+    pArchive->namesSize = (size_t)(songsOffset - namesOffset);
+    return 1;
+}
+
+
+// Get a song's name.
+const char* archive_song_name (
+    const struct archive* pArchive, // Open archive.
+    unsigned int          song,     // Index of song in the directory, less than pArchive->countSongs.
+    size_t*               pNameLen  // Output param, set to the length of the name.
+    // Returns pointer to the name, which isn't 0-terminated, or NULL if the directory entry is corrupt.
+){
+    const unsigned char* pEntry = pArchive->pDirectory + ((size_t)song * ARCHIVE_ENTRY_SIZE);
+    size_t nameOffset = le_get32 (pEntry + 12);
+    size_t nameLen = le_get32 (pEntry + 16);
+    if (nameOffset > pArchive->namesSize || nameLen > pArchive->namesSize - nameOffset) return NULL;
+    *pNameLen = nameLen;
+    return (const char*)(pArchive->pNames + nameOffset);
+}
+
+
+// Get a song's encoded bytes.
+const unsigned char* archive_song_bytes (
+    const struct archive* pArchive,   // Open archive.
+    unsigned int          song,       // Index of song in the directory, less than pArchive->countSongs.
+    size_t*               pCountBytes // Output param, set to the count of bytes.
+    // Returns pointer to the bytes, which can be passed to render_bytes, or NULL if the directory entry is
+    // corrupt. Plain encoded songs are checked to end with a terminator, so parsing stops inside the archive.
+){
+    const unsigned char* pEntry = pArchive->pDirectory + ((size_t)song * ARCHIVE_ENTRY_SIZE);
+    unsigned long long offset = le_get64 (pEntry);
+    unsigned long long countBytes = le_get32 (pEntry + 8);
+    if (countBytes == 0 || offset > pArchive->mapping.size || countBytes > pArchive->mapping.size - offset) return NULL;
+    const unsigned char* pBytes = pArchive->mapping.pBytes + offset;
+    if (!container_is_container (pBytes, (size_t)countBytes) && pBytes[countBytes - 1] != 0) return NULL;
+    *pCountBytes = (size_t)countBytes;
+    return pBytes;
+}
+
+
+// Find a song by name, using the hash table.
+int archive_find (
+    const struct archive* pArchive, // Open archive.
+    const char*           name      // Name of song, 0-terminated.
+    // Returns index of the song in the directory, or -1 if there's no song with that name.
+){
+    if (pArchive->countSongs == 0) return -1;
+    size_t nameLen = strlen (name);
+    unsigned int mask = pArchive->countBuckets - 1;
+    unsigned int bucket = (unsigned int)hash_bytes ((const unsigned char*)name, nameLen, 0) & mask;
+    for (unsigned int probe = 0; probe < pArchive->countBuckets; ++probe, bucket = (bucket + 1) & mask) {
+        unsigned int song = le_get32 (pArchive->pBuckets + ((size_t)bucket * 4));
+        if (song == 0) return -1;
+        if (song > pArchive->countSongs) return -1; // Corrupt
+        size_t songNameLen;
+        const char* songName = archive_song_name (pArchive, song - 1, &songNameLen);
+        if (songName != NULL && songNameLen == nameLen && memcmp (songName, name, nameLen) == 0) {
+            return (int)(song - 1);
+        }
+    }
+    return -1;
+}
+
+
+
+//**********
+// Building
+//**********
+
+// One song file found while scanning a directory
+struct archive_source {
+    char*              name; // File name, allocated.
+    unsigned long long size; // File size in bytes.
+};
+
+// Song files found while scanning a directory
+struct archive_scan {
+    struct archive_source* pSources;
+    size_t                 count;
+    size_t                 capacity;
+    int                    failed;   // Set if out of memory.
+};
+
+// platform_list_dir callback that collects song files into a struct archive_scan
+void archive_scan_callback (void* pContext, const char* name, unsigned long long size, long long modifiedTime) {
+    struct archive_scan* pScan = pContext;
+    (void)modifiedTime; // Part of the callback signature, not needed here
+    if (size == 0 || pScan->failed) return;
+    if (pScan->count == pScan->capacity) {
+        size_t newCapacity = (pScan->capacity == 0) ? 256 : pScan->capacity * 2;
+        struct archive_source* pNew = realloc (pScan->pSources, newCapacity * sizeof (struct archive_source));
+        if (pNew == NULL) { pScan->failed = 1; return; }
+        pScan->pSources = pNew;
+        pScan->capacity = newCapacity;
+    }
+    size_t nameLen = strlen (name);
+    char* nameCopy = malloc (nameLen + 1);
+    if (nameCopy == NULL) { pScan->failed = 1; return; }
+    memcpy (nameCopy, name, nameLen + 1);
+    pScan->pSources[pScan->count].name = nameCopy;
+    pScan->pSources[pScan->count].size = size;
+    ++(pScan->count);
+}
+
+// qsort comparison putting sources in directory order
+int archive_compare_sources (const void* p1, const void* p2) {
+    return strcmp (((const struct archive_source*)p1)->name, ((const struct archive_source*)p2)->name);
+}
+
+
+// Free the names collected by a scan
+void archive_free_scan (
+    struct archive_scan* pScan // Scan to free.
+){
+    for (size_t i = 0; i < pScan->count; ++i) { free (pScan->pSources[i].name); }
+    free (pScan->pSources);
+}
+
+
+// Write an archive of every file in a directory, each stored under its file name, for cmd line option -ab.
+void try_build_archive (
+    char* dirPath,    // User-entered path of directory of encoded files. Subdirectories are skipped.
+    char* outFilepath // User-entered path of archive to write.
+){
+    struct archive_scan scan = { NULL, 0, 0, 0 };
+    if (!platform_list_dir (dirPath, archive_scan_callback, &scan) || scan.failed) {
+        printf ("  Unable to list directory %s\n", dirPath);
+        archive_free_scan (&scan);
+        return;
+    }
+    qsort (scan.pSources, scan.count, sizeof (struct archive_source), archive_compare_sources);
+
+    // Lay out the archive. A plain file without its terminator gets one, so every plain song ends with one.
+    unsigned int countSongs = (unsigned int)scan.count;
+    unsigned int countBuckets = archive_bucket_count (countSongs);
+    size_t namesOffset = ARCHIVE_HEADER_SIZE + ((size_t)countSongs * ARCHIVE_ENTRY_SIZE) + ((size_t)countBuckets * 4);
+    size_t namesSize = 0, songsSize = 0;
+    for (size_t i = 0; i < scan.count; ++i) {
+        namesSize += strlen (scan.pSources[i].name);
+        songsSize += (size_t)scan.pSources[i].size + 1;
+    }
+    size_t songsOffset = namesOffset + namesSize;
+    unsigned char* pArchive = calloc (songsOffset + songsSize, 1);
+    if (pArchive == NULL) {
+        printf ("  Memory allocation error\n");
+        archive_free_scan (&scan);
+        return;
+    }
+    memcpy (pArchive, ARCHIVE_MAGIC, 4);
+    le_put32 (pArchive + 4, ARCHIVE_VERSION);
+    le_put32 (pArchive + 8, countSongs);
+    le_put32 (pArchive + 12, countBuckets);
+    le_put64 (pArchive + 16, namesOffset);
+    le_put64 (pArchive + 24, songsOffset);
+
+    // Directory, names, songs' bytes, and hash table
+    unsigned char* pBuckets = pArchive + ARCHIVE_HEADER_SIZE + ((size_t)countSongs * ARCHIVE_ENTRY_SIZE);
+    size_t nameOffset = 0, songOffset = songsOffset;
+    for (unsigned int song = 0; song < countSongs; ++song) {
+        const char* name = scan.pSources[song].name;
+        size_t nameLen = strlen (name);
+        unsigned long long traceNs = trace_begin ();
+        char path[1024];
+        FILE* file = NULL;
+        if (snprintf (path, sizeof (path), "%s/%s", dirPath, name) >= (int)sizeof (path)
+            || fopen_s (&file, path, "rb") || file == NULL) {
+            printf ("  Unable to open file %s/%s\n", dirPath, name);
+            free (pArchive); archive_free_scan (&scan);
+            return;
+        }
+        size_t countBytes = fread (pArchive + songOffset, 1, (size_t)scan.pSources[song].size, file);
+        fclose (file);
+        if (countBytes != scan.pSources[song].size) {
+            printf ("  Unable to read file %s/%s\n", dirPath, name);
+            free (pArchive); archive_free_scan (&scan);
+            return;
+        }
+        const unsigned char* pSong = pArchive + songOffset;
+        if (!container_is_container (pSong, countBytes) && pSong[countBytes - 1] != 0) {
+            ++countBytes; // Add the terminator, already 0 from calloc
+        }
+
+        unsigned char* pEntry = pArchive + ARCHIVE_HEADER_SIZE + ((size_t)song * ARCHIVE_ENTRY_SIZE);
+        le_put64 (pEntry, songOffset);
+        le_put32 (pEntry + 8, (unsigned int)countBytes);
+        le_put32 (pEntry + 12, (unsigned int)nameOffset);
+        le_put32 (pEntry + 16, (unsigned int)nameLen);
+        memcpy (pArchive + namesOffset + nameOffset, name, nameLen);
+        unsigned int mask = countBuckets - 1;
+        unsigned int bucket = (unsigned int)hash_bytes ((const unsigned char*)name, nameLen, 0) & mask;
+        while (le_get32 (pBuckets + ((size_t)bucket * 4)) != 0) { bucket = (bucket + 1) & mask; }
+        le_put32 (pBuckets + ((size_t)bucket * 4), song + 1);
+        nameOffset += nameLen;
+        songOffset += countBytes;
+        trace_end ("archive_file", traceNs, song);
+    }
+    archive_free_scan (&scan);
+
+    // Write to a temporary file and rename, so a reader never maps a partly written archive
+    char tempPath[1100];
+    snprintf (tempPath, sizeof (tempPath), "%s.%lu.tmp", outFilepath, platform_process_id ());
+    FILE* file;
+    errno_t fopenErr = fopen_s (&file, tempPath, "wb");
+    if (fopenErr || file == NULL) {
+        printf ("  Unable to create file %s\n", outFilepath);
+        free (pArchive);
+        return;
+    }
+    int writeOk = fwrite (pArchive, 1, songOffset, file) == songOffset;
+    writeOk = (fclose (file) == 0) && writeOk;
+    if (!writeOk || !platform_rename_replace (tempPath, outFilepath)) {
+        printf ("  Unable to write file %s\n", outFilepath);
+        remove (tempPath);
+    }
+    else {
+        printf ("  Wrote %s: %u songs, %zu bytes\n", outFilepath, countSongs, songOffset);
+    }
+    free (pArchive);
+}
+
+
+
+//*****
+// IO
+//*****
+
+// Print the names and sizes of the songs in an archive, in name order, for cmd line option -al.
+void try_list_archive (
+    char* filepath // User-entered path of archive.
+){
+    struct archive archive;
+    if (!archive_open (filepath, &archive)) {
+        printf ("  Unable to open archive %s\n", filepath);
+        return;
+    }
+    for (unsigned int song = 0; song < archive.countSongs; ++song) {
+        size_t nameLen, countBytes;
+        const char* name = archive_song_name (&archive, song, &nameLen);
+        if (name == NULL || archive_song_bytes (&archive, song, &countBytes) == NULL) {
+            printf ("  Corrupt directory entry #%u\n", song);
+            continue;
+        }
+        printf ("%8zu  %.*s\n", countBytes, (int)nameLen, name);
+    }
+    printf ("  %u songs\n", archive.countSongs);
+    archive_close (&archive);
+}
+
+
+// Print one song from an archive, for cmd line option -ar.
+void try_read_archive_song (
+    char* filepath, // User-entered path of archive.
+    char* name,     // User-entered name of song.
+    char* widthStr  // User-entered string for maximum staff width, or NULL if not entered.
+){
+    int widthInt;
+    if (!parse_width_arg (widthStr, &widthInt)) return;
+    struct archive archive;
+    if (!archive_open (filepath, &archive)) {
+        printf ("  Unable to open archive %s\n", filepath);
+        return;
+    }
+    int song = archive_find (&archive, name);
+    size_t countBytes;
+    const unsigned char* pBytes = (song < 0) ? NULL : archive_song_bytes (&archive, (unsigned int)song, &countBytes);
+    if (pBytes == NULL) {
+        printf ("  No song named %s in archive %s\n", name, filepath);
+        archive_close (&archive);
+        return;
+    }
+
+    int errIndex;
+    int parseResult;
+    char* str = render_bytes (pBytes, countBytes, widthInt, &parseResult, &errIndex);
+    if (parseResult != PARSE_RESULT_PARSED_ALL) {
+        print_parse_error (parseResult, pBytes, errIndex);
+    }
+    else if (str == NULL) {
+        printf ("  Internal error while converting noteblocks to string\n");
+    }
+    else {
+        printf ("%s", str);
+    }
+    free (str);
+    archive_close (&archive);
+}
@@ -0,0 +1,30 @@
+//*****************************************************************************
+// music2_archive.h.
+// Scope: Private to music2 program.
+// Bare-bones .h file to facilitate linking. See the .c file for descriptions.
+//*****************************************************************************
+
+#pragma once
+
+#include <stddef.h> // size_t
+
+#include "music2_platform.h"
+
+struct archive {
+    struct platform_mapping mapping;
+    unsigned int            countSongs;
+    unsigned int            countBuckets;
+    const unsigned char*    pDirectory;
+    const unsigned char*    pBuckets;
+    const unsigned char*    pNames;
+    size_t                  namesSize;
+};
+int archive_is_archive (const unsigned char* pBytes, size_t countBytes);
+void archive_close (struct archive* pArchive);
+int archive_open (const char* path, struct archive* pArchive);
+const char* archive_song_name (const struct archive* pArchive, unsigned int song, size_t* pNameLen);
+const unsigned char* archive_song_bytes (const struct archive* pArchive, unsigned int song, size_t* pCountBytes);
+int archive_find (const struct archive* pArchive, const char* name);
+void try_build_archive (char* dirPath, char* outFilepath);
+void try_list_archive (char* filepath);
+void try_read_archive_song (char* filepath, char* name, char* widthStr);
@@ -0,0 +1,991 @@
+//*****************************************************************************************************
+// music2_bench.c
+// This file contains the benchmark behind cmd line option -p. It times rendering one input many times,
+// after some untimed warm-up runs, and reports each stage separately so parsing and string building can
+// be told apart:
+//   - parse:                parse_file_bytes (parse_bytes_start_to_end, for plain encoded bytes)
+//   - noteblocks_to_string: drawing the noteblocks into the printed string
+//   - free_noteblocks:      freeing the list of noteblocks
+// Times come from a monotonic nanosecond clock, and each stage's minimum, median, and 99th percentile over
+// the runs are printed as text, JSON, or CSV. The input is an example from option -v or any plain encoded
+// file, with or without a header.
+// With option --counters, each stage's mean performance counts per run are printed too: cycles, instructions,
+// branch misses, and cache misses where the processor allows, or some software counts where it doesn't.
+// With option --threads, it instead renders the input on 1, 2, ... threads at once, to see how throughput scales
+// across cores, and reports each thread count's combined throughput and latency of single renders.
+// It also contains microbenchmarks (option -pm), which time each noteblock make function and each note draw
+// function on its own, calling it with every input its encoding allows, so a slowdown points at one function.
+// Each make function handles one byte group type, so with --counters they give performance counts per type.
+// And it contains a scaling sweep (option -ps), which renders generated inputs from 1 KB up at staff widths from 5
+// to 255 and continuous, printing time, memory, and allocations as CSV for plotting how they grow.
+//*****************************************************************************************************
+
+
+// External inclusions
+#include <limits.h> // INT_MAX
+#include <stddef.h> // NULL, size_t
+#include <stdio.h>  // printf, putchar, fflush, fprintf
+#include <stdlib.h> // atoi, malloc, free, qsort
+#include <string.h> // memset, strcmp, strlen
+
+// Internal inclusions
+#include "music2_container.h"
+#include "music2_corpus.h"
+#include "music2_draw_note.h"
+#include "music2_draw_other.h"
+#include "music2_general2.h"
+#include "music2_header.h"
+#include "music2_memo.h"
+#include "music2_noteblock.h"
+#include "music2_platform.h"
+#include "music2_rans.h"
+#include "music2_stats.h"
+#include "music2_trace.h"
+
+
+//***********
+// Constants
+//***********
+
+// Fewest timed runs
+#define BENCH_RUNS_MIN (10)
+
+// Stages timed in each run, plus their total
+#define BENCH_STAGE_PARSE     (0)
+#define BENCH_STAGE_TO_STRING (1)
+#define BENCH_STAGE_FREE      (2)
+#define BENCH_STAGE_TOTAL     (3)
+#define BENCH_STAGE_COUNT     (4)
+
+// Names of the stages, as printed
+const char* BENCH_STAGE_NAMES[BENCH_STAGE_COUNT] = { "parse", "noteblocks_to_string", "free_noteblocks", "total" };
+
+// Output formats
+#define BENCH_FORMAT_TEXT (0)
+#define BENCH_FORMAT_JSON (1)
+#define BENCH_FORMAT_CSV  (2)
+
+
+
+//*********
+// Globals
+//*********
+
+// Whether -p and -pm read performance counters as well as the clock
+int benchUsesCounters = 0;
+
+
+// Set whether -p and -pm read performance counters.
+void bench_set_counters (
+    int usesCounters // 1 to read performance counters, 0 not to.
+){
+    benchUsesCounters = usesCounters;
+}
+
+
+// Open performance counters if they were asked for.
+void bench_open_counters (
+    struct platform_counters* pCounters // Output param, set to the counters, none if not asked for or available.
+){
+    pCounters->countCounters = 0;
+    if (!benchUsesCounters) return;
+    if (platform_counters_open (pCounters) == 0) {
+        fprintf (stderr, "  Performance counters unavailable\n");
+    }
+    else if (pCounters->isSoftware) {
+        fprintf (stderr, "  Hardware performance counters unavailable, using software counters\n");
+    }
+}
+
+
+
+//*******
+// Input
+//*******
+
+// What's rendered in each run
+struct bench_input {
+    const char*    name;            // Example type or file path, as entered.
+    unsigned char* pBytes;          // Encoded bytes, plus a 0 after them.
+    size_t         countBytes;      // Number of encoded bytes.
+    int            isFile;          // 1 if pBytes was read from a file and must be freed, 0 for an example.
+    int            width;           // Max width of a staff in characters.
+    unsigned int   countGroups;     // Byte groups, not including the terminator.
+    unsigned int   countNoteblocks; // Noteblocks drawn.
+    size_t         countOutBytes;   // Length of the printed string.
+};
+
+
+// Count the byte groups in plain encoded bytes, with or without a header.
+unsigned int bench_count_groups (
+    const unsigned char* pBytes,    // Pointer to encoded bytes.
+    size_t               countBytes // Number of encoded bytes.
+    // Returns the number of byte groups before the terminator or the first invalid byte group.
+){
+    size_t index = header_is_header (pBytes, countBytes) ? HEADER_SIZE : 0;
+    unsigned int countGroups = 0;
+    for (int length; (length = scan_byte_group (pBytes, countBytes, index)) > 0; index += length) {
+        ++countGroups;
+    }
+    return countGroups;
+}
+
+
+// Render an input once, to report errors before timing and to find the sizes.
+int bench_check_input (
+    struct bench_input* pInput // Input with name, pBytes, countBytes, and width set. The rest are set here.
+    // Returns 1 on success, otherwise prints an error and returns 0.
+){
+    struct noteblock* p1stNoteblock;
+    int errIndex;
+    int parseResult = parse_file_bytes (pInput->pBytes, pInput->countBytes, &p1stNoteblock, &errIndex);
+    char* str = (parseResult == PARSE_RESULT_PARSED_ALL) ? noteblocks_to_string (p1stNoteblock, pInput->width) : NULL;
+    pInput->countNoteblocks = count_noteblocks (p1stNoteblock);
+    free_noteblocks (p1stNoteblock);
+    if (parseResult != PARSE_RESULT_PARSED_ALL || str == NULL) {
+        if (parseResult != PARSE_RESULT_PARSED_ALL) { print_parse_error (parseResult, pInput->pBytes, errIndex); }
+        else { printf ("  Internal error while converting noteblocks to string\n"); }
+        return 0;
+    }
+    pInput->countOutBytes = strlen (str);
+    free (str);
+    pInput->countGroups = bench_count_groups (pInput->pBytes, pInput->countBytes);
+    return 1;
+}
+
+
+// Get the bytes to render from an example type or a file path, and render them once to check them.
+int bench_load_input (
+    char*               inputArg, // User-entered example type or file path, or NULL for the general example song.
+    char*               widthStr, // User-entered width for a file, or NULL for a continuous staff.
+    struct bench_input* pInput    // Output param, set to the input. Free pBytes if isFile is set.
+    // Returns 1 on success, otherwise prints an error and returns 0.
+){
+    pInput->name = (inputArg == NULL) ? "example" : inputArg;
+    pInput->isFile = 0;
+    unsigned char* pExampleBytes = NULL;
+    if (widthStr == NULL && get_example_bytes_width (inputArg, &pExampleBytes, &(pInput->width))) {
+        pInput->pBytes = pExampleBytes;
+        pInput->countBytes = strlen ((char*)pExampleBytes) + 1;
+    }
+    else {
+        // Not an example, so it's a file. Generated files (option -g) can be larger than the limit on files to
+        // print.
+        if (!parse_width_arg (widthStr, &(pInput->width))) return 0;
+        pInput->pBytes = read_large_file_bytes (inputArg, &(pInput->countBytes));
+        if (pInput->pBytes == NULL) return 0;
+        pInput->isFile = 1;
+        if (container_is_container (pInput->pBytes, pInput->countBytes)
+            || rans_is_compressed (pInput->pBytes, pInput->countBytes)) {
+            printf ("  Option -p needs plain encoded bytes, not a container or compressed file: %s\n", inputArg);
+            free (pInput->pBytes);
+            return 0;
+        }
+    }
+
+    if (!bench_check_input (pInput)) {
+        if (pInput->isFile) { free (pInput->pBytes); }
+        return 0;
+    }
+    return 1;
+}
+
+
+
+//*********
+// Results
+//*********
+
+// One stage's times over all runs, in nanoseconds
+struct bench_summary {
+    unsigned long long minNs;
+    unsigned long long medianNs;
+    unsigned long long p99Ns;
+};
+
+
+// Order times for qsort
+int bench_compare_ns (
+    const void* pA, // Pointer to an unsigned long long.
+    const void* pB  // Pointer to an unsigned long long.
+    // Returns negative, 0, or positive as *pA is less than, equal to, or greater than *pB.
+){
+    unsigned long long a = *(const unsigned long long*)pA;
+    unsigned long long b = *(const unsigned long long*)pB;
+    return (a > b) - (a < b);
+}
+
+
+// Get a stage's name, as printed.
+const char* bench_stage_name (
+    int stage // One of the BENCH_STAGEs.
+){
+    return BENCH_STAGE_NAMES[stage];
+}
+
+
+// Summarize a stage's times.
+struct bench_summary bench_summarize (
+    unsigned long long* pNs,     // Times of each run. Sorted in place.
+    unsigned int        countRuns // Number of runs, at least 1.
+    // Returns the minimum, median, and 99th percentile (nearest rank).
+){
+    qsort (pNs, countRuns, sizeof (unsigned long long), bench_compare_ns);
+    struct bench_summary summary;
+    summary.minNs = pNs[0];
+    summary.medianNs = pNs[(countRuns - 1) / 2];
+    unsigned int p99Rank = (unsigned int)(((unsigned long long)countRuns * 99 + 99) / 100); // Rounded up
+    summary.p99Ns = pNs[p99Rank - 1];
+    return summary;
+}
+
+
+// Print a string as a JSON string, with quotes.
+void bench_print_json_string (
+    const char* str // String to print.
+){
+    putchar ('"');
+    for (const unsigned char* p = (const unsigned char*)str; *p != '\0'; ++p) {
+        if (*p == '"' || *p == '\\') { putchar ('\\'); putchar (*p); }
+        else if (*p < 0x20) { printf ("\\u%04x", *p); }
+        else { putchar (*p); }
+    }
+    putchar ('"');
+}
+
+
+// Print a string as a CSV field, with quotes.
+void bench_print_csv_string (
+    const char* str // String to print.
+){
+    putchar ('"');
+    for (const char* p = str; *p != '\0'; ++p) {
+        if (*p == '"') { putchar ('"'); }
+        putchar (*p);
+    }
+    putchar ('"');
+}
+
+
+// Print the results in one of the BENCH_FORMATs.
+void bench_print_results (
+    const struct bench_input*       pInput,       // What was rendered.
+    unsigned int                    countRuns,    // Timed runs.
+    unsigned int                    countWarmUp,  // Untimed runs before them.
+    const struct bench_summary*     pSummaries,   // BENCH_STAGE_COUNT summaries.
+    const struct platform_counters* pCounters,    // Counters read during the runs, possibly none.
+    const unsigned long long*       pCounterSums, // Each stage's PLATFORM_COUNTERS_MAX counts over all timed runs.
+    int                             format        // One of the BENCH_FORMATs.
+){
+    // Throughput at the median total time
+    double seconds = (double)pSummaries[BENCH_STAGE_TOTAL].medianNs / 1e9;
+    double groupsPerSecond = (seconds > 0) ? pInput->countGroups / seconds : 0;
+    double outMBPerSecond = (seconds > 0) ? (pInput->countOutBytes / 1e6) / seconds : 0;
+
+    if (format == BENCH_FORMAT_JSON) {
+        printf ("{\"input\": ");
+        bench_print_json_string (pInput->name);
+        // A continuous staff has no width
+        if (pInput->width == INT_MAX) { printf (", \"width\": null"); }
+        else { printf (", \"width\": %d", pInput->width); }
+        printf (", \"runs\": %u, \"warmUpRuns\": %u, \"byteGroups\": %u, \"noteblocks\": %u, \"outputBytes\": %zu,\n"
+            " \"stages\": [\n", countRuns, countWarmUp, pInput->countGroups, pInput->countNoteblocks,
+            pInput->countOutBytes);
+        for (int stage = 0; stage < BENCH_STAGE_COUNT; ++stage) {
+            printf ("  {\"name\": \"%s\", \"minNs\": %llu, \"medianNs\": %llu, \"p99Ns\": %llu",
+                BENCH_STAGE_NAMES[stage], pSummaries[stage].minNs, pSummaries[stage].medianNs,
+                pSummaries[stage].p99Ns);
+            if (pCounters->countCounters > 0) {
+                printf (", \"counterMeans\": {");
+                for (int c = 0; c < pCounters->countCounters; ++c) {
+                    printf ("%s\"%s\": %.1f", (c > 0) ? ", " : "", pCounters->names[c],
+                        (double)pCounterSums[stage * PLATFORM_COUNTERS_MAX + c] / countRuns);
+                }
+                printf ("}");
+            }
+            printf ("}%s\n", (stage + 1 < BENCH_STAGE_COUNT) ? "," : "");
+        }
+        printf (" ],\n");
+        if (pCounters->countCounters > 0) {
+            printf (" \"counters\": \"%s\",\n", pCounters->isSoftware ? "software" : "hardware");
+        }
+        printf (" \"byteGroupsPerSecond\": %.0f, \"outputMBPerSecond\": %.3f}\n", groupsPerSecond, outMBPerSecond);
+    }
+    else if (format == BENCH_FORMAT_CSV) {
+        printf ("input,stage,runs,min_ns,median_ns,p99_ns,byte_groups_per_s,output_mb_per_s");
+        for (int c = 0; c < pCounters->countCounters; ++c) { printf (",mean_%s", pCounters->names[c]); }
+        printf ("\n");
+        for (int stage = 0; stage < BENCH_STAGE_COUNT; ++stage) {
+            bench_print_csv_string (pInput->name);
+            printf (",%s,%u,%llu,%llu,%llu,%.0f,%.3f", BENCH_STAGE_NAMES[stage], countRuns, pSummaries[stage].minNs,
+                pSummaries[stage].medianNs, pSummaries[stage].p99Ns, groupsPerSecond, outMBPerSecond);
+            for (int c = 0; c < pCounters->countCounters; ++c) {
+                printf (",%.1f", (double)pCounterSums[stage * PLATFORM_COUNTERS_MAX + c] / countRuns);
+            }
+            printf ("\n");
+        }
+    }
+    else {
+        printf ("  %s: %u byte groups, %u noteblocks, %zu bytes of output\n", pInput->name, pInput->countGroups,
+            pInput->countNoteblocks, pInput->countOutBytes);
+        printf ("  %u timed runs after %u warm-up runs\n", countRuns, countWarmUp);
+        printf ("  %-22s %12s %12s %12s\n", "Stage", "min (us)", "median (us)", "p99 (us)");
+        for (int stage = 0; stage < BENCH_STAGE_COUNT; ++stage) {
+            printf ("  %-22s %12.3f %12.3f %12.3f\n", BENCH_STAGE_NAMES[stage], pSummaries[stage].minNs / 1e3,
+                pSummaries[stage].medianNs / 1e3, pSummaries[stage].p99Ns / 1e3);
+        }
+        printf ("  Throughput at median: %.0f byte groups/s, %.3f MB/s of output\n", groupsPerSecond, outMBPerSecond);
+        if (pCounters->countCounters > 0) {
+            printf ("  Mean %s counts per run\n", pCounters->isSoftware ? "software" : "hardware");
+            printf ("  %-22s", "Stage");
+            for (int c = 0; c < pCounters->countCounters; ++c) { printf (" %17s", pCounters->names[c]); }
+            printf ("\n");
+            for (int stage = 0; stage < BENCH_STAGE_COUNT; ++stage) {
+                printf ("  %-22s", BENCH_STAGE_NAMES[stage]);
+                for (int c = 0; c < pCounters->countCounters; ++c) {
+                    printf (" %17.0f", (double)pCounterSums[stage * PLATFORM_COUNTERS_MAX + c] / countRuns);
+                }
+                printf ("\n");
+            }
+        }
+    }
+}
+
+
+
+//********
+// Timing
+//********
+
+// Render an input repeatedly, timing each stage of each run after untimed warm-up runs. Counters are read
+// between stages, outside the clock readings, so reading them doesn't add to the times.
+void bench_run_stages (
+    const struct bench_input*       pInput,       // What to render, checked by bench_check_input.
+    unsigned int                    countRuns,    // Timed runs.
+    unsigned int                    countWarmUp,  // Untimed runs before them.
+    const struct platform_counters* pCounters,    // Counters to read between stages, possibly none.
+    unsigned long long*             pNs,          // Output param, array of BENCH_STAGE_COUNT * countRuns times, each
+                                                  // stage's countRuns times together.
+    unsigned long long*             pCounterSums  // Array of BENCH_STAGE_COUNT * PLATFORM_COUNTERS_MAX that each
+                                                  // stage's counts over the timed runs are added to.
+){
+    for (unsigned int run = 0; run < countWarmUp + countRuns; ++run) {
+        struct noteblock* p1stNoteblock;
+        int errIndex;
+        unsigned long long readings[BENCH_STAGE_TOTAL + 1][PLATFORM_COUNTERS_MAX]; // Before each stage and after
+        unsigned long long ns[BENCH_STAGE_TOTAL];
+        platform_counters_read (pCounters, readings[BENCH_STAGE_PARSE]);
+        unsigned long long time0 = platform_now_ns ();
+        parse_file_bytes (pInput->pBytes, pInput->countBytes, &p1stNoteblock, &errIndex);
+        ns[BENCH_STAGE_PARSE] = platform_now_ns () - time0;
+        platform_counters_read (pCounters, readings[BENCH_STAGE_TO_STRING]);
+        time0 = platform_now_ns ();
+        char* str = noteblocks_to_string (p1stNoteblock, pInput->width);
+        ns[BENCH_STAGE_TO_STRING] = platform_now_ns () - time0;
+        platform_counters_read (pCounters, readings[BENCH_STAGE_FREE]);
+        time0 = platform_now_ns ();
+        free_noteblocks (p1stNoteblock);
+        ns[BENCH_STAGE_FREE] = platform_now_ns () - time0;
+        platform_counters_read (pCounters, readings[BENCH_STAGE_TOTAL]);
+        free (str);
+        if (run < countWarmUp) continue;
+        unsigned int i = run - countWarmUp;
+        pNs[BENCH_STAGE_TOTAL * countRuns + i] = 0;
+        for (int stage = 0; stage < BENCH_STAGE_TOTAL; ++stage) {
+            pNs[stage * countRuns + i] = ns[stage];
+            pNs[BENCH_STAGE_TOTAL * countRuns + i] += ns[stage];
+            for (int c = 0; c < pCounters->countCounters; ++c) {
+                unsigned long long count = readings[stage + 1][c] - readings[stage][c];
+                pCounterSums[stage * PLATFORM_COUNTERS_MAX + c] += count;
+                pCounterSums[BENCH_STAGE_TOTAL * PLATFORM_COUNTERS_MAX + c] += count;
+            }
+        }
+    }
+}
+
+
+
+//*******************
+// Concurrent renders
+//*******************
+
+// Most threads -p --threads runs
+#define BENCH_THREADS_MAX (64)
+
+// What each thread of a concurrent run renders, and what it records
+struct bench_thread_context {
+    const struct bench_input* pInput;       // What every thread renders.
+    unsigned int              countRuns;    // Timed renders per thread.
+    unsigned int              countWarmUp;  // Untimed renders per thread before them.
+    unsigned long long*       pLatencyNs;   // Time of each timed render, countRuns per thread.
+    unsigned long long        startNs[BENCH_THREADS_MAX]; // When each thread started its timed renders.
+    unsigned long long        endNs[BENCH_THREADS_MAX];   // When each thread finished them.
+};
+
+
+// Render the input repeatedly on one thread, timing each whole render. Run by platform_run_parallel.
+void bench_thread_task (
+    void*        pContext, // Pointer to a bench_thread_context.
+    unsigned int task      // Thread number.
+){
+    struct bench_thread_context* pThreads = pContext;
+    const struct bench_input* pInput = pThreads->pInput;
+    unsigned long long* pLatencyNs = pThreads->pLatencyNs + (size_t)task * pThreads->countRuns;
+    for (unsigned int run = 0; run < pThreads->countWarmUp + pThreads->countRuns; ++run) {
+        struct noteblock* p1stNoteblock;
+        int errIndex;
+        unsigned long long time0 = platform_now_ns ();
+        if (run == pThreads->countWarmUp) { pThreads->startNs[task] = time0; }
+        parse_file_bytes (pInput->pBytes, pInput->countBytes, &p1stNoteblock, &errIndex);
+        char* str = noteblocks_to_string (p1stNoteblock, pInput->width);
+        free_noteblocks (p1stNoteblock);
+        free (str);
+        unsigned long long time1 = platform_now_ns ();
+        trace_end ("render", time0, run); // time0 is a platform_now_ns reading, as from trace_begin
+        if (run < pThreads->countWarmUp) continue;
+        pLatencyNs[run - pThreads->countWarmUp] = time1 - time0;
+    }
+    pThreads->endNs[task] = platform_now_ns ();
+}
+
+
+// Render the input on 1 to countThreads threads at once, each thread rendering it countRuns times, and print the
+// combined throughput and the latency of single renders for each thread count. The memo is shared by the whole
+// process and is only safe on one thread, so it's turned off, and each render draws every measure. So are render
+// stats (--stats), for the same reason.
+void bench_test_threads (
+    const struct bench_input* pInput,       // What to render.
+    unsigned int              countRuns,    // Timed renders per thread.
+    unsigned int              countWarmUp,  // Untimed renders per thread before them.
+    unsigned int              countThreads, // Most threads, at most BENCH_THREADS_MAX.
+    int                       format        // One of the BENCH_FORMATs.
+){
+    struct bench_thread_context threads;
+    threads.pInput = pInput;
+    threads.countRuns = countRuns;
+    threads.countWarmUp = countWarmUp;
+    threads.pLatencyNs = malloc (sizeof (unsigned long long) * countRuns * countThreads);
+    if (threads.pLatencyNs == NULL) {
+        printf ("  Memory allocation error\n");
+        return;
+    }
+    memo_set_enabled (0);
+    stats_skip_threads ();
+
+    if (format == BENCH_FORMAT_JSON) {
+        printf ("{\"input\": ");
+        bench_print_json_string (pInput->name);
+        printf (", \"runsPerThread\": %u, \"warmUpRunsPerThread\": %u, \"byteGroups\": %u, \"threads\": [\n",
+            countRuns, countWarmUp, pInput->countGroups);
+    }
+    else if (format == BENCH_FORMAT_CSV) {
+        printf ("input,threads,runs_per_thread,renders_per_s,byte_groups_per_s,speedup,min_ns,median_ns,p99_ns,"
+            "slowest_thread_median_ns\n");
+    }
+    else {
+        printf ("  %s: %u byte groups, %u timed runs per thread after %u warm-up runs, memo off\n", pInput->name,
+            pInput->countGroups, countRuns, countWarmUp);
+        printf ("  %7s %13s %16s %8s %12s %12s %12s %14s\n", "Threads", "Renders/s", "Byte groups/s", "Speedup",
+            "min (us)", "median (us)", "p99 (us)", "slowest (us)");
+    }
+    double rendersPerSecond1 = 0;
+    for (unsigned int count = 1; count <= countThreads; ++count) {
+        platform_run_parallel (count, count, bench_thread_task, &threads);
+
+        // Throughput over the span in which any thread was timing. Each thread's median shows whether some
+        // threads were starved.
+        unsigned long long startNs = threads.startNs[0], endNs = threads.endNs[0];
+        unsigned long long slowestMedianNs = 0;
+        for (unsigned int t = 0; t < count; ++t) {
+            if (threads.startNs[t] < startNs) { startNs = threads.startNs[t]; }
+            if (threads.endNs[t] > endNs) { endNs = threads.endNs[t]; }
+            unsigned long long* pThreadNs = threads.pLatencyNs + (size_t)t * countRuns;
+            struct bench_summary threadSummary = bench_summarize (pThreadNs, countRuns);
+            if (threadSummary.medianNs > slowestMedianNs) { slowestMedianNs = threadSummary.medianNs; }
+        }
+        struct bench_summary summary = bench_summarize (threads.pLatencyNs, countRuns * count);
+        double seconds = (endNs > startNs) ? (double)(endNs - startNs) / 1e9 : 0;
+        double rendersPerSecond = (seconds > 0) ? (double)countRuns * count / seconds : 0;
+        double groupsPerSecond = rendersPerSecond * pInput->countGroups;
+        if (count == 1) { rendersPerSecond1 = rendersPerSecond; }
+        double speedup = (rendersPerSecond1 > 0) ? rendersPerSecond / rendersPerSecond1 : 0;
+
+        if (format == BENCH_FORMAT_JSON) {
+            printf ("  {\"threads\": %u, \"rendersPerSecond\": %.1f, \"byteGroupsPerSecond\": %.0f, \"speedup\": %.2f, "
+                "\"minNs\": %llu, \"medianNs\": %llu, \"p99Ns\": %llu, \"slowestThreadMedianNs\": %llu}%s\n", count,
+                rendersPerSecond, groupsPerSecond, speedup, summary.minNs, summary.medianNs, summary.p99Ns,
+                slowestMedianNs, (count < countThreads) ? "," : "");
+        }
+        else if (format == BENCH_FORMAT_CSV) {
+            bench_print_csv_string (pInput->name);
+            printf (",%u,%u,%.1f,%.0f,%.2f,%llu,%llu,%llu,%llu\n", count, countRuns, rendersPerSecond, groupsPerSecond,
+                speedup, summary.minNs, summary.medianNs, summary.p99Ns, slowestMedianNs);
+        }
+        else {
+            printf ("  %7u %13.1f %16.0f %8.2f %12.3f %12.3f %12.3f %14.3f\n", count, rendersPerSecond,
+                groupsPerSecond, speedup, summary.minNs / 1e3, summary.medianNs / 1e3, summary.p99Ns / 1e3,
+                slowestMedianNs / 1e3);
+        }
+        fflush (stdout); // Many threads take a while, so show each count as it's done
+    }
+    if (format == BENCH_FORMAT_JSON) { printf ("]}\n"); }
+    free (threads.pLatencyNs);
+}
+
+
+
+//*****
+// IO
+//*****
+
+// Test performance by rendering an example or a file many times, for cmd line option -p.
+void test_performance (
+    char* countStr,  // User-entered number of timed runs. Should be >= BENCH_RUNS_MIN.
+    char* inputArg,  // User-entered example type or file path, or NULL for the general example song. A type that
+                     // names no example is read as a file.
+    char* widthStr,  // User-entered width for a file, or NULL for a continuous staff.
+    char* formatStr, // User-entered output format: "text", "json", or "csv". NULL means text.
+    char* threadsStr // User-entered most threads to render on at once, or NULL to time each stage on one thread.
+){
+    // Parse args
+    int countInt = atoi (countStr); // Returns 0 if not parsable
+    if (countInt < BENCH_RUNS_MIN) {
+        if (countInt <= 0) {
+            printf ("  Invalid count\n");
+        }
+        else {
+            printf ("  Invalid count: %s < %d\n", countStr, BENCH_RUNS_MIN);
+        }
+        return;
+    }
+    int format = (formatStr == NULL || strcmp (formatStr, "text") == 0) ? BENCH_FORMAT_TEXT
+               : (strcmp (formatStr, "json") == 0) ? BENCH_FORMAT_JSON
+               : (strcmp (formatStr, "csv") == 0) ? BENCH_FORMAT_CSV : -1;
+    if (format < 0) {
+        printf ("  Invalid format \"%s\"\n", formatStr);
+        return;
+    }
+    int countThreads = (threadsStr == NULL) ? 0 : atoi (threadsStr);
+    if (threadsStr != NULL && (countThreads < 1 || countThreads > BENCH_THREADS_MAX)) {
+        printf ("  Invalid thread count (1 to %d)\n", BENCH_THREADS_MAX);
+        return;
+    }
+    struct bench_input input;
+    if (!bench_load_input (inputArg, widthStr, &input)) return;
+    unsigned int countRuns = (unsigned int)countInt;
+    unsigned int countWarmUp = countRuns / 10;
+    if (countThreads > 0) {
+        bench_test_threads (&input, countRuns, countWarmUp, (unsigned int)countThreads, format);
+        if (input.isFile) { free (input.pBytes); }
+        return;
+    }
+
+    // One array of times per stage
+    unsigned long long* pNs = malloc (sizeof (unsigned long long) * BENCH_STAGE_COUNT * countRuns);
+    if (pNs == NULL) {
+        printf ("  Memory allocation error\n");
+        if (input.isFile) { free (input.pBytes); }
+        return;
+    }
+
+    struct platform_counters counters;
+    bench_open_counters (&counters);
+    unsigned long long counterSums[BENCH_STAGE_COUNT * PLATFORM_COUNTERS_MAX] = {0};
+
+    bench_run_stages (&input, countRuns, countWarmUp, &counters, pNs, counterSums);
+
+    // Output
+    struct bench_summary summaries[BENCH_STAGE_COUNT];
+    for (int stage = 0; stage < BENCH_STAGE_COUNT; ++stage) {
+        summaries[stage] = bench_summarize (pNs + (size_t)stage * countRuns, countRuns);
+    }
+    bench_print_results (&input, countRuns, countWarmUp, summaries, &counters, counterSums, format);
+    platform_counters_close (&counters);
+    free (pNs);
+    if (input.isFile) { free (input.pBytes); }
+}
+
+
+
+//*****************
+// Microbenchmarks
+//*****************
+
+// Inputs timed together, between two readings of the clock
+#define MICRO_BATCH_SIZE (4096)
+
+// Fewest calls per function per round. Functions with smaller domains go through them repeatedly.
+#define MICRO_CALLS_MIN (65536)
+
+// Where a batch of calls draws
+struct micro_batch {
+    char*             pText;                          // Noteblock text that draw functions draw in.
+    struct noteblock* pNoteblocks[MICRO_BATCH_SIZE]; // Noteblocks that make functions made, freed after timing.
+};
+
+// A function to time, and how to call it with each input in its domain
+struct micro_function {
+    const char*  name;
+    unsigned int countInputs; // Size of the function's domain.
+    void         (*pRun) (struct micro_batch* pBatch, unsigned int first, unsigned int count); // Calls the
+                              // function with inputs first to first + count - 1.
+};
+
+
+// Each input is bits 4-8 of byte 1 (bits 1-3 are always 001) and byte 2.
+void micro_run_make_nn (struct micro_batch* pBatch, unsigned int first, unsigned int count) {
+    for (unsigned int i = 0; i < count; ++i) {
+        unsigned int input = first + i;
+        pBatch->pNoteblocks[i] = make_nn ((unsigned char)(((input >> 8) << 3) | 0b001), (unsigned char)input, 0);
+    }
+}
+
+// Each input is bits 4-8 of byte 1 (bits 1-3 are always 101), byte 2, and byte 3.
+void micro_run_make_nb (struct micro_batch* pBatch, unsigned int first, unsigned int count) {
+    for (unsigned int i = 0; i < count; ++i) {
+        unsigned int input = first + i;
+        pBatch->pNoteblocks[i] = make_nb ((unsigned char)(((input >> 16) << 3) | 0b101), (unsigned char)(input >> 8),
+            (unsigned char)input, 0);
+    }
+}
+
+// Each input is the arrangement bit and the 11 pitch bits of each of the two bit strings.
+void micro_run_make_key_signature (struct micro_batch* pBatch, unsigned int first, unsigned int count) {
+    for (unsigned int i = 0; i < count; ++i) {
+        unsigned int input = first + i;
+        unsigned short bits01to16 = (unsigned short)(0b11 | ((input >> 22) << 2) | ((input & 0x7FF) << 3));
+        unsigned short bits17to32 = (unsigned short)(((input >> 11) & 0x7FF) << 3);
+        pBatch->pNoteblocks[i] = make_key_signature (bits01to16, bits17to32);
+    }
+}
+
+// Each input is bits 3-8 of the byte (bits 1-2 are always 10).
+void micro_run_make_time_signature (struct micro_batch* pBatch, unsigned int first, unsigned int count) {
+    for (unsigned int i = 0; i < count; ++i) {
+        pBatch->pNoteblocks[i] = make_time_signature ((unsigned char)(((first + i) << 2) | 0b10));
+    }
+}
+
+// Each input is bits 5-8 of the byte (bits 1-4 are always 0100).
+void micro_run_make_barline (struct micro_batch* pBatch, unsigned int first, unsigned int count) {
+    for (unsigned int i = 0; i < count; ++i) {
+        pBatch->pNoteblocks[i] = make_barline ((unsigned char)(((first + i) << 4) | 0b0100));
+    }
+}
+
+// Each input is bits 7-8 of the byte (bits 1-6 are always 100000).
+void micro_run_make_clef (struct micro_batch* pBatch, unsigned int first, unsigned int count) {
+    for (unsigned int i = 0; i < count; ++i) {
+        pBatch->pNoteblocks[i] = make_clef ((unsigned char)(((first + i) << 6) | 0b100000));
+    }
+}
+
+// Each input is bits 5-8 of byte 1 (bits 1-4 are always 1000), byte 2, and byte 3.
+void micro_run_draw_dynamics_text_row (struct micro_batch* pBatch, unsigned int first, unsigned int count) {
+    for (unsigned int i = 0; i < count; ++i) {
+        unsigned int input = first + i;
+        draw_dynamics_text_row (pBatch->pText, (unsigned char)(((input >> 16) << 4) | 0b1000),
+            (unsigned char)(input >> 8), (unsigned char)input);
+    }
+}
+
+// Each input is whether the previous note is tied, byte 2, bits 4-8 of byte 1, and whether the note is NB.
+void micro_run_n_draw_pre_post_notehead_chars (struct micro_batch* pBatch, unsigned int first, unsigned int count) {
+    for (unsigned int i = 0; i < count; ++i) {
+        unsigned int input = first + i;
+        unsigned int parseInfo = (input & 1) ? 0x8100 : 0x0100; // Previous note, tied or not
+        unsigned char byte1 = (unsigned char)((((input >> 9) & 0x1F) << 3) | ((input >> 14) ? 0b101 : 0b001));
+        n_draw_pre_post_notehead_chars (pBatch->pText, byte1, (unsigned char)(input >> 1), parseInfo);
+    }
+}
+
+// Each input is byte 2, bits 4-8 of byte 1, and whether the note is NB.
+void micro_run_n_draw_articulation (struct micro_batch* pBatch, unsigned int first, unsigned int count) {
+    for (unsigned int i = 0; i < count; ++i) {
+        unsigned int input = first + i;
+        unsigned char byte1 = (unsigned char)((((input >> 8) & 0x1F) << 3) | ((input >> 13) ? 0b101 : 0b001));
+        n_draw_articulation (pBatch->pText, byte1, (unsigned char)input);
+    }
+}
+
+// Each input is byte 2.
+void micro_run_nn_draw_rest (struct micro_batch* pBatch, unsigned int first, unsigned int count) {
+    for (unsigned int i = 0; i < count; ++i) { nn_draw_rest (pBatch->pText, (unsigned char)(first + i)); }
+}
+
+// Each input is byte 2.
+void micro_run_nn_draw_notehead (struct micro_batch* pBatch, unsigned int first, unsigned int count) {
+    for (unsigned int i = 0; i < count; ++i) { nn_draw_notehead (pBatch->pText, (unsigned char)(first + i)); }
+}
+
+// Each input is byte 2.
+void micro_run_nn_draw_stem_flags (struct micro_batch* pBatch, unsigned int first, unsigned int count) {
+    for (unsigned int i = 0; i < count; ++i) { nn_draw_stem_flags (pBatch->pText, (unsigned char)(first + i)); }
+}
+
+// Each input is byte 2.
+void micro_run_nb_draw_notehead (struct micro_batch* pBatch, unsigned int first, unsigned int count) {
+    for (unsigned int i = 0; i < count; ++i) { nb_draw_notehead (pBatch->pText, (unsigned char)(first + i)); }
+}
+
+// Each input is byte 2 and byte 3.
+void micro_run_nb_draw_stem_beams (struct micro_batch* pBatch, unsigned int first, unsigned int count) {
+    for (unsigned int i = 0; i < count; ++i) {
+        unsigned int input = first + i;
+        nb_draw_stem_beams (pBatch->pText, (unsigned char)(input >> 8), (unsigned char)input);
+    }
+}
+
+// Functions timed by option -pm, with every input their encoding allows
+const struct micro_function MICRO_FUNCTIONS[] = {
+    { "make_nn",                        1 << 13, micro_run_make_nn },
+    { "make_nb",                        1 << 21, micro_run_make_nb },
+    { "make_key_signature",             1 << 23, micro_run_make_key_signature },
+    { "make_time_signature",            1 << 6,  micro_run_make_time_signature },
+    { "make_barline",                   1 << 4,  micro_run_make_barline },
+    { "make_clef",                      1 << 2,  micro_run_make_clef },
+    { "draw_dynamics_text_row",         1 << 20, micro_run_draw_dynamics_text_row },
+    { "n_draw_pre_post_notehead_chars", 1 << 15, micro_run_n_draw_pre_post_notehead_chars },
+    { "n_draw_articulation",            1 << 14, micro_run_n_draw_articulation },
+    { "nn_draw_rest",                   1 << 8,  micro_run_nn_draw_rest },
+    { "nn_draw_notehead",               1 << 8,  micro_run_nn_draw_notehead },
+    { "nn_draw_stem_flags",             1 << 8,  micro_run_nn_draw_stem_flags },
+    { "nb_draw_notehead",               1 << 8,  micro_run_nb_draw_notehead },
+    { "nb_draw_stem_beams",             1 << 16, micro_run_nb_draw_stem_beams },
+};
+#define MICRO_FUNCTION_COUNT (sizeof (MICRO_FUNCTIONS) / sizeof (MICRO_FUNCTIONS[0]))
+
+
+// Time one round of a function: every input in its domain, at least MICRO_CALLS_MIN calls.
+unsigned long long micro_time_round (
+    const struct micro_function*    pFunction,    // Function to time.
+    struct micro_batch*             pBatch,       // Where to draw and keep noteblocks.
+    const struct platform_counters* pCounters,    // Counters to read around the calls, possibly none.
+    unsigned long long*             pCounterSums, // Array of PLATFORM_COUNTERS_MAX that the calls' counts are added
+                                                  // to, or NULL not to add them.
+    unsigned long long*             pCalls        // Output param, set to the number of calls.
+    // Returns the time of all the calls, in nanoseconds, not counting freeing the noteblocks made.
+){
+    unsigned long long ns = 0;
+    *pCalls = 0;
+    do {
+        for (unsigned int first = 0; first < pFunction->countInputs; first += MICRO_BATCH_SIZE) {
+            unsigned int count = pFunction->countInputs - first;
+            if (count > MICRO_BATCH_SIZE) { count = MICRO_BATCH_SIZE; }
+            memset (pBatch->pNoteblocks, 0, count * sizeof (struct noteblock*));
+            unsigned long long readings[2][PLATFORM_COUNTERS_MAX];
+            platform_counters_read (pCounters, readings[0]);
+            unsigned long long time0 = platform_now_ns ();
+            pFunction->pRun (pBatch, first, count);
+            ns += platform_now_ns () - time0;
+            platform_counters_read (pCounters, readings[1]);
+            for (int c = 0; pCounterSums != NULL && c < pCounters->countCounters; ++c) {
+                pCounterSums[c] += readings[1][c] - readings[0][c];
+            }
+            for (unsigned int i = 0; i < count; ++i) { free_noteblocks (pBatch->pNoteblocks[i]); }
+            *pCalls += count;
+        }
+    } while (*pCalls < MICRO_CALLS_MIN);
+    return ns;
+}
+
+
+// Time each noteblock make function and draw function on its own, for cmd line option -pm.
+void test_microbenchmarks (
+    char* roundsStr,   // User-entered number of rounds, or NULL for 5.
+    char* functionArg, // User-entered function name, or NULL for all of them.
+    char* formatStr    // User-entered output format: "text", "json", or "csv". NULL means text.
+){
+    int countRounds = (roundsStr == NULL) ? 5 : atoi (roundsStr);
+    if (countRounds < 1) {
+        printf ("  Invalid count\n");
+        return;
+    }
+    int format = (formatStr == NULL || strcmp (formatStr, "text") == 0) ? BENCH_FORMAT_TEXT
+               : (strcmp (formatStr, "json") == 0) ? BENCH_FORMAT_JSON
+               : (strcmp (formatStr, "csv") == 0) ? BENCH_FORMAT_CSV : -1;
+    if (format < 0) {
+        printf ("  Invalid format \"%s\"\n", formatStr);
+        return;
+    }
+    int isFound = (functionArg == NULL);
+    for (size_t f = 0; f < MICRO_FUNCTION_COUNT; ++f) {
+        if (functionArg != NULL && strcmp (functionArg, MICRO_FUNCTIONS[f].name) == 0) { isFound = 1; }
+    }
+    if (!isFound) {
+        printf ("  Invalid function \"%s\"\n", functionArg);
+        return;
+    }
+    struct micro_batch* pBatch = malloc (sizeof (struct micro_batch));
+    unsigned long long* pNs = malloc ((size_t)countRounds * sizeof (unsigned long long));
+    struct noteblock* pTextNoteblock = allocate_noteblock ();
+    if (pBatch == NULL || pNs == NULL || pTextNoteblock == NULL) {
+        printf ("  Memory allocation error\n");
+        free (pBatch); free (pNs); free (pTextNoteblock);
+        return;
+    }
+    memset (pTextNoteblock, 1, sizeof (struct noteblock));
+    pTextNoteblock->pNext = NULL;
+    pBatch->pText = get_ptr_to_text (pTextNoteblock);
+    struct platform_counters counters;
+    bench_open_counters (&counters);
+
+    if (format == BENCH_FORMAT_JSON) {
+        printf ("{\"rounds\": %d, ", countRounds);
+        if (counters.countCounters > 0) {
+            printf ("\"counters\": \"%s\", ", counters.isSoftware ? "software" : "hardware");
+        }
+        printf ("\"functions\": [\n");
+    }
+    else if (format == BENCH_FORMAT_CSV) {
+        printf ("function,inputs,calls,rounds,min_ns_per_call,median_ns_per_call");
+        for (int c = 0; c < counters.countCounters; ++c) { printf (",%s_per_call", counters.names[c]); }
+        printf ("\n");
+    }
+    else {
+        printf ("  %-32s %10s %10s %12s %15s", "Function", "Inputs", "Calls", "min ns/call", "median ns/call");
+        for (int c = 0; c < counters.countCounters; ++c) { printf (" %17s", counters.names[c]); }
+        printf ("\n");
+    }
+    int isFirst = 1;
+    for (size_t f = 0; f < MICRO_FUNCTION_COUNT; ++f) {
+        const struct micro_function* pFunction = &(MICRO_FUNCTIONS[f]);
+        if (functionArg != NULL && strcmp (functionArg, pFunction->name) != 0) continue;
+
+        // One untimed round to warm up, then the timed rounds. Counts are the mean over all timed rounds.
+        unsigned long long countCalls;
+        unsigned long long counterSums[PLATFORM_COUNTERS_MAX] = {0};
+        micro_time_round (pFunction, pBatch, &counters, NULL, &countCalls);
+        for (int round = 0; round < countRounds; ++round) {
+            pNs[round] = micro_time_round (pFunction, pBatch, &counters, counterSums, &countCalls);
+        }
+        struct bench_summary summary = bench_summarize (pNs, (unsigned int)countRounds);
+        double minNsPerCall = (double)summary.minNs / countCalls;
+        double medianNsPerCall = (double)summary.medianNs / countCalls;
+        double countPerCall[PLATFORM_COUNTERS_MAX];
+        for (int c = 0; c < counters.countCounters; ++c) {
+            countPerCall[c] = (double)counterSums[c] / ((double)countCalls * countRounds);
+        }
+
+        if (format == BENCH_FORMAT_JSON) {
+            printf ("%s  {\"name\": \"%s\", \"inputs\": %u, \"calls\": %llu, \"minNsPerCall\": %.2f, "
+                "\"medianNsPerCall\": %.2f", isFirst ? "" : ",\n", pFunction->name, pFunction->countInputs,
+                countCalls, minNsPerCall, medianNsPerCall);
+            if (counters.countCounters > 0) {
+                printf (", \"countsPerCall\": {");
+                for (int c = 0; c < counters.countCounters; ++c) {
+                    printf ("%s\"%s\": %.3f", (c > 0) ? ", " : "", counters.names[c], countPerCall[c]);
+                }
+                printf ("}");
+            }
+            printf ("}");
+        }
+        else if (format == BENCH_FORMAT_CSV) {
+            printf ("%s,%u,%llu,%d,%.2f,%.2f", pFunction->name, pFunction->countInputs, countCalls, countRounds,
+                minNsPerCall, medianNsPerCall);
+            for (int c = 0; c < counters.countCounters; ++c) { printf (",%.3f", countPerCall[c]); }
+            printf ("\n");
+        }
+        else {
+            printf ("  %-32s %10u %10llu %12.2f %15.2f", pFunction->name, pFunction->countInputs, countCalls,
+                minNsPerCall, medianNsPerCall);
+            for (int c = 0; c < counters.countCounters; ++c) { printf (" %17.3f", countPerCall[c]); }
+            printf ("\n");
+        }
+        fflush (stdout); // Some functions take a while, so show each as it's done
+        isFirst = 0;
+    }
+    if (format == BENCH_FORMAT_JSON) { printf ("\n]}\n"); }
+    platform_counters_close (&counters);
+    free (pBatch); free (pNs); free (pTextNoteblock);
+}
+
+
+
+//*********
+// Scaling
+//*********
+
+// Smallest input size in the scaling sweep. Each size after it is 4 times bigger.
+#define SCALING_SIZE_MIN (1024ULL)
+
+// Default largest input size in the scaling sweep. Very large sizes need many times their size in memory.
+#define SCALING_SIZE_MAX_DEFAULT (16ULL * 1024 * 1024)
+
+// Staff widths in the scaling sweep. INT_MAX means a continuous staff.
+const int SCALING_WIDTHS[] = {5, 10, 20, 40, 80, 160, 255, INT_MAX};
+#define SCALING_WIDTH_COUNT (sizeof (SCALING_WIDTHS) / sizeof (SCALING_WIDTHS[0]))
+
+// Render generated inputs of growing size at each staff width, for cmd line option -ps, and print a CSV line
+// for each, for plotting how time and memory grow. Each line has:
+//   - wall_ns and cpu_ns:  Time to parse, draw into a string, and free the noteblocks.
+//   - peak_memory_bytes:   Peak resident memory during that, including the generated input. On systems where
+//                          the peak can't be reset (all but Linux), this is the peak since the program started.
+//   - allocations:         Blocks allocated: one per noteblock, one per measure stored by the memo, and the string.
+//   - output_bytes:        Length of the string, empty if it couldn't be made (status says why).
+// The memo keeps measures from one line to the next, as it would while printing many files.
+void test_scaling (
+    char* maxSizeStr, // User-entered largest input size (suffix K, M, or G allowed), or NULL for the default.
+    char* profileStr  // User-entered profile, or NULL for the default. See corpus_parse_profile.
+){
+    unsigned long long maxSize = (maxSizeStr == NULL) ? SCALING_SIZE_MAX_DEFAULT : corpus_parse_size (maxSizeStr);
+    if (maxSize < SCALING_SIZE_MIN) {
+        printf ("  Invalid size\n");
+        return;
+    }
+    struct corpus_profile profile;
+    if (!corpus_parse_profile (profileStr, &profile)) {
+        printf ("  Invalid profile \"%s\"\n", profileStr);
+        return;
+    }
+
+    printf ("profile,target_bytes,input_bytes,noteblocks,width,status,wall_ns,cpu_ns,peak_memory_bytes,allocations,"
+        "output_bytes\n");
+    for (unsigned long long size = SCALING_SIZE_MIN; size <= maxSize; size *= 4) {
+        // Same seed for every size, so a smaller input's music starts each bigger one
+        size_t countBytes;
+        unsigned long long countNoteblocks;
+        unsigned char* pBytes = corpus_generate (size, &profile, 0, &countBytes, &countNoteblocks);
+        if (pBytes == NULL) {
+            printf ("  Memory allocation error\n");
+            return;
+        }
+        for (size_t w = 0; w < SCALING_WIDTH_COUNT; ++w) {
+            int width = SCALING_WIDTHS[w];
+            struct memo_stats memoBefore = memo_get_stats ();
+            platform_reset_peak_memory ();
+            unsigned long long cpu0 = platform_cpu_time_ns ();
+            unsigned long long time0 = platform_now_ns ();
+            struct noteblock* p1stNoteblock;
+            int errIndex;
+            int parseResult = parse_file_bytes (pBytes, countBytes, &p1stNoteblock, &errIndex);
+            char* str = (parseResult == PARSE_RESULT_PARSED_ALL) ? noteblocks_to_string (p1stNoteblock, width) : NULL;
+            unsigned long long time1 = platform_now_ns ();
+            unsigned long long cpu1 = platform_cpu_time_ns ();
+            unsigned int countParsed = count_noteblocks (p1stNoteblock); // Not timed
+            unsigned long long time2 = platform_now_ns ();
+            unsigned long long cpu2 = platform_cpu_time_ns ();
+            free_noteblocks (p1stNoteblock);
+            unsigned long long time3 = platform_now_ns ();
+            unsigned long long cpu3 = platform_cpu_time_ns ();
+            unsigned long long peakMemory = platform_peak_memory ();
+            unsigned long long allocations = countParsed + (memo_get_stats ().stores - memoBefore.stores)
+                + (str != NULL);
+
+            // The string is measured and freed after the clocks stop, but before the next width's peak is reset
+            const char* status = (parseResult != PARSE_RESULT_PARSED_ALL) ? "parse_failed"
+                               : (str == NULL) ? "output_too_large" : "ok";
+            printf ("%s,%llu,%zu,%llu,", (profileStr == NULL) ? "typical" : profileStr, size, countBytes,
+                countNoteblocks);
+            if (width == INT_MAX) { printf ("continuous,"); } else { printf ("%d,", width); }
+            printf ("%s,%llu,%llu,%llu,%llu,", status, (time1 - time0) + (time3 - time2), (cpu1 - cpu0) + (cpu3 - cpu2),
+                peakMemory, allocations);
+            if (str != NULL) { printf ("%zu", strlen (str)); }
+            printf ("\n");
+            fflush (stdout); // Big sizes take a while, so show each line as it's done
+            free (str);
+        }
+        free (pBytes);
+        if (size > maxSize / 4) break; // Next size would pass the max, or overflow
+    }
+}
@@ -0,0 +1,42 @@
+//*****************************************************************************
+// music2_bench.h.
+// Scope: Private to music2 program.
+// Bare-bones .h file to facilitate linking. See the .c file for descriptions.
+//*****************************************************************************
+
+#pragma once
+
+#include <stddef.h> // size_t
+
+#include "music2_platform.h"
+
+#define BENCH_RUNS_MIN (10)
+#define BENCH_STAGE_PARSE     (0)
+#define BENCH_STAGE_TO_STRING (1)
+#define BENCH_STAGE_FREE      (2)
+#define BENCH_STAGE_TOTAL     (3)
+#define BENCH_STAGE_COUNT     (4)
+struct bench_input {
+    const char*    name;
+    unsigned char* pBytes;
+    size_t         countBytes;
+    int            isFile;
+    int            width;
+    unsigned int   countGroups;
+    unsigned int   countNoteblocks;
+    size_t         countOutBytes;
+};
+int bench_check_input (struct bench_input* pInput);
+struct bench_summary {
+    unsigned long long minNs;
+    unsigned long long medianNs;
+    unsigned long long p99Ns;
+};
+const char* bench_stage_name (int stage);
+struct bench_summary bench_summarize (unsigned long long* pNs, unsigned int countRuns);
+void bench_run_stages (const struct bench_input* pInput, unsigned int countRuns, unsigned int countWarmUp,
+    const struct platform_counters* pCounters, unsigned long long* pNs, unsigned long long* pCounterSums);
+void bench_set_counters (int usesCounters);
+void test_performance (char* countStr, char* inputArg, char* widthStr, char* formatStr, char* threadsStr);
+void test_microbenchmarks (char* roundsStr, char* functionArg, char* formatStr);
+void test_scaling (char* maxSizeStr, char* profileStr);
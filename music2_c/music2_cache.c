@@ -0,0 +1,302 @@
+//*****************************************************************************************************
+// music2_cache.c
+// This file contains an optional on-disk cache of rendered music. Rendering the same encoded bytes at the
+// same width always produces the same string, so a finished string can be stored in a file named after
+// (hash of input bytes, width, renderer version) and read back instead of rendering again. Each entry also
+// holds the input bytes, which are compared on a hit, so a hash collision is a miss rather than wrong music.
+// The cache is off until cache_configure is called with a directory.
+//   - Writes are atomic: a string is written to a temporary file, then renamed over the final name, so a
+//     concurrent reader sees either nothing or a complete entry.
+//   - The directory's total size is bounded. After each store, least recently used entries (by file
+//     modification time, refreshed on every hit) are deleted until the total fits.
+//   - Hits, misses, stores, and evictions are counted for the current process.
+//*****************************************************************************************************
+
+
+// External inclusions
+#include <stddef.h> // NULL, size_t
+#include <stdio.h>  // fopen_s, fread, fwrite, snprintf
+#include <stdlib.h> // malloc, free, qsort
+#include <string.h> // memcmp, strlen, strcpy_s
+
+// Internal inclusions
+#include "music2_hash.h"
+#include "music2_platform.h"
+
+
+//***********
+// Constants
+//***********
+
+// Bump this whenever a change to drawing or string building changes the output for some input, or the entry
+// format changes. Entries written by other versions are then never read, and age out through eviction.
+#define CACHE_RENDERER_VERSION (2)
+
+// Each cache file starts with this header, followed by the input bytes, then the rendered string without its '\0'.
+//   Bytes 0-3:   CACHE_FILE_MAGIC
+//   Bytes 4-11:  Hash of the input bytes, little-endian
+//   Bytes 12-19: Count of input bytes, little-endian
+#define CACHE_FILE_MAGIC       ("M2RC")
+#define CACHE_FILE_HEADER_SIZE (20)
+
+// File name extension of cache entries. Other files in the directory are left alone.
+#define CACHE_FILE_EXTENSION (".m2c")
+
+// Default bound on the total size of cache entries, used when cache_configure gets 0.
+#define CACHE_DEFAULT_MAX_BYTES (64ULL * 1024 * 1024)
+
+// Longest directory path the cache accepts, leaving room for an entry file name.
+#define CACHE_DIR_PATH_MAX (900)
+
+// Size of the chunks in which a lookup compares stored input bytes.
+#define CACHE_COMPARE_CHUNK_SIZE (4096)
+
+
+
+//*******
+// State
+//*******
+
+// Counters for the current process. Returned by cache_get_stats.
+struct cache_stats {
+    unsigned long long hits;      // Lookups that returned a stored string.
+    unsigned long long misses;    // Lookups that found no usable entry.
+    unsigned long long stores;    // Strings written to the cache.
+    unsigned long long evictions; // Entries deleted to keep the cache within its size bound.
+    unsigned long long errors;    // Failed writes and unreadable or corrupt entries.
+};
+
+// Cache directory, or empty if the cache is off.
+char cacheDirPath[CACHE_DIR_PATH_MAX + 1] = "";
+
+// Bound on the total size of cache entries, in bytes.
+unsigned long long cacheMaxBytes = CACHE_DEFAULT_MAX_BYTES;
+
+// Counters for the current process.
+struct cache_stats cacheStats = { 0 };
+
+
+
+//*********
+// Helpers
+//*********
+
+// Build the path of the cache entry for some input bytes and width.
+int cache_entry_path (
+    char               path[1024], // Output param, set to the entry's path.
+    unsigned long long hash,       // Hash of the input bytes, from hash_bytes.
+    int                width       // Max staff width the input was rendered with.
+    // Returns 1 on success, 0 if the path is too long.
+){
+    int len = snprintf (path, 1024, "%s/%016llx-w%d-v%d%s",
+        cacheDirPath, hash, width, CACHE_RENDERER_VERSION, CACHE_FILE_EXTENSION);
+    return 0 < len && len < 1024;
+}
+
+
+// Whether a file name ends with the cache entry extension
+int cache_is_entry_name (
+    const char* name // File name without directory.
+){
+    size_t nameLen = strlen (name);
+    size_t extLen = strlen (CACHE_FILE_EXTENSION);
+    return nameLen > extLen && strcmp (name + nameLen - extLen, CACHE_FILE_EXTENSION) == 0;
+}
+
+
+
+//*************************
+// Configuration and stats
+//*************************
+
+// Turn the cache on (or off) for the rest of the process.
+int cache_configure (
+    const char*        dirPath, // Cache directory, created if it doesn't exist. NULL or "" turns the cache off.
+    unsigned long long maxBytes // Bound on the total size of cache entries, or 0 for the default of 64 MB.
+    // Returns 1 on success, 0 if the directory is unusable (and the cache stays off).
+){
+    cacheDirPath[0] = '\0';
+    cacheMaxBytes = (maxBytes == 0) ? CACHE_DEFAULT_MAX_BYTES : maxBytes;
+    if (dirPath == NULL || dirPath[0] == '\0') return 1;
+    if (strlen (dirPath) > CACHE_DIR_PATH_MAX) return 0;
+    if (!platform_make_dir (dirPath)) return 0;
+    strcpy_s (cacheDirPath, sizeof (cacheDirPath), dirPath);
+    return 1;
+}
+
+
+// Whether cache_configure has turned the cache on.
+int cache_is_enabled () {
+    return cacheDirPath[0] != '\0';
+}
+
+
+// Get the counters for the current process.
+struct cache_stats cache_get_stats () {
+    return cacheStats;
+}
+
+
+
+//*********************
+// Lookup and storage
+//*********************
+
+// Look for a previously stored rendering of some input bytes at some width.
+// Entries are found by hash, then the stored input bytes are compared with the input.
+char* cache_lookup (
+    const unsigned char* pBytes,     // Pointer to encoded input bytes.
+    size_t               countBytes, // Number of input bytes.
+    unsigned long long   hash,       // hash_bytes (pBytes, countBytes, 0).
+    int                  width       // Max staff width.
+    // Returns the stored string (caller must free), or NULL on a miss or if the cache is off.
+){
+    if (!cache_is_enabled ()) return NULL;
+    char path[1024];
+    if (!cache_entry_path (path, hash, width)) { ++cacheStats.misses; return NULL; }
+
+    FILE* file;
+    errno_t fopenErr = fopen_s (&file, path, "rb");
+    if (fopenErr || file == NULL) { ++cacheStats.misses; return NULL; }
+    fseek (file, 0, SEEK_END);
+    long fileSize = ftell (file);
+    rewind (file);
+
+    // Validate header against the input we were asked about
+    unsigned char header[CACHE_FILE_HEADER_SIZE];
+    unsigned char expected[CACHE_FILE_HEADER_SIZE];
+    memcpy (expected, CACHE_FILE_MAGIC, 4);
+    le_put64 (expected + 4, hash);
+    le_put64 (expected + 12, countBytes);
+    if (fileSize < CACHE_FILE_HEADER_SIZE || (size_t)fileSize - CACHE_FILE_HEADER_SIZE < countBytes
+        || fread (header, 1, CACHE_FILE_HEADER_SIZE, file) != CACHE_FILE_HEADER_SIZE
+        || memcmp (header, expected, CACHE_FILE_HEADER_SIZE) != 0) {
+        fclose (file);
+        ++cacheStats.errors; ++cacheStats.misses;
+        return NULL;
+    }
+
+    // Compare the stored input bytes. A difference is a hash collision, so a miss rather than an error.
+    unsigned char chunk[CACHE_COMPARE_CHUNK_SIZE];
+    for (size_t done = 0; done < countBytes; ) {
+        size_t size = countBytes - done < sizeof (chunk) ? countBytes - done : sizeof (chunk);
+        if (fread (chunk, 1, size, file) != size || memcmp (chunk, pBytes + done, size) != 0) {
+            fclose (file);
+            ++cacheStats.misses;
+            return NULL;
+        }
+        done += size;
+    }
+
+    // Read the string
+    size_t strLen = (size_t)fileSize - CACHE_FILE_HEADER_SIZE - countBytes;
+    char* str = malloc (strLen + 1);
+    if (str == NULL || fread (str, 1, strLen, file) != strLen) {
+        free (str); fclose (file);
+        ++cacheStats.errors; ++cacheStats.misses;
+        return NULL;
+    }
+    fclose (file);
+    str[strLen] = '\0';
+
+    platform_touch_file (path); // Mark as recently used for eviction
+    ++cacheStats.hits;
+    return str;
+}
+
+
+// One cache entry found while scanning the directory for eviction
+struct cache_entry_info {
+    char               name[64];
+    unsigned long long size;
+    long long          modifiedTime;
+};
+
+// Entries found while scanning the directory for eviction
+struct cache_scan {
+    struct cache_entry_info* pEntries;
+    size_t                   count;
+    size_t                   capacity;
+    unsigned long long       totalBytes;
+};
+
+// platform_list_dir callback that collects cache entries into a struct cache_scan
+void cache_scan_callback (void* pContext, const char* name, unsigned long long size, long long modifiedTime) {
+    struct cache_scan* pScan = pContext;
+    if (!cache_is_entry_name (name) || strlen (name) >= sizeof (pScan->pEntries[0].name)) return;
+    if (pScan->count == pScan->capacity) {
+        size_t newCapacity = (pScan->capacity == 0) ? 64 : pScan->capacity * 2;
+        struct cache_entry_info* pNew = realloc (pScan->pEntries, newCapacity * sizeof (struct cache_entry_info));
+        if (pNew == NULL) return;
+        pScan->pEntries = pNew;
+        pScan->capacity = newCapacity;
+    }
+    struct cache_entry_info* pEntry = &(pScan->pEntries[pScan->count]);
+    strcpy_s (pEntry->name, sizeof (pEntry->name), name);
+    pEntry->size = size;
+    pEntry->modifiedTime = modifiedTime;
+    ++(pScan->count);
+    pScan->totalBytes += size;
+}
+
+// qsort comparison putting least recently used entries first
+int cache_compare_entries_lru (const void* p1, const void* p2) {
+    long long t1 = ((const struct cache_entry_info*)p1)->modifiedTime;
+    long long t2 = ((const struct cache_entry_info*)p2)->modifiedTime;
+    return (t1 > t2) - (t1 < t2);
+}
+
+
+// Delete least recently used entries until the cache fits within its size bound.
+void cache_evict () {
+    struct cache_scan scan = { NULL, 0, 0, 0 };
+    if (!platform_list_dir (cacheDirPath, cache_scan_callback, &scan)) return;
+    if (scan.totalBytes > cacheMaxBytes) {
+        qsort (scan.pEntries, scan.count, sizeof (struct cache_entry_info), cache_compare_entries_lru);
+        for (size_t i = 0; i < scan.count && scan.totalBytes > cacheMaxBytes; ++i) {
+            char path[1024];
+            snprintf (path, sizeof (path), "%s/%s", cacheDirPath, scan.pEntries[i].name);
+            if (remove (path) == 0) {
+                scan.totalBytes -= scan.pEntries[i].size;
+                ++cacheStats.evictions;
+            }
+        }
+    }
+    free (scan.pEntries);
+}
+
+
+// Store the rendering of some input bytes at some width.
+void cache_store (
+    const unsigned char* pBytes,     // Pointer to encoded input bytes.
+    size_t               countBytes, // Number of input bytes.
+    unsigned long long   hash,       // Same hash passed to cache_lookup.
+    int                  width,      // Max staff width.
+    const char*          str         // Rendered string to store.
+){
+    if (!cache_is_enabled () || str == NULL) return;
+    char path[1024], tempPath[1100];
+    if (!cache_entry_path (path, hash, width)) return;
+    // Temporary name is unique per process, and doesn't end with the entry extension so eviction skips it
+    snprintf (tempPath, sizeof (tempPath), "%s.%lu.tmp", path, platform_process_id ());
+
+    FILE* file;
+    errno_t fopenErr = fopen_s (&file, tempPath, "wb");
+    if (fopenErr || file == NULL) { ++cacheStats.errors; return; }
+    unsigned char header[CACHE_FILE_HEADER_SIZE];
+    memcpy (header, CACHE_FILE_MAGIC, 4);
+    le_put64 (header + 4, hash);
+    le_put64 (header + 12, countBytes);
+    size_t strLen = strlen (str);
+    int writeOk = fwrite (header, 1, CACHE_FILE_HEADER_SIZE, file) == CACHE_FILE_HEADER_SIZE
+        && fwrite (pBytes, 1, countBytes, file) == countBytes
+        && fwrite (str, 1, strLen, file) == strLen;
+    writeOk = (fclose (file) == 0) && writeOk;
+    if (!writeOk || !platform_rename_replace (tempPath, path)) {
+        remove (tempPath);
+        ++cacheStats.errors;
+        return;
+    }
+    ++cacheStats.stores;
+    cache_evict ();
+}
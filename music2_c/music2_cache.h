@@ -0,0 +1,23 @@
+//*****************************************************************************
+// music2_cache.h.
+// Scope: Private to music2 program.
+// Bare-bones .h file to facilitate linking. See the .c file for descriptions.
+//*****************************************************************************
+
+#pragma once
+
+#include <stddef.h> // size_t
+
+struct cache_stats {
+    unsigned long long hits;
+    unsigned long long misses;
+    unsigned long long stores;
+    unsigned long long evictions;
+    unsigned long long errors;
+};
+int cache_configure (const char* dirPath, unsigned long long maxBytes);
+int cache_is_enabled ();
+struct cache_stats cache_get_stats ();
+char* cache_lookup (const unsigned char* pBytes, size_t countBytes, unsigned long long hash, int width);
+void cache_store (const unsigned char* pBytes, size_t countBytes, unsigned long long hash, int width,
+    const char* str);
@@ -0,0 +1,473 @@
+//*****************************************************************************************************
+// music2_checkpoint.c
+// This file contains a sidecar checkpoint index for large encoded files. Byte group boundaries and the
+// parseInfo carried between byte groups are only known by reading from the start of the file, so without
+// help, showing the end of a huge score means parsing all of it. The index records, every N byte groups,
+// everything the parser needs to start there: the byte offset, parseInfo, and counts of byte groups and
+// noteblocks so far. It also records the clef, key signature, and time signature in effect, so a decode
+// starting partway through can show them first.
+// The index file is a fixed-size header followed by fixed-size records, all little-endian, so it can be
+// mapped into memory and binary searched in place. At 24 bytes per record it is about 1% of the input at
+// the default interval. Records hold 32-bit offsets and counts, and the parser's byte indexes are ints, so
+// inputs over INT_MAX bytes, or with too many noteblocks to count in 32 bits, aren't indexed.
+//*****************************************************************************************************
+
+
+// External inclusions
+#include <limits.h> // INT_MAX, UINT_MAX
+#include <stddef.h> // NULL, size_t
+#include <stdio.h>  // printf, fopen_s, fwrite, snprintf
+#include <stdlib.h> // malloc, realloc, free, atoi
+#include <string.h> // memcmp, memcpy
+
+// Internal inclusions
+#include "music2_draw_other.h"
+#include "music2_general2.h"
+#include "music2_hash.h"
+#include "music2_noteblock.h"
+#include "music2_platform.h"
+
+
+//*******************
+// Index file format
+//*******************
+
+// Header (40 bytes):
+//   Bytes 0-3:   CHECKPOINT_MAGIC
+//   Bytes 4-7:   CHECKPOINT_VERSION
+//   Bytes 8-11:  Interval - byte groups between checkpoints
+//   Bytes 12-15: Count of checkpoint records
+//   Bytes 16-23: Size of the indexed input file in bytes
+//   Bytes 24-31: hash_bytes of the first (up to) CHECKPOINT_HASHED_PREFIX bytes of the input, to catch an index
+//                used with the wrong file without hashing all of a huge file
+//   Bytes 32-39: Last-modified time of the input when it was indexed (see platform_file_modified_time), to
+//                catch edits past the hashed bytes that keep the size
+// Records (24 bytes each), in increasing order of every field that counts something:
+//   Bytes 0-3:   Byte offset of the byte group the checkpoint is before
+//   Bytes 4-7:   Count of byte groups before the checkpoint
+//   Bytes 8-11:  Count of noteblocks before the checkpoint
+//   Bytes 12-15: parseInfo as of the checkpoint - see update_parse_info
+//   Bytes 16-19: Bytes of the most recent key change, or 0s if none
+//   Byte  20:    Byte of the most recent time change, or 0 if none
+//   Byte  21:    Byte of the most recent clef, or 0 if none
+//   Bytes 22-23: Always 0
+// A checkpoint is never placed before dynamics text, because dynamics text modifies the previous noteblock.
+// If one is due there, it moves to the next byte group.
+#define CHECKPOINT_MAGIC            ("\x10M2I")
+#define CHECKPOINT_VERSION          (2)
+#define CHECKPOINT_HEADER_SIZE      (40)
+#define CHECKPOINT_RECORD_SIZE      (24)
+#define CHECKPOINT_HASHED_PREFIX    (65536)
+#define CHECKPOINT_DEFAULT_INTERVAL (256)
+
+// Set as checkpoint_build's error index when the input is too large to index
+#define CHECKPOINT_ERR_TOO_LARGE (-2)
+
+// File name extension added to the input file's name to name its index
+#define CHECKPOINT_FILE_EXTENSION (".m2i")
+
+
+// Hash the part of the input that an index header records
+unsigned long long checkpoint_prefix_hash (
+    const unsigned char* pBytes,    // Pointer to input bytes.
+    size_t               countBytes // Number of input bytes.
+){
+    return hash_bytes (pBytes, (countBytes < CHECKPOINT_HASHED_PREFIX) ? countBytes : CHECKPOINT_HASHED_PREFIX, 0);
+}
+
+
+
+//****************
+// Building index
+//****************
+
+// Context noteblocks being tracked by checkpoint_build
+struct checkpoint_context {
+    const unsigned char* pBytes;
+    unsigned char        keyBytes[4];
+    unsigned char        timeByte;
+    unsigned char        clefByte;
+};
+
+// scan_byte_group_history callback that tracks the clef, key signature, and time signature in effect. A repeat
+// byte group can copy these too, so they're tracked from the byte group that first drew each noteblock.
+void checkpoint_track_context (void* pContext, unsigned int byteIndex) {
+    struct checkpoint_context* pTrack = pContext;
+    unsigned char byte1 = pTrack->pBytes[byteIndex];
+    int byteGroupType = byte_group_type (byte1);
+    if (byteGroupType == BYTE_GROUP_TYPE_KEY_CHANGE) { memcpy (pTrack->keyBytes, pTrack->pBytes + byteIndex, 4); }
+    if (byteGroupType == BYTE_GROUP_TYPE_TIME_CHANGE) { pTrack->timeByte = byte1; }
+    if (byteGroupType == BYTE_GROUP_TYPE_CLEF) { pTrack->clefByte = byte1; }
+}
+
+
+// Build a checkpoint index for some encoded bytes. Reads the byte groups without drawing anything.
+unsigned char* checkpoint_build (
+    const unsigned char* pBytes,      // Pointer to encoded bytes. Need not be 0-terminated.
+    size_t               countBytes,   // Number of encoded bytes.
+    unsigned int         interval,     // Byte groups between checkpoints, at least 1.
+    long long            modifiedTime, // Last-modified time of the input, from platform_file_modified_time.
+    size_t*              pIndexSize,   // Output param, set to the size of the index in bytes.
+    int*                 pErrIndex     // Output param, set to the index of an invalid byte, to
+                                       // CHECKPOINT_ERR_TOO_LARGE if the input is too large, otherwise to -1.
+    // Returns the index (caller must free), or NULL if the bytes are invalid or too large, or out of memory.
+){
+    *pErrIndex = -1;
+    if (countBytes > INT_MAX) {
+        *pErrIndex = CHECKPOINT_ERR_TOO_LARGE;
+        return NULL;
+    }
+    size_t capacity = 64, count = 0;
+    unsigned char* pIndex = malloc (CHECKPOINT_HEADER_SIZE + (capacity * CHECKPOINT_RECORD_SIZE));
+    if (pIndex == NULL) return NULL;
+
+    // Parsing can't start where a later repeat byte group would copy from before
+    unsigned int countSpans = 0;
+    unsigned char* pRepeatSpans = mark_repeat_spans (pBytes, countBytes, &countSpans);
+    if (pRepeatSpans == NULL) { free (pIndex); return NULL; }
+
+    struct checkpoint_context context = { pBytes, { 0, 0, 0, 0 }, 0, 0 };
+    struct scan_history history;
+    history.count = 0;
+    unsigned int parseInfo = 0, countGroups = 0, countNoteblocks = 0;
+    int checkpointDue = 1;
+    size_t index = 0;
+    while (1) {
+        // Read byte group. A missing terminator is allowed; the index covers what there is.
+        int length = scan_byte_group (pBytes, countBytes, index);
+        if (length == 0) break;
+        if (length < 0) {
+            *pErrIndex = (int)index;
+            free (pIndex); free (pRepeatSpans);
+            return NULL;
+        }
+        int byteGroupType = byte_group_type (pBytes[index]);
+        if (countNoteblocks > UINT_MAX - 255) { // A repeat adds at most 255
+            *pErrIndex = CHECKPOINT_ERR_TOO_LARGE;
+            free (pIndex); free (pRepeatSpans);
+            return NULL;
+        }
+
+        // Add checkpoint record before this byte group if due
+        if (countGroups % interval == 0) checkpointDue = 1;
+        if (checkpointDue && byteGroupType != BYTE_GROUP_TYPE_DYN_TEXT && !pRepeatSpans[countNoteblocks]) {
+            if (count == capacity) {
+                capacity *= 2;
+                unsigned char* pNew = realloc (pIndex, CHECKPOINT_HEADER_SIZE + (capacity * CHECKPOINT_RECORD_SIZE));
+                if (pNew == NULL) { free (pIndex); free (pRepeatSpans); return NULL; }
+                pIndex = pNew;
+            }
+            unsigned char* pRecord = pIndex + CHECKPOINT_HEADER_SIZE + (count * CHECKPOINT_RECORD_SIZE);
+            le_put32 (pRecord, (unsigned int)index);
+            le_put32 (pRecord + 4, countGroups);
+            le_put32 (pRecord + 8, countNoteblocks);
+            le_put32 (pRecord + 12, parseInfo);
+            memcpy (pRecord + 16, context.keyBytes, 4);
+            pRecord[20] = context.timeByte; pRecord[21] = context.clefByte; pRecord[22] = 0; pRecord[23] = 0;
+            ++count;
+            checkpointDue = 0;
+        }
+
+        // Track state the parser would have after this byte group
+        int countNew = scan_byte_group_history (pBytes, index, &parseInfo, &history, checkpoint_track_context,
+            &context);
+        if (countNew < 0) {
+            *pErrIndex = (int)index + 1;
+            free (pIndex); free (pRepeatSpans);
+            return NULL;
+        }
+        countNoteblocks += countNew;
+        ++countGroups;
+        index += length;
+    }
+    free (pRepeatSpans);
+
+    // Header
+    memcpy (pIndex, CHECKPOINT_MAGIC, 4);
+    le_put32 (pIndex + 4, CHECKPOINT_VERSION);
+    le_put32 (pIndex + 8, interval);
+    le_put32 (pIndex + 12, (unsigned int)count);
+    le_put64 (pIndex + 16, countBytes);
+    le_put64 (pIndex + 24, checkpoint_prefix_hash (pBytes, countBytes));
+    le_put64 (pIndex + 32, (unsigned long long)modifiedTime);
+    *pIndexSize = CHECKPOINT_HEADER_SIZE + (count * CHECKPOINT_RECORD_SIZE);
+    return pIndex;
+}
+
+
+
+//************************
+// Decoding from an index
+//************************
+
+// Check that an index is well formed and belongs to some input.
+int checkpoint_validate (
+    const unsigned char* pBytes,       // Pointer to input bytes.
+    size_t               countBytes,   // Number of input bytes.
+    long long            modifiedTime, // Last-modified time of the input, from platform_file_modified_time.
+    const unsigned char* pIndex,       // Pointer to index bytes, for example mapped from an index file.
+    size_t               indexSize     // Number of index bytes.
+    // Returns 1 if valid, otherwise 0.
+){
+    return countBytes <= INT_MAX && indexSize >= CHECKPOINT_HEADER_SIZE
+        && memcmp (pIndex, CHECKPOINT_MAGIC, 4) == 0
+        && le_get32 (pIndex + 4) == CHECKPOINT_VERSION
+        && le_get32 (pIndex + 12) > 0
+        && indexSize == CHECKPOINT_HEADER_SIZE + ((size_t)le_get32 (pIndex + 12) * CHECKPOINT_RECORD_SIZE)
+        && le_get64 (pIndex + 16) == countBytes
+        && le_get64 (pIndex + 24) == checkpoint_prefix_hash (pBytes, countBytes)
+        && le_get64 (pIndex + 32) == (unsigned long long)modifiedTime;
+}
+
+
+// Find the last checkpoint at or before a noteblock, by binary search.
+const unsigned char* checkpoint_find (
+    const unsigned char* pIndex,   // Pointer to a valid index.
+    unsigned int         noteblock // Index (from 0) of the noteblock to decode from.
+    // Returns pointer to the checkpoint record.
+){
+    unsigned int lo = 0, hi = le_get32 (pIndex + 12); // First record has noteblock count 0, so lo works
+    const unsigned char* pRecords = pIndex + CHECKPOINT_HEADER_SIZE;
+    while (hi - lo > 1) {
+        unsigned int mid = lo + ((hi - lo) / 2);
+        if (le_get32 (pRecords + (mid * CHECKPOINT_RECORD_SIZE) + 8) <= noteblock) { lo = mid; }
+        else                                                                             { hi = mid; }
+    }
+    return pRecords + (lo * CHECKPOINT_RECORD_SIZE);
+}
+
+
+// Decode a range of noteblocks from the middle of encoded bytes, starting at the nearest checkpoint.
+// Noteblocks for the clef, key signature, and time signature in effect at the checkpoint come first.
+int checkpoint_decode (
+    const unsigned char* pBytes,          // Pointer to encoded bytes. Need not be 0-terminated.
+    size_t               countBytes,      // Number of encoded bytes.
+    const unsigned char* pIndex,          // Pointer to index bytes, already checked with checkpoint_validate.
+    unsigned int         firstNoteblock,  // Index (from 0) of first noteblock wanted.
+    unsigned int         countNoteblocks, // Number of noteblocks wanted. Fewer are decoded at the end of the bytes.
+    struct noteblock**   pp1stNoteblock,  // Will be set to pointer to first noteblock in list, or NULL.
+    int*                 pErrIndex        // If an error occurs, will be set to its index in *pBytes, otherwise to -1.
+    // Returns one of the PARSE_RESULTs. PARSE_RESULT_PARSED_ALL if the range was decoded.
+){
+    *pp1stNoteblock = NULL;
+    *pErrIndex = -1;
+    const unsigned char* pRecord = checkpoint_find (pIndex, firstNoteblock);
+    int index = (int)le_get32 (pRecord);
+    unsigned int noteblock = le_get32 (pRecord + 8);
+    unsigned int parseInfo = le_get32 (pRecord + 12);
+
+    // Context noteblocks, unless decoding from the very start where the file itself has them
+    struct noteblock* pContextHead = NULL;
+    struct noteblock* pContextTail = NULL;
+    if (noteblock > 0) {
+        struct noteblock* pContext[3] = { NULL, NULL, NULL };
+        if (pRecord[21] != 0) { pContext[0] = make_clef (pRecord[21]); }
+        if (le_get32 (pRecord + 16) != 0) {
+            pContext[1] = make_key_signature ((unsigned short)(pRecord[16] | (pRecord[17] << 8)),
+                (unsigned short)(pRecord[18] | (pRecord[19] << 8)));
+        }
+        if (pRecord[20] != 0) { pContext[2] = make_time_signature (pRecord[20]); }
+        for (int i = 0; i < 3; ++i) {
+            if (pContext[i] == NULL) continue;
+            if (pContextTail == NULL) { pContextHead = pContext[i]; }
+            else                      { pContextTail->pNext = pContext[i]; }
+            pContextTail = pContext[i];
+        }
+    }
+
+    // Parse from the checkpoint. Noteblocks before firstNoteblock are parsed only to advance, then freed.
+    struct noteblock* pSkipHead = NULL;  // First parsed noteblock before firstNoteblock
+    struct noteblock* pSkipTail = NULL;  // Last parsed noteblock before firstNoteblock
+    struct noteblock* pKeptHead = NULL;  // Noteblock firstNoteblock
+    struct noteblock* pNoteblock = NULL; // Most recently parsed noteblock
+    struct noteblock* pOverHead = NULL;  // First noteblock past the range, if a repeat byte group went past it
+    struct noteblock* pOverPrev = NULL;  // Noteblock before that
+    struct parse_history history;
+    history.count = 0;
+    unsigned int endNoteblock = firstNoteblock + countNoteblocks;
+    int parseResult = PARSE_RESULT_PARSED_ALL;
+    while (index >= 0 && (size_t)index < countBytes) {
+        int byteGroupType = byte_group_type (pBytes[index]);
+        if (byteGroupType == BYTE_GROUP_TYPE_TERMINATOR) break;
+        // Stop at the end of the range, but still apply dynamics text to the last noteblock in it
+        if (noteblock >= endNoteblock && byteGroupType != BYTE_GROUP_TYPE_DYN_TEXT) break;
+        if ((size_t)index + byte_group_length (byteGroupType) > countBytes) {
+            parseResult = PARSE_RESULT_UNEXPECTED_TERMINATOR;
+            *pErrIndex = index;
+            break;
+        }
+        struct noteblock* pPrevious = pNoteblock;
+        int groupResult = parse_byte_group (pBytes, &index, &pNoteblock, &parseInfo, &history);
+        if (groupResult != PARSE_RESULT_PARSED_NOTEBLOCK) {
+            parseResult = groupResult;
+            *pErrIndex = index - 1;
+            pNoteblock = pPrevious; // parse_byte_group may have set it to NULL
+            break;
+        }
+        if (pNoteblock == pPrevious) continue; // Dynamics text
+        // New noteblocks. A repeat byte group can make many, possibly going past the range.
+        struct noteblock* pNew = (pPrevious == NULL) ? pNoteblock : pPrevious->pNext;
+        for (; pNew != NULL; pPrevious = pNew, pNew = pNew->pNext) {
+            if (noteblock < firstNoteblock) {
+                if (pSkipHead == NULL) { pSkipHead = pNew; }
+                pSkipTail = pNew;
+            }
+            else if (noteblock >= endNoteblock) {
+                if (pOverHead == NULL) { pOverHead = pNew; pOverPrev = pPrevious; }
+            }
+            else if (noteblock == firstNoteblock) {
+                pKeptHead = pNew;
+            }
+            ++noteblock;
+        }
+    }
+
+    // Free noteblocks past the range. There is always one before them, since a repeat can't come first.
+    if (pOverHead != NULL) {
+        pOverPrev->pNext = NULL;
+        free_noteblocks (pOverHead);
+    }
+
+    // Free skipped noteblocks, and link context noteblocks in front of the kept ones
+    if (pSkipTail != NULL) {
+        pSkipTail->pNext = NULL;
+        free_noteblocks (pSkipHead);
+    }
+    else if (pKeptHead == NULL) {
+        free_noteblocks (pSkipHead);
+    }
+    if (pKeptHead == NULL) {
+        free_noteblocks (pContextHead); // Nothing in range, so nothing to show context for
+    }
+    else if (pContextTail != NULL) {
+        pContextTail->pNext = pKeptHead;
+        *pp1stNoteblock = pContextHead;
+    }
+    else {
+        *pp1stNoteblock = pKeptHead;
+    }
+    return parseResult;
+}
+
+
+
+//*****
+// IO
+//*****
+
+// Build the path of a file's index
+int checkpoint_index_path (
+    char        indexPath[1024], // Output param, set to the index path.
+    const char* filepath         // Path of the encoded file.
+    // Returns 1 on success, 0 if the path is too long.
+){
+    int len = snprintf (indexPath, 1024, "%s%s", filepath, CHECKPOINT_FILE_EXTENSION);
+    return 0 < len && len < 1024;
+}
+
+
+// Build an index for a file and write it next to the file, for cmd line option -ib.
+void try_build_checkpoint_index (
+    char* filepath,   // User-entered file path and name.
+    char* intervalStr // User-entered count of byte groups between checkpoints, or NULL for the default.
+){
+    int interval = (intervalStr == NULL) ? CHECKPOINT_DEFAULT_INTERVAL : atoi (intervalStr);
+    if (interval < 1) {
+        printf ("  Invalid interval\n");
+        return;
+    }
+    char indexPath[1024];
+    if (!checkpoint_index_path (indexPath, filepath)) {
+        printf ("  File path is too long: %s\n", filepath);
+        return;
+    }
+    struct platform_mapping mapping;
+    if (!platform_map_file (filepath, &mapping)) {
+        printf ("  Unable to open file %s\n", filepath);
+        return;
+    }
+
+    size_t indexSize;
+    int errIndex;
+    unsigned char* pIndex = checkpoint_build (mapping.pBytes, mapping.size, (unsigned int)interval,
+        platform_file_modified_time (filepath), &indexSize, &errIndex);
+    if (pIndex == NULL) {
+        if (errIndex >= 0) { printf ("  Invalid byte group at location #%d\n", errIndex); }
+        else if (errIndex == CHECKPOINT_ERR_TOO_LARGE) {
+            printf ("  File is too large to index (over %d bytes, or %u noteblocks): %s\n", INT_MAX, UINT_MAX - 255,
+                filepath);
+        }
+        else { printf ("  Memory allocation error\n"); }
+        platform_unmap_file (&mapping);
+        return;
+    }
+
+    FILE* file;
+    errno_t fopenErr = fopen_s (&file, indexPath, "wb");
+    if (fopenErr || file == NULL) {
+        printf ("  Unable to create file %s\n", indexPath);
+    }
+    else {
+        size_t written = fwrite (pIndex, 1, indexSize, file);
+        fclose (file);
+        if (written != indexSize) { printf ("  Unable to write file %s\n", indexPath); }
+        else {
+            printf ("  Wrote %s: %u checkpoints, %zu bytes for %zu input bytes\n",
+                indexPath, le_get32 (pIndex + 12), indexSize, mapping.size);
+        }
+    }
+    free (pIndex);
+    platform_unmap_file (&mapping);
+}
+
+
+// Print part of a file using its index, for cmd line option -is.
+void try_read_file_from_checkpoint (
+    char* filepath,     // User-entered file path and name. Its index must have been built with option -ib.
+    char* noteblockStr, // User-entered index (from 0) of first noteblock to print.
+    char* countStr,     // User-entered number of noteblocks to print.
+    char* widthStr      // User-entered string for maximum staff width, or NULL if not entered.
+){
+    int widthInt;
+    if (!parse_width_arg (widthStr, &widthInt)) return;
+    int firstNoteblock = atoi (noteblockStr), countNoteblocks = atoi (countStr);
+    if (firstNoteblock < 0 || countNoteblocks < 1) {
+        printf ("  Invalid noteblock range %s, %s\n", noteblockStr, countStr);
+        return;
+    }
+    char indexPath[1024];
+    if (!checkpoint_index_path (indexPath, filepath)) {
+        printf ("  File path is too long: %s\n", filepath);
+        return;
+    }
+    struct platform_mapping mapping, indexMapping;
+    if (!platform_map_file (filepath, &mapping)) {
+        printf ("  Unable to open file %s\n", filepath);
+        return;
+    }
+    if (!platform_map_file (indexPath, &indexMapping)
+        || !checkpoint_validate (mapping.pBytes, mapping.size, platform_file_modified_time (filepath),
+                                 indexMapping.pBytes, indexMapping.size)) {
+        printf ("  Missing or out-of-date index %s - build it with option -ib\n", indexPath);
+        platform_unmap_file (&indexMapping); platform_unmap_file (&mapping);
+        return;
+    }
+
+    struct noteblock* p1stNoteblock;
+    int errIndex;
+    int parseResult = checkpoint_decode (mapping.pBytes, mapping.size, indexMapping.pBytes,
+        (unsigned int)firstNoteblock, (unsigned int)countNoteblocks, &p1stNoteblock, &errIndex);
+    if (parseResult != PARSE_RESULT_PARSED_ALL) {
+        printf ("  Invalid byte group at location #%d\n", errIndex);
+    }
+    else if (p1stNoteblock == NULL) {
+        printf ("  No noteblocks at or after #%d\n", firstNoteblock);
+    }
+    else {
+        char* str = noteblocks_to_string (p1stNoteblock, widthInt);
+        if (str == NULL) { printf ("  Internal error while converting noteblocks to string\n"); }
+        else             { printf ("%s", str); free (str); }
+    }
+    free_noteblocks (p1stNoteblock);
+    platform_unmap_file (&indexMapping); platform_unmap_file (&mapping);
+}
@@ -0,0 +1,20 @@
+//*****************************************************************************
+// music2_checkpoint.h.
+// Scope: Private to music2 program.
+// Bare-bones .h file to facilitate linking. See the .c file for descriptions.
+//*****************************************************************************
+
+#pragma once
+
+#include <stddef.h> // size_t
+
+#include "music2_noteblock.h"
+
+unsigned char* checkpoint_build (const unsigned char* pBytes, size_t countBytes, unsigned int interval,
+    long long modifiedTime, size_t* pIndexSize, int* pErrIndex);
+int checkpoint_validate (const unsigned char* pBytes, size_t countBytes, long long modifiedTime,
+    const unsigned char* pIndex, size_t indexSize);
+int checkpoint_decode (const unsigned char* pBytes, size_t countBytes, const unsigned char* pIndex,
+    unsigned int firstNoteblock, unsigned int countNoteblocks, struct noteblock** pp1stNoteblock, int* pErrIndex);
+void try_build_checkpoint_index (char* filepath, char* intervalStr);
+void try_read_file_from_checkpoint (char* filepath, char* noteblockStr, char* countStr, char* widthStr);
@@ -0,0 +1,351 @@
+//*****************************************************************************************************
+// music2_container.c
+// This file contains an optional container format that wraps the usual byte group encoding in chunks.
+// A plain encoded file is one stream: each byte group's meaning can depend on the groups before it
+// (through parseInfo), so it can only be parsed from the start, one group at a time. A container splits
+// the byte groups into chunks at group boundaries and stores, for each chunk, the parseInfo the parser
+// would have at its start. Chunks can then be parsed independently and in parallel, and their lists of
+// noteblocks joined in order.
+// Each chunk also carries a CRC32C, so corruption is reported instead of drawn as wrong music.
+// Plain files are unaffected; a container is recognized by its first 4 bytes, which can't start a plain
+// file because 0x10 is an invalid first byte.
+//*****************************************************************************************************
+
+
+// External inclusions
+#include <limits.h> // INT_MAX
+#include <stddef.h> // NULL, size_t
+#include <stdio.h>  // printf, fopen_s, fwrite
+#include <stdlib.h> // malloc, free, atoi
+#include <string.h> // memcmp, memcpy
+
+// Internal inclusions
+#include "music2_general2.h"
+#include "music2_hash.h"
+#include "music2_noteblock.h"
+#include "music2_platform.h"
+#include "music2_trace.h"
+
+
+//***********************
+// Container file format
+//***********************
+
+// Header (8 bytes):
+//   Bytes 0-3: CONTAINER_MAGIC
+//   Bytes 4-7: CONTAINER_VERSION
+// Chunks: the byte groups of each chunk in order, without terminators, starting right after the header
+// Chunk table (20 bytes per chunk):
+//   Bytes 0-7:   Byte offset of the chunk in the container
+//   Bytes 8-11:  Length of the chunk in bytes
+//   Bytes 12-15: parseInfo as of the chunk's first byte group - see update_parse_info
+//   Bytes 16-19: CRC32C of the chunk's bytes
+// Footer (16 bytes), at the very end so a writer can stream chunks before it knows how many there are:
+//   Bytes 0-7:   Byte offset of the chunk table
+//   Bytes 8-11:  Count of chunks
+//   Bytes 12-15: CRC32C of the chunk table
+// All numbers are little-endian. A chunk never starts with dynamics text, because dynamics text modifies the
+// previous noteblock.
+#define CONTAINER_MAGIC              ("\x10M2C")
+#define CONTAINER_VERSION            (1)
+#define CONTAINER_HEADER_SIZE        (8)
+#define CONTAINER_CHUNK_ENTRY_SIZE   (20)
+#define CONTAINER_FOOTER_SIZE        (16)
+#define CONTAINER_DEFAULT_CHUNK_SIZE (4096) // Byte groups per chunk
+
+
+// Whether some bytes start with the container magic
+int container_is_container (
+    const unsigned char* pBytes,    // Pointer to file bytes.
+    size_t               countBytes // Number of file bytes.
+){
+    return countBytes >= 4 && memcmp (pBytes, CONTAINER_MAGIC, 4) == 0;
+}
+
+
+
+//**********
+// Building
+//**********
+
+// Wrap plain encoded bytes in a container.
+unsigned char* container_build (
+    const unsigned char* pBytes,        // Pointer to plain encoded bytes. Read up to the terminator, or to countBytes.
+    size_t               countBytes,    // Number of plain encoded bytes.
+    unsigned int         chunkSize,     // Byte groups per chunk, at least 1.
+    size_t*              pContainerSize, // Output param, set to the size of the container in bytes.
+    int*                 pErrIndex      // Output param, set to the index of an invalid byte, otherwise to -1.
+    // Returns the container (caller must free), or NULL if the bytes are invalid or out of memory.
+){
+    *pErrIndex = -1;
+
+    // Find chunk boundaries and their parseInfo. The chunk table is built in place of the chunk bytes at first,
+    // since the group count (and so the chunk count) isn't known until the end.
+    size_t capacity = 16, countChunks = 0;
+    unsigned char* pTable = malloc (capacity * CONTAINER_CHUNK_ENTRY_SIZE);
+    if (pTable == NULL) return NULL;
+    // Chunks are parsed independently, so one can't start where a later repeat byte group would copy from before
+    unsigned int countSpans = 0;
+    unsigned char* pRepeatSpans = mark_repeat_spans (pBytes, countBytes, &countSpans);
+    if (pRepeatSpans == NULL) { free (pTable); return NULL; }
+    struct scan_history history;
+    history.count = 0;
+    unsigned int parseInfo = 0, countGroups = 0, countNoteblocks = 0;
+    int chunkDue = 1;
+    size_t index = 0;
+    while (1) {
+        int length = scan_byte_group (pBytes, countBytes, index);
+        if (length == 0) break;
+        if (length < 0) {
+            *pErrIndex = (int)index;
+            free (pTable); free (pRepeatSpans);
+            return NULL;
+        }
+        int byteGroupType = byte_group_type (pBytes[index]);
+        if (countGroups % chunkSize == 0) chunkDue = 1;
+        if (chunkDue && byteGroupType != BYTE_GROUP_TYPE_DYN_TEXT && !pRepeatSpans[countNoteblocks]) {
+            if (countChunks == capacity) {
+                capacity *= 2;
+                unsigned char* pNew = realloc (pTable, capacity * CONTAINER_CHUNK_ENTRY_SIZE);
+                if (pNew == NULL) { free (pTable); free (pRepeatSpans); return NULL; }
+                pTable = pNew;
+            }
+            unsigned char* pEntry = pTable + (countChunks * CONTAINER_CHUNK_ENTRY_SIZE);
+            le_put64 (pEntry, CONTAINER_HEADER_SIZE + index);
+            le_put32 (pEntry + 12, parseInfo);
+            ++countChunks;
+            chunkDue = 0;
+        }
+        int countNew = scan_byte_group_history (pBytes, index, &parseInfo, &history, NULL, NULL);
+        if (countNew < 0) {
+            *pErrIndex = (int)index + 1;
+            free (pTable); free (pRepeatSpans);
+            return NULL;
+        }
+        countNoteblocks += countNew;
+        ++countGroups;
+        index += length;
+    }
+    free (pRepeatSpans);
+    size_t countPlainBytes = index; // Without the terminator
+
+    // Lay out the container
+    size_t tableOffset = CONTAINER_HEADER_SIZE + countPlainBytes;
+    size_t tableSize = countChunks * CONTAINER_CHUNK_ENTRY_SIZE;
+    size_t containerSize = tableOffset + tableSize + CONTAINER_FOOTER_SIZE;
+    unsigned char* pContainer = malloc (containerSize);
+    if (pContainer == NULL) { free (pTable); return NULL; }
+    memcpy (pContainer, CONTAINER_MAGIC, 4);
+    le_put32 (pContainer + 4, CONTAINER_VERSION);
+    memcpy (pContainer + CONTAINER_HEADER_SIZE, pBytes, countPlainBytes);
+
+    // Finish chunk table entries now that each chunk's end is known
+    for (size_t chunk = 0; chunk < countChunks; ++chunk) {
+        unsigned char* pEntry = pTable + (chunk * CONTAINER_CHUNK_ENTRY_SIZE);
+        size_t chunkStart = (size_t)le_get64 (pEntry);
+        size_t chunkEnd = (chunk + 1 < countChunks) ? (size_t)le_get64 (pEntry + CONTAINER_CHUNK_ENTRY_SIZE)
+                                                    : tableOffset;
+        le_put32 (pEntry + 8, (unsigned int)(chunkEnd - chunkStart));
+        le_put32 (pEntry + 16, crc32c_bytes (pContainer + chunkStart, chunkEnd - chunkStart, 0));
+    }
+    memcpy (pContainer + tableOffset, pTable, tableSize);
+    free (pTable);
+
+    unsigned char* pFooter = pContainer + tableOffset + tableSize;
+    le_put64 (pFooter, tableOffset);
+    le_put32 (pFooter + 8, (unsigned int)countChunks);
+    le_put32 (pFooter + 12, crc32c_bytes (pContainer + tableOffset, tableSize, 0));
+    *pContainerSize = containerSize;
+    return pContainer;
+}
+
+
+
+//**********
+// Decoding
+//**********
+
+// Result of parsing one chunk
+struct container_chunk_result {
+    struct noteblock* p1stNoteblock;  // First noteblock parsed from the chunk, or NULL.
+    struct noteblock* pLastNoteblock; // Last noteblock parsed from the chunk, or NULL.
+    int               parseResult;    // One of the PARSE_RESULTs.
+    int               errIndex;       // Index of an error in the container, otherwise -1.
+};
+
+// Shared by the tasks parsing each chunk
+struct container_decode {
+    const unsigned char*           pBytes;   // Container bytes.
+    const unsigned char*           pTable;   // Chunk table within pBytes, already checked.
+    struct container_chunk_result* pResults; // One per chunk.
+};
+
+
+// Check and parse one chunk. Run by platform_run_parallel; chunks share nothing but read-only bytes.
+void container_decode_chunk (
+    void*        pContext, // Pointer to struct container_decode.
+    unsigned int chunk     // Index of chunk to parse.
+){
+    struct container_decode* pDecode = pContext;
+    const unsigned char* pEntry = pDecode->pTable + ((size_t)chunk * CONTAINER_CHUNK_ENTRY_SIZE);
+    struct container_chunk_result* pResult = &(pDecode->pResults[chunk]);
+    unsigned long long traceNs = trace_begin ();
+    int start = (int)le_get64 (pEntry);
+    int length = (int)le_get32 (pEntry + 8);
+    if (crc32c_bytes (pDecode->pBytes + start, length, 0) != le_get32 (pEntry + 16)) {
+        pResult->p1stNoteblock = NULL; pResult->pLastNoteblock = NULL;
+        pResult->parseResult = PARSE_RESULT_CORRUPT;
+        pResult->errIndex = start;
+        trace_end ("container_chunk", traceNs, chunk);
+        return;
+    }
+    pResult->parseResult = parse_bytes_range (pDecode->pBytes, start, start + length, le_get32 (pEntry + 12),
+        &(pResult->p1stNoteblock), &(pResult->pLastNoteblock), &(pResult->errIndex));
+    trace_end ("container_chunk", traceNs, chunk);
+}
+
+
+// Check a container's footer and chunk table.
+const unsigned char* container_chunk_table (
+    const unsigned char* pBytes,      // Pointer to container bytes.
+    size_t               countBytes,  // Number of container bytes.
+    unsigned int*        pCountChunks // Output param, set to the count of chunks.
+    // Returns pointer to the chunk table, or NULL if the container is truncated or corrupt.
+){
+    if (countBytes < CONTAINER_HEADER_SIZE + CONTAINER_FOOTER_SIZE || countBytes > INT_MAX
+        || le_get32 (pBytes + 4) != CONTAINER_VERSION) return NULL;
+    const unsigned char* pFooter = pBytes + countBytes - CONTAINER_FOOTER_SIZE;
+    unsigned long long tableOffset = le_get64 (pFooter);
+    unsigned int countChunks = le_get32 (pFooter + 8);
+    if (tableOffset < CONTAINER_HEADER_SIZE
+        || tableOffset + ((unsigned long long)countChunks * CONTAINER_CHUNK_ENTRY_SIZE) != countBytes - CONTAINER_FOOTER_SIZE
+        || crc32c_bytes (pBytes + tableOffset, (size_t)countChunks * CONTAINER_CHUNK_ENTRY_SIZE, 0)
+            != le_get32 (pFooter + 12)) return NULL;
+
+    // Chunks must lie between the header and the table. They needn't be contiguous.
+    const unsigned char* pTable = pBytes + tableOffset;
+    for (unsigned int chunk = 0; chunk < countChunks; ++chunk) {
+        const unsigned char* pEntry = pTable + ((size_t)chunk * CONTAINER_CHUNK_ENTRY_SIZE);
+        unsigned long long start = le_get64 (pEntry);
+        if (start < CONTAINER_HEADER_SIZE || start + le_get32 (pEntry + 8) > tableOffset) return NULL;
+    }
+    *pCountChunks = countChunks;
+    return pTable;
+}
+
+
+// Get where a chunk's bytes are in a container.
+void container_chunk_range (
+    const unsigned char* pTable, // Chunk table from container_chunk_table.
+    unsigned int         chunk,  // Index of the chunk.
+    size_t*              pStart, // Output param, set to the index of the chunk's first byte in the container.
+    size_t*              pEnd    // Output param, set to the index just past the chunk's last byte.
+){
+    const unsigned char* pEntry = pTable + ((size_t)chunk * CONTAINER_CHUNK_ENTRY_SIZE);
+    *pStart = (size_t)le_get64 (pEntry);
+    *pEnd = *pStart + le_get32 (pEntry + 8);
+}
+
+
+// Parse a container to create list of noteblocks, parsing its chunks in parallel.
+int container_parse (
+    const unsigned char* pBytes,         // Pointer to container bytes, for which container_is_container is true.
+    size_t               countBytes,     // Number of container bytes.
+    unsigned int         countThreads,   // Most threads to use, or 0 for one per processor.
+    struct noteblock**   pp1stNoteblock, // Will be set to pointer to first noteblock in list.
+    int*                 pErrIndex       // If an error occurs, will be set to its index in *pBytes, otherwise to -1.
+    // Returns one of the PARSE_RESULTs. On an error, the list holds the noteblocks before the failed chunk.
+){
+    *pp1stNoteblock = NULL;
+    *pErrIndex = -1;
+    unsigned int countChunks;
+    const unsigned char* pTable = container_chunk_table (pBytes, countBytes, &countChunks);
+    if (pTable == NULL) {
+        *pErrIndex = (int)((countBytes > CONTAINER_FOOTER_SIZE) ? countBytes - CONTAINER_FOOTER_SIZE : 0);
+        return PARSE_RESULT_CORRUPT;
+    }
+    struct container_chunk_result* pResults = malloc ((countChunks + 1) * sizeof (struct container_chunk_result));
+    if (pResults == NULL) return PARSE_RESULT_INTERNAL_ERROR;
+
+    struct container_decode decode = { pBytes, pTable, pResults };
+    platform_run_parallel (countChunks, countThreads, container_decode_chunk, &decode);
+
+    // Join chunks' lists in order. Stop at the first failed chunk and free everything after it.
+    int parseResult = PARSE_RESULT_PARSED_ALL;
+    struct noteblock* pLastNoteblock = NULL;
+    for (unsigned int chunk = 0; chunk < countChunks; ++chunk) {
+        struct container_chunk_result* pResult = &(pResults[chunk]);
+        if (parseResult != PARSE_RESULT_PARSED_ALL) {
+            free_noteblocks (pResult->p1stNoteblock);
+            continue;
+        }
+        if (pResult->parseResult != PARSE_RESULT_PARSED_ALL) {
+            parseResult = pResult->parseResult;
+            *pErrIndex = pResult->errIndex;
+            free_noteblocks (pResult->p1stNoteblock);
+            continue;
+        }
+        if (pResult->p1stNoteblock == NULL) continue;
+        if (pLastNoteblock == NULL) { *pp1stNoteblock = pResult->p1stNoteblock; }
+        else                        { pLastNoteblock->pNext = pResult->p1stNoteblock; }
+        pLastNoteblock = pResult->pLastNoteblock;
+    }
+    free (pResults);
+    return parseResult;
+}
+
+
+
+//*****
+// IO
+//*****
+
+// Wrap a plain encoded file in a container, for cmd line option -cw.
+void try_write_container (
+    char* filepath,     // User-entered path of plain encoded file.
+    char* outFilepath,  // User-entered path of container file to write.
+    char* chunkSizeStr  // User-entered count of byte groups per chunk, or NULL for the default.
+){
+    int chunkSize = (chunkSizeStr == NULL) ? CONTAINER_DEFAULT_CHUNK_SIZE : atoi (chunkSizeStr);
+    if (chunkSize < 1) {
+        printf ("  Invalid chunk size\n");
+        return;
+    }
+    struct platform_mapping mapping;
+    if (!platform_map_file (filepath, &mapping)) {
+        printf ("  Unable to open file %s\n", filepath);
+        return;
+    }
+    if (container_is_container (mapping.pBytes, mapping.size)) {
+        printf ("  File is already a container: %s\n", filepath);
+        platform_unmap_file (&mapping);
+        return;
+    }
+
+    size_t containerSize;
+    int errIndex;
+    unsigned char* pContainer = container_build (mapping.pBytes, mapping.size, (unsigned int)chunkSize,
+        &containerSize, &errIndex);
+    platform_unmap_file (&mapping);
+    if (pContainer == NULL) {
+        if (errIndex >= 0) { printf ("  Invalid byte group at location #%d\n", errIndex); }
+        else               { printf ("  Memory allocation error\n"); }
+        return;
+    }
+
+    FILE* file;
+    errno_t fopenErr = fopen_s (&file, outFilepath, "wb");
+    if (fopenErr || file == NULL) {
+        printf ("  Unable to create file %s\n", outFilepath);
+    }
+    else {
+        size_t written = fwrite (pContainer, 1, containerSize, file);
+        fclose (file);
+        if (written != containerSize) { printf ("  Unable to write file %s\n", outFilepath); }
+        else {
+            printf ("  Wrote %s: %u chunks, %zu bytes\n", outFilepath,
+                le_get32 (pContainer + containerSize - CONTAINER_FOOTER_SIZE + 8), containerSize);
+        }
+    }
+    free (pContainer);
+}
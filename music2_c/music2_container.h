@@ -0,0 +1,21 @@
+//*****************************************************************************
+// music2_container.h.
+// Scope: Private to music2 program.
+// Bare-bones .h file to facilitate linking. See the .c file for descriptions.
+//*****************************************************************************
+
+#pragma once
+
+#include <stddef.h> // size_t
+
+#include "music2_noteblock.h"
+
+int container_is_container (const unsigned char* pBytes, size_t countBytes);
+unsigned char* container_build (const unsigned char* pBytes, size_t countBytes, unsigned int chunkSize,
+    size_t* pContainerSize, int* pErrIndex);
+const unsigned char* container_chunk_table (const unsigned char* pBytes, size_t countBytes,
+    unsigned int* pCountChunks);
+void container_chunk_range (const unsigned char* pTable, unsigned int chunk, size_t* pStart, size_t* pEnd);
+int container_parse (const unsigned char* pBytes, size_t countBytes, unsigned int countThreads,
+    struct noteblock** pp1stNoteblock, int* pErrIndex);
+void try_write_container (char* filepath, char* outFilepath, char* chunkSizeStr);
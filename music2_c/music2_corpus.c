@@ -0,0 +1,512 @@
+//*****************************************************************************************************
+// music2_corpus.c
+// This file contains a generator of encoded files for benchmarks (cmd line option -g). The examples in
+// music2_data.c are a few hundred bytes, far from the large scores and catalogs the program reads, so this
+// makes valid encoded bytes of any size from a seed and a profile:
+//   - A profile sets the mix of music: how many notes are beamed and how long beamed runs are, how often
+//     rests, ties, and dynamics text come, how often the key or time changes, and how often a measure is
+//     repeated with a repeat byte group.
+//   - The adversarial profile instead aims to make each byte as costly as possible to parse and draw:
+//     notes with every mark, beams on both sides, crowded key signatures, and no barlines, so the measure
+//     memo never applies.
+//   - The same seed, size, and profile always make the same bytes.
+// The output is plain encoded bytes, which every option that reads files accepts.
+//*****************************************************************************************************
+
+
+// External inclusions
+#include <stddef.h> // NULL, size_t
+#include <stdio.h>  // printf, fopen_s, fwrite
+#include <stdlib.h> // malloc, realloc, free, strtoull
+#include <string.h> // memchr, strchr, strlen, strncmp
+
+// Internal inclusions
+#include "music2_general2.h"
+
+
+//**********
+// Profiles
+//**********
+
+// The mix of music to generate
+struct corpus_profile {
+    unsigned int nbPercent;       // Share of notes that are beamed (NB), 0-100.
+    unsigned int beamRunMax;      // Most notes in a beamed run, 2-16.
+    unsigned int restPercent;     // Share of unbeamed notes that are rests, 0-100.
+    unsigned int tiePercent;      // Share of notes tied to the next, 0-100.
+    unsigned int dynamicsPercent; // Share of notes with dynamics text, 0-100.
+    unsigned int keyPermille;     // Chance of a key change before each measure, in thousandths.
+    unsigned int timePermille;    // Chance of a time change before each measure, in thousandths.
+    unsigned int repeatPercent;   // Chance of a repeat byte group copying each measure after it, 0-100.
+    unsigned int isAdversarial;   // 1 to ignore the above and make the costliest bytes per byte, otherwise 0.
+};
+
+// A named profile
+struct corpus_named_profile {
+    const char*           name;
+    struct corpus_profile profile;
+};
+
+// Profiles that option -g knows by name. The first is the default.
+const struct corpus_named_profile CORPUS_PROFILES[] = {
+    //               nb   run rest  tie  dyn   key  time  rep  adversarial
+    { "typical",     { 40,  4,  10,    5,   5,   10,   10,   0, 0 } },
+    { "dense",       { 70,  8,   5,   15,  30,  100,  100,   0, 0 } },
+    { "repetitive",  { 40,  4,  10,    5,   5,   10,   10,  50, 0 } },
+    { "adversarial", {  0,  2,   0,    0,   0,    0,    0,   0, 1 } },
+};
+#define CORPUS_PROFILE_COUNT (sizeof (CORPUS_PROFILES) / sizeof (CORPUS_PROFILES[0]))
+
+
+// Parse a profile: a profile name, optionally followed by changes to it, such as "typical,nb=60,dyn=20".
+// Changes can also come alone, changing the default profile. The keys are nb, run, rest, tie, dyn, key, time,
+// and rep, for the fields of corpus_profile in that order.
+int corpus_parse_profile (
+    const char*            str,      // String to parse, or NULL for the default profile.
+    struct corpus_profile* pProfile  // Output param, set to the profile.
+    // Returns 1 if valid, otherwise 0.
+){
+    *pProfile = CORPUS_PROFILES[0].profile;
+    if (str == NULL) return 1;
+    const char* p = str;
+    while (*p != '\0') {
+        const char* pEnd = strchr (p, ',');
+        size_t length = (pEnd == NULL) ? strlen (p) : (size_t)(pEnd - p);
+        const char* pEquals = memchr (p, '=', length);
+        if (pEquals == NULL) {
+            // A profile name, only allowed first
+            if (p != str) return 0;
+            int isFound = 0;
+            for (size_t i = 0; i < CORPUS_PROFILE_COUNT && !isFound; ++i) {
+                if (strlen (CORPUS_PROFILES[i].name) == length && strncmp (CORPUS_PROFILES[i].name, p, length) == 0) {
+                    *pProfile = CORPUS_PROFILES[i].profile;
+                    isFound = 1;
+                }
+            }
+            if (!isFound) return 0;
+        }
+        else {
+            size_t keyLength = (size_t)(pEquals - p);
+            char* pNumberEnd;
+            unsigned long long value = strtoull (pEquals + 1, &pNumberEnd, 10);
+            if (pNumberEnd != p + length || pNumberEnd == pEquals + 1) return 0;
+            unsigned int* pField =
+                (keyLength == 2 && strncmp (p, "nb", 2) == 0)   ? &(pProfile->nbPercent) :
+                (keyLength == 3 && strncmp (p, "run", 3) == 0)  ? &(pProfile->beamRunMax) :
+                (keyLength == 4 && strncmp (p, "rest", 4) == 0) ? &(pProfile->restPercent) :
+                (keyLength == 3 && strncmp (p, "tie", 3) == 0)  ? &(pProfile->tiePercent) :
+                (keyLength == 3 && strncmp (p, "dyn", 3) == 0)  ? &(pProfile->dynamicsPercent) :
+                (keyLength == 3 && strncmp (p, "key", 3) == 0)  ? &(pProfile->keyPermille) :
+                (keyLength == 4 && strncmp (p, "time", 4) == 0) ? &(pProfile->timePermille) :
+                (keyLength == 3 && strncmp (p, "rep", 3) == 0)  ? &(pProfile->repeatPercent) : NULL;
+            unsigned long long limit = (pField == &(pProfile->beamRunMax)) ? 16 :
+                (pField == &(pProfile->keyPermille) || pField == &(pProfile->timePermille)) ? 1000 : 100;
+            if (pField == NULL || value > limit) return 0;
+            if (pField == &(pProfile->beamRunMax) && value < 2) return 0;
+            *pField = (unsigned int)value;
+        }
+        p += length;
+        if (*p == ',') { ++p; }
+    }
+    return 1;
+}
+
+
+// Parse a size in bytes, with an optional suffix K, M, or G for units of 1024, 1024^2, or 1024^3 bytes.
+unsigned long long corpus_parse_size (
+    const char* str // String to parse, such as "64K".
+    // Returns the size, or 0 if invalid.
+){
+    char* pEnd;
+    unsigned long long size = strtoull (str, &pEnd, 10);
+    if (pEnd == str) return 0;
+    unsigned long long unit = 1;
+    if (*pEnd == 'K' || *pEnd == 'k') { unit = 1024ULL; ++pEnd; }
+    else if (*pEnd == 'M' || *pEnd == 'm') { unit = 1024ULL * 1024; ++pEnd; }
+    else if (*pEnd == 'G' || *pEnd == 'g') { unit = 1024ULL * 1024 * 1024; ++pEnd; }
+    if (*pEnd != '\0' || size > (~0ULL) / unit) return 0;
+    return size * unit;
+}
+
+
+
+//********
+// Writer
+//********
+
+// Bytes generated so far
+struct corpus_writer {
+    unsigned char*     pBytes;
+    size_t             countBytes;
+    size_t             capacity;
+    unsigned long long seed;            // Random number generator state.
+    int                isOk;            // 0 after running out of memory.
+    unsigned long long countNoteblocks; // Noteblocks drawn by the bytes so far.
+};
+
+
+// Get a random number
+unsigned int corpus_random (
+    struct corpus_writer* pWriter // Writer, whose seed is updated.
+    // Returns 32 random bits.
+){
+    unsigned long long x = pWriter->seed;
+    x ^= x << 13; x ^= x >> 7; x ^= x << 17; // xorshift64
+    pWriter->seed = x;
+    return (unsigned int)(pWriter->seed >> 32);
+}
+
+
+// Get a random number in a range
+unsigned int corpus_random_range (
+    struct corpus_writer* pWriter, // Writer, whose seed is updated.
+    unsigned int          low,     // Smallest possible result.
+    unsigned int          high     // Largest possible result.
+    // Returns a number from low to high.
+){
+    return low + corpus_random (pWriter) % (high - low + 1);
+}
+
+
+// Decide whether something with some chance happens
+int corpus_chance (
+    struct corpus_writer* pWriter, // Writer, whose seed is updated.
+    unsigned int          chance,  // Chance, in units of outOf.
+    unsigned int          outOf    // 100 for percent, 1000 for permille.
+    // Returns 1 with the given chance, otherwise 0.
+){
+    return (corpus_random (pWriter) % outOf) < chance;
+}
+
+
+// Add one byte group
+void corpus_add (
+    struct corpus_writer* pWriter,   // Writer to add to.
+    int                   countBytes, // Number of bytes in the byte group, 1-4.
+    unsigned char         byte1,     // Bytes of the byte group. Those past countBytes are ignored.
+    unsigned char         byte2,
+    unsigned char         byte3,
+    unsigned char         byte4
+){
+    if (!pWriter->isOk) return;
+    if (pWriter->countBytes + 4 > pWriter->capacity) {
+        size_t capacity = (pWriter->capacity < 4096) ? 4096 : pWriter->capacity * 2;
+        unsigned char* pBytes = realloc (pWriter->pBytes, capacity);
+        if (pBytes == NULL) { pWriter->isOk = 0; return; }
+        pWriter->pBytes = pBytes;
+        pWriter->capacity = capacity;
+    }
+    unsigned char* p = pWriter->pBytes + pWriter->countBytes;
+    p[0] = byte1; p[1] = byte2; p[2] = byte3; p[3] = byte4;
+    pWriter->countBytes += countBytes;
+    if (byte_group_type (byte1) != BYTE_GROUP_TYPE_DYN_TEXT) { ++pWriter->countNoteblocks; }
+}
+
+
+
+//*************
+// Byte groups
+//*************
+
+// Dynamics texts, each 5 characters
+const char* CORPUS_DYNAMICS[] = { " pp  ", " mp  ", " mf  ", " ff  ", " sfz ", "cresc", " decr", "<<<<<", ">>>>>",
+                                  " mp<<", "<<f>>", "p.<< " };
+#define CORPUS_DYNAMICS_COUNT (sizeof (CORPUS_DYNAMICS) / sizeof (CORPUS_DYNAMICS[0]))
+
+// Add dynamics text under the previous noteblock
+void corpus_add_dynamics (
+    struct corpus_writer* pWriter, // Writer to add to.
+    const char*           text     // 5 characters from those dynamics text can encode.
+){
+    unsigned char codes[5];
+    for (int i = 0; i < 5; ++i) {
+        const char* pFound = strchr ("\x01 <>.cdefmprs", text[i]); // Codes 1-13, in order
+        codes[i] = (pFound == NULL) ? 2 : (unsigned char)(pFound - "\x01 <>.cdefmprs" + 1);
+    }
+    corpus_add (pWriter, 3, (unsigned char)(0b1000 | (codes[0] << 4)), (unsigned char)(codes[1] | (codes[2] << 4)),
+        (unsigned char)(codes[3] | (codes[4] << 4)), 0);
+}
+
+
+// Add an unbeamed note or rest
+void corpus_add_nn (
+    struct corpus_writer* pWriter,      // Writer to add to.
+    unsigned int          pitch,        // Rest (0) or pitch (1-15).
+    unsigned int          duration,     // Encoded duration (2-7).
+    int                   isDotted,     // 1 if dotted.
+    unsigned int          accidental,   // Encoded accidental (0-3).
+    unsigned int          articulation, // Encoded articulation (0-3).
+    int                   isTied        // 1 if tied to the next note.
+){
+    corpus_add (pWriter, 2, (unsigned char)(0b001 | (accidental << 3) | (articulation << 5) | (isTied << 7)),
+        (unsigned char)(pitch | (duration << 4) | (isDotted << 7)), 0, 0);
+}
+
+
+// Add a beamed note
+void corpus_add_nb (
+    struct corpus_writer* pWriter,      // Writer to add to.
+    unsigned int          pitch,        // Pitch (1-15).
+    unsigned int          stemLength,   // Stem length (1-4). Must fit on the staff with the beams.
+    int                   isDown,       // 1 for a downward stem.
+    int                   isDotted,     // 1 if dotted.
+    unsigned int          accidental,   // Encoded accidental (0-3).
+    unsigned int          articulation, // Encoded articulation (0-3).
+    int                   isTied,       // 1 if tied to the next note.
+    unsigned int          beamsLeft,    // Beams left of the stem (0-3).
+    unsigned int          beamsRight,   // Beams right of the stem (0-3).
+    unsigned int          beamsNarrow   // Narrow beams (0-2), fewer than the beams on their side.
+){
+    corpus_add (pWriter, 3, (unsigned char)(0b101 | (accidental << 3) | (articulation << 5) | (isTied << 7)),
+        (unsigned char)(pitch | ((stemLength - 1) << 4) | (isDown << 6) | (isDotted << 7)),
+        (unsigned char)(beamsRight | (beamsLeft << 2) | (beamsNarrow << 4) | 0b11000000), 0);
+}
+
+
+// Add one of CORPUS_DYNAMICS under the previous noteblock
+void corpus_add_random_dynamics (
+    struct corpus_writer* pWriter // Writer to add to.
+){
+    corpus_add_dynamics (pWriter, CORPUS_DYNAMICS[corpus_random_range (pWriter, 0, CORPUS_DYNAMICS_COUNT - 1)]);
+}
+
+
+// Pick an accidental or articulation for a note, which usually has none
+unsigned int corpus_random_mark (
+    struct corpus_writer* pWriter // Writer, whose seed is updated.
+    // Returns an encoded accidental or articulation (0-3).
+){
+    return corpus_chance (pWriter, 1, 16) ? corpus_random_range (pWriter, 1, 3) : 0;
+}
+
+
+// Pitches that take sharps and flats in key signatures, in order
+const unsigned char CORPUS_SHARP_ROWS[7] = { 12, 9, 13, 10, 7, 11, 8 }; // High F, C, G, D, A, E, middle B
+const unsigned char CORPUS_FLAT_ROWS[7] = { 8, 11, 7, 10, 6, 9, 5 };    // Middle B, high E, A, D, G, C, F
+
+// Add a key change
+void corpus_add_key (
+    struct corpus_writer* pWriter,    // Writer to add to.
+    int                   countSharps, // -7 to 7, negative for flats.
+    unsigned short        extraFlats,  // Bits for other pitches to mark as flats (or naturals, with extraSharps).
+    unsigned short        extraSharps  // Bits for other pitches to mark as sharps (or naturals, with extraFlats).
+){
+    unsigned short bits01to16 = 0b11 | extraFlats, bits17to32 = extraSharps;
+    for (int i = 0; i < countSharps; ++i) { bits17to32 |= (unsigned short)(1 << CORPUS_SHARP_ROWS[i]); }
+    for (int i = 0; i < -countSharps; ++i) { bits01to16 |= (unsigned short)(1 << CORPUS_FLAT_ROWS[i]); }
+    if (countSharps > 0) { bits01to16 |= 0b100; } // Arranged like B major
+    bits01to16 |= 0x8000; bits17to32 |= 0x8001; // Bits 16, 17, and 32, so no byte is 0
+    corpus_add (pWriter, 4, (unsigned char)bits01to16, (unsigned char)(bits01to16 >> 8), (unsigned char)bits17to32,
+        (unsigned char)(bits17to32 >> 8));
+}
+
+
+// Add a time change
+void corpus_add_time (
+    struct corpus_writer* pWriter, // Writer to add to.
+    unsigned int          top,     // Top number, 1-16.
+    unsigned int          bottom   // Bottom number, 1, 2, 4, or 8.
+){
+    unsigned int bottomCode = (bottom == 1) ? 0 : (bottom == 2) ? 1 : (bottom == 4) ? 2 : 3;
+    corpus_add (pWriter, 1, (unsigned char)(0b10 | (bottomCode << 2) | ((top - 1) << 4)), 0, 0, 0);
+}
+
+
+
+//*********
+// Measures
+//*********
+
+// Time signatures a generated song can change to
+const unsigned char CORPUS_TIME_TOPS[8] = { 4, 3, 2, 6, 5, 7, 12, 9 };
+const unsigned char CORPUS_TIME_BOTTOMS[8] = { 4, 4, 4, 8, 4, 8, 8, 8 };
+
+// Encoded durations of unbeamed notes and their lengths in sixteenths
+const unsigned char CORPUS_NN_DURATIONS[5] = { 3, 4, 5, 6, 7 }; // Whole to sixteenth
+const unsigned char CORPUS_NN_SIXTEENTHS[5] = { 16, 8, 4, 2, 1 };
+
+// Add a measure of music
+void corpus_add_measure (
+    struct corpus_writer*        pWriter,    // Writer to add to.
+    const struct corpus_profile* pProfile,   // Mix of music.
+    unsigned int*                pTimeIndex  // Current time signature in CORPUS_TIME_TOPS. May be changed.
+){
+    unsigned long long countNoteblocksBefore = pWriter->countNoteblocks;
+    if (corpus_chance (pWriter, pProfile->keyPermille, 1000)) {
+        corpus_add_key (pWriter, (int)corpus_random_range (pWriter, 0, 14) - 7, 0, 0);
+    }
+    if (corpus_chance (pWriter, pProfile->timePermille, 1000)) {
+        *pTimeIndex = corpus_random_range (pWriter, 0, 7);
+        corpus_add_time (pWriter, CORPUS_TIME_TOPS[*pTimeIndex], CORPUS_TIME_BOTTOMS[*pTimeIndex]);
+    }
+
+    unsigned int sixteenthsLeft = CORPUS_TIME_TOPS[*pTimeIndex] * 16 / CORPUS_TIME_BOTTOMS[*pTimeIndex];
+    while (sixteenthsLeft > 0) {
+        // Beamed run of eighths or sixteenths, from 2 to beamRunMax notes
+        unsigned int beamSixteenths = corpus_chance (pWriter, 1, 3) ? 1 : 2;
+        unsigned int runMax = sixteenthsLeft / beamSixteenths;
+        if (runMax > pProfile->beamRunMax) { runMax = pProfile->beamRunMax; }
+        if (runMax >= 2 && corpus_chance (pWriter, pProfile->nbPercent, 100)) {
+            unsigned int countNotes = corpus_random_range (pWriter, 2, runMax);
+            unsigned int beams = (beamSixteenths == 1) ? 2 : 1;
+            int isDown = (int)corpus_random_range (pWriter, 0, 1);
+            for (unsigned int note = 0; note < countNotes; ++note) {
+                // Stem length 3 fits on the staff for pitches low E to high C, either way, with 2 beams
+                unsigned int pitch = corpus_random_range (pWriter, 4, 9);
+                int isTied = corpus_chance (pWriter, pProfile->tiePercent, 100);
+                unsigned int accidental = corpus_random_mark (pWriter);
+                corpus_add_nb (pWriter, pitch, 3, isDown, 0, accidental, 0, isTied, (note > 0) ? beams : 0,
+                    (note + 1 < countNotes) ? beams : 0, 0);
+                if (corpus_chance (pWriter, pProfile->dynamicsPercent, 100)) { corpus_add_random_dynamics (pWriter); }
+            }
+            sixteenthsLeft -= countNotes * beamSixteenths;
+            continue;
+        }
+
+        // Unbeamed note or rest, mostly quarters and eighths, dotted if the dotted length fits
+        unsigned int i = corpus_random_range (pWriter, 0, 7);
+        i = (i < 2) ? i : (i < 5) ? 2 : (i < 7) ? 3 : 4;
+        while (CORPUS_NN_SIXTEENTHS[i] > sixteenthsLeft) { ++i; }
+        int isDotted = CORPUS_NN_SIXTEENTHS[i] > 1 && (CORPUS_NN_SIXTEENTHS[i] * 3 / 2) <= sixteenthsLeft
+            && corpus_chance (pWriter, 1, 8);
+        int isRest = corpus_chance (pWriter, pProfile->restPercent, 100);
+        unsigned int pitch = isRest ? 0 : corpus_random_range (pWriter, 1, 15);
+        int isTied = !isRest && corpus_chance (pWriter, pProfile->tiePercent, 100);
+        unsigned int accidental = isRest ? 0 : corpus_random_mark (pWriter);
+        unsigned int articulation = isRest ? 0 : corpus_random_mark (pWriter);
+        corpus_add_nn (pWriter, pitch, CORPUS_NN_DURATIONS[i], isDotted, accidental, articulation, isTied);
+        if (corpus_chance (pWriter, pProfile->dynamicsPercent, 100)) { corpus_add_random_dynamics (pWriter); }
+        sixteenthsLeft -= CORPUS_NN_SIXTEENTHS[i] * (isDotted ? 3 : 2) / 2;
+    }
+
+    // Barline, mostly single
+    unsigned int barlineType = corpus_chance (pWriter, 1, 32) ? 1 : 0;
+    corpus_add (pWriter, 1, (unsigned char)(0b0100 | (barlineType << 4)), 0, 0, 0);
+
+    // Play it again
+    unsigned long long countNoteblocks = pWriter->countNoteblocks - countNoteblocksBefore;
+    if (countNoteblocks <= 255 && corpus_chance (pWriter, pProfile->repeatPercent, 100)) {
+        corpus_add (pWriter, 2, BYTE_GROUP_TYPE_REPEAT, (unsigned char)countNoteblocks, 0, 0);
+        pWriter->countNoteblocks += countNoteblocks - 1; // corpus_add counted one
+    }
+}
+
+
+// Add a few byte groups that are as costly as possible per byte. There are no barlines, so the measure memo
+// never applies, and each byte group differs from the last.
+void corpus_add_adversarial (
+    struct corpus_writer* pWriter // Writer to add to.
+){
+    unsigned int choice = corpus_random_range (pWriter, 0, 15);
+    if (choice == 0) {
+        // Every pitch in the key signature, so it fills all its columns
+        unsigned short sharps = (unsigned short)(corpus_random (pWriter) & 0x3FF8); // Some naturals, some flats
+        corpus_add_key (pWriter, (int)corpus_random_range (pWriter, 0, 14) - 7, 0x3FF8, sharps);
+    }
+    else if (choice < 4) {
+        // Two-digit time signatures are the widest, for one byte
+        corpus_add_time (pWriter, corpus_random_range (pWriter, 10, 16), 1 << corpus_random_range (pWriter, 0, 3));
+    }
+    else if (choice < 6) {
+        // Beams on both sides, some narrow, with the longest stem that fits
+        int isDown = (int)corpus_random_range (pWriter, 0, 1);
+        unsigned int pitch = corpus_random_range (pWriter, 5, 10); // Stem length 4 fits either way with 3 beams
+        corpus_add_nb (pWriter, pitch, 4, isDown, 1, corpus_random_range (pWriter, 1, 3),
+            corpus_random_range (pWriter, 1, 3), 1, 3, 3, corpus_random_range (pWriter, 1, 2));
+        corpus_add_random_dynamics (pWriter);
+    }
+    else {
+        // Tied, dotted, flagged notes with accidentals and articulations: every drawing step, for 2 bytes
+        corpus_add_nn (pWriter, corpus_random_range (pWriter, 1, 15), corpus_random_range (pWriter, 6, 7), 1,
+            corpus_random_range (pWriter, 1, 3), corpus_random_range (pWriter, 1, 3), 1);
+    }
+}
+
+
+
+//************
+// Generation
+//************
+
+// Generate encoded bytes of about some size.
+unsigned char* corpus_generate (
+    unsigned long long           targetBytes,      // Size to reach. The result is no smaller, and larger by at most
+                                                   // a measure.
+    const struct corpus_profile* pProfile,         // Mix of music.
+    unsigned long long           seed,             // Random number generator seed. 0 means a fixed default.
+    size_t*                      pCountBytes,      // Output param, set to the number of bytes, including the
+                                                   // terminator.
+    unsigned long long*          pCountNoteblocks  // Output param, set to the number of noteblocks they draw. Can be
+                                                   // NULL.
+    // Returns the bytes, followed by a 0 past the terminator as from read_file_bytes (caller must free), or NULL
+    // if out of memory.
+){
+    struct corpus_writer writer = { NULL, 0, 0, (seed == 0) ? 0x9E3779B97F4A7C15ULL : seed, 1, 0 };
+    corpus_add (&writer, 1, corpus_chance (&writer, 1, 8) ? 0b01100000 : 0b00100000, 0, 0, 0); // Bass or treble clef
+    if (pProfile->isAdversarial) {
+        while (writer.isOk && writer.countBytes + 1 < targetBytes) { corpus_add_adversarial (&writer); }
+    }
+    else {
+        corpus_add_key (&writer, (int)corpus_random_range (&writer, 0, 14) - 7, 0, 0);
+        unsigned int timeIndex = 0;
+        corpus_add_time (&writer, CORPUS_TIME_TOPS[timeIndex], CORPUS_TIME_BOTTOMS[timeIndex]);
+        while (writer.isOk && writer.countBytes + 1 < targetBytes) {
+            corpus_add_measure (&writer, pProfile, &timeIndex);
+        }
+    }
+    corpus_add (&writer, 2, 0, 0, 0, 0); // Terminator, and the 0 after it
+    --writer.countNoteblocks; // For the terminator
+    if (!writer.isOk) {
+        free (writer.pBytes);
+        return NULL;
+    }
+    *pCountBytes = writer.countBytes - 1;
+    if (pCountNoteblocks != NULL) { *pCountNoteblocks = writer.countNoteblocks; }
+    return writer.pBytes;
+}
+
+
+
+//*****
+// IO
+//*****
+
+// Write a generated file, for cmd line option -g.
+void try_generate_corpus (
+    char* outFilepath, // User-entered path of the file to write.
+    char* sizeStr,     // User-entered size, such as 100000, 64K, or 1G.
+    char* profileStr,  // User-entered profile, or NULL for the default. See corpus_parse_profile.
+    char* seedStr      // User-entered seed, or NULL for the default.
+){
+    unsigned long long targetBytes = corpus_parse_size (sizeStr);
+    if (targetBytes == 0) {
+        printf ("  Invalid size\n");
+        return;
+    }
+    struct corpus_profile profile;
+    if (!corpus_parse_profile (profileStr, &profile)) {
+        printf ("  Invalid profile \"%s\"\n", profileStr);
+        return;
+    }
+    unsigned long long seed = (seedStr == NULL) ? 0 : strtoull (seedStr, NULL, 10);
+
+    size_t countBytes;
+    unsigned long long countNoteblocks;
+    unsigned char* pBytes = corpus_generate (targetBytes, &profile, seed, &countBytes, &countNoteblocks);
+    if (pBytes == NULL) {
+        printf ("  Memory allocation error\n");
+        return;
+    }
+    FILE* file;
+    errno_t fopenErr = fopen_s (&file, outFilepath, "wb");
+    if (fopenErr || file == NULL) {
+        printf ("  Unable to create file %s\n", outFilepath);
+    }
+    else {
+        size_t written = fwrite (pBytes, 1, countBytes, file);
+        fclose (file);
+        if (written != countBytes) { printf ("  Unable to write file %s\n", outFilepath); }
+        else { printf ("  Wrote %s: %zu bytes, %llu noteblocks\n", outFilepath, countBytes, countNoteblocks); }
+    }
+    free (pBytes);
+}
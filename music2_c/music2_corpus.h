@@ -0,0 +1,26 @@
+//*****************************************************************************
+// music2_corpus.h.
+// Scope: Private to music2 program.
+// Bare-bones .h file to facilitate linking. See the .c file for descriptions.
+//*****************************************************************************
+
+#pragma once
+
+#include <stddef.h> // size_t
+
+struct corpus_profile {
+    unsigned int nbPercent;
+    unsigned int beamRunMax;
+    unsigned int restPercent;
+    unsigned int tiePercent;
+    unsigned int dynamicsPercent;
+    unsigned int keyPermille;
+    unsigned int timePermille;
+    unsigned int repeatPercent;
+    unsigned int isAdversarial;
+};
+int corpus_parse_profile (const char* str, struct corpus_profile* pProfile);
+unsigned long long corpus_parse_size (const char* str);
+unsigned char* corpus_generate (unsigned long long targetBytes, const struct corpus_profile* pProfile,
+    unsigned long long seed, size_t* pCountBytes, unsigned long long* pCountNoteblocks);
+void try_generate_corpus (char* outFilepath, char* sizeStr, char* profileStr, char* seedStr);
@@ -350,3 +350,19 @@ const unsigned char DTL_BYTES_BARLINE[] = {
     0b00100000, // Treble clef
     0           // Terminator
 };
+
+// Detailed example of repeats. Displays a measure, then copies of it and of part of the next.
+const unsigned char DTL_BYTES_REPEAT[] = {
+    0b00111010, // 4|4 time change
+    0b00000001, 0b01010100, // Low E, quarter
+    0b00000001, 0b01010101, // Low F, quarter
+    0b00000001, 0b01010110, // Low G, quarter
+    0b00000001, 0b01010111, // Low A, quarter
+    0b00000100, // Single barline
+    0b00001100, 0b00000101, // Repeat previous 5 noteblocks (the whole measure)
+    0b00000001, 0b01011001, // High C, quarter
+    0b00000001, 0b01011010, // High D, quarter
+    0b00001100, 0b00000010, // Repeat previous 2 noteblocks
+    0b00010100, // Double wide barline
+    0           // Terminator
+};
@@ -17,3 +17,4 @@ const unsigned char DTL_BYTES_NOTE[];
 const unsigned char DTL_BYTES_BEAMED_NOTE[];
 const unsigned char DTL_BYTES_TEXT[];
 const unsigned char DTL_BYTES_BARLINE[];
+const unsigned char DTL_BYTES_REPEAT[];
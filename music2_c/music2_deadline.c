@@ -0,0 +1,402 @@
+//*****************************************************************************************************
+// music2_deadline.c
+// This file contains rendering with a deadline (cmd line option -dl). Parsing and converting to a string
+// normally run one after the other over the whole score, so nothing is ready until everything is. Here
+// they're interleaved a staff at a time: byte groups are parsed until the next staff's noteblocks are known,
+// the staff is written, and the deadline and a cancellation flag are checked before starting the next one.
+// On expiry the staves written so far are returned, with a resume token for a later call to carry on.
+//   - A staff is known once the noteblock after it is parsed. Dynamics text only changes the most recent
+//     noteblock, and never its top row, where staff breaks are measured, so earlier noteblocks are final.
+//   - Noteblocks are freed once they're written and no repeat byte group can copy them, so memory stays
+//     bounded however long the score.
+//   - A resume token records where parsing can restart, as a checkpoint does (see music2_checkpoint.c): a byte
+//     group with the parseInfo as of it, at least PARSE_HISTORY_SIZE noteblocks before the next staff so
+//     repeats after it have what they copy, and not inside a repeat's span. Resuming parses only from there,
+//     drawing at most a few hundred noteblocks again, rather than from the start.
+//   - The measure memo isn't used, since resuming starts with an empty history.
+// Ctrl+C while rendering with a deadline sets the cancellation flag, so the staves so far are printed with a
+// token rather than lost.
+//*****************************************************************************************************
+
+
+// External inclusions
+#include <signal.h> // signal, sig_atomic_t, SIGINT
+#include <stddef.h> // NULL, size_t
+#include <stdio.h>  // printf, fprintf, snprintf, sscanf
+#include <stdlib.h> // malloc, realloc, free, atoi
+#include <string.h> // strcmp
+
+// Internal inclusions
+#include "music2_container.h"
+#include "music2_general2.h"
+#include "music2_hash.h"
+#include "music2_header.h"
+#include "music2_noteblock.h"
+#include "music2_platform.h"
+#include "music2_probes.h"
+#include "music2_rans.h"
+#include "music2_trace.h"
+
+
+//***********
+// Constants
+//***********
+
+// Restart points remembered while parsing, by noteblock count. Must cover PARSE_HISTORY_SIZE noteblocks
+// before a staff plus the noteblocks a repeat can add past it, with room to look further back.
+#define DEADLINE_RESTART_POINTS (1024)
+
+// Resume token format version, and how much of the input its hash covers
+#define DEADLINE_TOKEN_VERSION      (1)
+#define DEADLINE_TOKEN_HASHED_BYTES (65536)
+
+// Exit status of option -dl when it stops early. 75 is EX_TEMPFAIL from sysexits.h: try again later.
+#define DEADLINE_EXIT_STOPPED (75)
+
+
+
+//*******
+// State
+//*******
+
+// Where parsing can restart, before the byte group that makes a noteblock
+struct deadline_restart {
+    int          byteIndex;  // Index of the byte group.
+    unsigned int parseInfo;  // parseInfo as of it.
+    unsigned int noteblock;  // Noteblocks before it, to tell a current entry from a stale one.
+    int          isValid;    // 0 if a later repeat byte group copies noteblocks from before it.
+};
+
+// Where to carry on rendering. Written and read as text by deadline_format_token and deadline_parse_token.
+struct render_token {
+    int                byteIndex;  // Byte group to restart parsing at.
+    unsigned int       parseInfo;  // parseInfo as of it.
+    unsigned int       noteblock;  // Noteblocks before it.
+    unsigned int       staffHead;  // Noteblock starting the first staff not yet written.
+    unsigned int       staff;      // Staves written so far.
+    int                width;      // Max staff width, which decides the staff breaks.
+    unsigned long long hash;       // Hash of the input's size and first bytes, to catch a token used with the
+                                   // wrong file.
+};
+
+// Set by the interrupt handler, and by callers that want a render to stop. Checked between staves.
+volatile sig_atomic_t deadlineIsCancelled = 0;
+
+
+
+//*************
+// Cancellation
+//*************
+
+// Ask renders in progress to stop after their current staff.
+void deadline_cancel () {
+    deadlineIsCancelled = 1;
+}
+
+
+// Ctrl+C handler: cancel rather than exit, so the staves so far aren't lost.
+void deadline_handle_interrupt (
+    int signalNumber // SIGINT.
+){
+    deadlineIsCancelled = 1;
+    signal (signalNumber, deadline_handle_interrupt); // Some platforms reset the handler after each signal
+}
+
+
+
+//***********
+// Rendering
+//***********
+
+// Hash what a resume token records about its input
+unsigned long long deadline_token_hash (
+    const unsigned char* pBytes,    // Pointer to input bytes.
+    size_t               countBytes // Number of input bytes.
+){
+    size_t countHashed = (countBytes < DEADLINE_TOKEN_HASHED_BYTES) ? countBytes : DEADLINE_TOKEN_HASHED_BYTES;
+    return hash_bytes (pBytes, countHashed, (unsigned long long)countBytes);
+}
+
+
+// Write a staff to a string, growing the string if needed.
+int deadline_append_staff (
+    struct noteblock* pStaffHead,      // First noteblock in the staff.
+    struct noteblock* pStaffHeadNext,  // First noteblock in the next staff, or NULL.
+    unsigned int      countNoteblocks, // Noteblocks in the staff.
+    char**            pStr,            // Pointer to the string, updated if it's moved.
+    size_t*           pCapacity,       // Pointer to the string's size, updated if it grows.
+    unsigned int*     pIdxInStr        // Pointer to next index in the string. Increased.
+    // Returns 1 on success, 0 if out of memory.
+){
+    // Every noteblock fills at most all 5 columns, plus a '\n' per row, the separator row, and the '\0'
+    size_t needed = *pIdxInStr + ((size_t)NOTEBLOCK_HEIGHT * NOTEBLOCK_WIDTH * countNoteblocks) + NOTEBLOCK_HEIGHT + 2;
+    if (needed > *pCapacity) {
+        size_t capacity = *pCapacity * 2;
+        if (capacity < needed) { capacity = needed; }
+        char* str = realloc (*pStr, capacity);
+        if (str == NULL) return 0;
+        *pStr = str;
+        *pCapacity = capacity;
+    }
+    // Rows are numbered from bottom, but we're printing from top, so loop backwards
+    for (int row = NOTEBLOCK_HEIGHT - 1; row >= 0; --row) {
+        append_staff_row_subsequent (pStaffHead, pStaffHeadNext, row, *pStr, pIdxInStr);
+    }
+    (*pStr)[*pIdxInStr] = '\n'; ++(*pIdxInStr); // Separate staves
+    return 1;
+}
+
+
+// Parse and render encoded bytes a staff at a time, until done, past a deadline, or cancelled.
+int deadline_render (
+    const unsigned char*       pBytes,        // Pointer to encoded bytes, 0-terminated, with or without a header.
+    size_t                     countBytes,    // Number of encoded bytes.
+    int                        maxStaffWidth, // Max width of a staff in characters. At least NOTEBLOCK_WIDTH.
+    unsigned long long         deadlineNs,    // platform_now_ns time to stop by, or 0 for none.
+    const struct render_token* pResume,       // Token from an earlier call to carry on from, or NULL to start.
+    char**                     pStr,          // Output param, set to the staves written (caller must free), or NULL.
+    struct render_token*       pNext,         // Output param, set to a token to carry on from if stopped early.
+    int*                       pIsDone,       // Output param, set to 1 if every staff was written, 0 if stopped.
+    int*                       pErrIndex      // Output param, set to the index of an error, otherwise to -1.
+    // Returns one of the PARSE_RESULTs: PARSE_RESULT_PARSED_ALL if done or stopped without error, and
+    // PARSE_RESULT_CORRUPT if the token doesn't belong to the bytes and width.
+){
+    *pStr = NULL;
+    *pIsDone = 0;
+    *pErrIndex = -1;
+    int bodyStart = header_is_header (pBytes, countBytes) ? HEADER_SIZE : 0;
+    unsigned long long hash = deadline_token_hash (pBytes, countBytes);
+    struct render_token start = { bodyStart, 0, 0, 0, 0, maxStaffWidth, hash };
+    if (pResume == NULL) { pResume = &start; }
+    if (pResume->hash != hash || pResume->width != maxStaffWidth || pResume->byteIndex < bodyStart
+        || (size_t)pResume->byteIndex >= countBytes || pResume->noteblock > pResume->staffHead) {
+        return PARSE_RESULT_CORRUPT;
+    }
+
+    size_t capacity = 4096;
+    char* str = malloc (capacity);
+    struct deadline_restart* pRestarts = calloc (DEADLINE_RESTART_POINTS, sizeof (struct deadline_restart));
+    if (str == NULL || pRestarts == NULL) { free (str); free (pRestarts); return PARSE_RESULT_INTERNAL_ERROR; }
+
+    int index = pResume->byteIndex;
+    unsigned int parseInfo = pResume->parseInfo;
+    unsigned int countNoteblocks = pResume->noteblock; // Noteblocks parsed, counting from the start of the bytes
+    unsigned int staffHead = pResume->staffHead;       // Noteblock starting the staff being collected
+    unsigned int staff = pResume->staff;
+    struct parse_history history;
+    history.count = 0;
+    struct noteblock* pOldest = NULL;       // Oldest noteblock not yet freed
+    unsigned int oldest = countNoteblocks;  // Its number
+    struct noteblock* pNoteblock = NULL;    // Most recently parsed noteblock
+    struct noteblock* pStaffHead = NULL;    // First noteblock of the staff being collected, once parsed
+    unsigned int staffCount = 0;            // Noteblocks in the staff being collected
+    unsigned long long staffWidth = 0;      // Their top rows' total width
+    unsigned int idxInStr = 0;
+    int parseResult = PARSE_RESULT_PARSED_NOTEBLOCK;
+    int isStopped = 0;
+    while (parseResult == PARSE_RESULT_PARSED_NOTEBLOCK && !isStopped) {
+        // Remember where parsing could restart, and forget restart points a repeat copies from after
+        int byteGroupType = byte_group_type (pBytes[index]);
+        if (byteGroupType == BYTE_GROUP_TYPE_REPEAT) {
+            unsigned int countCopied = pBytes[index + 1];
+            for (unsigned int i = 0; i < countCopied && i < countNoteblocks; ++i) {
+                pRestarts[(countNoteblocks - i) % DEADLINE_RESTART_POINTS].isValid = 0;
+            }
+        }
+        else if (byteGroupType != BYTE_GROUP_TYPE_DYN_TEXT && byteGroupType != BYTE_GROUP_TYPE_TERMINATOR) {
+            struct deadline_restart* pRestart = &(pRestarts[countNoteblocks % DEADLINE_RESTART_POINTS]);
+            pRestart->byteIndex = index;
+            pRestart->parseInfo = parseInfo;
+            pRestart->noteblock = countNoteblocks;
+            pRestart->isValid = 1;
+        }
+
+        struct noteblock* pPrevious = pNoteblock;
+        parseResult = parse_byte_group (pBytes, &index, &pNoteblock, &parseInfo, &history);
+        if (parseResult != PARSE_RESULT_PARSED_NOTEBLOCK) {
+            pNoteblock = pPrevious; // parse_byte_group may have set it to NULL
+            break;
+        }
+        if (pNoteblock == pPrevious) continue; // Dynamics text
+
+        // Collect the new noteblocks into staves. A repeat byte group can make many, and finish several staves.
+        struct noteblock* pNew = (pPrevious == NULL) ? pNoteblock : pPrevious->pNext;
+        if (pOldest == NULL) { pOldest = pNew; }
+        for (; pNew != NULL; pNew = pNew->pNext) {
+            unsigned int number = countNoteblocks++;
+            if (number < staffHead) continue; // Parsed again after resuming, only for repeats to copy
+            char* pRow = get_ptr_to_row_from_noteblock (pNew, ROW_HI_B);
+            int width = (pRow[0] != '\0') + (pRow[1] != '\0') + (pRow[2] != '\0') + (pRow[3] != '\0') + (pRow[4] != '\0');
+            // As in append_staff_row_initial, the staff ends before a noteblock that doesn't fit
+            if (pStaffHead != NULL && staffWidth + width >= (unsigned long long)maxStaffWidth) {
+                unsigned long long traceNs = trace_begin ();
+                MUSIC2_PROBE1 (staff__start, staff);
+                if (!deadline_append_staff (pStaffHead, pNew, staffCount, &str, &capacity, &idxInStr)) {
+                    parseResult = PARSE_RESULT_INTERNAL_ERROR;
+                    break;
+                }
+                trace_end ("staff", traceNs, staff);
+                MUSIC2_PROBE2 (staff__end, staff, idxInStr);
+                ++staff;
+                staffHead = number;
+                pStaffHead = NULL;
+                staffCount = 0;
+                staffWidth = 0;
+                isStopped = deadlineIsCancelled || (deadlineNs > 0 && platform_now_ns () >= deadlineNs);
+                if (isStopped) break;
+            }
+            if (pStaffHead == NULL) { pStaffHead = pNew; }
+            ++staffCount;
+            staffWidth += width;
+        }
+        if (isStopped) break;
+
+        // Free noteblocks that are written and out of repeats' reach
+        while (pOldest != NULL && oldest + PARSE_HISTORY_SIZE < countNoteblocks && oldest < staffHead) {
+            struct noteblock* pFreed = pOldest;
+            pOldest = pOldest->pNext;
+            free (pFreed);
+            ++oldest;
+        }
+    }
+
+    // The last staff, or a token for carrying on
+    if (parseResult == PARSE_RESULT_PARSED_ALL && pStaffHead != NULL) {
+        if (!deadline_append_staff (pStaffHead, NULL, staffCount, &str, &capacity, &idxInStr)) {
+            parseResult = PARSE_RESULT_INTERNAL_ERROR;
+        }
+        ++staff;
+    }
+    if (parseResult == PARSE_RESULT_PARSED_NOTEBLOCK && isStopped) {
+        // Restart far enough back for repeats from the next staff on, or at the start
+        *pNext = start;
+        pNext->staffHead = staffHead;
+        pNext->staff = staff;
+        if (staffHead >= PARSE_HISTORY_SIZE) {
+            unsigned int lowest = (countNoteblocks > DEADLINE_RESTART_POINTS)
+                                ? countNoteblocks - DEADLINE_RESTART_POINTS : 0; // Older entries are overwritten
+            for (unsigned int number = staffHead - PARSE_HISTORY_SIZE + 1; number-- > lowest; ) {
+                const struct deadline_restart* pRestart = &(pRestarts[number % DEADLINE_RESTART_POINTS]);
+                if (pRestart->isValid && pRestart->noteblock == number) {
+                    pNext->byteIndex = pRestart->byteIndex;
+                    pNext->parseInfo = pRestart->parseInfo;
+                    pNext->noteblock = number;
+                    break;
+                }
+            }
+        }
+        parseResult = PARSE_RESULT_PARSED_ALL;
+    }
+    else if (parseResult == PARSE_RESULT_PARSED_ALL) {
+        *pIsDone = 1;
+    }
+    else {
+        *pErrIndex = index - 1;
+        MUSIC2_PROBE2 (parse__error, parseResult, *pErrIndex);
+    }
+    free_noteblocks (pOldest);
+    free (pRestarts);
+    if (parseResult != PARSE_RESULT_PARSED_ALL) {
+        free (str);
+        return parseResult;
+    }
+    str[idxInStr] = '\0';
+    *pStr = str;
+    return parseResult;
+}
+
+
+
+//*****
+// IO
+//*****
+
+// Write a resume token as text.
+void deadline_format_token (
+    const struct render_token* pToken, // Token to write.
+    char*                      tokenStr, // Output param, array of at least 128 characters set to the text.
+    size_t                     size      // Size of tokenStr.
+){
+    snprintf (tokenStr, size, "%d-%x-%x-%x-%x-%x-%x-%llx", DEADLINE_TOKEN_VERSION, (unsigned int)pToken->byteIndex,
+        pToken->parseInfo, pToken->noteblock, pToken->staffHead, pToken->staff, (unsigned int)pToken->width,
+        pToken->hash);
+}
+
+
+// Read a resume token written by deadline_format_token.
+int deadline_parse_token (
+    const char*          tokenStr, // Text of the token.
+    struct render_token* pToken    // Output param, set to the token.
+    // Returns 1 on success, 0 if it isn't a token.
+){
+    int version;
+    unsigned int byteIndex, width;
+    int countRead = sscanf (tokenStr, "%d-%x-%x-%x-%x-%x-%x-%llx", &version, &byteIndex, &(pToken->parseInfo),
+        &(pToken->noteblock), &(pToken->staffHead), &(pToken->staff), &width, &(pToken->hash));
+    pToken->byteIndex = (int)byteIndex;
+    pToken->width = (int)width;
+    return countRead == 8 && version == DEADLINE_TOKEN_VERSION && pToken->byteIndex >= 0 && pToken->width > 0;
+}
+
+
+// Print as many staves of a file as can be rendered by a deadline, then a resume token if any are left, for cmd
+// line option -dl.
+int try_read_file_deadline (
+    char* filepath, // User-entered file path and name.
+    char* widthStr, // User-entered string for maximum staff width.
+    char* msStr,    // User-entered milliseconds to stop rendering after, or 0 for no deadline.
+    char* tokenStr  // User-entered resume token printed by an earlier call, or NULL to start.
+    // Returns the process exit status: 0 if every staff was printed, DEADLINE_EXIT_STOPPED if stopped early,
+    // 1 on error.
+){
+    unsigned long long startNs = platform_now_ns ();
+    int widthInt;
+    if (!parse_width_arg (widthStr, &widthInt)) return 1;
+    int ms = atoi (msStr);
+    if (ms < 0 || (ms == 0 && strcmp (msStr, "0") != 0)) {
+        printf ("  Invalid deadline %s\n", msStr);
+        return 1;
+    }
+    struct render_token resume;
+    if (tokenStr != NULL && !deadline_parse_token (tokenStr, &resume)) {
+        printf ("  Invalid resume token %s\n", tokenStr);
+        return 1;
+    }
+    size_t countBytes;
+    unsigned char* pBytes = read_large_file_bytes (filepath, &countBytes);
+    if (pBytes == NULL) return 1;
+    if (container_is_container (pBytes, countBytes) || rans_is_compressed (pBytes, countBytes)) {
+        printf ("  Containers and compressed files can't be rendered with a deadline\n");
+        free (pBytes);
+        return 1;
+    }
+
+    deadlineIsCancelled = 0;
+    signal (SIGINT, deadline_handle_interrupt);
+    char* str;
+    struct render_token next;
+    int isDone, errIndex;
+    int parseResult = deadline_render (pBytes, countBytes, widthInt, (ms == 0) ? 0 : startNs + ms * 1000000ULL,
+        (tokenStr == NULL) ? NULL : &resume, &str, &next, &isDone, &errIndex);
+    signal (SIGINT, SIG_DFL);
+    if (parseResult == PARSE_RESULT_CORRUPT) {
+        printf ("  Resume token %s is for another file or width\n", tokenStr);
+        free (pBytes);
+        return 1;
+    }
+    if (parseResult != PARSE_RESULT_PARSED_ALL) {
+        print_parse_error (parseResult, pBytes, errIndex);
+        free (pBytes);
+        return 1;
+    }
+    printf ("%s", str);
+    fflush (stdout);
+    free (str); free (pBytes);
+    if (isDone) return 0;
+    // stderr, so the token doesn't mix with printed music
+    char nextStr[128];
+    deadline_format_token (&next, nextStr, sizeof (nextStr));
+    fprintf (stderr, "  %s after %u staves. Resume with: -dl %s %s %s %s\n",
+        deadlineIsCancelled ? "Cancelled" : "Deadline reached", next.staff, filepath, widthStr, msStr, nextStr);
+    return DEADLINE_EXIT_STOPPED;
+}
@@ -0,0 +1,25 @@
+//*****************************************************************************
+// music2_deadline.h.
+// Scope: Private to music2 program.
+// Bare-bones .h file to facilitate linking. See the .c file for descriptions.
+//*****************************************************************************
+
+#pragma once
+
+#include <stddef.h> // size_t
+
+struct render_token {
+    int                byteIndex;
+    unsigned int       parseInfo;
+    unsigned int       noteblock;
+    unsigned int       staffHead;
+    unsigned int       staff;
+    int                width;
+    unsigned long long hash;
+};
+void deadline_cancel ();
+int deadline_render (const unsigned char* pBytes, size_t countBytes, int maxStaffWidth, unsigned long long deadlineNs,
+    const struct render_token* pResume, char** pStr, struct render_token* pNext, int* pIsDone, int* pErrIndex);
+void deadline_format_token (const struct render_token* pToken, char* tokenStr, size_t size);
+int deadline_parse_token (const char* tokenStr, struct render_token* pToken);
+int try_read_file_deadline (char* filepath, char* widthStr, char* msStr, char* tokenStr);
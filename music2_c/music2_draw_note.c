@@ -52,6 +52,14 @@ inline int n_is_dotted (
 }
 
 
+// Get a note's accidental: 0 for none, 1 for flat, 2 for natural, 3 for sharp.
+inline int n_accidental (
+    unsigned char byte1 // Bits 1-8 of note encoding. Bits 4-5 are relevant here.
+){
+    return (byte1 & 0b00011000) >> 3;
+}
+
+
 // Accidental characters - Existing/none, flat, natural, sharp, tie/slur
 const char ACCIDENTAL_CHARS[] = { 1, 'b', '~', '#', '_' };
 
@@ -61,12 +69,20 @@ inline char n_pre_notehead_character (
     unsigned char byte1,   // Bits 1-8 of note encoding. Bits 4-5 are relevant here.
     int           prevTied // Whether the previous note is tied/slurred to this one.
 ){
-    int index1 = (byte1 & 0b00011000) >> 3;
+    int index1 = n_accidental (byte1);
     int index2 = ((index1 == 0) && prevTied) ? 4 : index1;
     return ACCIDENTAL_CHARS[index2];
 }
 
 
+// Get a note's articulation: 0 for none, 1 for staccato, 2 for accent, 3 for tenuto.
+inline int n_articulation (
+    unsigned char byte1 // Bits 1-8 of note encoding. Bits 6-7 are relevant here.
+){
+    return (byte1 & 0b01100000) >> 5;
+}
+
+
 // Articulation characters - Existing/none, staccato, accent, tenuto
 const char ARTICULATION_CHARS[] = { 1, '.', '>', '=' };
 
@@ -75,7 +91,7 @@ const char ARTICULATION_CHARS[] = { 1, '.', '>', '=' };
 inline char n_articulation_notehead_character (
     unsigned char byte1 // Bits 1-8 of note encoding. Bits 6-7 are relevant here.
 ){
-    int index = (byte1 & 0b01100000) >> 5;
+    int index = n_articulation (byte1);
     return ARTICULATION_CHARS[index];
 }
 
@@ -6,5 +6,62 @@
 
 #pragma once
 
+#include "music2_noteblock.h"
+
+inline int n_isNB (unsigned char byte1){
+    return (byte1 & 0b0100) == 0b0100;
+}
+inline int n_notehead_row (unsigned char byte2){
+    return byte2 & 0b1111;
+}
+inline int n_is_tied (unsigned char byte1){
+    return (byte1 & 0b10000000) > 0;
+}
+inline int n_is_dotted (unsigned char byte2){
+    return (byte2 & 0b10000000) > 0;
+}
+inline int n_accidental (unsigned char byte1){
+    return (byte1 & 0b00011000) >> 3;
+}
+inline int n_articulation (unsigned char byte1){
+    return (byte1 & 0b01100000) >> 5;
+}
+#define nn_DUR_BREVE     (2)
+#define nn_DUR_WHOLE     (3)
+#define nn_DUR_HALF      (4)
+#define nn_DUR_QUARTER   (5)
+#define nn_DUR_EIGHTH    (6)
+#define nn_DUR_SIXTEENTH (7)
+inline int nn_duration (unsigned char byte2){
+    return (byte2 & 0b01110000) >> 4;
+}
+inline int nn_is_rest (int row){
+    return row == 0;
+}
+inline int nn_orientation (int noteheadRow){
+    return 1 - ((ROW_MD_B < noteheadRow) * 2);
+}
+inline int nb_stem_length (unsigned char byte2){
+    return ((byte2 & 0b00110000) >> 4) + 1;
+}
+inline int nb_orientation (unsigned char byte2){
+    return 1 - (((byte2 & 0b01000000) >> 6) * 2);
+}
+inline int nb_beam_count_left (unsigned char byte3){
+    return (byte3 & 0b1100) >> 2;
+}
+inline int nb_beam_count_right (unsigned char byte3){
+    return byte3 & 0b11;
+}
+inline int nb_beam_count_narrow (unsigned char byte3){
+    return (byte3 & 0b110000) >> 4;
+}
 struct noteblock* make_nn (unsigned char byte1, unsigned char byte2, unsigned int  parseInfo);
 struct noteblock* make_nb (unsigned char byte1, unsigned char byte2, unsigned char byte3, unsigned int  parseInfo);
+void n_draw_pre_post_notehead_chars (char* pText, unsigned char byte1, unsigned char byte2, unsigned int parseInfo);
+void n_draw_articulation (char* pText, unsigned char byte1, unsigned char byte2);
+void nn_draw_rest (char* pText, unsigned char byte2);
+void nn_draw_notehead (char* pText, unsigned char byte2);
+void nn_draw_stem_flags (char* pText, unsigned char byte2);
+void nb_draw_notehead (char* pText, unsigned char byte2);
+void nb_draw_stem_beams (char* pText, unsigned char byte2, unsigned char byte3);
@@ -6,8 +6,10 @@
 
 #pragma once
 
+const char DYNAMICS_CHARACTERS[16];
 void draw_dynamics_text_row (char* pText, unsigned char byte1, unsigned char byte2, unsigned char byte3);
 struct noteblock* make_time_signature (unsigned char byte);
+const unsigned char KEY_SIGNATURE_ROWS[11];
 struct noteblock* make_key_signature (unsigned short bits01to16, unsigned short bits17to32);
 struct noteblock* make_barline (unsigned char byte);
 struct noteblock* make_clef (unsigned char byte);
@@ -0,0 +1,647 @@
+//*****************************************************************************************************
+// music2_estimate.c
+// This file contains a cost estimate for rendering encoded bytes, made without drawing anything, and
+// admission control built on it (cmd line options -es and -ec, and --budget-ms, --budget-mb, --defer).
+// A queue that mixes tiny and enormous jobs can then turn away or put off the enormous ones before
+// spending their time and memory.
+//   - The estimate is one pass over the byte groups, looking only at each group's first byte (and a repeat's
+//     count), so it runs at about the speed memory can be read.
+//   - Each byte group type has a cost in a model: nanoseconds to parse, draw, and convert it to text, and the
+//     columns and characters its noteblock adds. Repeats cost per copied noteblock, and add the mean columns
+//     and characters of the noteblocks before them.
+//   - Staves are estimated from the total columns, as if every noteblock had the mean width. A file with a
+//     header (see music2_header.c) has its exact totals, which are used instead if they're no less than the
+//     pass found, since nothing checks them.
+//   - Memory is the file's bytes, the noteblocks, and the string noteblocks_to_string allocates.
+//   - The built-in model was measured on one machine. Option -ec measures a model on this one and writes it
+//     to a file for --cost-model, by rendering long runs of random byte groups of each type.
+// A container's chunks hold plain byte groups, so the pass runs over each in turn. A compressed file is decoded
+// a byte group at a time into the same pass, without drawing anything.
+//*****************************************************************************************************
+
+
+// External inclusions
+#include <limits.h> // INT_MAX
+#include <stddef.h> // NULL, size_t
+#include <stdio.h>  // printf, fprintf, fopen_s
+#include <stdlib.h> // malloc, free, atoi, strtod
+#include <string.h> // memset, strchr, strcmp, strlen, strncmp
+
+// Internal inclusions
+#include "music2_container.h"
+#include "music2_general2.h"
+#include "music2_header.h"
+#include "music2_memo.h"
+#include "music2_noteblock.h"
+#include "music2_platform.h"
+#include "music2_rans.h"
+
+
+//***********
+// Constants
+//***********
+
+// Byte group types in the model, and their names in a model file
+const int ESTIMATE_TYPES[] = {
+    BYTE_GROUP_TYPE_CLEF, BYTE_GROUP_TYPE_KEY_CHANGE, BYTE_GROUP_TYPE_TIME_CHANGE, BYTE_GROUP_TYPE_NOTE_NN,
+    BYTE_GROUP_TYPE_NOTE_NB, BYTE_GROUP_TYPE_DYN_TEXT, BYTE_GROUP_TYPE_BARLINE, BYTE_GROUP_TYPE_REPEAT
+};
+const char* ESTIMATE_TYPE_NAMES[] = { "clef", "key", "time", "nn", "nb", "text", "barline", "repeat" };
+#define ESTIMATE_TYPE_COUNT  (8)
+#define ESTIMATE_TYPE_TEXT   (5) // Index of dynamics text
+#define ESTIMATE_TYPE_REPEAT (7) // Index of repeat
+#define ESTIMATE_TYPE_END    (9) // Not a type: the terminator
+
+// Byte groups of each type rendered to measure a model
+#define ESTIMATE_CALIBRATION_GROUPS (8192)
+
+// Repeats rendered to measure their cost, each copying 255 noteblocks, about as many as the other types make
+#define ESTIMATE_CALIBRATION_REPEATS (ESTIMATE_CALIBRATION_GROUPS / 255 - 1)
+
+// Renders of each measurement. The median counts.
+#define ESTIMATE_CALIBRATION_RUNS (10)
+
+// Staff width a model is measured at
+#define ESTIMATE_CALIBRATION_WIDTH (80)
+
+// Exit statuses of admission control. 75 is EX_TEMPFAIL from sysexits.h: try again later.
+#define ESTIMATE_EXIT_REJECTED (1)
+#define ESTIMATE_EXIT_DEFERRED (75)
+
+
+
+//*******
+// State
+//*******
+
+// What one byte group of a type costs. For repeats, per copied noteblock, with columns and chars unused.
+struct estimate_cost {
+    double ns;      // Time to parse, draw, convert to text, and free, in nanoseconds.
+    double columns; // Columns its noteblock adds to a staff. For dynamics text, added to the previous noteblock.
+    double chars;   // Characters its noteblock adds to the string, not counting '\n's.
+};
+
+// Model in use, by type in ESTIMATE_TYPES order. Measured with option -ec.
+struct estimate_cost estimateCosts[ESTIMATE_TYPE_COUNT] = {
+    { 272.0, 5.00, 80.00 }, // clef
+    { 490.0, 5.00, 80.00 }, // key
+    { 306.0, 3.44, 54.99 }, // time
+    { 356.0, 5.00, 80.00 }, // nn
+    { 324.0, 5.00, 80.00 }, // nb
+    {  85.0, 0.00,  0.00 }, // text
+    { 426.0, 3.81, 60.42 }, // barline
+    { 278.0, 0.00,  0.00 }, // repeat
+};
+
+// Index in ESTIMATE_TYPES of each first byte of a byte group, ESTIMATE_TYPE_COUNT if invalid, or
+// ESTIMATE_TYPE_END for the terminator. Filled on the first estimate, so the pass needn't decode types.
+unsigned char estimateTypeIndexes[256];
+int estimateHasTypeIndexes = 0;
+
+// Length of a byte group by its first byte, or 0 if invalid or the terminator. Looked up by the first byte
+// rather than the type, so the pass can look up both at once.
+unsigned char estimateLengths[256];
+
+// Where the model came from, for printing
+const char* estimateModelName = "built-in";
+
+// Budgets for admission control. 0 means none.
+unsigned long long estimateBudgetNs = 0;
+unsigned long long estimateBudgetBytes = 0;
+
+// Whether jobs over budget are deferred rather than rejected
+int estimateDefers = 0;
+
+// An estimate. Filled by estimate_bytes.
+struct render_estimate {
+    unsigned long long groups[ESTIMATE_TYPE_COUNT]; // Byte groups by type, in ESTIMATE_TYPES order.
+    unsigned long long noteblocks;                  // Noteblocks.
+    unsigned long long staves;                      // Staves at the width.
+    unsigned long long outputBytes;                 // Characters in the string, not counting '\0'.
+    unsigned long long memoryBytes;                 // Bytes allocated at once: file, noteblocks, and string.
+    double             renderNs;                    // Time to parse, convert to text, and free.
+    int                errIndex;                    // Index the parser would report an error at, or -1.
+    int                isExact;                     // 1 if noteblocks, staves, and output are a header's totals.
+};
+
+
+
+//**********
+// Estimate
+//**********
+
+// Counts so far of a pass over a file's byte groups. Added to by estimate_pass_range.
+struct estimate_pass {
+    unsigned long long* pGroups;       // Byte groups by type, in ESTIMATE_TYPES order.
+    double              copiedColumns; // Columns of the noteblocks repeats copied.
+    double              copiedChars;   // Characters of the noteblocks repeats copied.
+    unsigned long long  countCopied;   // Noteblocks repeats copied.
+    int                 errIndex;      // Index the parser would report an error at, or -1.
+};
+
+
+// Fill the tables of byte groups' types and lengths by first byte, the first time they're needed.
+void estimate_fill_tables () {
+    if (estimateHasTypeIndexes) return;
+    for (int byte1 = 0; byte1 < 256; ++byte1) {
+        int byteGroupType = byte_group_type ((unsigned char)byte1);
+        int type = 0;
+        while (type < ESTIMATE_TYPE_COUNT && ESTIMATE_TYPES[type] != byteGroupType) { ++type; }
+        int length = (type < ESTIMATE_TYPE_COUNT) ? byte_group_length (byteGroupType) : 0;
+        estimateLengths[byte1] = (unsigned char)length;
+        estimateTypeIndexes[byte1] = (unsigned char)((byteGroupType == BYTE_GROUP_TYPE_TERMINATOR)
+                                                     ? ESTIMATE_TYPE_END : type);
+    }
+    estimateHasTypeIndexes = 1; // Only ever set to the same values, so threads racing here do no harm
+}
+
+
+// Count the byte groups in a range by type, as part of a pass over a file's byte groups.
+int estimate_pass_range (
+    struct estimate_pass* pPass,  // Counts so far. Updated.
+    const unsigned char*  pBytes, // Pointer to bytes holding the range.
+    size_t                start,  // Index of the range's first byte group.
+    size_t                end     // Index just past the range. A byte group cut short there is an error.
+    // Returns 1 if the pass goes on past the range, or 0 if it ended at the terminator or an error.
+){
+    // Only repeats need the costs so far
+    unsigned long long* pGroups = pPass->pGroups;
+    for (size_t index = start; index < end; ) {
+        int type = estimateTypeIndexes[pBytes[index]];
+        int length = estimateLengths[pBytes[index]];
+        if (type == ESTIMATE_TYPE_END) return 0;
+        // Parsing stops at an invalid byte group, one cut short, or a repeat of more noteblocks than there are
+        int isValid = (length > 0 && index + length <= end);
+        if (isValid && index + 4 <= end) {
+            // Check the bytes after the first without branching on the length, which the types' mix makes
+            // unpredictable
+            const unsigned char* p = pBytes + index;
+            unsigned int nonzeros = (p[1] != 0) | ((p[2] != 0) << 1) | ((p[3] != 0) << 2);
+            unsigned int needed = (1u << (length - 1)) - 1;
+            isValid = ((nonzeros & needed) == needed);
+        }
+        else {
+            for (int i = 1; isValid && i < length; ++i) { isValid = (pBytes[index + i] != 0); }
+        }
+        if (!isValid) {
+            // Report the byte the parser stops at: the first byte if it's invalid, otherwise the first 0 or
+            // missing byte after it
+            int i = 1;
+            while (i < length && index + i < end && pBytes[index + i] != 0) { ++i; }
+            pPass->errIndex = (int)index + ((length > 0) ? i : 0);
+            return 0;
+        }
+        ++(pGroups[type]);
+        if (type == ESTIMATE_TYPE_REPEAT) {
+            // A repeat copies noteblocks of the mean columns and characters so far
+            unsigned long long countNoteblocks = pPass->countCopied;
+            double columns = pPass->copiedColumns, chars = pPass->copiedChars;
+            for (int i = 0; i < ESTIMATE_TYPE_COUNT; ++i) {
+                if (i == ESTIMATE_TYPE_REPEAT) continue;
+                countNoteblocks += (i == ESTIMATE_TYPE_TEXT) ? 0 : pGroups[i];
+                columns += pGroups[i] * estimateCosts[i].columns;
+                chars += pGroups[i] * estimateCosts[i].chars;
+            }
+            unsigned int countCopies = pBytes[index + 1];
+            if (countCopies > countNoteblocks) {
+                --(pGroups[type]);
+                pPass->errIndex = (int)index + 1; // The parser reports the count byte
+                return 0;
+            }
+            pPass->copiedColumns += countCopies * columns / countNoteblocks;
+            pPass->copiedChars += countCopies * chars / countNoteblocks;
+            pPass->countCopied += countCopies;
+        }
+        index += length;
+    }
+    return 1;
+}
+
+
+// rans_decode callback that counts each byte group into a struct estimate_pass
+int estimate_rans_callback (void* pContext, const unsigned char* pGroup) {
+    int length = estimateLengths[pGroup[0]];
+    if (!estimate_pass_range (pContext, pGroup, 0, (length > 0) ? length : 1)) return PARSE_RESULT_INVALID_BYTE;
+    return PARSE_RESULT_PARSED_NOTEBLOCK;
+}
+
+
+// Estimate what rendering encoded bytes costs, without drawing them.
+int estimate_bytes (
+    const unsigned char*    pBytes,     // File bytes: plain encoded bytes with or without a header, a container,
+                                        // or a compressed file.
+    size_t                  countBytes, // Number of file bytes.
+    int                     width,      // Max width of a staff in characters, or INT_MAX for one staff.
+    struct render_estimate* pEstimate   // Output param, set to the estimate.
+    // Returns 1 on success, 0 for a container whose chunk table is corrupt, or if out of memory.
+){
+    memset (pEstimate, 0, sizeof (struct render_estimate));
+    pEstimate->errIndex = -1;
+    estimate_fill_tables ();
+
+    // One pass over the byte groups, counting them by type
+    struct estimate_pass pass = { pEstimate->groups, 0, 0, 0, -1 };
+    struct file_header header;
+    int hasHeader = 0;
+    if (container_is_container (pBytes, countBytes)) {
+        // Chunks hold plain byte groups without terminators, in order
+        unsigned int countChunks;
+        const unsigned char* pTable = container_chunk_table (pBytes, countBytes, &countChunks);
+        if (pTable == NULL) return 0;
+        for (unsigned int chunk = 0; chunk < countChunks; ++chunk) {
+            size_t start, end;
+            container_chunk_range (pTable, chunk, &start, &end);
+            if (!estimate_pass_range (&pass, pBytes, start, end)) break;
+        }
+    }
+    else if (rans_is_compressed (pBytes, countBytes)) {
+        // Byte groups are decoded without drawing them. rans_decode checks the header's plain size before
+        // decoding, so that bounds the time this takes.
+        int errIndex;
+        if (rans_decode (pBytes, countBytes, estimate_rans_callback, &pass, &errIndex) == PARSE_RESULT_INTERNAL_ERROR) {
+            return 0;
+        }
+        pass.errIndex = errIndex;
+    }
+    else {
+        hasHeader = header_is_header (pBytes, countBytes) && header_read (pBytes, countBytes, &header);
+        estimate_pass_range (&pass, pBytes, hasHeader ? HEADER_SIZE : 0, countBytes);
+    }
+    pEstimate->errIndex = pass.errIndex;
+    unsigned long long* pGroups = pEstimate->groups;
+    double columns = pass.copiedColumns, chars = pass.copiedChars;
+    double ns = pass.countCopied * estimateCosts[ESTIMATE_TYPE_REPEAT].ns;
+    unsigned long long countNoteblocks = pass.countCopied;
+    for (int i = 0; i < ESTIMATE_TYPE_COUNT; ++i) {
+        if (i == ESTIMATE_TYPE_REPEAT) continue;
+        countNoteblocks += (i == ESTIMATE_TYPE_TEXT) ? 0 : pGroups[i];
+        columns += pGroups[i] * estimateCosts[i].columns;
+        chars += pGroups[i] * estimateCosts[i].chars;
+        ns += pGroups[i] * estimateCosts[i].ns;
+    }
+    // Nothing checks a header's totals against its file, so they're shown only if the noteblocks match what the
+    // pass counted, and memory is estimated as if they were wrong (see below)
+    if (hasHeader && pEstimate->errIndex < 0 && header.countNoteblocks == countNoteblocks) {
+        columns = header.totalWidth;
+        chars = header.totalChars;
+        pEstimate->isExact = 1;
+    }
+
+    // A staff holds noteblocks while they fit in width - 1 columns, so on average half a noteblock's width is
+    // left over
+    unsigned long long countStaves = 0;
+    if (countNoteblocks > 0) {
+        double meanColumns = columns / countNoteblocks;
+        double staffColumns = (width - 1) - meanColumns / 2;
+        if (width == INT_MAX) { countStaves = 1; }
+        else if (staffColumns < 1) { countStaves = countNoteblocks; }
+        else {
+            countStaves = (unsigned long long)(columns / staffColumns);
+            if (countStaves * staffColumns < columns) { ++countStaves; }
+        }
+        if (countStaves > countNoteblocks) { countStaves = countNoteblocks; }
+    }
+    pEstimate->noteblocks = countNoteblocks;
+    pEstimate->staves = countStaves;
+    pEstimate->outputBytes = (unsigned long long)chars + (NOTEBLOCK_HEIGHT + 1) * countStaves;
+
+    // The string is sized as noteblocks_to_string sizes it. With a header, it's first sized from the header's
+    // totals, and if they're too small, that string is freed and noteblocks_to_string tried instead, so at most
+    // the larger of the two is allocated at a time.
+    unsigned long long stringBytes = pEstimate->outputBytes + 1;
+    if (countNoteblocks > 0) {
+        unsigned long long noteblocksPerStaff = (width == INT_MAX) ? countNoteblocks
+                                                : (unsigned long long)((width - 1) / NOTEBLOCK_WIDTH);
+        if (noteblocksPerStaff == 0) { noteblocksPerStaff = 1; }
+        stringBytes = (unsigned long long)NOTEBLOCK_HEIGHT * NOTEBLOCK_WIDTH * countNoteblocks
+            + (NOTEBLOCK_HEIGHT + 1) * ((countNoteblocks + noteblocksPerStaff - 1) / noteblocksPerStaff) + 1;
+    }
+    if (hasHeader && header.countNoteblocks > 0 && width >= NOTEBLOCK_WIDTH) {
+        unsigned int minFullWidth = (unsigned int)width - NOTEBLOCK_WIDTH;
+        unsigned long long headerStaves = (minFullWidth == 0) ? header.countNoteblocks
+                                                              : (header.totalWidth / minFullWidth) + 1;
+        if (headerStaves > header.countNoteblocks) { headerStaves = header.countNoteblocks; }
+        unsigned long long headerStringBytes = header.totalChars + ((NOTEBLOCK_HEIGHT + 1) * headerStaves) + 1;
+        if (headerStringBytes > stringBytes && headerStringBytes <= INT_MAX) { stringBytes = headerStringBytes; }
+    }
+    pEstimate->memoryBytes = countBytes + 1 + countNoteblocks * sizeof (struct noteblock) + stringBytes;
+    pEstimate->renderNs = ns;
+    return 1;
+}
+
+
+
+//****************
+// Model and budget
+//****************
+
+// Load a model written by option -ec.
+int estimate_load_model (
+    const char* filepath // User-entered path of the model file.
+    // Returns 1 on success, otherwise prints an error and returns 0.
+){
+    size_t countBytes;
+    char* text = (char*)read_large_file_bytes ((char*)filepath, &countBytes);
+    if (text == NULL) return 0;
+    struct estimate_cost costs[ESTIMATE_TYPE_COUNT];
+    int isFound[ESTIMATE_TYPE_COUNT] = { 0 };
+    for (const char* pLine = text; pLine != NULL && *pLine != '\0'; ) {
+        for (int type = 0; type < ESTIMATE_TYPE_COUNT; ++type) {
+            size_t nameLen = strlen (ESTIMATE_TYPE_NAMES[type]);
+            if (strncmp (pLine, ESTIMATE_TYPE_NAMES[type], nameLen) != 0 || pLine[nameLen] != ',') continue;
+            char* pEnd;
+            costs[type].ns = strtod (pLine + nameLen + 1, &pEnd);
+            costs[type].columns = (*pEnd == ',') ? strtod (pEnd + 1, &pEnd) : -1;
+            costs[type].chars = (*pEnd == ',') ? strtod (pEnd + 1, &pEnd) : -1;
+            isFound[type] = (costs[type].ns >= 0 && costs[type].columns >= 0 && costs[type].chars >= 0);
+        }
+        pLine = strchr (pLine, '\n');
+        if (pLine != NULL) { ++pLine; }
+    }
+    free (text);
+    for (int type = 0; type < ESTIMATE_TYPE_COUNT; ++type) {
+        if (!isFound[type]) {
+            printf ("  No valid cost for %s in %s\n", ESTIMATE_TYPE_NAMES[type], filepath);
+            return 0;
+        }
+    }
+    memcpy (estimateCosts, costs, sizeof (costs));
+    estimateModelName = filepath;
+    return 1;
+}
+
+
+// Set the budgets for admission control.
+int estimate_set_budget (
+    char* msStr, // User-entered most milliseconds a render may be estimated to take, or NULL for no limit.
+    char* mbStr, // User-entered most megabytes a render may be estimated to allocate, or NULL for no limit.
+    int   defers // 1 to defer jobs over budget, 0 to reject them.
+    // Returns 1 on success, otherwise prints an error and returns 0.
+){
+    double ms = (msStr == NULL) ? 0 : strtod (msStr, NULL);
+    double mb = (mbStr == NULL) ? 0 : strtod (mbStr, NULL);
+    if ((msStr != NULL && !(ms > 0)) || (mbStr != NULL && !(mb > 0))) {
+        printf ("  Invalid budget\n");
+        return 0;
+    }
+    estimateBudgetNs = (unsigned long long)(ms * 1e6);
+    estimateBudgetBytes = (unsigned long long)(mb * 1024 * 1024);
+    estimateDefers = defers;
+    return 1;
+}
+
+
+// Whether a budget is set.
+int estimate_has_budget () {
+    return estimateBudgetNs > 0 || estimateBudgetBytes > 0;
+}
+
+
+
+//*****
+// IO
+//*****
+
+// Decide whether to render a file, from its estimate and the budgets. Prints nothing if it's within budget.
+int try_admit_file (
+    char* filepath, // User-entered file path and name.
+    char* widthStr  // User-entered string for maximum staff width, or NULL if not entered.
+    // Returns the process exit status: 0 to go ahead and render, ESTIMATE_EXIT_REJECTED or
+    // ESTIMATE_EXIT_DEFERRED if over budget. Files that can't be read are let through, so rendering reports the
+    // problem, but files that can't be estimated count as over budget.
+){
+    int width;
+    size_t countBytes;
+    if (!parse_width_arg (widthStr, &width)) return 0;
+    unsigned char* pBytes = read_large_file_bytes (filepath, &countBytes);
+    if (pBytes == NULL) return 0;
+    struct render_estimate estimate;
+    int isEstimated = estimate_bytes (pBytes, countBytes, width, &estimate);
+    free (pBytes);
+    if (!isEstimated) {
+        printf ("  %s: can't be estimated, so counted as over budget\n", estimateDefers ? "Deferred" : "Rejected");
+        return estimateDefers ? ESTIMATE_EXIT_DEFERRED : ESTIMATE_EXIT_REJECTED;
+    }
+    int isOverTime = estimateBudgetNs > 0 && estimate.renderNs > estimateBudgetNs;
+    int isOverMemory = estimateBudgetBytes > 0 && estimate.memoryBytes > estimateBudgetBytes;
+    if (!isOverTime && !isOverMemory) return 0;
+    printf ("  %s: estimated %.3f ms and %.1f MB, over the budget of", estimateDefers ? "Deferred" : "Rejected",
+        estimate.renderNs / 1e6, estimate.memoryBytes / (1024.0 * 1024.0));
+    if (isOverTime) { printf (" %.3f ms", estimateBudgetNs / 1e6); }
+    if (isOverTime && isOverMemory) { printf (" and"); }
+    if (isOverMemory) { printf (" %.1f MB", estimateBudgetBytes / (1024.0 * 1024.0)); }
+    printf ("\n");
+    return estimateDefers ? ESTIMATE_EXIT_DEFERRED : ESTIMATE_EXIT_REJECTED;
+}
+
+
+// Print the estimate for a file, for cmd line option -es.
+void try_estimate_file (
+    char* filepath, // User-entered file path and name.
+    char* widthStr  // User-entered string for maximum staff width, or NULL if not entered.
+){
+    int width;
+    size_t countBytes;
+    if (!parse_width_arg (widthStr, &width)) return;
+    unsigned char* pBytes = read_large_file_bytes (filepath, &countBytes);
+    if (pBytes == NULL) return;
+    struct render_estimate estimate;
+    unsigned long long time0 = platform_now_ns ();
+    int isEstimated = estimate_bytes (pBytes, countBytes, width, &estimate);
+    unsigned long long estimateNs = platform_now_ns () - time0;
+    free (pBytes);
+    if (!isEstimated) {
+        printf ("  Corrupt container or memory allocation error; unable to estimate %s\n", filepath);
+        return;
+    }
+    printf ("  Byte groups:");
+    for (int type = 0; type < ESTIMATE_TYPE_COUNT; ++type) {
+        printf ("%s %s %llu", (type == 0) ? "" : ",", ESTIMATE_TYPE_NAMES[type], estimate.groups[type]);
+    }
+    printf ("\n");
+    if (estimate.errIndex >= 0) {
+        printf ("  Invalid byte at location #%d; estimated up to it\n", estimate.errIndex);
+    }
+    printf ("  Noteblocks:   %llu%s\n", estimate.noteblocks, estimate.isExact ? " (from header)" : "");
+    printf ("  Staves:       %llu%s\n", estimate.staves, estimate.isExact ? "" : " (estimated)");
+    printf ("  Output bytes: %llu%s\n", estimate.outputBytes, estimate.isExact ? "" : " (estimated)");
+    printf ("  Memory:       %.1f MB (estimated)\n", estimate.memoryBytes / (1024.0 * 1024.0));
+    printf ("  Render time:  %.3f ms (estimated by the %s model, without the measure memo)\n",
+        estimate.renderNs / 1e6, estimateModelName);
+    printf ("  Estimated in %.3f ms\n", estimateNs / 1e6);
+}
+
+
+// Make bytes of many random byte groups of one type, to measure its cost.
+unsigned char* estimate_make_calibration_bytes (
+    int                 type,         // Index in ESTIMATE_TYPES, or -1 for notes only, the baseline for dynamics
+                                      // text and repeats.
+    unsigned long long* pSeed,        // Random number generator state, updated.
+    size_t*             pCountBytes   // Output param, set to the number of bytes, including the terminator.
+    // Returns the bytes, plus a 0 after them (caller must free), or NULL if out of memory.
+){
+    // Repeats follow 255 notes, each copying all 255
+    int countGroups = (type == ESTIMATE_TYPE_REPEAT) ? 255 + ESTIMATE_CALIBRATION_REPEATS : ESTIMATE_CALIBRATION_GROUPS;
+    unsigned char* pBytes = malloc (4 * 2 * countGroups + 2);
+    if (pBytes == NULL) return NULL;
+    size_t index = 0;
+    for (int i = 0; i < countGroups; ++i) {
+        unsigned char random[4];
+        for (int j = 0; j < 4; ++j) {
+            *pSeed ^= *pSeed << 13; *pSeed ^= *pSeed >> 7; *pSeed ^= *pSeed << 17; // xorshift64
+            random[j] = (unsigned char)((*pSeed >> 32) | 1); // Never 0, which would end the byte group early
+        }
+        if (type < 0 || type == ESTIMATE_TYPE_TEXT || (type == ESTIMATE_TYPE_REPEAT && i < 255)) {
+            pBytes[index++] = (unsigned char)((random[0] & ~0b111) | BYTE_GROUP_TYPE_NOTE_NN);
+            pBytes[index++] = random[1];
+            if (type != ESTIMATE_TYPE_TEXT) continue;
+        }
+        switch (ESTIMATE_TYPES[(type < 0) ? 0 : type]) {
+            case BYTE_GROUP_TYPE_CLEF:
+                if (type < 0) break;
+                pBytes[index++] = (unsigned char)((random[0] & ~0b111111) | BYTE_GROUP_TYPE_CLEF); break;
+            case BYTE_GROUP_TYPE_KEY_CHANGE:
+                pBytes[index++] = (unsigned char)((random[0] & ~0b11) | BYTE_GROUP_TYPE_KEY_CHANGE);
+                pBytes[index++] = random[1]; pBytes[index++] = random[2]; pBytes[index++] = random[3]; break;
+            case BYTE_GROUP_TYPE_TIME_CHANGE:
+                pBytes[index++] = (unsigned char)((random[0] & ~0b11) | BYTE_GROUP_TYPE_TIME_CHANGE); break;
+            case BYTE_GROUP_TYPE_NOTE_NN:
+                pBytes[index++] = (unsigned char)((random[0] & ~0b111) | BYTE_GROUP_TYPE_NOTE_NN);
+                pBytes[index++] = random[1]; break;
+            case BYTE_GROUP_TYPE_NOTE_NB:
+                pBytes[index++] = (unsigned char)((random[0] & ~0b111) | BYTE_GROUP_TYPE_NOTE_NB);
+                pBytes[index++] = random[1]; pBytes[index++] = random[2]; break;
+            case BYTE_GROUP_TYPE_DYN_TEXT:
+                pBytes[index++] = (unsigned char)((random[0] & ~0b1111) | BYTE_GROUP_TYPE_DYN_TEXT);
+                pBytes[index++] = random[1]; pBytes[index++] = random[2]; break;
+            case BYTE_GROUP_TYPE_BARLINE:
+                pBytes[index++] = (unsigned char)((random[0] & ~0b1111) | BYTE_GROUP_TYPE_BARLINE); break;
+            case BYTE_GROUP_TYPE_REPEAT:
+                if (i < 255) break;
+                pBytes[index++] = BYTE_GROUP_TYPE_REPEAT;
+                pBytes[index++] = 255; break;
+        }
+    }
+    pBytes[index++] = 0; // Terminator
+    pBytes[index] = 0;
+    *pCountBytes = index;
+    return pBytes;
+}
+
+
+// Measure rendering some bytes as the model counts it. Each run's noteblocks and string are kept until the last
+// run, so every run allocates fresh memory, as printing a file once does, rather than reusing what the previous
+// run freed.
+int estimate_measure_calibration (
+    const unsigned char* pBytes,      // Encoded bytes, plus a 0 after them.
+    size_t               countBytes,  // Number of encoded bytes.
+    double*              pNs,         // Output param, set to the median render time, including freeing.
+    double*              pColumns,    // Output param, set to the noteblocks' total width.
+    double*              pChars       // Output param, set to the noteblocks' total characters.
+    // Returns 1 on success, otherwise prints an error and returns 0.
+){
+    struct noteblock* p1stNoteblocks[ESTIMATE_CALIBRATION_RUNS] = { NULL };
+    char* strs[ESTIMATE_CALIBRATION_RUNS] = { NULL };
+    unsigned long long runNs[ESTIMATE_CALIBRATION_RUNS];
+    int isOk = 1;
+    for (int run = 0; run < ESTIMATE_CALIBRATION_RUNS && isOk; ++run) {
+        int errIndex;
+        unsigned long long time0 = platform_now_ns ();
+        int parseResult = parse_file_bytes (pBytes, countBytes, &(p1stNoteblocks[run]), &errIndex);
+        strs[run] = (parseResult == PARSE_RESULT_PARSED_ALL)
+                  ? noteblocks_to_string (p1stNoteblocks[run], ESTIMATE_CALIBRATION_WIDTH) : NULL;
+        runNs[run] = platform_now_ns () - time0;
+        isOk = (strs[run] != NULL);
+    }
+    if (isOk) {
+        unsigned int countNoteblocks, totalWidth, totalChars;
+        header_measure_noteblocks (p1stNoteblocks[0], &countNoteblocks, &totalWidth, &totalChars);
+        *pColumns = totalWidth;
+        *pChars = totalChars;
+    }
+    for (int run = 0; run < ESTIMATE_CALIBRATION_RUNS; ++run) {
+        unsigned long long time0 = platform_now_ns ();
+        free_noteblocks (p1stNoteblocks[run]);
+        free (strs[run]);
+        runNs[run] += platform_now_ns () - time0;
+    }
+    // Median, by insertion sort
+    for (int i = 1; i < ESTIMATE_CALIBRATION_RUNS; ++i) {
+        unsigned long long ns = runNs[i];
+        int j = i;
+        for (; j > 0 && runNs[j - 1] > ns; --j) { runNs[j] = runNs[j - 1]; }
+        runNs[j] = ns;
+    }
+    *pNs = (double)runNs[ESTIMATE_CALIBRATION_RUNS / 2];
+    if (!isOk) { printf ("  Internal error while measuring\n"); }
+    return isOk;
+}
+
+
+// Measure a model on this machine and write it to a file for --cost-model, for cmd line option -ec.
+void try_calibrate_estimate (
+    char* outFilepath // User-entered path of the model file to write.
+){
+    int wasMemoEnabled = memo_is_enabled ();
+    memo_set_enabled (0); // The model is of drawing every measure
+    unsigned long long seed = 0x9E3779B97F4A7C15ULL;
+    struct estimate_cost costs[ESTIMATE_TYPE_COUNT];
+    struct estimate_cost notes; // Notes alone, subtracted from the types that need notes before them
+    int isOk = 1;
+    for (int type = -1; type < ESTIMATE_TYPE_COUNT && isOk; ++type) {
+        size_t countBytes;
+        unsigned char* pBytes = estimate_make_calibration_bytes (type, &seed, &countBytes);
+        if (pBytes == NULL) {
+            printf ("  Memory allocation error\n");
+            isOk = 0;
+            break;
+        }
+        struct estimate_cost cost;
+        isOk = estimate_measure_calibration (pBytes, countBytes, &(cost.ns), &(cost.columns), &(cost.chars));
+        free (pBytes);
+        if (type < 0) {
+            notes = cost;
+            continue;
+        }
+        if (type == ESTIMATE_TYPE_TEXT) {
+            cost.ns -= notes.ns; cost.columns -= notes.columns; cost.chars -= notes.chars;
+        }
+        else if (type == ESTIMATE_TYPE_REPEAT) {
+            // 255 notes, then each repeat copies 255 noteblocks
+            double notesShare = 255.0 / ESTIMATE_CALIBRATION_GROUPS;
+            cost.ns = (cost.ns - notes.ns * notesShare) / (ESTIMATE_CALIBRATION_REPEATS * 255.0);
+            cost.columns = 0;
+            cost.chars = 0;
+        }
+        if (type != ESTIMATE_TYPE_REPEAT) {
+            cost.ns /= ESTIMATE_CALIBRATION_GROUPS;
+            cost.columns /= ESTIMATE_CALIBRATION_GROUPS;
+            cost.chars /= ESTIMATE_CALIBRATION_GROUPS;
+        }
+        if (cost.ns < 0) { cost.ns = 0; }
+        if (cost.columns < 0) { cost.columns = 0; }
+        if (cost.chars < 0) { cost.chars = 0; }
+        costs[type] = cost;
+    }
+    memo_set_enabled (wasMemoEnabled);
+    if (!isOk) return;
+
+    FILE* file = NULL;
+    if (fopen_s (&file, outFilepath, "wb") || file == NULL) {
+        printf ("  Unable to create file %s\n", outFilepath);
+        return;
+    }
+    fprintf (file, "type,ns,columns,chars\n");
+    printf ("  %-8s %10s %8s %8s\n", "Type", "ns", "Columns", "Chars");
+    for (int type = 0; type < ESTIMATE_TYPE_COUNT; ++type) {
+        fprintf (file, "%s,%.1f,%.2f,%.2f\n", ESTIMATE_TYPE_NAMES[type], costs[type].ns, costs[type].columns,
+            costs[type].chars);
+        printf ("  %-8s %10.1f %8.2f %8.2f\n", ESTIMATE_TYPE_NAMES[type], costs[type].ns, costs[type].columns,
+            costs[type].chars);
+    }
+    if (fclose (file) != 0) {
+        printf ("  Unable to write file %s\n", outFilepath);
+        return;
+    }
+    printf ("  Wrote %s. Repeat costs are per copied noteblock.\n", outFilepath);
+}
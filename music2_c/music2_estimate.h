@@ -0,0 +1,28 @@
+//*****************************************************************************
+// music2_estimate.h.
+// Scope: Private to music2 program.
+// Bare-bones .h file to facilitate linking. See the .c file for descriptions.
+//*****************************************************************************
+
+#pragma once
+
+#include <stddef.h> // size_t
+
+#define ESTIMATE_TYPE_COUNT (8)
+struct render_estimate {
+    unsigned long long groups[ESTIMATE_TYPE_COUNT];
+    unsigned long long noteblocks;
+    unsigned long long staves;
+    unsigned long long outputBytes;
+    unsigned long long memoryBytes;
+    double             renderNs;
+    int                errIndex;
+    int                isExact;
+};
+int estimate_bytes (const unsigned char* pBytes, size_t countBytes, int width, struct render_estimate* pEstimate);
+int estimate_load_model (const char* filepath);
+int estimate_set_budget (char* msStr, char* mbStr, int defers);
+int estimate_has_budget ();
+int try_admit_file (char* filepath, char* widthStr);
+void try_estimate_file (char* filepath, char* widthStr);
+void try_calibrate_estimate (char* outFilepath);
@@ -0,0 +1,432 @@
+//*****************************************************************************************************
+// music2_events.c
+// This file contains an event decoder, for code that needs what the music says rather than how it looks, such
+// as playback, search, or conversion to other formats, and the cmd line option -ev that prints the events of a
+// file. It walks the byte groups as parse_byte_group does, using the same n_*, nn_*, and nb_* functions as
+// music2_draw_note.c to read their fields, and hands each one to a callback as a struct music_event.
+//   - Nothing is drawn and no noteblocks are allocated, so it runs many times faster than printing.
+//   - There is an event for each noteblock, in order, plus one for each dynamics text after the noteblock it's
+//     written under. Repeat byte groups produce the events of the noteblocks they copy again, including their
+//     dynamics text, with isRepeat set.
+//   - Errors, and their indexes, are the same as parse_bytes_from gives. Events up to an error are still handed
+//     over.
+//*****************************************************************************************************
+
+
+// External inclusions
+#include <limits.h> // UINT_MAX
+#include <stddef.h> // NULL, size_t
+#include <stdio.h>  // printf
+#include <stdlib.h> // free, realloc
+
+// Internal inclusions
+#include "music2_container.h"
+#include "music2_draw_note.h"
+#include "music2_draw_other.h"
+#include "music2_general2.h"
+#include "music2_header.h"
+#include "music2_noteblock.h"
+#include "music2_rans.h"
+
+
+//***********
+// Constants
+//***********
+
+// EVENT_TYPE constants, one for each kind of noteblock, plus dynamics text
+#define EVENT_TYPE_CLEF     (0) // Clef. Sets clef.
+#define EVENT_TYPE_KEY      (1) // Key signature. Sets keyFlats, keyNaturals, keySharps.
+#define EVENT_TYPE_TIME     (2) // Time signature. Sets timeTop, timeBottom.
+#define EVENT_TYPE_NOTE     (3) // Note, not beamed (NN). Sets the note fields other than the beamed note fields.
+#define EVENT_TYPE_REST     (4) // Rest (NN with notehead row 0). Sets duration, isDotted.
+#define EVENT_TYPE_BEAMED   (5) // Note, beamed (NB). Sets the note fields other than duration.
+#define EVENT_TYPE_BARLINE  (6) // Barline. Sets barline.
+#define EVENT_TYPE_DYNAMICS (7) // Dynamics text under the noteblock of the event before. Sets text.
+#define EVENT_TYPE_COUNT    (8)
+
+// Names of the EVENT_TYPEs, as printed by option -ev
+const char* EVENT_TYPE_NAMES[EVENT_TYPE_COUNT] = { "clef", "key", "time", "note", "rest", "beamed", "barline", "text" };
+
+// EVENT_CLEF constants
+#define EVENT_CLEF_TREBLE     (0)
+#define EVENT_CLEF_BASS       (1)
+#define EVENT_CLEF_PERCUSSION (2)
+#define EVENT_CLEF_INVALID    (3) // Printed as an error
+
+// Marks a noteblock in the event history without dynamics text
+#define EVENT_NO_TEXT (UINT_MAX)
+
+
+
+//********
+// Events
+//********
+
+// What one byte group says, or one noteblock copied by a repeat byte group. Fields a type doesn't set are 0.
+struct music_event {
+    unsigned char  type;          // One of the EVENT_TYPEs.
+    unsigned char  isRepeat;      // 1 if a repeat byte group copied this, otherwise 0.
+    unsigned char  row;           // Notes: notehead row (1-15, see ROW_ constants). Out of range rows are
+                                  // printed as an error.
+    unsigned char  duration;      // Notes and rests: an nn_DUR constant. Others are printed as an error.
+    unsigned char  accidental;    // Notes: 0 for none, 1 for flat, 2 for natural, 3 for sharp.
+    unsigned char  articulation;  // Notes: 0 for none, 1 for staccato, 2 for accent, 3 for tenuto.
+    unsigned char  isTied;        // Notes: 1 if tied/slurred to the next note.
+    unsigned char  isTiedToPrev;  // Notes: 1 if the previous note is tied/slurred to this one.
+    unsigned char  isDotted;      // Notes and rests: 1 if dotted.
+    signed char    orientation;   // Notes: 1 for stem up and articulation below, -1 for the opposite.
+    unsigned char  stemLength;    // Beamed notes: 1-4.
+    unsigned char  beamsLeft;     // Beamed notes: beams left of the stem, 0-3.
+    unsigned char  beamsRight;    // Beamed notes: beams right of the stem, 0-3.
+    unsigned char  beamsNarrow;   // Beamed notes: how many of the beams on one side are narrow, 0-3.
+    unsigned char  timeTop;       // Time signatures: top number, 1-16.
+    unsigned char  timeBottom;    // Time signatures: bottom number, 1, 2, 4, or 8.
+    unsigned char  barline;       // Barlines: barline type (0-15, of which 10-15 are printed as an error).
+    unsigned char  clef;          // Clefs: one of the EVENT_CLEFs.
+    unsigned short keyFlats;      // Key signatures: bit n is set for a flat on row n.
+    unsigned short keyNaturals;   // Key signatures: bit n is set for a natural on row n.
+    unsigned short keySharps;     // Key signatures: bit n is set for a sharp on row n.
+    char           text[5];       // Dynamics text: the 5 characters, '\0' where nothing is written.
+    unsigned int   noteblock;     // Index of the noteblock drawn, or written under for dynamics text.
+    unsigned int   byteIndex;     // Index of the byte group decoded. For copies, the byte group first copied.
+};
+
+
+// Set an event from the byte group at some index. The byte group must be whole and not a repeat.
+void events_decode_group (
+    const unsigned char* pBytes,     // Pointer to encoded bytes.
+    unsigned int         index,      // Index of the byte group's first byte.
+    unsigned int         parseInfo,  // parseInfo before the byte group - see update_parse_info.
+    unsigned int         noteblock,  // Index of the noteblock drawn, or written under.
+    int                  isRepeat,   // 1 if a repeat byte group copied the noteblock.
+    struct music_event*  pEvent      // Event to set.
+){
+    unsigned char byte1 = pBytes[index];
+    unsigned char byte2 = 0, byte3 = 0, byte4 = 0;
+    int byteGroupType = byte_group_type (byte1);
+    int length = byte_group_length (byteGroupType);
+    if (length > 1) byte2 = pBytes[index + 1];
+    if (length > 2) byte3 = pBytes[index + 2];
+    if (length > 3) byte4 = pBytes[index + 3];
+
+    *pEvent = (struct music_event) { 0 };
+    pEvent->isRepeat = (unsigned char)isRepeat;
+    pEvent->noteblock = noteblock;
+    pEvent->byteIndex = index;
+    switch (byteGroupType) {
+        case BYTE_GROUP_TYPE_CLEF:
+            pEvent->type = EVENT_TYPE_CLEF;
+            pEvent->clef =
+                (byte1 == 0b00100000) ? EVENT_CLEF_TREBLE :
+                (byte1 == 0b01100000) ? EVENT_CLEF_BASS :
+                (byte1 == 0b10100000) ? EVENT_CLEF_PERCUSSION : EVENT_CLEF_INVALID;
+            break;
+        case BYTE_GROUP_TYPE_KEY_CHANGE: {
+            // As in make_key_signature: a row set in both halves is a natural
+            unsigned short bits01to16 = ((unsigned short)byte2 << 8) + byte1;
+            unsigned short bits17to32 = ((unsigned short)byte4 << 8) + byte3;
+            unsigned short rows = 0;
+            for (size_t i = 0; i < sizeof (KEY_SIGNATURE_ROWS); ++i) { rows |= (1 << KEY_SIGNATURE_ROWS[i]); }
+            pEvent->type = EVENT_TYPE_KEY;
+            pEvent->keyFlats = bits01to16 & ~bits17to32 & rows;
+            pEvent->keyNaturals = bits01to16 & bits17to32 & rows;
+            pEvent->keySharps = ~bits01to16 & bits17to32 & rows;
+            break;
+        }
+        case BYTE_GROUP_TYPE_TIME_CHANGE:
+            pEvent->type = EVENT_TYPE_TIME;
+            pEvent->timeTop = (byte1 / 16) + 1;
+            pEvent->timeBottom = 1 << ((byte1 / 4) % 4);
+            break;
+        case BYTE_GROUP_TYPE_NOTE_NN:
+        case BYTE_GROUP_TYPE_NOTE_NB: {
+            int row = n_notehead_row (byte2);
+            int isNB = n_isNB (byte1);
+            pEvent->isDotted = (unsigned char)n_is_dotted (byte2);
+            if (!isNB) { pEvent->duration = (unsigned char)nn_duration (byte2); }
+            if (!isNB && nn_is_rest (row)) {
+                pEvent->type = EVENT_TYPE_REST;
+                break;
+            }
+            pEvent->type = isNB ? EVENT_TYPE_BEAMED : EVENT_TYPE_NOTE;
+            pEvent->row = (unsigned char)row;
+            pEvent->accidental = (unsigned char)n_accidental (byte1);
+            pEvent->articulation = (unsigned char)n_articulation (byte1);
+            pEvent->isTied = (unsigned char)n_is_tied (byte1);
+            pEvent->isTiedToPrev = (unsigned char)n_is_tied ((parseInfo & 0xFF00) >> 8);
+            pEvent->orientation = (signed char)(isNB ? nb_orientation (byte2) : nn_orientation (row));
+            if (isNB) {
+                pEvent->stemLength = (unsigned char)nb_stem_length (byte2);
+                pEvent->beamsLeft = (unsigned char)nb_beam_count_left (byte3);
+                pEvent->beamsRight = (unsigned char)nb_beam_count_right (byte3);
+                pEvent->beamsNarrow = (unsigned char)nb_beam_count_narrow (byte3);
+            }
+            break;
+        }
+        case BYTE_GROUP_TYPE_BARLINE:
+            pEvent->type = EVENT_TYPE_BARLINE;
+            pEvent->barline = byte1 >> 4;
+            break;
+        case BYTE_GROUP_TYPE_DYN_TEXT:
+            // As in draw_dynamics_text_row
+            pEvent->type = EVENT_TYPE_DYNAMICS;
+            pEvent->text[0] = DYNAMICS_CHARACTERS[byte1 / 16];
+            pEvent->text[1] = DYNAMICS_CHARACTERS[byte2 % 16];
+            pEvent->text[2] = DYNAMICS_CHARACTERS[byte2 / 16];
+            pEvent->text[3] = DYNAMICS_CHARACTERS[byte3 % 16];
+            pEvent->text[4] = DYNAMICS_CHARACTERS[byte3 / 16];
+            break;
+    }
+}
+
+
+
+//**********
+// Decoding
+//**********
+
+// Like scan_history, with what's needed to decode the noteblocks again for repeat byte groups. Initialize count
+// to 0.
+struct event_history {
+    unsigned int byteIndexes[PARSE_HISTORY_SIZE];  // Index of the byte group that first drew each noteblock.
+    unsigned int textIndexes[PARSE_HISTORY_SIZE];  // Index of the dynamics text under it, or EVENT_NO_TEXT.
+    unsigned int parseInfosIn[PARSE_HISTORY_SIZE]; // parseInfo before the byte group that first drew it.
+    unsigned int parseInfos[PARSE_HISTORY_SIZE];   // parseInfo after it and any dynamics text on it.
+    unsigned int count;                            // Count of noteblocks so far.
+};
+
+
+// Add a noteblock to the event history
+void event_history_add (
+    struct event_history* pHistory,     // History to add to.
+    unsigned int          byteIndex,    // Index of the byte group that first drew the noteblock.
+    unsigned int          textIndex,    // Index of the dynamics text under it, or EVENT_NO_TEXT.
+    unsigned int          parseInfoIn,  // parseInfo before the byte group that first drew it.
+    unsigned int          parseInfo     // parseInfo after it.
+){
+    unsigned int slot = pHistory->count % PARSE_HISTORY_SIZE;
+    pHistory->byteIndexes[slot] = byteIndex;
+    pHistory->textIndexes[slot] = textIndex;
+    pHistory->parseInfosIn[slot] = parseInfoIn;
+    pHistory->parseInfos[slot] = parseInfo;
+    ++(pHistory->count);
+}
+
+
+// Decode encoded bytes to events, without drawing anything. Allocates nothing.
+int events_decode (
+    const unsigned char* pBytes,     // Pointer to encoded bytes, without a header. Need not be 0-terminated.
+    size_t               countBytes, // Number of encoded bytes. The end of the bytes counts as a terminator.
+    void                 (*pEmit) (void* pContext, const struct music_event* pEvent), // Called with each event,
+                                     // in order. The event is only valid during the call.
+    void*                pContext,   // Passed to pEmit.
+    int*                 pErrIndex   // Will be set to the index of any error in *pBytes, otherwise to -1.
+    // Returns PARSE_RESULT_PARSED_ALL, or the PARSE_RESULT parse_bytes_from would give for an error.
+){
+    struct event_history history;
+    history.count = 0;
+    struct music_event event;
+    unsigned int parseInfo = 0;
+    size_t index = 0;
+    *pErrIndex = -1;
+    while (index < countBytes) {
+        unsigned char byte1 = pBytes[index];
+        int byteGroupType = byte_group_type (byte1);
+        if (byteGroupType == BYTE_GROUP_TYPE_TERMINATOR) break;
+        int length = byte_group_length (byteGroupType);
+        // Check the byte group in the order parse_byte_group does, so errors are reported at the same byte
+        int isTextMisplaced = (byteGroupType == BYTE_GROUP_TYPE_DYN_TEXT)
+            && (history.count == 0 || (parseInfo & 0xFF) == BYTE_GROUP_TYPE_DYN_TEXT);
+        if (length == 0 || isTextMisplaced) {
+            *pErrIndex = (int)index;
+            return PARSE_RESULT_INVALID_BYTE;
+        }
+        for (int i = 1; i < length; ++i) {
+            if (index + i >= countBytes || pBytes[index + i] == 0) {
+                *pErrIndex = (int)(index + i);
+                return PARSE_RESULT_UNEXPECTED_TERMINATOR;
+            }
+        }
+
+        if (byteGroupType == BYTE_GROUP_TYPE_REPEAT) {
+            // As in scan_byte_group_history, the next noteblock to copy is always countNoteblocks back
+            unsigned int countNoteblocks = pBytes[index + 1];
+            if (countNoteblocks > history.count) {
+                *pErrIndex = (int)(index + 1);
+                return PARSE_RESULT_INVALID_BYTE;
+            }
+            for (unsigned int i = 0; i < countNoteblocks; ++i) {
+                unsigned int slot = (history.count - countNoteblocks) % PARSE_HISTORY_SIZE;
+                unsigned int byteIndex = history.byteIndexes[slot];
+                unsigned int textIndex = history.textIndexes[slot];
+                unsigned int parseInfoIn = history.parseInfosIn[slot];
+                events_decode_group (pBytes, byteIndex, parseInfoIn, history.count, 1, &event);
+                pEmit (pContext, &event);
+                if (textIndex != EVENT_NO_TEXT) {
+                    events_decode_group (pBytes, textIndex, parseInfoIn, history.count, 1, &event);
+                    pEmit (pContext, &event);
+                }
+                int copiedType = byte_group_type (pBytes[byteIndex]);
+                unsigned int copiedParseInfo = history.parseInfos[slot];
+                parseInfo = (copiedType == BYTE_GROUP_TYPE_NOTE_NN || copiedType == BYTE_GROUP_TYPE_NOTE_NB)
+                    ? copiedParseInfo : ((parseInfo & 0x0000FF00) | (copiedParseInfo & 0xFF));
+                event_history_add (&history, byteIndex, textIndex, parseInfoIn, parseInfo);
+            }
+        }
+        else if (byteGroupType == BYTE_GROUP_TYPE_DYN_TEXT) {
+            // Written under the most recent noteblock, and copied with it
+            unsigned int slot = (history.count - 1) % PARSE_HISTORY_SIZE;
+            events_decode_group (pBytes, (unsigned int)index, parseInfo, history.count - 1, 0, &event);
+            pEmit (pContext, &event);
+            parseInfo = update_parse_info (parseInfo, (unsigned char)byteGroupType, byte1);
+            history.textIndexes[slot] = (unsigned int)index;
+            history.parseInfos[slot] = parseInfo;
+        }
+        else {
+            events_decode_group (pBytes, (unsigned int)index, parseInfo, history.count, 0, &event);
+            pEmit (pContext, &event);
+            unsigned int parseInfoIn = parseInfo;
+            parseInfo = update_parse_info (parseInfo, (unsigned char)byteGroupType, byte1);
+            event_history_add (&history, (unsigned int)index, EVENT_NO_TEXT, parseInfoIn, parseInfo);
+        }
+        index += length;
+    }
+    return PARSE_RESULT_PARSED_ALL;
+}
+
+
+// Events collected into a flat array by events_collect
+struct event_array {
+    struct music_event* pEvents;       // Events, or NULL if there are none yet.
+    size_t              count;         // Number of events.
+    size_t              capacity;      // Number of events there's room for.
+    int                 isOutOfMemory; // 1 if an event couldn't be added.
+};
+
+
+// events_decode callback that adds each event to an array
+void events_collect (void* pContext, const struct music_event* pEvent) {
+    struct event_array* pArray = pContext;
+    if (pArray->count == pArray->capacity) {
+        size_t capacity = (pArray->capacity == 0) ? 1024 : pArray->capacity * 2;
+        struct music_event* pNew = realloc (pArray->pEvents, capacity * sizeof (struct music_event));
+        if (pNew == NULL) {
+            pArray->isOutOfMemory = 1;
+            return;
+        }
+        pArray->pEvents = pNew;
+        pArray->capacity = capacity;
+    }
+    pArray->pEvents[pArray->count++] = *pEvent;
+}
+
+
+// Decode encoded bytes to a flat array of events.
+struct music_event* events_decode_to_array (
+    const unsigned char* pBytes,       // Pointer to encoded bytes, without a header. Need not be 0-terminated.
+    size_t               countBytes,   // Number of encoded bytes. The end of the bytes counts as a terminator.
+    size_t*              pCountEvents, // Output param, set to the number of events.
+    int*                 pParseResult, // Will be set to one of the PARSE_RESULTs, as events_decode returns.
+    int*                 pErrIndex     // Will be set to the index of any error in *pBytes, otherwise to -1.
+    // Returns the events up to the terminator or any error (caller must free), or NULL if there are none or
+    // memory ran out, in which case *pParseResult is PARSE_RESULT_INTERNAL_ERROR.
+){
+    struct event_array array = { NULL, 0, 0, 0 };
+    *pParseResult = events_decode (pBytes, countBytes, events_collect, &array, pErrIndex);
+    if (array.isOutOfMemory) {
+        free (array.pEvents);
+        array.pEvents = NULL;
+        array.count = 0;
+        *pParseResult = PARSE_RESULT_INTERNAL_ERROR;
+    }
+    *pCountEvents = array.count;
+    return array.pEvents;
+}
+
+
+
+//*****
+// IO
+//*****
+
+// Names of the nn_DUR constants, by duration
+const char* EVENT_DURATION_NAMES[8] = { "invalid", "invalid", "breve", "whole", "half", "quarter", "eighth", "16th" };
+
+// Names of the accidentals and articulations, by n_accidental and n_articulation
+const char* EVENT_ACCIDENTAL_NAMES[4] = { "", " flat", " natural", " sharp" };
+const char* EVENT_ARTICULATION_NAMES[4] = { "", " staccato", " accent", " tenuto" };
+
+// Names of the EVENT_CLEFs
+const char* EVENT_CLEF_NAMES[4] = { "treble", "bass", "percussion", "invalid" };
+
+
+// Print an event on one line: byte group location, noteblock, type, and what it says.
+void events_print (
+    const struct music_event* pEvent // Event to print.
+){
+    printf ("%10u %9u  %-7s", pEvent->byteIndex, pEvent->noteblock, EVENT_TYPE_NAMES[pEvent->type]);
+    switch (pEvent->type) {
+        case EVENT_TYPE_CLEF:
+            printf (" %s", EVENT_CLEF_NAMES[pEvent->clef]);
+            break;
+        case EVENT_TYPE_KEY:
+            printf (" flats 0x%04x naturals 0x%04x sharps 0x%04x", pEvent->keyFlats, pEvent->keyNaturals,
+                pEvent->keySharps);
+            break;
+        case EVENT_TYPE_TIME:
+            printf (" %d/%d", pEvent->timeTop, pEvent->timeBottom);
+            break;
+        case EVENT_TYPE_REST:
+            printf (" %s%s", EVENT_DURATION_NAMES[pEvent->duration], pEvent->isDotted ? " dotted" : "");
+            break;
+        case EVENT_TYPE_NOTE:
+        case EVENT_TYPE_BEAMED:
+            printf (" row %2d", pEvent->row);
+            if (pEvent->type == EVENT_TYPE_NOTE) { printf (" %s", EVENT_DURATION_NAMES[pEvent->duration]); }
+            else {
+                printf (" stem %d beams %d/%d narrow %d", pEvent->stemLength, pEvent->beamsLeft, pEvent->beamsRight,
+                    pEvent->beamsNarrow);
+            }
+            printf (" %s%s%s%s%s%s", (pEvent->orientation > 0) ? "up" : "down", pEvent->isDotted ? " dotted" : "",
+                EVENT_ACCIDENTAL_NAMES[pEvent->accidental], EVENT_ARTICULATION_NAMES[pEvent->articulation],
+                pEvent->isTiedToPrev ? " tied-from" : "", pEvent->isTied ? " tied" : "");
+            break;
+        case EVENT_TYPE_BARLINE:
+            printf (" type %d", pEvent->barline);
+            break;
+        case EVENT_TYPE_DYNAMICS:
+            printf (" \"");
+            for (int i = 0; i < 5; ++i) { printf ("%c", (pEvent->text[i] == '\0') ? ' ' : pEvent->text[i]); }
+            printf ("\"");
+            break;
+    }
+    printf ("%s\n", pEvent->isRepeat ? "  (repeat)" : "");
+}
+
+
+// Print the events of a file, for cmd line option -ev.
+void try_print_events (
+    char* filepath // User-entered file path and name.
+){
+    size_t countBytes;
+    unsigned char* pBytes = read_large_file_bytes (filepath, &countBytes);
+    if (pBytes == NULL) return;
+    if (container_is_container (pBytes, countBytes) || rans_is_compressed (pBytes, countBytes)) {
+        printf ("  Containers and compressed files can't be decoded to events\n");
+        free (pBytes);
+        return;
+    }
+    size_t bodyStart = header_is_header (pBytes, countBytes) ? HEADER_SIZE : 0;
+
+    size_t countEvents;
+    int parseResult, errIndex;
+    struct music_event* pEvents = events_decode_to_array (pBytes + bodyStart, countBytes - bodyStart, &countEvents,
+        &parseResult, &errIndex);
+    for (size_t i = 0; i < countEvents; ++i) { events_print (&(pEvents[i])); }
+    if (parseResult != PARSE_RESULT_PARSED_ALL) {
+        // Locations count from the start of the file, as for other options
+        print_parse_error (parseResult, pBytes, (errIndex < 0) ? 0 : (int)bodyStart + errIndex);
+    }
+    free (pEvents);
+    free (pBytes);
+}
@@ -0,0 +1,57 @@
+//*****************************************************************************
+// music2_events.h.
+// Scope: Private to music2 program.
+// Bare-bones .h file to facilitate linking. See the .c file for descriptions.
+//*****************************************************************************
+
+#pragma once
+
+#include <stddef.h> // size_t
+
+#define EVENT_TYPE_CLEF     (0)
+#define EVENT_TYPE_KEY      (1)
+#define EVENT_TYPE_TIME     (2)
+#define EVENT_TYPE_NOTE     (3)
+#define EVENT_TYPE_REST     (4)
+#define EVENT_TYPE_BEAMED   (5)
+#define EVENT_TYPE_BARLINE  (6)
+#define EVENT_TYPE_DYNAMICS (7)
+#define EVENT_TYPE_COUNT    (8)
+const char* EVENT_TYPE_NAMES[EVENT_TYPE_COUNT];
+#define EVENT_CLEF_TREBLE     (0)
+#define EVENT_CLEF_BASS       (1)
+#define EVENT_CLEF_PERCUSSION (2)
+#define EVENT_CLEF_INVALID    (3)
+struct music_event {
+    unsigned char  type;
+    unsigned char  isRepeat;
+    unsigned char  row;
+    unsigned char  duration;
+    unsigned char  accidental;
+    unsigned char  articulation;
+    unsigned char  isTied;
+    unsigned char  isTiedToPrev;
+    unsigned char  isDotted;
+    signed char    orientation;
+    unsigned char  stemLength;
+    unsigned char  beamsLeft;
+    unsigned char  beamsRight;
+    unsigned char  beamsNarrow;
+    unsigned char  timeTop;
+    unsigned char  timeBottom;
+    unsigned char  barline;
+    unsigned char  clef;
+    unsigned short keyFlats;
+    unsigned short keyNaturals;
+    unsigned short keySharps;
+    char           text[5];
+    unsigned int   noteblock;
+    unsigned int   byteIndex;
+};
+int events_decode (const unsigned char* pBytes, size_t countBytes,
+    void (*pEmit) (void* pContext, const struct music_event* pEvent), void* pContext, int* pErrIndex);
+void events_collect (void* pContext, const struct music_event* pEvent);
+struct music_event* events_decode_to_array (const unsigned char* pBytes, size_t countBytes, size_t* pCountEvents,
+    int* pParseResult, int* pErrIndex);
+void events_print (const struct music_event* pEvent);
+void try_print_events (char* filepath);
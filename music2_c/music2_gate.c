@@ -0,0 +1,540 @@
+//*****************************************************************************************************
+// music2_gate.c
+// This file contains a regression gate for changes to parsing and drawing (cmd line options -tw and -tc).
+// It renders a fixed set of cases at a matrix of staff widths:
+//   - every example from option -v, and
+//   - a small generated file (see music2_corpus.c) of each profile, with a fixed seed, and
+//   - every .jwl file in the cases subdirectory of the gate directory, such as the costliest inputs found by
+//     option -ws, so inputs that were once slow stay in the gate.
+// Option -tw writes each rendered string to a golden file in a directory, and times each stage of rendering
+// each case (as option -p does) into a baseline file there, with the spread of those times. Option -tc renders
+// the cases again, fails if any string differs from its golden file by a single byte, and fails if any stage is
+// slower than its baseline by more than both a tolerance and GATE_SPREAD_MULTIPLE times its spread, so a stage
+// whose times vary a lot on this machine doesn't fail the gate by noise alone. A stage that looks slow is timed
+// again, up to GATE_ATTEMPTS times, and the fastest median counts, so one noisy measurement doesn't either.
+// Golden files depend on the generator, so changes to music2_corpus.c need the golden files written again.
+//*****************************************************************************************************
+
+
+// External inclusions
+#include <limits.h> // INT_MAX
+#include <stddef.h> // NULL, size_t
+#include <stdio.h>  // printf, fprintf, fopen_s, fwrite, snprintf
+#include <stdlib.h> // malloc, free, atoi, strtoull, qsort
+#include <string.h> // memcpy, strchr, strcmp, strlen, strncmp
+
+// Internal inclusions
+#include "music2_bench.h"
+#include "music2_corpus.h"
+#include "music2_general2.h"
+#include "music2_platform.h"
+
+
+//***********
+// Constants
+//***********
+
+// Example types rendered, as for option -v. "" is the general example song.
+const char* GATE_EXAMPLES[] = { "", "clef", "key", "time", "rest", "note", "beam", "text", "barline", "repeat" };
+#define GATE_EXAMPLE_COUNT (sizeof (GATE_EXAMPLES) / sizeof (GATE_EXAMPLES[0]))
+
+// Generator profiles rendered, each from GATE_CORPUS_BYTES bytes with seed GATE_CORPUS_SEED
+const char* GATE_PROFILES[] = { "typical", "dense", "repetitive", "adversarial" };
+#define GATE_PROFILE_COUNT (sizeof (GATE_PROFILES) / sizeof (GATE_PROFILES[0]))
+#define GATE_CORPUS_BYTES (16 * 1024)
+#define GATE_CORPUS_SEED  (1)
+
+// Staff widths each case is rendered at. INT_MAX means a continuous staff.
+const int GATE_WIDTHS[] = { 5, 20, 80, 255, INT_MAX };
+#define GATE_WIDTH_COUNT (sizeof (GATE_WIDTHS) / sizeof (GATE_WIDTHS[0]))
+
+// Staff width each case is timed at
+#define GATE_BENCH_WIDTH (80)
+
+// Each timing renders a case at least BENCH_RUNS_MIN times and for about this long, for a steady median
+#define GATE_MEASURE_NS (50000000ULL)
+#define GATE_RUNS_MAX   (100000)
+
+// Most timings of a case, when a stage looks slower than its baseline
+#define GATE_ATTEMPTS (3)
+
+// Timings of each case for a baseline. The spread is the median absolute deviation of these.
+#define GATE_BASELINE_ATTEMPTS (7)
+
+// A stage fails the gate only if it's slower than its baseline by more than this many times its spread
+#define GATE_SPREAD_MULTIPLE (3)
+
+// Default tolerance, in percent of the baseline
+#define GATE_TOLERANCE_DEFAULT (10)
+
+// Slowdowns smaller than this, in nanoseconds, never fail the gate. Stages of the smallest examples take about
+// a microsecond, where clock resolution and noise outweigh any tolerance.
+#define GATE_SLACK_NS (1000)
+
+// Name of the baseline file in the gate directory
+#define GATE_BASELINE_NAME "baseline.csv"
+
+// Subdirectory of the gate directory with more cases, and the extension of their files
+#define GATE_CASES_DIR_NAME "cases"
+#define GATE_CASE_EXTENSION ".jwl"
+
+// Most cases, counting at most GATE_FILE_CASES_MAX files from the cases subdirectory
+#define GATE_FILE_CASES_MAX (64)
+#define GATE_CASE_MAX       (GATE_EXAMPLE_COUNT + GATE_PROFILE_COUNT + GATE_FILE_CASES_MAX)
+
+
+
+//*******
+// Cases
+//*******
+
+// A case's bytes
+struct gate_case {
+    const char*    name;         // Example type, "example", profile name, or fileName.
+    char           fileName[64]; // For a file from the cases subdirectory, its name without the extension.
+    unsigned char* pBytes;       // Encoded bytes, plus a 0 after them.
+    size_t         countBytes;   // Number of encoded bytes.
+    int            isGenerated;  // 1 if pBytes was generated or read and must be freed, 0 for an example.
+};
+
+// Cases found while scanning the cases subdirectory
+struct gate_scan {
+    struct gate_case* pCases;  // Array of GATE_CASE_MAX cases.
+    size_t            count;   // Number of cases so far, including the fixed ones.
+    int               failed;  // Set if there are too many files, or a name is too long.
+};
+
+
+// platform_list_dir callback that adds .jwl files to a struct gate_scan, without reading them yet
+void gate_scan_callback (void* pContext, const char* name, unsigned long long size, long long modifiedTime) {
+    struct gate_scan* pScan = pContext;
+    (void)size; (void)modifiedTime; // Part of the callback signature, not needed here
+    size_t nameLen = strlen (name);
+    size_t extensionLen = strlen (GATE_CASE_EXTENSION);
+    if (pScan->failed || nameLen <= extensionLen || strcmp (name + nameLen - extensionLen, GATE_CASE_EXTENSION) != 0) {
+        return;
+    }
+    struct gate_case* pCase = &(pScan->pCases[pScan->count]);
+    if (pScan->count == GATE_CASE_MAX || nameLen - extensionLen >= sizeof (pCase->fileName)) {
+        pScan->failed = 1;
+        return;
+    }
+    memcpy (pCase->fileName, name, nameLen - extensionLen);
+    pCase->fileName[nameLen - extensionLen] = '\0';
+    pCase->pBytes = NULL;
+    pCase->isGenerated = 1;
+    ++(pScan->count);
+}
+
+// qsort comparison putting file cases in name order, so they're timed and reported in the same order each time
+int gate_compare_cases (const void* p1, const void* p2) {
+    return strcmp (((const struct gate_case*)p1)->fileName, ((const struct gate_case*)p2)->fileName);
+}
+
+
+// Get the bytes of every case.
+int gate_load_cases (
+    const char*       dirPath,    // Gate directory.
+    struct gate_case* pCases,     // Output param, array of GATE_CASE_MAX cases. Free with gate_free_cases.
+    size_t*           pCountCases // Output param, set to the number of cases, even on failure.
+    // Returns 1 on success, otherwise prints an error and returns 0.
+){
+    *pCountCases = GATE_EXAMPLE_COUNT + GATE_PROFILE_COUNT;
+    for (size_t i = 0; i < *pCountCases; ++i) { pCases[i].pBytes = NULL; pCases[i].isGenerated = 0; }
+    for (size_t i = 0; i < GATE_EXAMPLE_COUNT; ++i) {
+        int width;
+        get_example_bytes_width ((char*)GATE_EXAMPLES[i], &(pCases[i].pBytes), &width);
+        pCases[i].name = (GATE_EXAMPLES[i][0] == '\0') ? "example" : GATE_EXAMPLES[i];
+        pCases[i].countBytes = strlen ((char*)pCases[i].pBytes) + 1;
+    }
+    for (size_t i = 0; i < GATE_PROFILE_COUNT; ++i) {
+        struct gate_case* pCase = &(pCases[GATE_EXAMPLE_COUNT + i]);
+        struct corpus_profile profile;
+        corpus_parse_profile (GATE_PROFILES[i], &profile);
+        unsigned long long countNoteblocks;
+        pCase->name = GATE_PROFILES[i];
+        pCase->pBytes = corpus_generate (GATE_CORPUS_BYTES, &profile, GATE_CORPUS_SEED, &(pCase->countBytes),
+            &countNoteblocks);
+        pCase->isGenerated = 1;
+        if (pCase->pBytes == NULL) {
+            printf ("  Memory allocation error\n");
+            return 0;
+        }
+    }
+
+    // Files in the cases subdirectory, if there is one
+    char path[1024];
+    if (snprintf (path, sizeof (path), "%s/%s", dirPath, GATE_CASES_DIR_NAME) >= (int)sizeof (path)) {
+        printf ("  Path too long in %s\n", dirPath);
+        return 0;
+    }
+    struct gate_scan scan = { pCases, *pCountCases, 0 };
+    platform_list_dir (path, gate_scan_callback, &scan);
+    qsort (pCases + *pCountCases, scan.count - *pCountCases, sizeof (struct gate_case), gate_compare_cases);
+    *pCountCases = scan.count;
+    if (scan.failed) {
+        printf ("  More than %d files, or too long a file name, in %s\n", GATE_FILE_CASES_MAX, path);
+        return 0;
+    }
+    for (size_t i = GATE_EXAMPLE_COUNT + GATE_PROFILE_COUNT; i < scan.count; ++i) {
+        pCases[i].name = pCases[i].fileName; // Set after sorting, which moves fileName
+        if (snprintf (path, sizeof (path), "%s/%s/%s%s", dirPath, GATE_CASES_DIR_NAME, pCases[i].fileName,
+            GATE_CASE_EXTENSION) >= (int)sizeof (path)) {
+            printf ("  Path too long in %s\n", dirPath);
+            return 0;
+        }
+        pCases[i].pBytes = read_large_file_bytes (path, &(pCases[i].countBytes));
+        if (pCases[i].pBytes == NULL) return 0;
+    }
+    return 1;
+}
+
+
+// Free the generated bytes of cases from gate_load_cases.
+void gate_free_cases (
+    struct gate_case* pCases,    // Array of cases.
+    size_t            countCases // Number of cases.
+){
+    for (size_t i = 0; i < countCases; ++i) {
+        if (pCases[i].isGenerated) { free (pCases[i].pBytes); }
+    }
+}
+
+
+// Render a case at a width.
+char* gate_render (
+    const struct gate_case* pCase, // Case to render.
+    int                     width  // Max width of a staff in characters.
+    // Returns the string (caller must free), or NULL after printing an error.
+){
+    struct noteblock* p1stNoteblock;
+    int errIndex;
+    int parseResult = parse_file_bytes (pCase->pBytes, pCase->countBytes, &p1stNoteblock, &errIndex);
+    char* str = (parseResult == PARSE_RESULT_PARSED_ALL) ? noteblocks_to_string (p1stNoteblock, width) : NULL;
+    free_noteblocks (p1stNoteblock);
+    if (parseResult != PARSE_RESULT_PARSED_ALL) {
+        printf ("  %s: ", pCase->name);
+        print_parse_error (parseResult, pCase->pBytes, errIndex);
+    }
+    else if (str == NULL) {
+        printf ("  %s: Internal error while converting noteblocks to string\n", pCase->name);
+    }
+    return str;
+}
+
+
+// Get the path of a case's golden file at a width.
+int gate_golden_path (
+    char*                   path,    // Output param, char[1024] set to the path.
+    const char*             dirPath, // Gate directory.
+    const struct gate_case* pCase,   // Case rendered.
+    int                     width    // Max width of a staff in characters.
+    // Returns 1 on success, 0 if the path is too long.
+){
+    int len = (width == INT_MAX) ? snprintf (path, 1024, "%s/%s-continuous.txt", dirPath, pCase->name)
+                                 : snprintf (path, 1024, "%s/%s-w%d.txt", dirPath, pCase->name, width);
+    return (len > 0 && len < 1024);
+}
+
+
+
+//********
+// Timing
+//********
+
+// Time each stage of rendering a case at GATE_BENCH_WIDTH once.
+int gate_time_case (
+    const struct gate_case* pCase,     // Case to time.
+    unsigned long long*     pMedianNs  // Output param, array set to the median time of each of BENCH_STAGE_COUNT
+                                       // stages.
+    // Returns 1 on success, otherwise prints an error and returns 0.
+){
+    struct bench_input input;
+    input.name = pCase->name;
+    input.pBytes = pCase->pBytes;
+    input.countBytes = pCase->countBytes;
+    input.isFile = 0;
+    input.width = GATE_BENCH_WIDTH;
+    if (!bench_check_input (&input)) return 0;
+    struct platform_counters counters;
+    counters.countCounters = 0;
+    unsigned long long counterSums[BENCH_STAGE_COUNT * PLATFORM_COUNTERS_MAX];
+
+    // One untimed render to find how many runs take about GATE_MEASURE_NS
+    unsigned long long ns[BENCH_STAGE_COUNT];
+    bench_run_stages (&input, 1, 0, &counters, ns, counterSums);
+    unsigned long long countRuns = (ns[BENCH_STAGE_TOTAL] == 0) ? GATE_RUNS_MAX
+                                 : GATE_MEASURE_NS / ns[BENCH_STAGE_TOTAL];
+    if (countRuns < BENCH_RUNS_MIN) { countRuns = BENCH_RUNS_MIN; }
+    if (countRuns > GATE_RUNS_MAX) { countRuns = GATE_RUNS_MAX; }
+
+    unsigned long long* pNs = malloc (sizeof (unsigned long long) * BENCH_STAGE_COUNT * countRuns);
+    if (pNs == NULL) {
+        printf ("  Memory allocation error\n");
+        return 0;
+    }
+    bench_run_stages (&input, (unsigned int)countRuns, (unsigned int)countRuns / 10, &counters, pNs, counterSums);
+    for (int stage = 0; stage < BENCH_STAGE_COUNT; ++stage) {
+        pMedianNs[stage] = bench_summarize (pNs + (size_t)stage * countRuns, (unsigned int)countRuns).medianNs;
+    }
+    free (pNs);
+    return 1;
+}
+
+
+// Get the median of a stage's baseline timings, and their median absolute deviation.
+void gate_summarize_attempts (
+    unsigned long long* pNs,       // Median time of each timing. Reordered in place.
+    unsigned int        count,     // Number of timings, at least 1.
+    unsigned long long* pMedianNs, // Output param, set to the median time.
+    unsigned long long* pSpreadNs  // Output param, set to the median absolute deviation.
+){
+    struct bench_summary summary = bench_summarize (pNs, count);
+    for (unsigned int i = 0; i < count; ++i) {
+        pNs[i] = (pNs[i] > summary.medianNs) ? pNs[i] - summary.medianNs : summary.medianNs - pNs[i];
+    }
+    *pMedianNs = summary.medianNs;
+    *pSpreadNs = bench_summarize (pNs, count).medianNs;
+}
+
+
+// Whether a stage's median is slower than its baseline beyond the tolerance and the baseline's spread.
+int gate_is_slow (
+    unsigned long long medianNs,    // Stage's median time.
+    unsigned long long baselineNs,  // Stage's baseline median time.
+    unsigned long long spreadNs,    // Stage's baseline spread.
+    int                tolerancePct // Tolerance, in percent of the baseline.
+){
+    return medianNs > baselineNs + (baselineNs * tolerancePct) / 100 + GATE_SLACK_NS
+        && medianNs > baselineNs + GATE_SPREAD_MULTIPLE * spreadNs;
+}
+
+
+// Find a stage's baseline in the text of a baseline file.
+int gate_find_baseline (
+    const char*         baselineText, // Baseline file, lines of "case,stage,median_ns,spread_ns".
+    const char*         caseName,     // Case to find.
+    const char*         stageName,    // Stage to find.
+    unsigned long long* pBaselineNs,  // Output param, set to the baseline median time.
+    unsigned long long* pSpreadNs     // Output param, set to the baseline spread, or 0 if the file has none.
+    // Returns 1 if found, otherwise 0.
+){
+    size_t caseLen = strlen (caseName);
+    size_t stageLen = strlen (stageName);
+    for (const char* pLine = baselineText; pLine != NULL && *pLine != '\0'; ) {
+        if (strncmp (pLine, caseName, caseLen) == 0 && pLine[caseLen] == ','
+            && strncmp (pLine + caseLen + 1, stageName, stageLen) == 0 && pLine[caseLen + 1 + stageLen] == ',') {
+            char* pEnd;
+            *pBaselineNs = strtoull (pLine + caseLen + 1 + stageLen + 1, &pEnd, 10);
+            *pSpreadNs = (*pEnd == ',') ? strtoull (pEnd + 1, NULL, 10) : 0;
+            return 1;
+        }
+        pLine = strchr (pLine, '\n');
+        if (pLine != NULL) { ++pLine; }
+    }
+    return 0;
+}
+
+
+
+//*****
+// IO
+//*****
+
+// Write golden files and a performance baseline, for cmd line option -tw.
+void try_write_gate (
+    char* dirPath // User-entered gate directory, created if needed.
+){
+    if (!platform_make_dir (dirPath)) {
+        printf ("  Unable to create directory %s\n", dirPath);
+        return;
+    }
+    struct gate_case cases[GATE_CASE_MAX];
+    size_t countCases;
+    if (!gate_load_cases (dirPath, cases, &countCases)) {
+        gate_free_cases (cases, countCases);
+        return;
+    }
+
+    // Baseline, the median of GATE_BASELINE_ATTEMPTS timings of each stage, and their spread. Cases are timed
+    // in turn, GATE_BASELINE_ATTEMPTS times over, so noise that comes and goes during the run shows in the spread.
+    // Timed first, as option -tc does, so the heap is in the same state: reading and writing large files changes
+    // how later allocations are served.
+    unsigned long long* pAttemptNs = malloc (sizeof (unsigned long long) * countCases * BENCH_STAGE_COUNT
+        * GATE_BASELINE_ATTEMPTS);
+    if (pAttemptNs == NULL) {
+        printf ("  Memory allocation error\n");
+        gate_free_cases (cases, countCases);
+        return;
+    }
+    for (int attempt = 0; attempt < GATE_BASELINE_ATTEMPTS; ++attempt) {
+        for (size_t i = 0; i < countCases; ++i) {
+            unsigned long long medianNs[BENCH_STAGE_COUNT];
+            if (!gate_time_case (&(cases[i]), medianNs)) {
+                free (pAttemptNs);
+                gate_free_cases (cases, countCases);
+                return;
+            }
+            for (int stage = 0; stage < BENCH_STAGE_COUNT; ++stage) {
+                pAttemptNs[(i * BENCH_STAGE_COUNT + stage) * GATE_BASELINE_ATTEMPTS + attempt] = medianNs[stage];
+            }
+        }
+    }
+    char path[1024];
+    FILE* file = NULL;
+    if (snprintf (path, sizeof (path), "%s/%s", dirPath, GATE_BASELINE_NAME) >= (int)sizeof (path)
+        || fopen_s (&file, path, "wb") || file == NULL) {
+        printf ("  Unable to create file %s/%s\n", dirPath, GATE_BASELINE_NAME);
+        free (pAttemptNs);
+        gate_free_cases (cases, countCases);
+        return;
+    }
+    fprintf (file, "case,stage,median_ns,spread_ns\n");
+    for (size_t i = 0; i < countCases; ++i) {
+        for (int stage = 0; stage < BENCH_STAGE_COUNT; ++stage) {
+            unsigned long long medianNs, spreadNs;
+            gate_summarize_attempts (pAttemptNs + (i * BENCH_STAGE_COUNT + stage) * GATE_BASELINE_ATTEMPTS,
+                GATE_BASELINE_ATTEMPTS, &medianNs, &spreadNs);
+            fprintf (file, "%s,%s,%llu,%llu\n", cases[i].name, bench_stage_name (stage), medianNs, spreadNs);
+        }
+    }
+    fclose (file);
+    free (pAttemptNs);
+
+    // Golden files
+    unsigned int countWritten = 0;
+    for (size_t i = 0; i < countCases; ++i) {
+        for (size_t w = 0; w < GATE_WIDTH_COUNT; ++w) {
+            if (!gate_golden_path (path, dirPath, &(cases[i]), GATE_WIDTHS[w])) {
+                printf ("  Path too long in %s\n", dirPath);
+                gate_free_cases (cases, countCases);
+                return;
+            }
+            char* str = gate_render (&(cases[i]), GATE_WIDTHS[w]);
+            if (str == NULL) {
+                gate_free_cases (cases, countCases);
+                return;
+            }
+            errno_t fopenErr = fopen_s (&file, path, "wb");
+            size_t len = strlen (str);
+            int isWritten = !fopenErr && file != NULL && fwrite (str, 1, len, file) == len;
+            if (!fopenErr && file != NULL) { fclose (file); }
+            free (str);
+            if (!isWritten) {
+                printf ("  Unable to write file %s\n", path);
+                gate_free_cases (cases, countCases);
+                return;
+            }
+            ++countWritten;
+        }
+    }
+    printf ("  Wrote %u golden files and %s to %s\n", countWritten, GATE_BASELINE_NAME, dirPath);
+    gate_free_cases (cases, countCases);
+}
+
+
+// Check rendered strings against golden files and stage times against the baseline, for cmd line option -tc.
+int test_gate (
+    char* dirPath,     // User-entered gate directory, written by option -tw.
+    char* toleranceStr // User-entered tolerance in percent, or NULL for GATE_TOLERANCE_DEFAULT.
+    // Returns the process exit status: 0 if everything matched, otherwise 1.
+){
+    int tolerancePct = (toleranceStr == NULL) ? GATE_TOLERANCE_DEFAULT : atoi (toleranceStr);
+    if (tolerancePct <= 0) {
+        printf ("  Invalid tolerance\n");
+        return 1;
+    }
+    char path[1024];
+    size_t countBaselineBytes;
+    if (snprintf (path, sizeof (path), "%s/%s", dirPath, GATE_BASELINE_NAME) >= (int)sizeof (path)) {
+        printf ("  Path too long in %s\n", dirPath);
+        return 1;
+    }
+    char* baselineText = (char*)read_large_file_bytes (path, &countBaselineBytes);
+    if (baselineText == NULL) return 1;
+    struct gate_case cases[GATE_CASE_MAX];
+    size_t countCases;
+    if (!gate_load_cases (dirPath, cases, &countCases)) {
+        gate_free_cases (cases, countCases);
+        free (baselineText);
+        return 1;
+    }
+
+    // Stage times, timed again while any looks slow. Timed before the golden files are read, as in option -tw.
+    unsigned int countTimed = 0, countSlow = 0;
+    for (size_t i = 0; i < countCases; ++i) {
+        unsigned long long baselineNs[BENCH_STAGE_COUNT], spreadNs[BENCH_STAGE_COUNT];
+        int isMissing = 0;
+        for (int stage = 0; stage < BENCH_STAGE_COUNT; ++stage) {
+            if (!gate_find_baseline (baselineText, cases[i].name, bench_stage_name (stage), &(baselineNs[stage]),
+                &(spreadNs[stage]))) {
+                isMissing = 1;
+            }
+        }
+        if (isMissing) {
+            printf ("  No baseline for %s in %s\n", cases[i].name, GATE_BASELINE_NAME);
+            ++countSlow;
+            continue;
+        }
+        unsigned long long bestNs[BENCH_STAGE_COUNT];
+        int isAnySlow = 1;
+        for (int attempt = 0; attempt < GATE_ATTEMPTS && isAnySlow; ++attempt) {
+            unsigned long long medianNs[BENCH_STAGE_COUNT];
+            if (!gate_time_case (&(cases[i]), medianNs)) {
+                gate_free_cases (cases, countCases);
+                free (baselineText);
+                return 1;
+            }
+            isAnySlow = 0;
+            for (int stage = 0; stage < BENCH_STAGE_COUNT; ++stage) {
+                if (attempt == 0 || medianNs[stage] < bestNs[stage]) { bestNs[stage] = medianNs[stage]; }
+                isAnySlow |= gate_is_slow (bestNs[stage], baselineNs[stage], spreadNs[stage], tolerancePct);
+            }
+        }
+        for (int stage = 0; stage < BENCH_STAGE_COUNT; ++stage) {
+            ++countTimed;
+            if (!gate_is_slow (bestNs[stage], baselineNs[stage], spreadNs[stage], tolerancePct)) continue;
+            ++countSlow;
+            printf ("  Slower: %s %s, median %.3f us vs baseline %.3f us (+%.1f%%, spread %.3f us)\n", cases[i].name,
+                bench_stage_name (stage), bestNs[stage] / 1e3, baselineNs[stage] / 1e3,
+                (baselineNs[stage] == 0) ? 0.0 : 100.0 * ((double)bestNs[stage] / baselineNs[stage] - 1),
+                spreadNs[stage] / 1e3);
+        }
+    }
+
+    // Golden files, compared byte for byte
+    unsigned int countChecked = 0, countDiffering = 0;
+    for (size_t i = 0; i < countCases; ++i) {
+        for (size_t w = 0; w < GATE_WIDTH_COUNT; ++w) {
+            ++countChecked;
+            char* str = gate_render (&(cases[i]), GATE_WIDTHS[w]);
+            size_t countGoldenBytes;
+            unsigned char* pGolden = (str != NULL && gate_golden_path (path, dirPath, &(cases[i]), GATE_WIDTHS[w]))
+                                   ? read_large_file_bytes (path, &countGoldenBytes) : NULL;
+            if (pGolden == NULL) {
+                ++countDiffering;
+                free (str);
+                continue;
+            }
+            size_t len = strlen (str);
+            size_t index = 0;
+            while (index < len && index < countGoldenBytes && (unsigned char)str[index] == pGolden[index]) { ++index; }
+            if (index < len || index < countGoldenBytes) {
+                ++countDiffering;
+                unsigned int line = 1;
+                for (size_t j = 0; j < index; ++j) { line += (str[j] == '\n'); }
+                printf ("  Output differs: %s, from byte %zu (line %u) of %zu (golden file has %zu)\n", path, index,
+                    line, len, countGoldenBytes);
+            }
+            free (pGolden);
+            free (str);
+        }
+    }
+
+    printf ("  %s: %u of %u outputs differ, %u of %u stage times slower than baseline by over %d%% and %d times "
+        "its spread\n", (countDiffering == 0 && countSlow == 0) ? "Passed" : "Failed", countDiffering, countChecked,
+        countSlow, countTimed, tolerancePct, GATE_SPREAD_MULTIPLE);
+    gate_free_cases (cases, countCases);
+    free (baselineText);
+    return (countDiffering == 0 && countSlow == 0) ? 0 : 1;
+}
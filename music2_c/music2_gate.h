@@ -0,0 +1,10 @@
+//*****************************************************************************
+// music2_gate.h.
+// Scope: Private to music2 program.
+// Bare-bones .h file to facilitate linking. See the .c file for descriptions.
+//*****************************************************************************
+
+#pragma once
+
+void try_write_gate (char* dirPath);
+int test_gate (char* dirPath, char* toleranceStr);
@@ -6,18 +6,29 @@
 
 // External inclusions
 #include <limits.h> // INT_MAX, UINT_MAX
-#include <stdio.h>  // printf, fopen_s
-#include <stdlib.h> // malloc, atoi
+#include <stdio.h>  // printf, fflush, fopen_s
+#include <stdlib.h> // calloc, malloc, atoi
 #include <stddef.h> // NULL
-#include <string.h> // strcmp, strcpy
-#include <time.h>   // time
+#include <string.h> // memcpy, memset, strcmp, strcpy
 
 // Internal inclusions
+#include "music2_archive.h"
+#include "music2_cache.h"
+#include "music2_container.h"
 #include "music2_data.h"
 #include "music2_draw_note.h"
 #include "music2_draw_other.h"
 #include "music2_general1.h"
+#include "music2_hash.h"
+#include "music2_header.h"
+#include "music2_layout.h"
+#include "music2_memo.h"
 #include "music2_noteblock.h"
+#include "music2_platform.h"
+#include "music2_probes.h"
+#include "music2_rans.h"
+#include "music2_stats.h"
+#include "music2_trace.h"
 
 
 //*****************
@@ -36,6 +47,7 @@
 #define BYTE_GROUP_TYPE_BARLINE     (0b00000100)
 #define BYTE_GROUP_TYPE_DYN_TEXT    (0b00001000)
 #define BYTE_GROUP_TYPE_CLEF        (0b00100000)
+#define BYTE_GROUP_TYPE_REPEAT      (0b00001100)
 #define BYTE_GROUP_TYPE_INVALID     (0b11010000)
 
 
@@ -58,7 +70,7 @@ int byte_group_type (
     switch (byte1 & 0b1100) {
         case 0b0100: return BYTE_GROUP_TYPE_BARLINE;
         case 0b1000: return BYTE_GROUP_TYPE_DYN_TEXT;
-        case 0b1100: return BYTE_GROUP_TYPE_INVALID;
+        case 0b1100: return (byte1 == BYTE_GROUP_TYPE_REPEAT) ? BYTE_GROUP_TYPE_REPEAT : BYTE_GROUP_TYPE_INVALID;
     }
     // At this point, we know byte1 & 0b1111 == 0b0000
     switch (byte1 & 0b110000) {
@@ -71,6 +83,46 @@ int byte_group_type (
 }
 
 
+// Get the number of bytes in a byte group, including byte1, from its type
+int byte_group_length (
+    int byteGroupType // One of the BYTE_GROUP_TYPE constants, from byte_group_type.
+    // Returns 1-4, or 0 for BYTE_GROUP_TYPE_INVALID.
+){
+    switch (byteGroupType) {
+        case BYTE_GROUP_TYPE_TERMINATOR:  return 1;
+        case BYTE_GROUP_TYPE_NOTE_NN:     return 2;
+        case BYTE_GROUP_TYPE_NOTE_NB:     return 3;
+        case BYTE_GROUP_TYPE_TIME_CHANGE: return 1;
+        case BYTE_GROUP_TYPE_KEY_CHANGE:  return 4;
+        case BYTE_GROUP_TYPE_BARLINE:     return 1;
+        case BYTE_GROUP_TYPE_DYN_TEXT:    return 3;
+        case BYTE_GROUP_TYPE_CLEF:        return 1;
+        case BYTE_GROUP_TYPE_REPEAT:      return 2;
+    }
+    return 0;
+}
+
+
+
+// Check the byte group at some index without parsing it, for code that only needs group boundaries.
+int scan_byte_group (
+    const unsigned char* pBytes,     // Pointer to encoded bytes. Need not be 0-terminated.
+    size_t               countBytes, // Number of encoded bytes. Nothing at or past this is read.
+    size_t               index       // Index of the byte group's first byte.
+    // Returns the byte group's length (1-4), 0 at the terminator or the end of the bytes, or -1 if the group is
+    // invalid or cut short by a 0 byte or the end of the bytes.
+){
+    if (index >= countBytes) return 0;
+    int byteGroupType = byte_group_type (pBytes[index]);
+    if (byteGroupType == BYTE_GROUP_TYPE_TERMINATOR) return 0;
+    int length = byte_group_length (byteGroupType);
+    if (length == 0 || index + length > countBytes) return -1;
+    for (int i = 1; i < length; ++i) {
+        if (pBytes[index + i] == 0) return -1;
+    }
+    return length;
+}
+
 
 //*************************************************
 // Functions for parsing byte groups to noteblocks
@@ -102,6 +154,204 @@ unsigned int update_parse_info (
 #define PARSE_RESULT_UNEXPECTED_TERMINATOR (2) // Failed to parse - found terminator byte (0) at invalid location.
 #define PARSE_RESULT_INVALID_BYTE          (3) // Failed to parse - found an invalid byte.
 #define PARSE_RESULT_INTERNAL_ERROR        (4) // Failed to parse - internal error, such as out of memory.
+#define PARSE_RESULT_CORRUPT               (5) // Failed to parse - container data failed an integrity check.
+#define PARSE_RESULT_ARCHIVE               (6) // Failed to parse - the bytes are an archive of songs (option -ab).
+
+
+// Most noteblocks a repeat byte group can copy, plus 1
+#define PARSE_HISTORY_SIZE (256)
+
+// The most recent noteblocks, kept while parsing so repeat byte groups can copy them. Initialize count to 0.
+struct parse_history {
+    struct noteblock* pNoteblocks[PARSE_HISTORY_SIZE]; // Noteblock n is at index n % PARSE_HISTORY_SIZE.
+    unsigned int      parseInfos[PARSE_HISTORY_SIZE];  // parseInfo after each noteblock and any dynamics text on it.
+    unsigned char     types[PARSE_HISTORY_SIZE];       // BYTE_GROUP_TYPE that created each noteblock.
+    unsigned int      count;                           // Count of noteblocks so far.
+};
+
+
+// Add a noteblock to the history
+void parse_history_add (
+    struct parse_history* pHistory,      // History to add to.
+    struct noteblock*     pNoteblock,    // New noteblock.
+    int                   byteGroupType, // BYTE_GROUP_TYPE that created it.
+    unsigned int          parseInfo      // parseInfo after it.
+){
+    unsigned int slot = pHistory->count % PARSE_HISTORY_SIZE;
+    pHistory->pNoteblocks[slot] = pNoteblock;
+    pHistory->parseInfos[slot] = parseInfo;
+    pHistory->types[slot] = (unsigned char)byteGroupType;
+    ++(pHistory->count);
+}
+
+
+// Parse a repeat byte group by copying already-drawn noteblocks. Copies are exactly what was drawn the first
+// time, including dynamics text, whatever comes before the repeat.
+int parse_repeat (
+    unsigned char         countNoteblocks, // Byte 2 of the repeat byte group: how many noteblocks to copy, 1-255.
+    struct noteblock**    ppNoteblock,     // Pointer to pointer to current noteblock. Set to the last copy.
+    unsigned int*         pParseInfo,      // Pointer to parseInfo. Set as if the copied byte groups were parsed again.
+    struct parse_history* pHistory         // Recent noteblocks, or NULL if repeats aren't allowed here.
+    // Returns one of the PARSE_RESULTs.
+){
+    if (pHistory == NULL || countNoteblocks > pHistory->count) { return PARSE_RESULT_INVALID_BYTE; }
+    unsigned int first = pHistory->count - countNoteblocks;
+    unsigned int parseInfo = *pParseInfo;
+    for (unsigned int i = 0; i < countNoteblocks; ++i) {
+        // Copies are added to the history as they're made. The history holds more than 255 noteblocks, so this
+        // never overwrites one still to be copied.
+        unsigned int slot = (first + i) % PARSE_HISTORY_SIZE;
+        struct noteblock* pCopy = allocate_noteblock ();
+        if (pCopy == NULL) {
+            *ppNoteblock = NULL;
+            return PARSE_RESULT_INTERNAL_ERROR;
+        }
+        memcpy (pCopy, pHistory->pNoteblocks[slot], sizeof (struct noteblock));
+        pCopy->pNext = NULL;
+        (*ppNoteblock)->pNext = pCopy; // Not NULL, since the history isn't empty
+        *ppNoteblock = pCopy;
+        // Notes set both bytes of parseInfo; other byte groups keep the most recent note's byte 1
+        int byteGroupType = pHistory->types[slot];
+        unsigned int copiedParseInfo = pHistory->parseInfos[slot];
+        parseInfo = (byteGroupType == BYTE_GROUP_TYPE_NOTE_NN || byteGroupType == BYTE_GROUP_TYPE_NOTE_NB)
+            ? copiedParseInfo : ((parseInfo & 0x0000FF00) | (copiedParseInfo & 0xFF));
+        parse_history_add (pHistory, pCopy, byteGroupType, parseInfo);
+    }
+    *pParseInfo = parseInfo;
+    MUSIC2_PROBE2 (noteblock__new, BYTE_GROUP_TYPE_REPEAT, countNoteblocks);
+    return PARSE_RESULT_PARSED_NOTEBLOCK;
+}
+
+
+// Like parse_history, for code that follows byte groups without drawing anything. Initialize count to 0.
+struct scan_history {
+    unsigned int byteIndexes[PARSE_HISTORY_SIZE]; // Index of the byte group that first drew each noteblock.
+    unsigned int parseInfos[PARSE_HISTORY_SIZE];  // parseInfo after each noteblock and any dynamics text on it.
+    unsigned int count;                           // Count of noteblocks so far.
+};
+
+
+// Add a noteblock to the scan history
+void scan_history_add (
+    struct scan_history* pHistory,  // History to add to.
+    unsigned int         byteIndex, // Index of the byte group that first drew the noteblock.
+    unsigned int         parseInfo  // parseInfo after it.
+){
+    unsigned int slot = pHistory->count % PARSE_HISTORY_SIZE;
+    pHistory->byteIndexes[slot] = byteIndex;
+    pHistory->parseInfos[slot] = parseInfo;
+    ++(pHistory->count);
+}
+
+
+// Follow the byte group at some index without drawing it, updating parseInfo and the scan history as
+// parse_byte_group would. The byte group must already have passed scan_byte_group.
+int scan_byte_group_history (
+    const unsigned char* pBytes,     // Pointer to encoded bytes.
+    size_t               index,      // Index of the byte group's first byte.
+    unsigned int*        pParseInfo, // Pointer to parseInfo.
+    struct scan_history* pHistory,   // Recent noteblocks.
+    void                 (*pCallback) (void* pContext, unsigned int byteIndex), // Called for each new noteblock
+                                     // with the index of the byte group that first drew it, or NULL.
+    void*                pContext    // Passed to pCallback.
+    // Returns the number of new noteblocks, or -1 if a repeat byte group reaches back past the first noteblock.
+){
+    unsigned char byte1 = pBytes[index];
+    int byteGroupType = byte_group_type (byte1);
+    if (byteGroupType == BYTE_GROUP_TYPE_REPEAT) {
+        unsigned int countNoteblocks = pBytes[index + 1];
+        if (countNoteblocks > pHistory->count) return -1;
+        for (unsigned int i = 0; i < countNoteblocks; ++i) {
+            // As in parse_repeat, the next noteblock to copy is always countNoteblocks back
+            unsigned int slot = (pHistory->count - countNoteblocks) % PARSE_HISTORY_SIZE;
+            unsigned int byteIndex = pHistory->byteIndexes[slot];
+            int copiedType = byte_group_type (pBytes[byteIndex]);
+            unsigned int copiedParseInfo = pHistory->parseInfos[slot];
+            *pParseInfo = (copiedType == BYTE_GROUP_TYPE_NOTE_NN || copiedType == BYTE_GROUP_TYPE_NOTE_NB)
+                ? copiedParseInfo : ((*pParseInfo & 0x0000FF00) | (copiedParseInfo & 0xFF));
+            scan_history_add (pHistory, byteIndex, *pParseInfo);
+            if (pCallback != NULL) { pCallback (pContext, byteIndex); }
+        }
+        return (int)countNoteblocks;
+    }
+    *pParseInfo = update_parse_info (*pParseInfo, (unsigned char)byteGroupType, byte1);
+    if (byteGroupType == BYTE_GROUP_TYPE_DYN_TEXT) {
+        if (pHistory->count > 0) { pHistory->parseInfos[(pHistory->count - 1) % PARSE_HISTORY_SIZE] = *pParseInfo; }
+        return 0;
+    }
+    scan_history_add (pHistory, (unsigned int)index, *pParseInfo);
+    if (pCallback != NULL) { pCallback (pContext, (unsigned int)index); }
+    return 1;
+}
+
+
+// Find where parsing can't start because a later repeat byte group would copy noteblocks from before there.
+// Code that splits bytes into independently parsed pieces, like checkpoints and container chunks, uses this.
+unsigned char* mark_repeat_spans (
+    const unsigned char* pBytes,           // Pointer to encoded bytes. Need not be 0-terminated.
+    size_t               countBytes,       // Number of encoded bytes.
+    unsigned int*        pCountNoteblocks  // Output param, set to the number of noteblocks.
+    // Returns an array (caller must free) with an element for each noteblock and one past the last, nonzero where
+    // parsing can't start before that noteblock. NULL if out of memory. Stops at the first invalid byte group, or
+    // before the count would no longer fit in an unsigned int.
+){
+    size_t capacity = 256;
+    unsigned char* pSpans = calloc (capacity, 1);
+    if (pSpans == NULL) return NULL;
+    unsigned int countNoteblocks = 0;
+    size_t index = 0;
+    while (1) {
+        int length = scan_byte_group (pBytes, countBytes, index);
+        if (length <= 0) break;
+        int byteGroupType = byte_group_type (pBytes[index]);
+        unsigned int countNew = (byteGroupType == BYTE_GROUP_TYPE_DYN_TEXT) ? 0
+                              : (byteGroupType == BYTE_GROUP_TYPE_REPEAT)   ? pBytes[index + 1] : 1;
+        if (countNoteblocks > UINT_MAX - 256) break;
+        if (countNoteblocks + countNew + 1 > capacity) {
+            size_t oldCapacity = capacity;
+            while (countNoteblocks + countNew + 1 > capacity) { capacity *= 2; }
+            unsigned char* pNew = realloc (pSpans, capacity);
+            if (pNew == NULL) { free (pSpans); return NULL; }
+            pSpans = pNew;
+            memset (pSpans + oldCapacity, 0, capacity - oldCapacity);
+        }
+        if (byteGroupType == BYTE_GROUP_TYPE_REPEAT) {
+            // Copies noteblocks countNoteblocks - countNew to countNoteblocks - 1, so parsing must start at or
+            // before the first of them
+            for (unsigned int i = 0; i < countNew && i < countNoteblocks; ++i) { pSpans[countNoteblocks - i] = 1; }
+        }
+        countNoteblocks += countNew;
+        index += length;
+    }
+    *pCountNoteblocks = countNoteblocks;
+    return pSpans;
+}
+
+
+// Add the noteblocks of a measure memoized by memo_store, as if parsing its bytes again.
+int parse_memo_entry (
+    const struct memo_entry* pEntry,      // Measure from memo_lookup.
+    struct noteblock**       ppNoteblock, // Pointer to pointer to current noteblock, or to NULL at the start.
+                                          // Set to the last copy.
+    unsigned int*            pParseInfo,  // Pointer to parseInfo. Set to the parseInfo after the measure.
+    struct parse_history*    pHistory     // Recent noteblocks, updated with the copies.
+    // Returns one of the PARSE_RESULTs.
+){
+    for (unsigned int i = 0; i < pEntry->countNoteblocks; ++i) {
+        struct noteblock* pCopy = allocate_noteblock ();
+        if (pCopy == NULL) {
+            *ppNoteblock = NULL;
+            return PARSE_RESULT_INTERNAL_ERROR;
+        }
+        memcpy (pCopy, &(pEntry->pNoteblocks[i]), sizeof (struct noteblock));
+        if (*ppNoteblock != NULL) { (*ppNoteblock)->pNext = pCopy; }
+        *ppNoteblock = pCopy;
+        parse_history_add (pHistory, pCopy, pEntry->pTypes[i], pEntry->pParseInfos[i]);
+    }
+    *pParseInfo = pEntry->parseInfoOut;
+    MUSIC2_PROBE2 (noteblock__new, 0, pEntry->countNoteblocks);
+    return PARSE_RESULT_PARSED_NOTEBLOCK;
+}
 
 
 // Parse one byte group. This usually creates a new noteblock.
@@ -111,8 +361,10 @@ int parse_byte_group (
     struct noteblock**   ppNoteblock, // Pointer to pointer to current noteblock (or pointer to NULL if none). If this
                          // function creates a new noteblock, *ppNoteblock will point to it afterwards. If a terminator
                          //  is parsed, *ppNoteblock will be set to NULL.
-    unsigned int*        pParseInfo   // Pointer to info stored between calls to this function - see update_parse_info.
+    unsigned int*        pParseInfo,  // Pointer to info stored between calls to this function - see update_parse_info.
                          // The first time you call this function, initialize *pParseInfo = 0.
+    struct parse_history* pHistory    // Recent noteblocks, updated by this function, for repeat byte groups to copy.
+                         // NULL if repeat byte groups aren't allowed, in which case they are invalid.
     // Returns one of the PARSE_RESULTs.
 ){
     if (ppNoteblock == NULL) { return PARSE_RESULT_INTERNAL_ERROR; } // *ppNoteblock can be NULL, but ppNoteblock can't
@@ -121,6 +373,7 @@ int parse_byte_group (
     unsigned char byte2 = 0, byte3 = 0, byte4 = 0; // May be set later depending on byte group type
     struct noteblock* pNewNoteblock = NULL;
     int byteGroupType = byte_group_type (byte1);
+    MUSIC2_PROBE2 (parse__group, byteGroupType, *pIndex - 1);
 
     switch (byteGroupType) {
         case BYTE_GROUP_TYPE_INVALID:
@@ -134,6 +387,12 @@ int parse_byte_group (
             // 1 byte
             pNewNoteblock = make_clef (byte1);
             break;
+        case BYTE_GROUP_TYPE_REPEAT:
+            // 2 bytes
+            // Creates any number of noteblocks, by copying rather than drawing, so it's handled separately.
+            byte2 = pBytes[*pIndex]; ++(*pIndex);
+            if (byte2 == 0) { return PARSE_RESULT_UNEXPECTED_TERMINATOR; }
+            return parse_repeat (byte2, ppNoteblock, pParseInfo, pHistory);
         case BYTE_GROUP_TYPE_KEY_CHANGE:
             // 2 bytes
             byte2 = pBytes[*pIndex]; ++(*pIndex);
@@ -173,7 +432,8 @@ int parse_byte_group (
             // This is the only set of bytes that modifies the current noteblock rather than creating a new one.
             // Dynamics text can't be the first byte group or appear twice consecutively.
             int prevByteGroupType = *pParseInfo & 0xFF;
-            if (ppNoteblock == NULL || prevByteGroupType == 0 || prevByteGroupType == BYTE_GROUP_TYPE_DYN_TEXT) {
+            // *ppNoteblock can also be NULL if parsing started partway through the bytes, right before dynamics text.
+            if (*ppNoteblock == NULL || prevByteGroupType == 0 || prevByteGroupType == BYTE_GROUP_TYPE_DYN_TEXT) {
                 return PARSE_RESULT_INVALID_BYTE;
             }
             char* pText = get_ptr_to_text (*ppNoteblock);
@@ -190,6 +450,7 @@ int parse_byte_group (
     if (pNewNoteblock != NULL) {
         if (*ppNoteblock != NULL) { (*ppNoteblock)->pNext = pNewNoteblock; }
         *ppNoteblock = pNewNoteblock;
+        MUSIC2_PROBE2 (noteblock__new, byteGroupType, 1);
     }
     else if (byteGroupType != BYTE_GROUP_TYPE_DYN_TEXT) {
         *ppNoteblock = NULL;
@@ -199,30 +460,172 @@ int parse_byte_group (
     // Update parseInfo
     *pParseInfo = update_parse_info (*pParseInfo, (unsigned char)byteGroupType, byte1);
 
+    // Update history. Dynamics text changes the most recent noteblock, so only its parseInfo is updated.
+    if (pHistory != NULL) {
+        if (pNewNoteblock != NULL) {
+            parse_history_add (pHistory, pNewNoteblock, byteGroupType, *pParseInfo);
+        }
+        else if (pHistory->count > 0) {
+            pHistory->parseInfos[(pHistory->count - 1) % PARSE_HISTORY_SIZE] = *pParseInfo;
+        }
+    }
+
     return PARSE_RESULT_PARSED_NOTEBLOCK;
 }
 
 
-// Parse array of encoded bytes to create list of noteblocks
-int parse_bytes_start_to_end (
-    const unsigned char* pBytes,         // Pointer to array of bytes (0b11111111-terminated) from which to read.
+// Parse encoded bytes from some index to the terminator to create list of noteblocks.
+// Starting partway through the bytes requires the parseInfo the parser had at that point, for example from a
+// checkpoint or the start of a chunk.
+int parse_bytes_from (
+    const unsigned char* pBytes,         // Pointer to array of bytes (0-terminated) from which to read.
+    int                  startIndex,     // Index of the first byte group to parse.
+    unsigned int         parseInfo,      // parseInfo as of startIndex - see update_parse_info. 0 at the start.
     struct noteblock**   pp1stNoteblock, // Will be set to pointer to pointer to first noteblock in list.
-    int*                 pErrIndex       // If an error occurs, will be set to its index in *pBytes, otherwise to -1.
+    int*                 pErrIndex,      // If an error occurs, will be set to its index in *pBytes, otherwise to -1.
+    unsigned int         countExpected   // Noteblocks expected, from a file header, to print progress to stderr
+                                         // as they're parsed. 0 not to.
     // Returns one of the PARSE_RESULTs
 ){
-    int index = 0;
-    unsigned int parseInfo = 0;
+    unsigned int progressStep = countExpected / 10;
+    unsigned int progressNext = progressStep;
+    unsigned int progressTenths = 0;
+    if (progressStep > 0) { fprintf (stderr, "  Parsed: 00%%"); }
+    int index = startIndex;
+    struct parse_history history;
+    history.count = 0;
     *pp1stNoteblock = NULL; // Set to NULL so parse_byte_group knows it's at the first noteblock
-    int parseResult = parse_byte_group (pBytes, &index, pp1stNoteblock, &parseInfo);
-    struct noteblock* pNoteblock = *pp1stNoteblock;
+    struct noteblock* pNoteblock = NULL;
+    int parseResult = PARSE_RESULT_PARSED_NOTEBLOCK;
     while (parseResult == PARSE_RESULT_PARSED_NOTEBLOCK) {
-        parseResult = parse_byte_group (pBytes, &index, &pNoteblock, &parseInfo);
+        while (progressStep > 0 && history.count >= progressNext && progressTenths < 9) {
+            ++progressTenths;
+            progressNext += progressStep;
+            fprintf (stderr, " %d0%%", progressTenths);
+        }
+        // Copy a measure parsed earlier, or parse it and remember it - see music2_memo.c
+        int measureLength = memo_is_enabled () ? memo_measure_length (pBytes, index) : 0;
+        if (measureLength > 0) {
+            const struct memo_entry* pEntry = memo_lookup (pBytes + index, measureLength, parseInfo);
+            if (pEntry != NULL) {
+                parseResult = parse_memo_entry (pEntry, &pNoteblock, &parseInfo, &history);
+                if (*pp1stNoteblock == NULL && history.count > 0) { *pp1stNoteblock = history.pNoteblocks[0]; }
+                if (parseResult != PARSE_RESULT_PARSED_NOTEBLOCK) { ++index; } // Report the measure's first byte
+                else                                              { index += measureLength; }
+                continue;
+            }
+            unsigned int parseInfoIn = parseInfo;
+            unsigned int countNoteblocksIn = history.count;
+            int measureEnd = index + measureLength;
+            while (index < measureEnd && parseResult == PARSE_RESULT_PARSED_NOTEBLOCK) {
+                parseResult = parse_byte_group (pBytes, &index, &pNoteblock, &parseInfo, &history);
+                if (*pp1stNoteblock == NULL) { *pp1stNoteblock = pNoteblock; }
+            }
+            if (parseResult == PARSE_RESULT_PARSED_NOTEBLOCK) {
+                memo_store (pBytes + measureEnd - measureLength, measureLength, parseInfoIn, parseInfo,
+                    history.count - countNoteblocksIn, &history);
+            }
+            continue;
+        }
+        parseResult = parse_byte_group (pBytes, &index, &pNoteblock, &parseInfo, &history);
+        if (*pp1stNoteblock == NULL) { *pp1stNoteblock = pNoteblock; }
     }
+    if (progressStep > 0) { fprintf (stderr, (parseResult == PARSE_RESULT_PARSED_ALL) ? " 100%%\n" : "\n"); }
+    stats_count_groups (pBytes, startIndex, index);
     *pErrIndex = (parseResult == PARSE_RESULT_PARSED_ALL) ? -1 : index - 1;
+    if (parseResult != PARSE_RESULT_PARSED_ALL) { MUSIC2_PROBE2 (parse__error, parseResult, *pErrIndex); }
+    return parseResult;
+}
+
+
+// Parse the byte groups in a range of encoded bytes to create list of noteblocks. The range needn't end with a
+// terminator, and nothing past it is read, so it suits pieces of a larger buffer such as container chunks.
+int parse_bytes_range (
+    const unsigned char* pBytes,          // Pointer to array of bytes from which to read.
+    int                  startIndex,      // Index of the first byte group to parse.
+    int                  endIndex,        // Index just past the last byte group to parse.
+    unsigned int         parseInfo,       // parseInfo as of startIndex - see update_parse_info. 0 at the start.
+    struct noteblock**   pp1stNoteblock,  // Will be set to pointer to first noteblock in list, or NULL if none.
+    struct noteblock**   ppLastNoteblock, // Will be set to pointer to last noteblock in list, or NULL if none.
+    int*                 pErrIndex        // If an error occurs, will be set to its index in *pBytes, otherwise to -1.
+    // Returns one of the PARSE_RESULTs. PARSE_RESULT_PARSED_ALL if the range ends on a byte group boundary.
+){
+    int index = startIndex;
+    int parseResult = PARSE_RESULT_PARSED_ALL;
+    struct noteblock* pNoteblock = NULL;
+    struct parse_history history;
+    history.count = 0;
+    *pp1stNoteblock = NULL;
+    *pErrIndex = -1;
+    while (index < endIndex) {
+        int byteGroupType = byte_group_type (pBytes[index]);
+        if (byteGroupType == BYTE_GROUP_TYPE_TERMINATOR || index + byte_group_length (byteGroupType) > endIndex) {
+            parseResult = PARSE_RESULT_UNEXPECTED_TERMINATOR;
+            *pErrIndex = index;
+            break;
+        }
+        parseResult = parse_byte_group (pBytes, &index, &pNoteblock, &parseInfo, &history);
+        if (*pp1stNoteblock == NULL) { *pp1stNoteblock = pNoteblock; }
+        if (parseResult != PARSE_RESULT_PARSED_NOTEBLOCK) {
+            *pErrIndex = index - 1;
+            break;
+        }
+        parseResult = PARSE_RESULT_PARSED_ALL;
+    }
+    *ppLastNoteblock = (parseResult == PARSE_RESULT_PARSED_ALL) ? pNoteblock : NULL;
+    if (parseResult != PARSE_RESULT_PARSED_ALL) { MUSIC2_PROBE2 (parse__error, parseResult, *pErrIndex); }
     return parseResult;
 }
 
 
+// Parse array of encoded bytes to create list of noteblocks
+int parse_bytes_start_to_end (
+    const unsigned char* pBytes,         // Pointer to array of bytes (0b11111111-terminated) from which to read.
+    struct noteblock**   pp1stNoteblock, // Will be set to pointer to pointer to first noteblock in list.
+    int*                 pErrIndex       // If an error occurs, will be set to its index in *pBytes, otherwise to -1.
+    // Returns one of the PARSE_RESULTs
+){
+    unsigned long long traceNs = trace_begin ();
+    int parseResult = parse_bytes_from (pBytes, 0, 0, pp1stNoteblock, pErrIndex, 0);
+    trace_end ("parse_bytes_start_to_end", traceNs, -1);
+    return parseResult;
+}
+
+
+
+// Parse the bytes of a file, which may be plain encoded bytes with or without a header, a container, or
+// compressed, to create list of noteblocks. An archive holds many songs, so it isn't parsed as one.
+int parse_file_bytes (
+    const unsigned char* pBytes,         // Pointer to array of file bytes, plus a 0 after them.
+    size_t               countBytes,     // Number of file bytes.
+    struct noteblock**   pp1stNoteblock, // Will be set to pointer to pointer to first noteblock in list.
+    int*                 pErrIndex       // If an error occurs, will be set to its index in *pBytes, otherwise to -1.
+    // Returns one of the PARSE_RESULTs
+){
+    if (container_is_container (pBytes, countBytes)) {
+        return container_parse (pBytes, countBytes, 0, pp1stNoteblock, pErrIndex);
+    }
+    if (rans_is_compressed (pBytes, countBytes)) {
+        return rans_parse (pBytes, countBytes, pp1stNoteblock, pErrIndex);
+    }
+    if (archive_is_archive (pBytes, countBytes)) {
+        *pp1stNoteblock = NULL;
+        *pErrIndex = 0;
+        return PARSE_RESULT_ARCHIVE;
+    }
+    if (header_is_header (pBytes, countBytes)) {
+        struct file_header header;
+        if (!header_read (pBytes, countBytes, &header)) {
+            *pp1stNoteblock = NULL;
+            *pErrIndex = 0;
+            return PARSE_RESULT_CORRUPT;
+        }
+        return parse_bytes_from (pBytes, HEADER_SIZE, 0, pp1stNoteblock, pErrIndex,
+            header_shows_progress () ? header.countNoteblocks : 0);
+    }
+    return parse_bytes_start_to_end (pBytes, pp1stNoteblock, pErrIndex);
+}
+
 
 //*****************************************************************************
 // Functions for converting a list of noteblocks to a string
@@ -257,7 +660,8 @@ void append_staff_row_initial (
         char* pRow = get_ptr_to_row_from_noteblock (pCurrentNoteblock, row);
         if (*pIdxInStr >= unsafeIdxInStr) {
             int width = (pRow[0] != '\0') + (pRow[1] != '\0') + (pRow[2] != '\0') + (pRow[3] != '\0') + (pRow[4] != '\0');
-            if (*pIdxInStr + width >= limitIdxInStr) { break; }
+            // The first noteblock always goes in, so a staff narrower than one noteblock still makes progress
+            if (*pIdxInStr + width >= limitIdxInStr && pCurrentNoteblock != pStaffHead) { break; }
         }
         if (pRow[0] != '\0') { str[*pIdxInStr] = pRow[0]; ++(*pIdxInStr); }
         if (pRow[1] != '\0') { str[*pIdxInStr] = pRow[1]; ++(*pIdxInStr); }
@@ -306,18 +710,26 @@ char* noteblocks_to_string (
 
     // Allocate a string with max length we might need if every noteblock fills all 5 columns (no '\0' column)
     unsigned int countNoteblocks = count_noteblocks (p1stNoteblock);
-    unsigned int noteblocksPerStaff = maxStaffWidth / NOTEBLOCK_WIDTH; // Assuming all 5 columns used always
+    // A staff's noteblocks must fit in maxStaffWidth - 1 columns (see append_staff_row_initial), and every staff
+    // holds at least one noteblock.
+    unsigned int noteblocksPerStaff = (maxStaffWidth - 1) / NOTEBLOCK_WIDTH; // Assuming all 5 columns used always
+    if (noteblocksPerStaff == 0) { noteblocksPerStaff = 1; }
     unsigned int countStaves = (countNoteblocks / noteblocksPerStaff) + (countNoteblocks % noteblocksPerStaff > 0);
-    unsigned int countChars = (NOTEBLOCK_HEIGHT * NOTEBLOCK_WIDTH * countNoteblocks) // Actual noteblock text
-        + ((NOTEBLOCK_HEIGHT + 1) * countStaves) // '\n' at end of each row, including extra seperator row between staves
+    // Counted wide so a huge list can't wrap around to a small size. Indexes into the string are unsigned int.
+    unsigned long long countChars = (NOTEBLOCK_HEIGHT * NOTEBLOCK_WIDTH * 1ULL * countNoteblocks) // Actual noteblock text
+        + ((NOTEBLOCK_HEIGHT + 1) * 1ULL * countStaves) // '\n' at end of each row, including extra seperator row between staves
         + 1; // '\0' at end of string
-    char* str = malloc (countChars);
+    if (countChars > UINT_MAX) { return NULL; }
+    char* str = malloc ((size_t)countChars);
     if (str == NULL) { return NULL; }
+    stats_add_string_bytes (countChars);
 
     // Loop over staves until last noteblock processed
     unsigned int idxInStr = 0;
     struct noteblock* pStaffHead = p1stNoteblock; // First noteblock in current staff
-    while (pStaffHead != NULL) {
+    for (long long staff = 0; pStaffHead != NULL; ++staff) {
+        unsigned long long traceNs = trace_begin ();
+        MUSIC2_PROBE1 (staff__start, staff);
         // Loop over rows in staff. Rows are numbered from bottom, but we're printing from top, so loop backwards.
         int row = NOTEBLOCK_HEIGHT - 1;
         struct noteblock* pStaffHeadNext; // Will be set by following function
@@ -327,6 +739,8 @@ char* noteblocks_to_string (
         }
         str[idxInStr] = '\n'; ++idxInStr; // Separate staves
         pStaffHead = pStaffHeadNext;
+        trace_end ("staff", traceNs, staff);
+        MUSIC2_PROBE2 (staff__end, staff, idxInStr);
     }
     str[idxInStr] = '\0'; ++idxInStr;
     if (idxInStr > countChars) { free (str); return NULL; } // Sanity check
@@ -335,6 +749,68 @@ char* noteblocks_to_string (
 
 
 
+// Convert noteblocks to a single string, given their totals from a file header so the string can be allocated
+// at its exact size up front. Each staff is measured before it's written, so totals that don't match the
+// noteblocks can't overrun the string.
+char* noteblocks_to_string_sized (
+    struct noteblock* p1stNoteblock,   // Initial noteblock.
+    int               maxStaffWidth,   // Max width of a staff in characters. Should be no less than NOTEBLOCK_WIDTH.
+    unsigned int      countNoteblocks, // Number of noteblocks in the list.
+    unsigned int      totalWidth,      // Total width of the noteblocks' top rows.
+    unsigned int      totalChars       // Total characters in all rows of the noteblocks.
+    // Returns the result of converting these noteblocks to a single string, or NULL if the totals are wrong.
+){
+    if (p1stNoteblock == NULL || maxStaffWidth < NOTEBLOCK_WIDTH || countNoteblocks == 0) { return NULL; }
+
+    // Every staff but the last is full enough that its next noteblock didn't fit, so it's at least
+    // maxStaffWidth - NOTEBLOCK_WIDTH wide, and every staff holds at least one noteblock.
+    unsigned int minFullWidth = (unsigned int)maxStaffWidth - NOTEBLOCK_WIDTH;
+    unsigned long long countStaves = (minFullWidth == 0) ? countNoteblocks : (totalWidth / minFullWidth) + 1;
+    if (countStaves > countNoteblocks) { countStaves = countNoteblocks; }
+    unsigned long long countChars = totalChars
+        + ((NOTEBLOCK_HEIGHT + 1) * countStaves) // '\n' at end of each row, including extra seperator row between staves
+        + 1; // '\0' at end of string
+    if (countChars > INT_MAX) { return NULL; }
+    char* str = malloc ((size_t)countChars);
+    if (str == NULL) { return NULL; }
+    stats_add_string_bytes (countChars);
+
+    unsigned int idxInStr = 0;
+    struct noteblock* pStaffHead = p1stNoteblock;
+    for (long long staff = 0; pStaffHead != NULL; ++staff) {
+        unsigned long long traceNs = trace_begin ();
+        MUSIC2_PROBE1 (staff__start, staff);
+        // Find the staff's noteblocks as append_staff_row_initial would, and the characters they need
+        unsigned long long staffWidth = 0, staffChars = 0;
+        struct noteblock* pStaffHeadNext = pStaffHead;
+        while (pStaffHeadNext != NULL) {
+            char* pRow = get_ptr_to_row_from_noteblock (pStaffHeadNext, ROW_HI_B);
+            int width = (pRow[0] != '\0') + (pRow[1] != '\0') + (pRow[2] != '\0') + (pRow[3] != '\0') + (pRow[4] != '\0');
+            if (staffWidth + width >= (unsigned long long)maxStaffWidth && pStaffHeadNext != pStaffHead) { break; }
+            staffWidth += width;
+            for (int row = 0; row < NOTEBLOCK_HEIGHT; ++row) {
+                pRow = get_ptr_to_row_from_noteblock (pStaffHeadNext, row);
+                staffChars += (pRow[0] != '\0') + (pRow[1] != '\0') + (pRow[2] != '\0') + (pRow[3] != '\0') + (pRow[4] != '\0');
+            }
+            pStaffHeadNext = pStaffHeadNext->pNext;
+        }
+        if (idxInStr + staffChars + NOTEBLOCK_HEIGHT + 1 + 1 > countChars) { free (str); return NULL; }
+
+        // Rows are numbered from bottom, but we're printing from top, so loop backwards
+        for (int row = NOTEBLOCK_HEIGHT - 1; row >= 0; --row) {
+            append_staff_row_subsequent (pStaffHead, pStaffHeadNext, row, str, &idxInStr);
+        }
+        str[idxInStr] = '\n'; ++idxInStr; // Separate staves
+        pStaffHead = pStaffHeadNext;
+        trace_end ("staff", traceNs, staff);
+        MUSIC2_PROBE2 (staff__end, staff, idxInStr);
+    }
+    str[idxInStr] = '\0'; ++idxInStr;
+    return str;
+}
+
+
+
 //***************************
 // Byte to string formatting
 //***************************
@@ -384,6 +860,73 @@ void format_byte_from_index (
 
 
 
+//***********************
+// Library entry point
+//***********************
+
+// Render an array of encoded bytes to a string, consulting the render cache (if configured) first.
+// This is the entry point for callers that just want the printed music for some bytes.
+char* render_bytes (
+    const unsigned char* pBytes,       // Pointer to array of bytes (0-terminated) from which to read.
+    size_t               countBytes,   // Number of bytes in the array, including the terminator. Used as part of
+                         // the cache key, so trailing bytes after the terminator also distinguish inputs.
+    int                  maxStaffWidth, // Max width of a staff in characters. Should be no less than NOTEBLOCK_WIDTH.
+    int*                 pParseResult, // Will be set to one of the PARSE_RESULTs. PARSE_RESULT_PARSED_ALL on a
+                         // cache hit.
+    int*                 pErrIndex     // If a parse error occurs, will be set to its index in *pBytes, otherwise to -1.
+    // Returns the rendered string (caller must free), or NULL on error.
+){
+    // A file header has the totals for sizing the string. Its hash isn't the cache key, since the body may have
+    // been edited since the header was written, and the totals are checked as the string is written anyway.
+    struct file_header header;
+    int hasHeader = header_is_header (pBytes, countBytes) && header_read (pBytes, countBytes, &header);
+
+    // Cache hit: skip parsing and drawing entirely
+    unsigned long long hash = 0;
+    if (cache_is_enabled ()) {
+        hash = hash_bytes (pBytes, countBytes, 0);
+        char* cachedStr = cache_lookup (pBytes, countBytes, hash, maxStaffWidth);
+        if (cachedStr != NULL) {
+            *pParseResult = PARSE_RESULT_PARSED_ALL;
+            *pErrIndex = -1;
+            stats_record_render (*pParseResult, *pErrIndex, cachedStr);
+            return cachedStr;
+        }
+    }
+
+    // Array of bytes to list of noteblocks
+    struct noteblock* p1stNoteblock;
+    unsigned long long stageNs = stats_now ();
+    *pParseResult = parse_file_bytes (pBytes, countBytes, &p1stNoteblock, pErrIndex);
+    stageNs = stats_end_stage (STATS_STAGE_PARSE, stageNs);
+    if (*pParseResult != PARSE_RESULT_PARSED_ALL) {
+        free_noteblocks (p1stNoteblock);
+        stats_end_stage (STATS_STAGE_FREE, stageNs);
+        stats_record_render (*pParseResult, *pErrIndex, NULL);
+        return NULL;
+    }
+
+    // List of noteblocks to string. If the header's totals turn out wrong, fall back on the usual estimate.
+    char* str = NULL;
+    if (hasHeader) {
+        str = noteblocks_to_string_sized (p1stNoteblock, maxStaffWidth, header.countNoteblocks, header.totalWidth,
+            header.totalChars);
+    }
+    if (str == NULL) { str = noteblocks_to_string (p1stNoteblock, maxStaffWidth); }
+    stats_end_stage (STATS_STAGE_TO_STRING, stageNs);
+    stats_count_noteblocks (p1stNoteblock); // Untimed, since it walks the list again
+    stageNs = stats_now ();
+    free_noteblocks (p1stNoteblock);
+    stats_end_stage (STATS_STAGE_FREE, stageNs);
+    stats_record_render (*pParseResult, *pErrIndex, str);
+    if (str != NULL && cache_is_enabled ()) {
+        cache_store (pBytes, countBytes, hash, maxStaffWidth, str);
+    }
+    return str;
+}
+
+
+
 //*********
 // Main IO
 //*********
@@ -391,35 +934,44 @@ void format_byte_from_index (
 // Size in bytes of largest file we would try to read from.
 #define FILE_SIZE_MAX (99999)
 
-// Attempts to open file, decode it, and print music.
-void try_read_file (
-    char* filepath, // User-entered file path and name.
-    char* widthStr  // User-entered string for maximum staff width, or NULL if not entered.
+// Parse a user-entered staff width.
+int parse_width_arg (
+    char* widthStr, // User-entered string for maximum staff width, or NULL if not entered.
+    int*  pWidth    // Output param, set to the width, or to INT_MAX (effectively ignored) if widthStr is NULL.
+    // Returns 1 if valid, otherwise prints an error and returns 0.
 ){
-    // Find staff width, parsing widthStr if specified
-    int widthInt;
-    if (widthStr != NULL) {
-        widthInt = atoi (widthStr); // Returns 0 if not parsable
-        if (widthInt == 0) {
-            printf ("  Invalid width\n");
-            return;
-        }
-        else if (widthInt < NOTEBLOCK_WIDTH) {
-            printf ("  Invalid width %s < %d\n", widthStr, NOTEBLOCK_WIDTH);
-            return;
-        }
+    if (widthStr == NULL) {
+        *pWidth = INT_MAX; // Will effectively be ignored
+        return 1;
     }
-    else {
-        widthInt = INT_MAX; // Will effectively be ignored
+    *pWidth = atoi (widthStr); // Returns 0 if not parsable
+    if (*pWidth == 0) {
+        printf ("  Invalid width\n");
+        return 0;
+    }
+    else if (*pWidth < NOTEBLOCK_WIDTH) {
+        printf ("  Invalid width %s < %d\n", widthStr, NOTEBLOCK_WIDTH);
+        return 0;
     }
+    return 1;
+}
 
+
+// Read a whole file into a new array of bytes.
+unsigned char* read_file_bytes (
+    char* filepath,   // User-entered file path and name.
+    int*  pCountBytes // Output param, set to the file size. The array has one more byte, a 0, so that parsing
+                      // stops inside the array even if the file lacks its terminator.
+    // Returns the array of bytes (caller must free), or NULL after printing an error.
+){
     // Open file
+    MUSIC2_PROBE1 (file__open, filepath);
     FILE* file;
     errno_t fopenErr = fopen_s ( // Microsoft's enhanced security version of fopen
         &file, filepath, "rb"); // rb: binary read mode
     if (fopenErr || file == NULL) {
         printf ("  Unable to open file %s\n", filepath);
-        return;
+        return NULL;
     }
 
     // Get file size
@@ -431,56 +983,223 @@ void try_read_file (
     if (fileSize == 0) {
         printf ("  File is empty: %s\n", filepath);
         fclose (file);
-        return;
+        return NULL;
     }
-    if (fileSize > FILE_SIZE_MAX) {
+    // Containers are meant for large scores, and carry checksums, so the limit doesn't apply to them. For files
+    // with headers it applies to the encoded bytes after the header.
+    unsigned char magic[4] = { 0, 0, 0, 0 };
+    fread (magic, 1, sizeof (magic), file);
+    rewind (file);
+    int countLimitedBytes = header_is_header (magic, sizeof (magic)) ? fileSize - HEADER_SIZE : fileSize;
+    if (countLimitedBytes > FILE_SIZE_MAX && !container_is_container (magic, sizeof (magic))) {
         printf ("  File is too long (>%d bytes): %s\n", FILE_SIZE_MAX, filepath);
         fclose (file);
-        return;
+        return NULL;
     }
 
     // Read file into array, and close file
-    unsigned char* pBytes = malloc (fileSize);
+    unsigned char* pBytes = malloc (fileSize + 1);
     if (pBytes == NULL) {
         printf ("  Memory allocation error\n");
         fclose (file);
-        return;
+        return NULL;
     }
     fread (pBytes, 1, fileSize, file);
+    pBytes[fileSize] = 0;
     fclose (file);
+    *pCountBytes = fileSize;
+    MUSIC2_PROBE2 (file__read, filepath, fileSize);
+    return pBytes;
+}
+
+
+// Read a whole file of any size into a new array of bytes, for options that process files without printing
+// them, such as writing a header or benchmarking. Large files are mapped rather than read with stdio.
+unsigned char* read_large_file_bytes (
+    char*   filepath,   // User-entered file path and name.
+    size_t* pCountBytes // Output param, set to the file size. As with read_file_bytes, the array has one more
+                        // byte, a 0.
+    // Returns the array of bytes (caller must free), or NULL after printing an error.
+){
+    MUSIC2_PROBE1 (file__open, filepath);
+    struct platform_mapping mapping;
+    if (!platform_map_file (filepath, &mapping)) {
+        printf ("  Unable to open file %s\n", filepath);
+        return NULL;
+    }
+    unsigned char* pBytes = malloc (mapping.size + 1);
+    if (pBytes == NULL) {
+        printf ("  Memory allocation error\n");
+        platform_unmap_file (&mapping);
+        return NULL;
+    }
+    memcpy (pBytes, mapping.pBytes, mapping.size);
+    pBytes[mapping.size] = 0;
+    *pCountBytes = mapping.size;
+    platform_unmap_file (&mapping);
+    MUSIC2_PROBE2 (file__read, filepath, mapping.size);
+    return pBytes;
+}
+
+
+// Print the error for a failed parse.
+void print_parse_error (
+    int                  parseResult, // One of the PARSE_RESULTs other than PARSE_RESULT_PARSED_ALL.
+    const unsigned char* pBytes,      // Pointer to array of bytes that was parsed.
+    int                  errIndex     // Index of the error in *pBytes.
+){
+    switch (parseResult) {
+        case PARSE_RESULT_INVALID_BYTE: {
+            char byteStr[11];
+            format_byte_from_index (byteStr, pBytes, errIndex);
+            printf ("  Invalid byte %s at location #%d\n", byteStr, errIndex);
+            break;
+        }
+        case PARSE_RESULT_UNEXPECTED_TERMINATOR:
+            printf ("  Invalid terminator byte 0b00000000 at location #%d\n", errIndex);
+            break;
+        case PARSE_RESULT_CORRUPT:
+            printf ("  Corrupt or truncated data at location #%d\n", errIndex);
+            break;
+        case PARSE_RESULT_ARCHIVE:
+            printf ("  This is an archive of songs; print one with option -ar <archive> <name>\n");
+            break;
+        default:
+            printf ("  Internal error while parsing noteblocks\n");
+    }
+}
+
+
+// Attempts to open file, decode it, and print music.
+void try_read_file (
+    char* filepath, // User-entered file path and name.
+    char* widthStr  // User-entered string for maximum staff width, or NULL if not entered.
+){
+    int widthInt;
+    if (!parse_width_arg (widthStr, &widthInt)) return;
+    int fileSize;
+    unsigned long long stageNs = stats_now ();
+    unsigned char* pBytes = read_file_bytes (filepath, &fileSize);
+    stats_end_stage (STATS_STAGE_READ, stageNs);
+    if (pBytes == NULL) return;
+
+    // Array of bytes to string
+    int errIndex;
+    int parseResult;
+    char* str = render_bytes (pBytes, fileSize, widthInt, &parseResult, &errIndex);
+    if (parseResult != PARSE_RESULT_PARSED_ALL) {
+        print_parse_error (parseResult, pBytes, errIndex);
+        free (pBytes);
+        return;
+    }
+    if (str == NULL) {
+        printf ("  Internal error while converting noteblocks to string\n");
+        free (pBytes);
+        return;
+    }
+    unsigned long long traceNs = trace_begin ();
+    printf ("%s", str);
+    fflush (stdout);
+    trace_end ("print", traceNs, -1);
+    free (str); free (pBytes);
+}
+
+
+// Attempts to open file, decode it, and print a range of staves.
+void try_read_file_staves (
+    char* filepath,      // User-entered file path and name.
+    char* widthStr,      // User-entered string for maximum staff width.
+    char* firstStaffStr, // User-entered number of first staff to print, counting from 1.
+    char* lastStaffStr   // User-entered number of last staff to print, counting from 1.
+){
+    int widthInt;
+    if (!parse_width_arg (widthStr, &widthInt)) return;
+    int firstStaff = atoi (firstStaffStr), lastStaff = atoi (lastStaffStr);
+    if (firstStaff < 1 || lastStaff < firstStaff) {
+        printf ("  Invalid staff range %s to %s\n", firstStaffStr, lastStaffStr);
+        return;
+    }
+    int fileSize;
+    unsigned char* pBytes = read_file_bytes (filepath, &fileSize);
+    if (pBytes == NULL) return;
 
     // Array of bytes to list of noteblocks
     struct noteblock* p1stNoteblock;
     int errIndex;
-    int parseResult;
-    parseResult = parse_bytes_start_to_end (pBytes, &p1stNoteblock, &errIndex);
+    int parseResult = parse_file_bytes (pBytes, fileSize, &p1stNoteblock, &errIndex);
     if (parseResult != PARSE_RESULT_PARSED_ALL) {
-        switch (parseResult) {
-            case PARSE_RESULT_INVALID_BYTE: {
-                char byteStr[11];
-                format_byte_from_index (byteStr, pBytes, errIndex);
-                printf ("  Invalid byte %s at location #%d\n", byteStr, errIndex);
-                break;
-            }
-            case PARSE_RESULT_UNEXPECTED_TERMINATOR:
-                printf ("  Invalid terminator byte 0b00000000 at location #%d\n", errIndex);
-                break;
-            default:
-                printf ("  Internal error while parsing noteblocks\n");
-        }
+        print_parse_error (parseResult, pBytes, errIndex);
         free_noteblocks (p1stNoteblock); free (pBytes);
         return;
     }
 
-    // List of noteblocks to string
-    char* str = noteblocks_to_string (p1stNoteblock, widthInt);
+    // List of noteblocks to layout index to string
+    struct layout_index index;
+    if (!layout_index_build (p1stNoteblock, &index)) {
+        printf ("  Internal error while indexing noteblocks\n");
+        free_noteblocks (p1stNoteblock); free (pBytes);
+        return;
+    }
+    unsigned int countStaves = layout_count_staves (&index, widthInt);
+    char* str = layout_render_staves (&index, widthInt, firstStaff - 1, lastStaff - 1);
     if (str == NULL) {
-        printf ("  Internal error while converting noteblocks to string\n");
+        printf ("  No staves in range %d to %d; there are %u staves at width %d\n",
+            firstStaff, lastStaff, countStaves, widthInt);
+    }
+    else {
+        printf ("%s", str);
+        free (str);
+    }
+    layout_index_free (&index); free_noteblocks (p1stNoteblock); free (pBytes);
+}
+
+
+// layout_render_widths callback that prints each width's string under a line naming the width
+int print_width_callback (void* pContext, int maxStaffWidth, char* str) {
+    (void)pContext; // Part of the callback signature, not needed here
+    printf ("  Width %d:\n%s", maxStaffWidth, str);
+    free (str);
+    return 1;
+}
+
+
+// Attempts to open file, decode it once, and print it at every width in a range.
+void try_read_file_widths (
+    char* filepath,    // User-entered file path and name.
+    char* minWidthStr, // User-entered string for the first maximum staff width.
+    char* maxWidthStr  // User-entered string for the last maximum staff width.
+){
+    int minWidth, maxWidth;
+    if (!parse_width_arg (minWidthStr, &minWidth) || !parse_width_arg (maxWidthStr, &maxWidth)) return;
+    if (maxWidth < minWidth) {
+        printf ("  Invalid width range %s to %s\n", minWidthStr, maxWidthStr);
+        return;
+    }
+    int fileSize;
+    unsigned char* pBytes = read_file_bytes (filepath, &fileSize);
+    if (pBytes == NULL) return;
+
+    // Array of bytes to list of noteblocks
+    struct noteblock* p1stNoteblock;
+    int errIndex;
+    int parseResult = parse_file_bytes (pBytes, fileSize, &p1stNoteblock, &errIndex);
+    if (parseResult != PARSE_RESULT_PARSED_ALL) {
+        print_parse_error (parseResult, pBytes, errIndex);
         free_noteblocks (p1stNoteblock); free (pBytes);
         return;
     }
-    printf ("%s", str);
-    free (str); free_noteblocks (p1stNoteblock); free (pBytes);
+
+    // List of noteblocks to layout index to a string per width
+    struct layout_index index;
+    if (!layout_index_build (p1stNoteblock, &index)) {
+        printf ("  Internal error while indexing noteblocks\n");
+        free_noteblocks (p1stNoteblock); free (pBytes);
+        return;
+    }
+    if (!layout_render_widths (&index, minWidth, maxWidth, print_width_callback, NULL)) {
+        printf ("  Internal error while converting noteblocks to string\n");
+    }
+    layout_index_free (&index); free_noteblocks (p1stNoteblock); free (pBytes);
 }
 
 
@@ -507,6 +1226,7 @@ int get_example_bytes_width (
         (strcmp (typeArg, "beam") == 0) ? DTL_BYTES_BEAMED_NOTE :
         (strcmp (typeArg, "text") == 0) ? DTL_BYTES_TEXT :
         (strcmp (typeArg, "barline") == 0) ? DTL_BYTES_BARLINE :
+        (strcmp (typeArg, "repeat") == 0) ? DTL_BYTES_REPEAT :
         NULL;
     if (pExampleBytes == NULL) return 0;
     *pExampleWidth = (pExampleBytes == EXAMPLE_BYTES) ? EXAMPLE_WIDTH : DTL_WIDTH;
@@ -609,70 +1329,3 @@ void show_example (
         free (strBytes);
     }
 }
-
-
-// Test performance by constructing str_example count times
-void test_performance (
-    char* countStr, // String representing how many times to call str_example. Should be >= 10.
-    char* typeArg   // User-entered argument after -v, or NULL if none, which results in the general example song.
-){
-    // Parse countStr
-    int countInt = atoi (countStr); // Returns 0 if not parsable
-    if (countInt < 10) {
-        if (countInt == 0) {
-            printf ("  Invalid count\n");
-        }
-        else {
-            printf ("  Invalid count: %s < 10\n", countStr);
-        }
-        return;
-    }
-
-    // Process typeArg
-    unsigned char* pExampleBytes = NULL;
-    int exampleWidth = 0;
-    int isArgValid = get_example_bytes_width (typeArg, &pExampleBytes, &exampleWidth);
-    if (!isArgValid) {
-        printf ("  Invalid argument \"%s\"\n", typeArg);
-        return;
-    }
-
-    // Try once to build the string, make sure there's no error.
-    char* s = str_example (pExampleBytes, exampleWidth);
-    if (s == NULL) return;
-    free (s);
-
-    // The following is over-optimized for the speed of the loop.
-    // In particular, the loop does direct comparison to 0 with no modulus involved.
-    int tenthOfCount = countInt / 10;
-    int tenthsDone = 0; // How many times we have looped count/10 times
-    int i = tenthOfCount + (countInt % 10); // i will count down to 0 ten times
-    printf ("  Done: 00%%");
-    time_t time0, time1;
-    time (&time0);
-    while (1) {
-        // Meat of loop
-        s = str_example (pExampleBytes, exampleWidth);
-        free (s);
-        // Rest of loop
-        --i;
-        if (i) {
-            continue;
-        }
-        else {
-            ++tenthsDone;
-            printf (" %d0%%", tenthsDone);
-            if (tenthsDone < 10) {
-                i = tenthOfCount; // Reset for next countdown
-            }
-            else {
-                break;
-            }
-        }
-    }
-
-    // Output
-    time (&time1);
-    int dur = (int)(time1 - time0);
-    printf ("\n  Example output constructed %s times in <%d seconds\n", countStr, dur);
-}
@@ -6,6 +6,79 @@
 
 #pragma once
 
+#include <stddef.h> // size_t
+
+#include "music2_noteblock.h"
+
+#define BYTE_GROUP_TYPE_TERMINATOR  (0b00000000)
+#define BYTE_GROUP_TYPE_NOTE_NN     (0b00000001)
+#define BYTE_GROUP_TYPE_NOTE_NB     (0b00000101)
+#define BYTE_GROUP_TYPE_TIME_CHANGE (0b00000010)
+#define BYTE_GROUP_TYPE_KEY_CHANGE  (0b00000011)
+#define BYTE_GROUP_TYPE_BARLINE     (0b00000100)
+#define BYTE_GROUP_TYPE_DYN_TEXT    (0b00001000)
+#define BYTE_GROUP_TYPE_CLEF        (0b00100000)
+#define BYTE_GROUP_TYPE_REPEAT      (0b00001100)
+#define BYTE_GROUP_TYPE_INVALID     (0b11010000)
+int byte_group_type (unsigned char byte1);
+int byte_group_length (int byteGroupType);
+int scan_byte_group (const unsigned char* pBytes, size_t countBytes, size_t index);
+unsigned int update_parse_info (unsigned int oldParseInfo, unsigned char newByteGroupType, unsigned char newNoteByte1);
+#define PARSE_RESULT_PARSED_NOTEBLOCK      (0)
+#define PARSE_RESULT_PARSED_ALL            (1)
+#define PARSE_RESULT_UNEXPECTED_TERMINATOR (2)
+#define PARSE_RESULT_INVALID_BYTE          (3)
+#define PARSE_RESULT_INTERNAL_ERROR        (4)
+#define PARSE_RESULT_CORRUPT               (5)
+#define PARSE_RESULT_ARCHIVE               (6)
+#define PARSE_HISTORY_SIZE (256)
+struct parse_history {
+    struct noteblock* pNoteblocks[PARSE_HISTORY_SIZE];
+    unsigned int      parseInfos[PARSE_HISTORY_SIZE];
+    unsigned char     types[PARSE_HISTORY_SIZE];
+    unsigned int      count;
+};
+void parse_history_add (struct parse_history* pHistory, struct noteblock* pNoteblock, int byteGroupType,
+    unsigned int parseInfo);
+int parse_repeat (unsigned char countNoteblocks, struct noteblock** ppNoteblock, unsigned int* pParseInfo,
+    struct parse_history* pHistory);
+struct scan_history {
+    unsigned int byteIndexes[PARSE_HISTORY_SIZE];
+    unsigned int parseInfos[PARSE_HISTORY_SIZE];
+    unsigned int count;
+};
+void scan_history_add (struct scan_history* pHistory, unsigned int byteIndex, unsigned int parseInfo);
+int scan_byte_group_history (const unsigned char* pBytes, size_t index, unsigned int* pParseInfo,
+    struct scan_history* pHistory, void (*pCallback) (void* pContext, unsigned int byteIndex), void* pContext);
+unsigned char* mark_repeat_spans (const unsigned char* pBytes, size_t countBytes, unsigned int* pCountNoteblocks);
+struct memo_entry;
+int parse_memo_entry (const struct memo_entry* pEntry, struct noteblock** ppNoteblock, unsigned int* pParseInfo,
+    struct parse_history* pHistory);
+int parse_byte_group (const unsigned char* pBytes, int* pIndex, struct noteblock** ppNoteblock,
+    unsigned int* pParseInfo, struct parse_history* pHistory);
+int parse_bytes_from (const unsigned char* pBytes, int startIndex, unsigned int parseInfo,
+    struct noteblock** pp1stNoteblock, int* pErrIndex, unsigned int countExpected);
+int parse_bytes_range (const unsigned char* pBytes, int startIndex, int endIndex, unsigned int parseInfo,
+    struct noteblock** pp1stNoteblock, struct noteblock** ppLastNoteblock, int* pErrIndex);
+int parse_bytes_start_to_end (const unsigned char* pBytes, struct noteblock** pp1stNoteblock, int* pErrIndex);
+int parse_file_bytes (const unsigned char* pBytes, size_t countBytes, struct noteblock** pp1stNoteblock,
+    int* pErrIndex);
+void append_staff_row_subsequent (struct noteblock* pStaffHead, struct noteblock* pStaffHeadNext, int row, char* str,
+    unsigned int* pIdxInStr);
+char* noteblocks_to_string (struct noteblock* p1stNoteblock, int maxStaffWidth);
+char* noteblocks_to_string_sized (struct noteblock* p1stNoteblock, int maxStaffWidth, unsigned int countNoteblocks,
+    unsigned int totalWidth, unsigned int totalChars);
+void format_byte_0b (char byteStr[11], unsigned char byte);
+char* render_bytes (const unsigned char* pBytes, size_t countBytes, int maxStaffWidth, int* pParseResult,
+    int* pErrIndex);
+#define FILE_SIZE_MAX (99999)
+int parse_width_arg (char* widthStr, int* pWidth);
+unsigned char* read_file_bytes (char* filepath, int* pCountBytes);
+unsigned char* read_large_file_bytes (char* filepath, size_t* pCountBytes);
+void print_parse_error (int parseResult, const unsigned char* pBytes, int errIndex);
 void try_read_file (char* filepath, char* widthStr);
+void try_read_file_staves (char* filepath, char* widthStr, char* firstStaffStr, char* lastStaffStr);
+int print_width_callback (void* pContext, int maxStaffWidth, char* str);
+void try_read_file_widths (char* filepath, char* minWidthStr, char* maxWidthStr);
+int get_example_bytes_width (char* typeArg, unsigned char** ppExampleBytes, int* pExampleWidth);
 void show_example (char* typeArg, int showBytes);
-void test_performance (char* countStr, char* typeArg);
@@ -0,0 +1,270 @@
+//*****************************************************************************************************
+// music2_hash.c
+// This file contains a fast non-cryptographic 64-bit hash of an array of bytes, used to identify encoded
+// input without comparing it byte by byte (for example, as a render cache key).
+// The hash reads 64-byte stripes into eight independent 64-bit accumulators. Each accumulator step is a
+// 32x32->64 bit multiply and two adds, which maps directly onto SSE2 (two accumulators per register).
+// Where SSE2 is unavailable, the scalar loop computes exactly the same values.
+// It also contains CRC32C, used where stored data must be checked for corruption rather than just identified,
+// and the little-endian number reads and writes shared by the file formats.
+//*****************************************************************************************************
+
+
+// External inclusions
+#include <stddef.h> // size_t
+#include <string.h> // memcpy
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HASH_USE_SSE2
+#include <emmintrin.h> // _mm_mul_epu32 and other SSE2 intrinsics
+#endif
+
+#if defined(__SSE4_2__) || defined(__AVX__)
+#define HASH_USE_SSE42
+#include <nmmintrin.h> // _mm_crc32_u64, _mm_crc32_u8
+#endif
+
+
+//***********
+// Constants
+//***********
+
+#define HASH_STRIPE_LEN          (64) // Bytes consumed per accumulate step
+#define HASH_STRIPES_PER_SCRAMBLE (16) // Accumulate steps between scrambles, so high bits keep mixing in
+
+#define HASH_PRIME32_1 (0x9E3779B1U)
+#define HASH_PRIME64_1 (0x9E3779B185EBCA87ULL)
+#define HASH_PRIME64_2 (0xC2B2AE3D27D4EB4FULL)
+#define HASH_PRIME64_3 (0x165667B19E3779F9ULL)
+
+// Arbitrary 64-bit constants mixed into each accumulator lane. The scramble step uses the same ones.
+const unsigned long long HASH_SECRET[8] = {
+    0xBE4BA423396CFEB8ULL, 0x1CAD21F72C81017CULL, 0xDB979083E96DD4DEULL, 0x1F67B3B7A4A44072ULL,
+    0x78E5C0CC4EE679CBULL, 0x2172FFCC7DD05A82ULL, 0x8E2443F7744608B8ULL, 0x4C263A81E69035E0ULL
+};
+
+
+
+//***************
+// Helper steps
+//***************
+
+// Read 8 bytes as a little-endian 64-bit number, regardless of alignment
+unsigned long long hash_read64 (
+    const unsigned char* p // Pointer to 8 readable bytes
+){
+    unsigned long long value;
+    memcpy (&value, p, sizeof (value)); // Compiles to a single unaligned load on x86 and ARM
+    return value;
+}
+
+
+// Final mix so every input bit affects every output bit
+unsigned long long hash_avalanche (
+    unsigned long long h // Value to mix
+){
+    h ^= h >> 37;
+    h *= HASH_PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+
+// Accumulate one 64-byte stripe into the eight accumulators
+void hash_accumulate_stripe (
+    unsigned long long   acc[8], // Accumulators, updated in place
+    const unsigned char* pStripe // Pointer to 64 readable bytes
+){
+#ifdef HASH_USE_SSE2
+    __m128i* pAcc = (__m128i*)acc;
+    for (int i = 0; i < 4; ++i) {
+        __m128i data = _mm_loadu_si128 ((const __m128i*)(pStripe + (16 * i)));
+        __m128i key = _mm_xor_si128 (data, _mm_loadu_si128 ((const __m128i*)&HASH_SECRET[2 * i]));
+        __m128i keyHi = _mm_shuffle_epi32 (key, _MM_SHUFFLE (0, 3, 0, 1)); // High 32 bits of each lane moved low
+        __m128i product = _mm_mul_epu32 (key, keyHi);                     // lo32 * hi32 in each 64-bit lane
+        __m128i dataSwapped = _mm_shuffle_epi32 (data, _MM_SHUFFLE (1, 0, 3, 2)); // Swap the two 64-bit lanes
+        __m128i sum = _mm_add_epi64 (_mm_loadu_si128 (pAcc + i), dataSwapped);
+        _mm_storeu_si128 (pAcc + i, _mm_add_epi64 (sum, product));
+    }
+#else
+    for (int i = 0; i < 8; ++i) {
+        unsigned long long data = hash_read64 (pStripe + (8 * i));
+        unsigned long long key = data ^ HASH_SECRET[i];
+        acc[i ^ 1] += data; // Each lane's data also lands in its neighbor, as with the SSE2 lane swap
+        acc[i] += (key & 0xFFFFFFFFULL) * (key >> 32);
+    }
+#endif
+}
+
+
+// Scramble the accumulators so that long inputs don't let high bits of the products go unmixed
+void hash_scramble (
+    unsigned long long acc[8] // Accumulators, updated in place
+){
+    for (int i = 0; i < 8; ++i) {
+        unsigned long long a = acc[i];
+        a ^= a >> 47;
+        a ^= HASH_SECRET[i];
+        acc[i] = a * HASH_PRIME32_1;
+    }
+}
+
+
+
+//***********
+// Main hash
+//***********
+
+// Hash an array of bytes. The same bytes and seed always produce the same hash on every platform.
+unsigned long long hash_bytes (
+    const unsigned char* pBytes,     // Pointer to array of bytes to hash. Need not be 0-terminated or aligned.
+    size_t               countBytes, // Number of bytes to hash.
+    unsigned long long   seed        // Seed, for producing independent hashes of the same bytes. Usually 0.
+    // Returns the 64-bit hash.
+){
+    unsigned long long acc[8] = {
+        HASH_PRIME32_1, HASH_PRIME64_1, HASH_PRIME64_2, HASH_PRIME64_3,
+        HASH_PRIME64_1 ^ seed, HASH_PRIME64_2 + seed, HASH_PRIME64_3 - seed, HASH_PRIME32_1 ^ seed
+    };
+
+    // Full stripes
+    size_t countStripes = countBytes / HASH_STRIPE_LEN;
+    for (size_t stripe = 0; stripe < countStripes; ++stripe) {
+        hash_accumulate_stripe (acc, pBytes + (stripe * HASH_STRIPE_LEN));
+        if ((stripe % HASH_STRIPES_PER_SCRAMBLE) == HASH_STRIPES_PER_SCRAMBLE - 1) { hash_scramble (acc); }
+    }
+
+    // Remaining bytes, zero padded to one more stripe. The length mixed in below distinguishes padding zeros
+    // from real ones.
+    size_t countRemaining = countBytes % HASH_STRIPE_LEN;
+    if (countRemaining > 0) {
+        unsigned char lastStripe[HASH_STRIPE_LEN] = { 0 };
+        memcpy (lastStripe, pBytes + (countStripes * HASH_STRIPE_LEN), countRemaining);
+        hash_accumulate_stripe (acc, lastStripe);
+    }
+
+    // Merge accumulators
+    unsigned long long h = (countBytes * HASH_PRIME64_1) ^ seed;
+    for (int i = 0; i < 8; i += 2) {
+        unsigned long long lo = acc[i] ^ HASH_SECRET[i];
+        unsigned long long hi = acc[i + 1] ^ HASH_SECRET[i + 1];
+        // Fold a 64x64->128 bit multiply into 64 bits using four 32x32->64 bit multiplies
+        unsigned long long loLo = (lo & 0xFFFFFFFFULL) * (hi & 0xFFFFFFFFULL);
+        unsigned long long hiLo = (lo >> 32) * (hi & 0xFFFFFFFFULL);
+        unsigned long long loHi = (lo & 0xFFFFFFFFULL) * (hi >> 32);
+        unsigned long long hiHi = (lo >> 32) * (hi >> 32);
+        unsigned long long cross = (loLo >> 32) + (hiLo & 0xFFFFFFFFULL) + loHi;
+        unsigned long long upper = hiHi + (hiLo >> 32) + (cross >> 32);
+        unsigned long long lower = (cross << 32) | (loLo & 0xFFFFFFFFULL);
+        h += upper ^ lower;
+    }
+    return hash_avalanche (h);
+}
+
+
+
+//*********
+// CRC32C
+//*********
+
+// CRC32C (Castagnoli polynomial, reflected 0x82F63B78) of each possible byte, for the byte-at-a-time loop
+const unsigned int CRC32C_TABLE[256] = {
+    0x00000000U, 0xF26B8303U, 0xE13B70F7U, 0x1350F3F4U, 0xC79A971FU, 0x35F1141CU, 0x26A1E7E8U, 0xD4CA64EBU,
+    0x8AD958CFU, 0x78B2DBCCU, 0x6BE22838U, 0x9989AB3BU, 0x4D43CFD0U, 0xBF284CD3U, 0xAC78BF27U, 0x5E133C24U,
+    0x105EC76FU, 0xE235446CU, 0xF165B798U, 0x030E349BU, 0xD7C45070U, 0x25AFD373U, 0x36FF2087U, 0xC494A384U,
+    0x9A879FA0U, 0x68EC1CA3U, 0x7BBCEF57U, 0x89D76C54U, 0x5D1D08BFU, 0xAF768BBCU, 0xBC267848U, 0x4E4DFB4BU,
+    0x20BD8EDEU, 0xD2D60DDDU, 0xC186FE29U, 0x33ED7D2AU, 0xE72719C1U, 0x154C9AC2U, 0x061C6936U, 0xF477EA35U,
+    0xAA64D611U, 0x580F5512U, 0x4B5FA6E6U, 0xB93425E5U, 0x6DFE410EU, 0x9F95C20DU, 0x8CC531F9U, 0x7EAEB2FAU,
+    0x30E349B1U, 0xC288CAB2U, 0xD1D83946U, 0x23B3BA45U, 0xF779DEAEU, 0x05125DADU, 0x1642AE59U, 0xE4292D5AU,
+    0xBA3A117EU, 0x4851927DU, 0x5B016189U, 0xA96AE28AU, 0x7DA08661U, 0x8FCB0562U, 0x9C9BF696U, 0x6EF07595U,
+    0x417B1DBCU, 0xB3109EBFU, 0xA0406D4BU, 0x522BEE48U, 0x86E18AA3U, 0x748A09A0U, 0x67DAFA54U, 0x95B17957U,
+    0xCBA24573U, 0x39C9C670U, 0x2A993584U, 0xD8F2B687U, 0x0C38D26CU, 0xFE53516FU, 0xED03A29BU, 0x1F682198U,
+    0x5125DAD3U, 0xA34E59D0U, 0xB01EAA24U, 0x42752927U, 0x96BF4DCCU, 0x64D4CECFU, 0x77843D3BU, 0x85EFBE38U,
+    0xDBFC821CU, 0x2997011FU, 0x3AC7F2EBU, 0xC8AC71E8U, 0x1C661503U, 0xEE0D9600U, 0xFD5D65F4U, 0x0F36E6F7U,
+    0x61C69362U, 0x93AD1061U, 0x80FDE395U, 0x72966096U, 0xA65C047DU, 0x5437877EU, 0x4767748AU, 0xB50CF789U,
+    0xEB1FCBADU, 0x197448AEU, 0x0A24BB5AU, 0xF84F3859U, 0x2C855CB2U, 0xDEEEDFB1U, 0xCDBE2C45U, 0x3FD5AF46U,
+    0x7198540DU, 0x83F3D70EU, 0x90A324FAU, 0x62C8A7F9U, 0xB602C312U, 0x44694011U, 0x5739B3E5U, 0xA55230E6U,
+    0xFB410CC2U, 0x092A8FC1U, 0x1A7A7C35U, 0xE811FF36U, 0x3CDB9BDDU, 0xCEB018DEU, 0xDDE0EB2AU, 0x2F8B6829U,
+    0x82F63B78U, 0x709DB87BU, 0x63CD4B8FU, 0x91A6C88CU, 0x456CAC67U, 0xB7072F64U, 0xA457DC90U, 0x563C5F93U,
+    0x082F63B7U, 0xFA44E0B4U, 0xE9141340U, 0x1B7F9043U, 0xCFB5F4A8U, 0x3DDE77ABU, 0x2E8E845FU, 0xDCE5075CU,
+    0x92A8FC17U, 0x60C37F14U, 0x73938CE0U, 0x81F80FE3U, 0x55326B08U, 0xA759E80BU, 0xB4091BFFU, 0x466298FCU,
+    0x1871A4D8U, 0xEA1A27DBU, 0xF94AD42FU, 0x0B21572CU, 0xDFEB33C7U, 0x2D80B0C4U, 0x3ED04330U, 0xCCBBC033U,
+    0xA24BB5A6U, 0x502036A5U, 0x4370C551U, 0xB11B4652U, 0x65D122B9U, 0x97BAA1BAU, 0x84EA524EU, 0x7681D14DU,
+    0x2892ED69U, 0xDAF96E6AU, 0xC9A99D9EU, 0x3BC21E9DU, 0xEF087A76U, 0x1D63F975U, 0x0E330A81U, 0xFC588982U,
+    0xB21572C9U, 0x407EF1CAU, 0x532E023EU, 0xA145813DU, 0x758FE5D6U, 0x87E466D5U, 0x94B49521U, 0x66DF1622U,
+    0x38CC2A06U, 0xCAA7A905U, 0xD9F75AF1U, 0x2B9CD9F2U, 0xFF56BD19U, 0x0D3D3E1AU, 0x1E6DCDEEU, 0xEC064EEDU,
+    0xC38D26C4U, 0x31E6A5C7U, 0x22B65633U, 0xD0DDD530U, 0x0417B1DBU, 0xF67C32D8U, 0xE52CC12CU, 0x1747422FU,
+    0x49547E0BU, 0xBB3FFD08U, 0xA86F0EFCU, 0x5A048DFFU, 0x8ECEE914U, 0x7CA56A17U, 0x6FF599E3U, 0x9D9E1AE0U,
+    0xD3D3E1ABU, 0x21B862A8U, 0x32E8915CU, 0xC083125FU, 0x144976B4U, 0xE622F5B7U, 0xF5720643U, 0x07198540U,
+    0x590AB964U, 0xAB613A67U, 0xB831C993U, 0x4A5A4A90U, 0x9E902E7BU, 0x6CFBAD78U, 0x7FAB5E8CU, 0x8DC0DD8FU,
+    0xE330A81AU, 0x115B2B19U, 0x020BD8EDU, 0xF0605BEEU, 0x24AA3F05U, 0xD6C1BC06U, 0xC5914FF2U, 0x37FACCF1U,
+    0x69E9F0D5U, 0x9B8273D6U, 0x88D28022U, 0x7AB90321U, 0xAE7367CAU, 0x5C18E4C9U, 0x4F48173DU, 0xBD23943EU,
+    0xF36E6F75U, 0x0105EC76U, 0x12551F82U, 0xE03E9C81U, 0x34F4F86AU, 0xC69F7B69U, 0xD5CF889DU, 0x27A40B9EU,
+    0x79B737BAU, 0x8BDCB4B9U, 0x988C474DU, 0x6AE7C44EU, 0xBE2DA0A5U, 0x4C4623A6U, 0x5F16D052U, 0xAD7D5351U,
+};
+
+
+// Compute the CRC32C of an array of bytes. This is the same checksum as iSCSI, ext4, and the SSE4.2 crc32
+// instruction, which is used when available.
+unsigned int crc32c_bytes (
+    const unsigned char* pBytes,     // Pointer to bytes to check.
+    size_t               countBytes, // Number of bytes.
+    unsigned int         crc         // 0, or the result for the preceding bytes to continue a running checksum.
+    // Returns the CRC32C.
+){
+    crc = ~crc;
+#ifdef HASH_USE_SSE42
+    unsigned long long crc64 = crc;
+    for (; countBytes >= 8; countBytes -= 8, pBytes += 8) { crc64 = _mm_crc32_u64 (crc64, hash_read64 (pBytes)); }
+    crc = (unsigned int)crc64;
+    for (; countBytes > 0; --countBytes, ++pBytes) { crc = _mm_crc32_u8 (crc, *pBytes); }
+#else
+    for (; countBytes > 0; --countBytes, ++pBytes) { crc = CRC32C_TABLE[(crc ^ *pBytes) & 0xFF] ^ (crc >> 8); }
+#endif
+    return ~crc;
+}
+
+
+
+//***********************
+// Little-endian numbers
+//***********************
+
+// Read a little-endian 16-bit number
+unsigned int le_get16 (
+    const unsigned char* p // Pointer to 2 readable bytes
+){
+    return (unsigned int)p[0] | ((unsigned int)p[1] << 8);
+}
+
+// Read a little-endian 32-bit number
+unsigned int le_get32 (
+    const unsigned char* p // Pointer to 4 readable bytes
+){
+    return (unsigned int)p[0] | ((unsigned int)p[1] << 8) | ((unsigned int)p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+// Read a little-endian 64-bit number
+unsigned long long le_get64 (
+    const unsigned char* p // Pointer to 8 readable bytes
+){
+    return (unsigned long long)le_get32 (p) | ((unsigned long long)le_get32 (p + 4) << 32);
+}
+
+// Write a little-endian 32-bit number
+void le_put32 (
+    unsigned char* p,    // Pointer to 4 writable bytes
+    unsigned int   value // Value to write
+){
+    p[0] = (unsigned char)value; p[1] = (unsigned char)(value >> 8);
+    p[2] = (unsigned char)(value >> 16); p[3] = (unsigned char)(value >> 24);
+}
+
+// Write a little-endian 64-bit number
+void le_put64 (
+    unsigned char*     p,    // Pointer to 8 writable bytes
+    unsigned long long value // Value to write
+){
+    le_put32 (p, (unsigned int)value);
+    le_put32 (p + 4, (unsigned int)(value >> 32));
+}
@@ -0,0 +1,17 @@
+//*****************************************************************************
+// music2_hash.h.
+// Scope: Private to music2 program.
+// Bare-bones .h file to facilitate linking. See the .c file for descriptions.
+//*****************************************************************************
+
+#pragma once
+
+#include <stddef.h> // size_t
+
+unsigned long long hash_bytes (const unsigned char* pBytes, size_t countBytes, unsigned long long seed);
+unsigned int crc32c_bytes (const unsigned char* pBytes, size_t countBytes, unsigned int crc);
+unsigned int le_get16 (const unsigned char* p);
+unsigned int le_get32 (const unsigned char* p);
+unsigned long long le_get64 (const unsigned char* p);
+void le_put32 (unsigned char* p, unsigned int value);
+void le_put64 (unsigned char* p, unsigned long long value);
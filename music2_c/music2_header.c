@@ -0,0 +1,270 @@
+//*****************************************************************************************************
+// music2_header.c
+// This file contains an optional header for encoded files that describes what's in them. Without it, the
+// size of the rendered music and the number of noteblocks are only known after parsing the whole file,
+// so noteblocks_to_string over-allocates and a long parse can't report progress. A tool (option -hw)
+// parses the file once and writes the totals in front of the encoded bytes. Readers check the header
+// cheaply, without parsing or hashing, and then trust it:
+//   - The rendered string is allocated at its exact size - see noteblocks_to_string_sized, which still
+//     measures each staff before writing it.
+//   - The noteblock count drives progress reporting while parsing (--progress).
+//   - The content hash is only checked by option -hi. The render cache hashes the bytes itself, since an
+//     edit to the body after the header was written would otherwise find a stale render.
+// The header only goes in front of plain encoded bytes, not containers or compressed files.
+//*****************************************************************************************************
+
+
+// External inclusions
+#include <stddef.h> // NULL, size_t
+#include <stdio.h>  // printf, fopen_s, fwrite
+#include <stdlib.h> // malloc, free
+#include <string.h> // memcmp, memcpy
+
+// Internal inclusions
+#include "music2_general2.h"
+#include "music2_hash.h"
+#include "music2_noteblock.h"
+
+
+//*************
+// File format
+//*************
+
+// Header (40 bytes), followed by the plain encoded bytes through their terminator:
+//   Bytes 0-3:   HEADER_MAGIC
+//   Bytes 4-7:   HEADER_VERSION
+//   Bytes 8-15:  Size of the encoded bytes, including the terminator
+//   Bytes 16-19: Count of byte groups, not including the terminator
+//   Bytes 20-23: Count of noteblocks
+//   Bytes 24-27: Total rendered width - the sum of the noteblocks' top row widths
+//   Bytes 28-31: Total rendered characters - the sum of the widths of all the noteblocks' rows
+//   Bytes 32-39: hash_bytes of the encoded bytes, including the terminator
+#define HEADER_MAGIC   ("\x10M2H")
+#define HEADER_VERSION (1)
+#define HEADER_SIZE    (40)
+
+// Whether parsing a file with a header prints progress to stderr. Set by cmd line option --progress.
+int headerShowsProgress = 0;
+
+// Totals recorded in a header. Fill with header_read.
+struct file_header {
+    unsigned long long countBodyBytes;  // Size of the encoded bytes after the header, including the terminator.
+    unsigned int       countGroups;     // Count of byte groups.
+    unsigned int       countNoteblocks; // Count of noteblocks.
+    unsigned int       totalWidth;      // Sum of the noteblocks' top row widths.
+    unsigned int       totalChars;      // Sum of the widths of all the noteblocks' rows.
+    unsigned long long hash;            // hash_bytes of the encoded bytes after the header.
+};
+
+
+
+//*********
+// Reading
+//*********
+
+// Turn progress reporting on or off for files with headers.
+void header_set_progress (
+    int showsProgress // 1 to print progress while parsing, 0 not to.
+){
+    headerShowsProgress = showsProgress;
+}
+
+
+// Whether progress is printed while parsing files with headers.
+int header_shows_progress () {
+    return headerShowsProgress;
+}
+
+
+// Whether some bytes start with a header. No valid plain encoded bytes start with HEADER_MAGIC.
+int header_is_header (
+    const unsigned char* pBytes,    // Pointer to file bytes.
+    size_t               countBytes // Number of file bytes.
+){
+    return countBytes >= 4 && memcmp (pBytes, HEADER_MAGIC, 4) == 0;
+}
+
+
+// Read and check a header. The checks are cheap - nothing is parsed or hashed - so the totals are trusted as
+// long as they're possible for the number of encoded bytes.
+int header_read (
+    const unsigned char* pBytes,    // Pointer to file bytes, for which header_is_header is true.
+    size_t               countBytes, // Number of file bytes.
+    struct file_header*  pHeader    // Output param, set to the header's totals.
+    // Returns 1 if the header is usable, otherwise 0.
+){
+    if (countBytes < HEADER_SIZE + 1 || !header_is_header (pBytes, countBytes)) return 0;
+    if (le_get32 (pBytes + 4) != HEADER_VERSION) return 0;
+    pHeader->countBodyBytes = le_get64 (pBytes + 8);
+    pHeader->countGroups = le_get32 (pBytes + 16);
+    pHeader->countNoteblocks = le_get32 (pBytes + 20);
+    pHeader->totalWidth = le_get32 (pBytes + 24);
+    pHeader->totalChars = le_get32 (pBytes + 28);
+    pHeader->hash = le_get64 (pBytes + 32);
+
+    // The encoded bytes fill the rest of the file and end with the terminator. A byte group is 1-4 bytes, and
+    // a repeat byte group of 2 bytes can add up to 255 noteblocks.
+    if (pHeader->countBodyBytes != countBytes - HEADER_SIZE || pBytes[countBytes - 1] != 0) return 0;
+    if (pHeader->countGroups >= pHeader->countBodyBytes) return 0;
+    if (pHeader->countNoteblocks > 128ULL * pHeader->countBodyBytes) return 0;
+    if (pHeader->totalWidth > (unsigned long long)NOTEBLOCK_WIDTH * pHeader->countNoteblocks) return 0;
+    if (pHeader->totalChars > (unsigned long long)NOTEBLOCK_WIDTH * NOTEBLOCK_HEIGHT * pHeader->countNoteblocks) {
+        return 0;
+    }
+    return 1;
+}
+
+
+
+//*********
+// Writing
+//*********
+
+// Add up the rendered widths of a list of noteblocks.
+void header_measure_noteblocks (
+    struct noteblock* p1stNoteblock,    // First noteblock in list.
+    unsigned int*     pCountNoteblocks, // Output param, set to the count of noteblocks.
+    unsigned int*     pTotalWidth,      // Output param, set to the sum of their top row widths.
+    unsigned int*     pTotalChars       // Output param, set to the sum of the widths of all their rows.
+){
+    *pCountNoteblocks = 0; *pTotalWidth = 0; *pTotalChars = 0;
+    for (struct noteblock* pNoteblock = p1stNoteblock; pNoteblock != NULL; pNoteblock = pNoteblock->pNext) {
+        ++(*pCountNoteblocks);
+        for (int row = 0; row < NOTEBLOCK_HEIGHT; ++row) {
+            char* pRow = get_ptr_to_row_from_noteblock (pNoteblock, row);
+            unsigned int width = (pRow[0] != '\0') + (pRow[1] != '\0') + (pRow[2] != '\0') + (pRow[3] != '\0')
+                               + (pRow[4] != '\0');
+            *pTotalChars += width;
+            if (row == ROW_HI_B) { *pTotalWidth += width; }
+        }
+    }
+}
+
+
+// Parse plain encoded bytes and put a header in front of them.
+unsigned char* header_build (
+    const unsigned char* pBytes,       // Pointer to plain encoded bytes, or to a file with a header to refresh.
+                                       // There must be a 0 after them, as from read_file_bytes.
+    size_t               countBytes,   // Number of bytes.
+    size_t*              pOutSize,     // Output param, set to the size of the result in bytes.
+    int*                 pParseResult, // Output param, set to one of the PARSE_RESULTs.
+    int*                 pErrIndex     // Output param, set to the index of a parse error, otherwise to -1.
+    // Returns the header and encoded bytes (caller must free), or NULL on a parse error or if out of memory.
+){
+    // An existing header is replaced
+    size_t bodyStart = header_is_header (pBytes, countBytes) ? HEADER_SIZE : 0;
+    if (bodyStart > countBytes) {
+        *pParseResult = PARSE_RESULT_UNEXPECTED_TERMINATOR;
+        *pErrIndex = (int)countBytes;
+        return NULL;
+    }
+    const unsigned char* pBody = pBytes + bodyStart;
+
+    // Parse, so the totals are exactly what rendering would produce
+    struct noteblock* p1stNoteblock;
+    *pParseResult = parse_bytes_start_to_end (pBody, &p1stNoteblock, pErrIndex);
+    if (*pParseResult != PARSE_RESULT_PARSED_ALL) {
+        free_noteblocks (p1stNoteblock);
+        if (*pErrIndex >= 0) { *pErrIndex += (int)bodyStart; }
+        return NULL;
+    }
+    unsigned int countNoteblocks, totalWidth, totalChars;
+    header_measure_noteblocks (p1stNoteblock, &countNoteblocks, &totalWidth, &totalChars);
+    free_noteblocks (p1stNoteblock);
+    unsigned int countGroups = 0;
+    size_t index = 0;
+    for (int length; (length = scan_byte_group (pBody, countBytes - bodyStart, index)) > 0; index += length) {
+        ++countGroups;
+    }
+    size_t countBodyBytes = index + 1; // Through the terminator, which parsing found
+
+    unsigned char* pOut = malloc (HEADER_SIZE + countBodyBytes);
+    if (pOut == NULL) {
+        *pParseResult = PARSE_RESULT_INTERNAL_ERROR;
+        return NULL;
+    }
+    memcpy (pOut, HEADER_MAGIC, 4);
+    le_put32 (pOut + 4, HEADER_VERSION);
+    le_put64 (pOut + 8, countBodyBytes);
+    le_put32 (pOut + 16, countGroups);
+    le_put32 (pOut + 20, countNoteblocks);
+    le_put32 (pOut + 24, totalWidth);
+    le_put32 (pOut + 28, totalChars);
+    memcpy (pOut + HEADER_SIZE, pBody, countBodyBytes - 1);
+    pOut[HEADER_SIZE + countBodyBytes - 1] = 0;
+    le_put64 (pOut + 32, hash_bytes (pOut + HEADER_SIZE, countBodyBytes, 0));
+    *pOutSize = HEADER_SIZE + countBodyBytes;
+    return pOut;
+}
+
+
+
+//*****
+// IO
+//*****
+
+// Write a copy of a plain encoded file with a header, for cmd line option -hw.
+void try_write_header (
+    char* filepath,   // User-entered path of the plain encoded file, which may already have a header.
+    char* outFilepath // User-entered path of the file to write.
+){
+    size_t countBytes;
+    unsigned char* pBytes = read_large_file_bytes (filepath, &countBytes);
+    if (pBytes == NULL) return;
+    size_t outSize;
+    int parseResult, errIndex;
+    unsigned char* pOut = header_build (pBytes, countBytes, &outSize, &parseResult, &errIndex);
+    if (pOut == NULL) {
+        if (parseResult == PARSE_RESULT_PARSED_ALL || parseResult == PARSE_RESULT_INTERNAL_ERROR) {
+            printf ("  Memory allocation error\n");
+        }
+        else {
+            print_parse_error (parseResult, pBytes, errIndex);
+        }
+        free (pBytes);
+        return;
+    }
+    free (pBytes);
+
+    FILE* file;
+    errno_t fopenErr = fopen_s (&file, outFilepath, "wb");
+    if (fopenErr || file == NULL) {
+        printf ("  Unable to create file %s\n", outFilepath);
+    }
+    else {
+        size_t written = fwrite (pOut, 1, outSize, file);
+        fclose (file);
+        if (written != outSize) { printf ("  Unable to write file %s\n", outFilepath); }
+        else {
+            printf ("  Wrote %s: %u byte groups, %u noteblocks, rendered width %u\n",
+                outFilepath, le_get32 (pOut + 16), le_get32 (pOut + 20), le_get32 (pOut + 24));
+        }
+    }
+    free (pOut);
+}
+
+
+// Print a file's header, and check its hash, for cmd line option -hi.
+void try_show_header (
+    char* filepath // User-entered file path and name.
+){
+    int countBytes;
+    unsigned char* pBytes = read_file_bytes (filepath, &countBytes);
+    if (pBytes == NULL) return;
+    struct file_header header;
+    if (!header_is_header (pBytes, (size_t)countBytes)) {
+        printf ("  No header: %s\n", filepath);
+    }
+    else if (!header_read (pBytes, (size_t)countBytes, &header)) {
+        printf ("  Invalid header: %s\n", filepath);
+    }
+    else {
+        int isHashOk = hash_bytes (pBytes + HEADER_SIZE, (size_t)header.countBodyBytes, 0) == header.hash;
+        printf ("  Encoded bytes: %llu (%u byte groups)\n", header.countBodyBytes, header.countGroups);
+        printf ("  Noteblocks:    %u\n", header.countNoteblocks);
+        printf ("  Rendered:      width %u, %u characters, %u on one continuous staff with line breaks\n",
+            header.totalWidth, header.totalChars, header.totalChars + NOTEBLOCK_HEIGHT + 1);
+        printf ("  Hash:          %016llx (%s)\n", header.hash, isHashOk ? "matches" : "doesn't match - rewrite with -hw");
+    }
+    free (pBytes);
+}
@@ -0,0 +1,32 @@
+//*****************************************************************************
+// music2_header.h.
+// Scope: Private to music2 program.
+// Bare-bones .h file to facilitate linking. See the .c file for descriptions.
+//*****************************************************************************
+
+#pragma once
+
+#include <stddef.h> // size_t
+
+#include "music2_noteblock.h"
+
+#define HEADER_SIZE (40)
+
+struct file_header {
+    unsigned long long countBodyBytes;
+    unsigned int       countGroups;
+    unsigned int       countNoteblocks;
+    unsigned int       totalWidth;
+    unsigned int       totalChars;
+    unsigned long long hash;
+};
+void header_set_progress (int showsProgress);
+int header_shows_progress ();
+int header_is_header (const unsigned char* pBytes, size_t countBytes);
+int header_read (const unsigned char* pBytes, size_t countBytes, struct file_header* pHeader);
+void header_measure_noteblocks (struct noteblock* p1stNoteblock, unsigned int* pCountNoteblocks,
+    unsigned int* pTotalWidth, unsigned int* pTotalChars);
+unsigned char* header_build (const unsigned char* pBytes, size_t countBytes, size_t* pOutSize, int* pParseResult,
+    int* pErrIndex);
+void try_write_header (char* filepath, char* outFilepath);
+void try_show_header (char* filepath);
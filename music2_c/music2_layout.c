@@ -0,0 +1,220 @@
+//*****************************************************************************************************
+// music2_layout.c
+// This file contains a layout index for a parsed list of noteblocks: an array of the noteblocks plus the
+// cumulative widths of their top rows. With the index, the staff breaks for any max staff width come from
+// binary search rather than walking the list, so a parsed score can be rendered at many widths, or
+// rendered one range of staves at a time, in time proportional to the output.
+// Staff breaks match noteblocks_to_string: a staff holds as many noteblocks as fit in maxStaffWidth - 1
+// columns, measured on the top row.
+//*****************************************************************************************************
+
+
+// External inclusions
+#include <stddef.h> // NULL
+#include <stdlib.h> // malloc, free
+
+// Internal inclusions
+#include "music2_noteblock.h"
+
+
+//***********************
+// Layout index structure
+//***********************
+
+// Layout index of a list of noteblocks. Build with layout_index_build, free with layout_index_free.
+// The noteblocks themselves are not owned by the index and must outlive it.
+struct layout_index {
+    struct noteblock** ppNoteblocks; // Array of pointers to the noteblocks, in list order.
+    unsigned int*      pCumWidths;   // pCumWidths[i] is the total top-row width of noteblocks 0 to i-1.
+                                     // Has count + 1 entries, starting with 0.
+    unsigned int*      pCumChars;    // pCumChars[i] is the total count of characters in all rows of noteblocks
+                                     // 0 to i-1, used to size output strings exactly. Has count + 1 entries.
+    unsigned int       count;        // Number of noteblocks.
+};
+
+
+// Count the characters in a noteblock row that are printed (not '\0')
+unsigned int layout_row_width (
+    const char* pRow // Pointer to a 5-character noteblock row.
+    // Returns the number of printed characters (0-5).
+){
+    return (pRow[0] != '\0') + (pRow[1] != '\0') + (pRow[2] != '\0') + (pRow[3] != '\0') + (pRow[4] != '\0');
+}
+
+
+// Free the arrays in a layout index. Doesn't free the noteblocks.
+void layout_index_free (
+    struct layout_index* pIndex // Index to free. Its fields are set to NULL and 0.
+){
+    free (pIndex->ppNoteblocks); pIndex->ppNoteblocks = NULL;
+    free (pIndex->pCumWidths); pIndex->pCumWidths = NULL;
+    free (pIndex->pCumChars); pIndex->pCumChars = NULL;
+    pIndex->count = 0;
+}
+
+
+// Build a layout index of a list of noteblocks.
+int layout_index_build (
+    struct noteblock*    p1stNoteblock, // First noteblock in list.
+    struct layout_index* pIndex         // Output param, index to set. Free with layout_index_free.
+    // Returns 1 on success, 0 if out of memory or the list is empty.
+){
+    pIndex->count = count_noteblocks (p1stNoteblock);
+    pIndex->ppNoteblocks = malloc (pIndex->count * sizeof (struct noteblock*));
+    pIndex->pCumWidths = malloc ((pIndex->count + 1) * sizeof (unsigned int));
+    pIndex->pCumChars = malloc ((pIndex->count + 1) * sizeof (unsigned int));
+    if (pIndex->count == 0 || pIndex->ppNoteblocks == NULL || pIndex->pCumWidths == NULL || pIndex->pCumChars == NULL) {
+        layout_index_free (pIndex);
+        return 0;
+    }
+
+    pIndex->pCumWidths[0] = 0;
+    pIndex->pCumChars[0] = 0;
+    struct noteblock* pNoteblock = p1stNoteblock;
+    for (unsigned int i = 0; i < pIndex->count; ++i) {
+        pIndex->ppNoteblocks[i] = pNoteblock;
+        unsigned int countChars = 0;
+        for (int row = 0; row < NOTEBLOCK_HEIGHT; ++row) {
+            countChars += layout_row_width (get_ptr_to_row_from_noteblock (pNoteblock, row));
+        }
+        pIndex->pCumWidths[i + 1] =
+            pIndex->pCumWidths[i] + layout_row_width (get_ptr_to_row_from_noteblock (pNoteblock, ROW_HI_B));
+        pIndex->pCumChars[i + 1] = pIndex->pCumChars[i] + countChars;
+        pNoteblock = pNoteblock->pNext;
+    }
+    return 1;
+}
+
+
+
+//*************
+// Staff breaks
+//*************
+
+// Find where a staff ends, by binary search on cumulative widths.
+unsigned int layout_staff_end (
+    const struct layout_index* pIndex,       // Layout index.
+    unsigned int               staffStart,   // Index of first noteblock in the staff.
+    int                        maxStaffWidth // Max width of a staff in characters.
+    // Returns index of the first noteblock of the next staff, or pIndex->count if this is the last staff.
+    // At least one noteblock is always placed in a staff, even if it is wider than maxStaffWidth - 1.
+){
+    // Find the last e with pCumWidths[e] - pCumWidths[staffStart] < maxStaffWidth, searching (staffStart, count]
+    unsigned int limit = pIndex->pCumWidths[staffStart] + (unsigned int)maxStaffWidth;
+    unsigned int lo = staffStart + 1, hi = pIndex->count + 1; // Answer is in [lo - 1, hi - 1]
+    while (lo < hi) {
+        unsigned int mid = lo + ((hi - lo) / 2);
+        if (pIndex->pCumWidths[mid] < limit) { lo = mid + 1; }
+        else                                 { hi = mid; }
+    }
+    unsigned int staffEnd = lo - 1;
+    return (staffEnd > staffStart) ? staffEnd : staffStart + 1;
+}
+
+
+// Count the staves a layout index produces at some width.
+unsigned int layout_count_staves (
+    const struct layout_index* pIndex,       // Layout index.
+    int                        maxStaffWidth // Max width of a staff in characters.
+    // Returns the number of staves.
+){
+    unsigned int countStaves = 0;
+    for (unsigned int start = 0; start < pIndex->count; start = layout_staff_end (pIndex, start, maxStaffWidth)) {
+        ++countStaves;
+    }
+    return countStaves;
+}
+
+
+
+//***********
+// Rendering
+//***********
+
+// Append one staff (16 rows plus a separator row) to a string.
+void layout_append_staff (
+    const struct layout_index* pIndex,     // Layout index.
+    unsigned int               staffStart, // Index of first noteblock in the staff.
+    unsigned int               staffEnd,   // Index of first noteblock after the staff.
+    char*                      str,        // Partially populated character array, in which to append.
+    unsigned int*              pIdxInStr   // Pointer to next index in str. Increased when function called.
+){
+    char* pOut = str + *pIdxInStr;
+    for (int row = NOTEBLOCK_HEIGHT - 1; row >= 0; --row) {
+        for (unsigned int i = staffStart; i < staffEnd; ++i) {
+            const char* pRow = get_ptr_to_row_from_noteblock (pIndex->ppNoteblocks[i], row);
+            if (pRow[0] != '\0') { *pOut = pRow[0]; ++pOut; }
+            if (pRow[1] != '\0') { *pOut = pRow[1]; ++pOut; }
+            if (pRow[2] != '\0') { *pOut = pRow[2]; ++pOut; }
+            if (pRow[3] != '\0') { *pOut = pRow[3]; ++pOut; }
+            if (pRow[4] != '\0') { *pOut = pRow[4]; ++pOut; }
+        }
+        *pOut = '\n'; ++pOut;
+    }
+    *pOut = '\n'; ++pOut; // Separate staves
+    *pIdxInStr = (unsigned int)(pOut - str);
+}
+
+
+// Render a range of staves at some width. Rendering all staves gives the same string as noteblocks_to_string.
+char* layout_render_staves (
+    const struct layout_index* pIndex,        // Layout index.
+    int                        maxStaffWidth, // Max width of a staff in characters. Should be no less than
+                               // NOTEBLOCK_WIDTH.
+    unsigned int               firstStaff,    // Index (from 0) of first staff to render.
+    unsigned int               lastStaff      // Index of last staff to render. May be past the last staff.
+    // Returns the rendered staves (caller must free), or NULL if out of memory, the range is empty, or
+    // maxStaffWidth is too small.
+){
+    if (pIndex->count == 0 || maxStaffWidth < NOTEBLOCK_WIDTH || lastStaff < firstStaff) { return NULL; }
+
+    // Skip to first staff. Each break is one binary search.
+    unsigned int start = 0;
+    for (unsigned int staff = 0; staff < firstStaff && start < pIndex->count; ++staff) {
+        start = layout_staff_end (pIndex, start, maxStaffWidth);
+    }
+    if (start >= pIndex->count) { return NULL; }
+
+    // Find the noteblock range and the exact size of the output
+    unsigned int end = start;
+    unsigned int countStaves = 0;
+    for (unsigned int staff = firstStaff; staff <= lastStaff && end < pIndex->count; ++staff) {
+        end = layout_staff_end (pIndex, end, maxStaffWidth);
+        ++countStaves;
+    }
+    unsigned int countChars = (pIndex->pCumChars[end] - pIndex->pCumChars[start])
+        + ((NOTEBLOCK_HEIGHT + 1) * countStaves) // '\n' at end of each row, plus separator row after each staff
+        + 1; // '\0' at end of string
+    char* str = malloc (countChars);
+    if (str == NULL) { return NULL; }
+
+    // Render
+    unsigned int idxInStr = 0;
+    while (start < end) {
+        unsigned int staffEnd = layout_staff_end (pIndex, start, maxStaffWidth);
+        layout_append_staff (pIndex, start, staffEnd, str, &idxInStr);
+        start = staffEnd;
+    }
+    str[idxInStr] = '\0';
+    return str;
+}
+
+
+// Render a parsed score at every width in a range, without re-parsing or re-indexing.
+int layout_render_widths (
+    const struct layout_index* pIndex,   // Layout index.
+    int                        minWidth, // First width to render. Should be no less than NOTEBLOCK_WIDTH.
+    int                        maxWidth, // Last width to render.
+    int (*pCallback) (void* pContext, int maxStaffWidth, char* str),
+                               // Called once per width with the rendered string, which the callback must free.
+                               // Return 0 from the callback to stop early.
+    void*                      pContext  // Passed through to *pCallback.
+    // Returns 1 if every width was rendered and passed to the callback, otherwise 0.
+){
+    for (int width = minWidth; width <= maxWidth; ++width) {
+        char* str = layout_render_staves (pIndex, width, 0, pIndex->count);
+        if (str == NULL) { return 0; }
+        if (!pCallback (pContext, width, str)) { return 0; }
+    }
+    return 1;
+}
@@ -0,0 +1,24 @@
+//*****************************************************************************
+// music2_layout.h.
+// Scope: Private to music2 program.
+// Bare-bones .h file to facilitate linking. See the .c file for descriptions.
+//*****************************************************************************
+
+#pragma once
+
+#include "music2_noteblock.h"
+
+struct layout_index {
+    struct noteblock** ppNoteblocks;
+    unsigned int*      pCumWidths;
+    unsigned int*      pCumChars;
+    unsigned int       count;
+};
+void layout_index_free (struct layout_index* pIndex);
+int layout_index_build (struct noteblock* p1stNoteblock, struct layout_index* pIndex);
+unsigned int layout_staff_end (const struct layout_index* pIndex, unsigned int staffStart, int maxStaffWidth);
+unsigned int layout_count_staves (const struct layout_index* pIndex, int maxStaffWidth);
+char* layout_render_staves (const struct layout_index* pIndex, int maxStaffWidth, unsigned int firstStaff,
+    unsigned int lastStaff);
+int layout_render_widths (const struct layout_index* pIndex, int minWidth, int maxWidth,
+    int (*pCallback) (void* pContext, int maxStaffWidth, char* str), void* pContext);
@@ -0,0 +1,198 @@
+//*****************************************************************************************************
+// music2_memo.c
+// This file contains an in-memory memo of parsed measures. The same measure tends to come up again and
+// again, within a score and across the songs of a catalog, and parsing a measure only depends on its
+// bytes and the parseInfo coming into it. So parse_bytes_from splits the bytes at barlines, looks up
+// each measure's bytes and incoming parseInfo here, and on a hit copies the noteblocks drawn last time
+// instead of drawing them again.
+//   - A measure is the byte groups up to and including a barline, plus dynamics text on that barline.
+//     Measures with repeat byte groups, which depend on earlier noteblocks, are never memoized.
+//   - Entries hold a copy of the measure's bytes, so a hash collision can't change the output.
+//   - The memo is a fixed number of slots, each holding the latest measure that hashed to it.
+//   - The memo is off unless turned on with --memo. Its slots are shared by the whole process and not
+//     locked, so while it's on, parse_bytes_from is for the main thread only; threaded benchmarks turn it
+//     off, and parallel container decoding doesn't use it. With it off, parsing keeps no state between calls.
+//*****************************************************************************************************
+
+
+// External inclusions
+#include <stddef.h> // NULL
+#include <stdlib.h> // malloc, free
+#include <string.h> // memcmp, memcpy
+
+// Internal inclusions
+#include "music2_general2.h"
+#include "music2_hash.h"
+#include "music2_noteblock.h"
+
+
+//***********
+// Constants
+//***********
+
+// Number of memo slots. Must be a power of 2.
+#define MEMO_SLOT_COUNT (1024)
+
+// Longest measure, in bytes, that is memoized. Longer ones are parsed as usual.
+#define MEMO_MEASURE_BYTES_MAX (64)
+
+
+
+//*******
+// State
+//*******
+
+// A memoized measure. Allocated as one block, with the arrays following the struct.
+struct memo_entry {
+    unsigned long long hash;             // hash_bytes of the measure's bytes, seeded with parseInfoIn.
+    unsigned int       parseInfoIn;      // parseInfo before the measure.
+    unsigned int       parseInfoOut;     // parseInfo after the measure.
+    unsigned int       countBytes;       // Bytes in the measure.
+    unsigned int       countNoteblocks;  // Noteblocks the measure draws.
+    unsigned char*     pBytes;           // The measure's bytes.
+    struct noteblock*  pNoteblocks;      // Copies of the noteblocks, as drawn. pNext is unused.
+    unsigned char*     pTypes;           // BYTE_GROUP_TYPE that created each noteblock, for the parse history.
+    unsigned int*      pParseInfos;      // parseInfo after each noteblock, for the parse history.
+};
+
+// Counters for the current process. Returned by memo_get_stats.
+struct memo_stats {
+    unsigned long long lookups;    // Measures looked up.
+    unsigned long long hits;       // Lookups that found the measure.
+    unsigned long long noteblocks; // Noteblocks copied on hits rather than drawn.
+    unsigned long long stores;     // Measures added.
+    unsigned long long replaced;   // Measures dropped to make room for another in the same slot.
+};
+
+// Whether the memo is used.
+int memoIsEnabled = 0;
+
+// Memo slots, each NULL or an entry.
+struct memo_entry* memoSlots[MEMO_SLOT_COUNT] = { NULL };
+
+// Counters for the current process.
+struct memo_stats memoStats = { 0 };
+
+
+
+//*************************
+// Configuration and stats
+//*************************
+
+// Turn the memo on or off for the rest of the process. Turning it off frees the entries.
+void memo_set_enabled (
+    int isEnabled // 1 to use the memo, 0 not to.
+){
+    memoIsEnabled = isEnabled;
+    if (isEnabled) return;
+    for (int slot = 0; slot < MEMO_SLOT_COUNT; ++slot) {
+        free (memoSlots[slot]);
+        memoSlots[slot] = NULL;
+    }
+}
+
+
+// Whether the memo is used.
+int memo_is_enabled () {
+    return memoIsEnabled;
+}
+
+
+// Get the counters for the current process.
+struct memo_stats memo_get_stats () {
+    return memoStats;
+}
+
+
+
+//*********************
+// Lookup and storage
+//*********************
+
+// Find the length of the measure starting at some index.
+int memo_measure_length (
+    const unsigned char* pBytes, // Pointer to array of bytes (0-terminated).
+    int                  index   // Index of the measure's first byte group.
+    // Returns the measure's length in bytes, or 0 if the measure can't be memoized because it's too long, has
+    // an invalid or repeat byte group, or starts with dynamics text.
+){
+    int length = 0;
+    int isBarlineDone = 0;
+    while (1) {
+        int byteGroupType = byte_group_type (pBytes[index + length]);
+        if (byteGroupType == BYTE_GROUP_TYPE_TERMINATOR) break;
+        if (isBarlineDone && byteGroupType != BYTE_GROUP_TYPE_DYN_TEXT) break;
+        if (length == 0 && byteGroupType == BYTE_GROUP_TYPE_DYN_TEXT) return 0;
+        int groupLength = byte_group_length (byteGroupType);
+        if (groupLength == 0 || byteGroupType == BYTE_GROUP_TYPE_REPEAT) return 0;
+        if (length + groupLength > MEMO_MEASURE_BYTES_MAX) return 0;
+        for (int i = 1; i < groupLength; ++i) {
+            if (pBytes[index + length + i] == 0) return 0;
+        }
+        length += groupLength;
+        if (isBarlineDone) break; // Dynamics text on the barline
+        if (byteGroupType == BYTE_GROUP_TYPE_BARLINE) { isBarlineDone = 1; }
+    }
+    return length;
+}
+
+
+// Look for a measure parsed earlier with the same bytes and incoming parseInfo.
+const struct memo_entry* memo_lookup (
+    const unsigned char* pBytes,     // Pointer to the measure's bytes.
+    int                  countBytes, // Bytes in the measure, from memo_measure_length.
+    unsigned int         parseInfo   // parseInfo before the measure.
+    // Returns the entry, which stays valid until the next memo_store, or NULL on a miss.
+){
+    if (!memoIsEnabled) return NULL;
+    ++memoStats.lookups;
+    unsigned long long hash = hash_bytes (pBytes, (size_t)countBytes, parseInfo);
+    const struct memo_entry* pEntry = memoSlots[hash & (MEMO_SLOT_COUNT - 1)];
+    if (pEntry == NULL || pEntry->hash != hash || pEntry->parseInfoIn != parseInfo
+        || pEntry->countBytes != (unsigned int)countBytes || memcmp (pEntry->pBytes, pBytes, countBytes) != 0) {
+        return NULL;
+    }
+    ++memoStats.hits;
+    memoStats.noteblocks += pEntry->countNoteblocks;
+    return pEntry;
+}
+
+
+// Add a measure that was just parsed. Its noteblocks are the most recent ones in the parse history.
+void memo_store (
+    const unsigned char*        pBytes,          // Pointer to the measure's bytes.
+    int                         countBytes,      // Bytes in the measure, from memo_measure_length.
+    unsigned int                parseInfoIn,     // parseInfo before the measure.
+    unsigned int                parseInfoOut,    // parseInfo after the measure.
+    unsigned int                countNoteblocks, // Noteblocks the measure drew.
+    const struct parse_history* pHistory         // History with those noteblocks at the end.
+){
+    if (!memoIsEnabled || countNoteblocks > (unsigned int)countBytes || countNoteblocks > pHistory->count) return;
+    size_t size = sizeof (struct memo_entry) + (countNoteblocks * sizeof (struct noteblock))
+                + (countNoteblocks * sizeof (unsigned int)) + countNoteblocks + (size_t)countBytes;
+    struct memo_entry* pEntry = malloc (size);
+    if (pEntry == NULL) return;
+    pEntry->hash = hash_bytes (pBytes, (size_t)countBytes, parseInfoIn);
+    pEntry->parseInfoIn = parseInfoIn;
+    pEntry->parseInfoOut = parseInfoOut;
+    pEntry->countBytes = (unsigned int)countBytes;
+    pEntry->countNoteblocks = countNoteblocks;
+    pEntry->pNoteblocks = (struct noteblock*)(pEntry + 1);
+    pEntry->pParseInfos = (unsigned int*)(pEntry->pNoteblocks + countNoteblocks);
+    pEntry->pTypes = (unsigned char*)(pEntry->pParseInfos + countNoteblocks);
+    pEntry->pBytes = pEntry->pTypes + countNoteblocks;
+    memcpy (pEntry->pBytes, pBytes, countBytes);
+    for (unsigned int i = 0; i < countNoteblocks; ++i) {
+        unsigned int slot = (pHistory->count - countNoteblocks + i) % PARSE_HISTORY_SIZE;
+        pEntry->pNoteblocks[i] = *(pHistory->pNoteblocks[slot]);
+        pEntry->pNoteblocks[i].pNext = NULL;
+        pEntry->pParseInfos[i] = pHistory->parseInfos[slot];
+        pEntry->pTypes[i] = pHistory->types[slot];
+    }
+
+    struct memo_entry** ppSlot = &(memoSlots[pEntry->hash & (MEMO_SLOT_COUNT - 1)]);
+    if (*ppSlot != NULL) { ++memoStats.replaced; }
+    free (*ppSlot);
+    *ppSlot = pEntry;
+    ++memoStats.stores;
+}
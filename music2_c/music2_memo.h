@@ -0,0 +1,37 @@
+//*****************************************************************************
+// music2_memo.h.
+// Scope: Private to music2 program.
+// Bare-bones .h file to facilitate linking. See the .c file for descriptions.
+//*****************************************************************************
+
+#pragma once
+
+#include "music2_noteblock.h"
+
+struct parse_history;
+
+struct memo_entry {
+    unsigned long long hash;
+    unsigned int       parseInfoIn;
+    unsigned int       parseInfoOut;
+    unsigned int       countBytes;
+    unsigned int       countNoteblocks;
+    unsigned char*     pBytes;
+    struct noteblock*  pNoteblocks;
+    unsigned char*     pTypes;
+    unsigned int*      pParseInfos;
+};
+struct memo_stats {
+    unsigned long long lookups;
+    unsigned long long hits;
+    unsigned long long noteblocks;
+    unsigned long long stores;
+    unsigned long long replaced;
+};
+void memo_set_enabled (int isEnabled);
+int memo_is_enabled ();
+struct memo_stats memo_get_stats ();
+int memo_measure_length (const unsigned char* pBytes, int index);
+const struct memo_entry* memo_lookup (const unsigned char* pBytes, int countBytes, unsigned int parseInfo);
+void memo_store (const unsigned char* pBytes, int countBytes, unsigned int parseInfoIn, unsigned int parseInfoOut,
+    unsigned int countNoteblocks, const struct parse_history* pHistory);
@@ -0,0 +1,263 @@
+//*****************************************************************************************************
+// music2_meter.c
+// This file contains a measure duration checker, and the cmd line option -mc that runs it on files and
+// archives. It finds measures whose notes and rests don't add up to the time signature, from the events of
+// events_decode, so nothing is drawn and a whole archive can be checked quickly.
+//   - A measure ends at any barline other than a blank column, or at the end of the music. Measures with no
+//     notes or rests, such as between two barlines in a row, aren't counted.
+//   - Durations add up in 64ths of a whole note. A dot adds half again. Beamed notes get their duration from
+//     their beams: 1 for an eighth, 2 for a sixteenth, 3 for a thirty-second, and none for a quarter.
+//   - A time signature applies to the measure it's in and those after it. Measures before the first time
+//     signature aren't checked.
+//   - Ties don't change durations, and pickup measures aren't treated specially, so they're reported too.
+//*****************************************************************************************************
+
+
+// External inclusions
+#include <stddef.h> // NULL, size_t
+#include <stdio.h>  // printf
+#include <stdlib.h> // free
+#include <string.h> // strlen
+
+// Internal inclusions
+#include "music2_archive.h"
+#include "music2_container.h"
+#include "music2_draw_note.h"
+#include "music2_events.h"
+#include "music2_general2.h"
+#include "music2_header.h"
+#include "music2_rans.h"
+
+
+//***********
+// Constants
+//***********
+
+// Units durations add up in, per whole note. A dotted thirty-second note is 3 of them.
+#define METER_UNITS_PER_WHOLE (64)
+
+// Barline type of a blank column, which is spacing rather than a barline
+#define METER_BARLINE_BLANK (0b0101)
+
+// Barline types 10-15 are invalid, and printed as an error
+#define METER_BARLINE_TYPE_COUNT (10)
+
+
+
+//*******
+// State
+//*******
+
+// The measure being added up, and counts so far, for one song. Set up with meter_init.
+struct meter_state {
+    const char*  name;            // Name of the song, for reports. Need not be 0-terminated.
+    int          nameLen;         // Length of the name.
+    size_t       bodyStart;       // Index of the encoded bytes in the file, for reported locations.
+    unsigned int timeTop;         // Time signature top number, or 0 before the first time signature.
+    unsigned int timeBottom;      // Time signature bottom number.
+    unsigned int units;           // Duration of the notes and rests so far in the measure, in units.
+    unsigned int countNotes;      // Notes and rests so far in the measure.
+    int          isInvalid;       // 1 if a note or rest in the measure has an invalid duration.
+    int          isRepeat;        // 1 if a repeat byte group copied any of the measure.
+    unsigned int firstIndex;      // Index of the measure's first note or rest.
+    unsigned int measure;         // Measures with notes or rests so far, counting the current one if it has any.
+    unsigned int countChecked;    // Measures checked against a time signature.
+    unsigned int countMismatched; // Measures reported.
+};
+
+
+// Set up to check one song.
+void meter_init (
+    struct meter_state* pState,    // State to set up.
+    const char*         name,      // Name of the song, for reports. Need not be 0-terminated.
+    int                 nameLen,   // Length of the name.
+    size_t              bodyStart  // Index of the encoded bytes in the file, for reported locations.
+){
+    pState->name = name;
+    pState->nameLen = nameLen;
+    pState->bodyStart = bodyStart;
+    pState->timeTop = 0;
+    pState->timeBottom = 0;
+    pState->units = 0;
+    pState->countNotes = 0;
+    pState->isInvalid = 0;
+    pState->isRepeat = 0;
+    pState->firstIndex = 0;
+    pState->measure = 0;
+    pState->countChecked = 0;
+    pState->countMismatched = 0;
+}
+
+
+
+//**********
+// Checking
+//**********
+
+// Get the duration of a note or rest.
+unsigned int meter_duration (
+    const struct music_event* pEvent // Event of type EVENT_TYPE_NOTE, EVENT_TYPE_REST, or EVENT_TYPE_BEAMED.
+    // Returns the duration in units, or 0 if it's invalid.
+){
+    unsigned int units;
+    if (pEvent->type == EVENT_TYPE_BEAMED) {
+        int beams = (pEvent->beamsLeft > pEvent->beamsRight) ? pEvent->beamsLeft : pEvent->beamsRight;
+        units = (METER_UNITS_PER_WHOLE / 4) >> beams;
+    }
+    else if (pEvent->duration < nn_DUR_BREVE || pEvent->duration > nn_DUR_SIXTEENTH) {
+        return 0;
+    }
+    else {
+        units = (METER_UNITS_PER_WHOLE * 2) >> (pEvent->duration - nn_DUR_BREVE);
+    }
+    return pEvent->isDotted ? units + (units / 2) : units;
+}
+
+
+// Check the measure that just ended against the time signature, and start the next.
+void meter_end_measure (
+    struct meter_state* pState,   // State of the song.
+    long long           endIndex  // Index of the barline that ended the measure, or -1 at the end of the music.
+){
+    if (pState->countNotes > 0 && pState->timeTop > 0) {
+        unsigned int expected = pState->timeTop * (METER_UNITS_PER_WHOLE / pState->timeBottom);
+        ++(pState->countChecked);
+        if (pState->isInvalid || pState->units != expected) {
+            ++(pState->countMismatched);
+            printf ("  %.*s: measure %u, location #%llu to ", pState->nameLen, pState->name, pState->measure,
+                (unsigned long long)(pState->bodyStart + pState->firstIndex));
+            if (endIndex < 0) { printf ("the end"); }
+            else              { printf ("#%llu", (unsigned long long)(pState->bodyStart + endIndex)); }
+            if (pState->isInvalid) { printf (", has a note or rest with an invalid duration"); }
+            else {
+                double length = (double)pState->units * pState->timeBottom / METER_UNITS_PER_WHOLE;
+                printf (", is %g/%u long in %u/%u time", length, pState->timeBottom, pState->timeTop,
+                    pState->timeBottom);
+            }
+            printf ("%s\n", pState->isRepeat ? " (copied by a repeat)" : "");
+        }
+    }
+    pState->units = 0;
+    pState->countNotes = 0;
+    pState->isInvalid = 0;
+    pState->isRepeat = 0;
+}
+
+
+// events_decode callback that adds up measures and reports those that don't match the time signature
+void meter_event (void* pContext, const struct music_event* pEvent) {
+    struct meter_state* pState = pContext;
+    switch (pEvent->type) {
+        case EVENT_TYPE_TIME:
+            pState->timeTop = pEvent->timeTop;
+            pState->timeBottom = pEvent->timeBottom;
+            break;
+        case EVENT_TYPE_NOTE:
+        case EVENT_TYPE_REST:
+        case EVENT_TYPE_BEAMED: {
+            unsigned int units = meter_duration (pEvent);
+            if (pState->countNotes == 0) {
+                ++(pState->measure);
+                pState->firstIndex = pEvent->byteIndex;
+            }
+            ++(pState->countNotes);
+            pState->units += units;
+            pState->isInvalid |= (units == 0);
+            pState->isRepeat |= pEvent->isRepeat;
+            break;
+        }
+        case EVENT_TYPE_BARLINE:
+            if (pEvent->barline == METER_BARLINE_BLANK || pEvent->barline >= METER_BARLINE_TYPE_COUNT) break;
+            pState->isRepeat |= pEvent->isRepeat && pState->countNotes > 0;
+            meter_end_measure (pState, pEvent->byteIndex);
+            break;
+    }
+}
+
+
+// Check the measures of one song, printing a line for each that doesn't match its time signature.
+int meter_check_bytes (
+    const unsigned char* pBytes,        // Pointer to the file bytes, ending with a terminator or followed by a 0.
+    size_t               countBytes,    // Number of file bytes.
+    const char*          name,          // Name of the song, for reports. Need not be 0-terminated.
+    int                  nameLen,       // Length of the name.
+    unsigned int*        pCountChecked  // Output param, set to the number of measures checked.
+    // Returns the number of measures reported, or -1 if the song couldn't be checked to the end.
+){
+    *pCountChecked = 0;
+    if (container_is_container (pBytes, countBytes) || rans_is_compressed (pBytes, countBytes)) {
+        printf ("  %.*s: containers and compressed files can't be checked\n", nameLen, name);
+        return -1;
+    }
+    size_t bodyStart = header_is_header (pBytes, countBytes) ? HEADER_SIZE : 0;
+    struct meter_state state;
+    meter_init (&state, name, nameLen, bodyStart);
+    int errIndex;
+    int parseResult = events_decode (pBytes + bodyStart, countBytes - bodyStart, meter_event, &state, &errIndex);
+    *pCountChecked = state.countChecked;
+    if (parseResult != PARSE_RESULT_PARSED_ALL) {
+        // Measures up to the error are still checked, but the one it's in isn't
+        printf ("  %.*s: checked up to an error\n", nameLen, name);
+        print_parse_error (parseResult, pBytes, (int)bodyStart + errIndex);
+        return -1;
+    }
+    meter_end_measure (&state, -1);
+    *pCountChecked = state.countChecked;
+    return (int)state.countMismatched;
+}
+
+
+
+//*****
+// IO
+//*****
+
+// Check the measures of files and archives against their time signatures, for cmd line option -mc.
+int try_check_measures (
+    int    countPaths, // Number of paths.
+    char** paths       // User-entered paths of files and archives. Every song in an archive is checked.
+    // Returns exit status 0 if every measure matches, or 1 if any don't or anything couldn't be checked.
+){
+    unsigned long long countSongs = 0, countChecked = 0, countMismatched = 0, countFailed = 0;
+    for (int i = 0; i < countPaths; ++i) {
+        struct archive archive;
+        unsigned int checked;
+        int mismatched;
+        if (archive_open (paths[i], &archive)) {
+            for (unsigned int song = 0; song < archive.countSongs; ++song) {
+                size_t nameLen, countBytes;
+                const char* name = archive_song_name (&archive, song, &nameLen);
+                const unsigned char* pBytes = archive_song_bytes (&archive, song, &countBytes);
+                ++countSongs;
+                if (name == NULL || pBytes == NULL) {
+                    printf ("  %s: corrupt directory entry #%u\n", paths[i], song);
+                    ++countFailed;
+                    continue;
+                }
+                mismatched = meter_check_bytes (pBytes, countBytes, name, (int)nameLen, &checked);
+                countChecked += checked;
+                if (mismatched < 0) { ++countFailed; }
+                else                { countMismatched += mismatched; }
+            }
+            archive_close (&archive);
+            continue;
+        }
+        size_t countBytes;
+        unsigned char* pBytes = read_large_file_bytes (paths[i], &countBytes);
+        ++countSongs;
+        if (pBytes == NULL) {
+            ++countFailed;
+            continue;
+        }
+        mismatched = meter_check_bytes (pBytes, countBytes, paths[i], (int)strlen (paths[i]), &checked);
+        countChecked += checked;
+        if (mismatched < 0) { ++countFailed; }
+        else                { countMismatched += mismatched; }
+        free (pBytes);
+    }
+    printf ("  %llu measures checked in %llu songs: %llu don't match their time signature", countChecked,
+        countSongs, countMismatched);
+    if (countFailed > 0) { printf (", and %llu songs couldn't be checked to the end", countFailed); }
+    printf ("\n");
+    return (countMismatched > 0 || countFailed > 0) ? 1 : 0;
+}
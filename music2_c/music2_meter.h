@@ -0,0 +1,13 @@
+//*****************************************************************************
+// music2_meter.h.
+// Scope: Private to music2 program.
+// Bare-bones .h file to facilitate linking. See the .c file for descriptions.
+//*****************************************************************************
+
+#pragma once
+
+#include <stddef.h> // size_t
+
+int meter_check_bytes (const unsigned char* pBytes, size_t countBytes, const char* name, int nameLen,
+    unsigned int* pCountChecked);
+int try_check_measures (int countPaths, char** paths);
@@ -0,0 +1,542 @@
+//*****************************************************************************************************
+// music2_platform.c
+// This file contains the few operating system services the program needs beyond the C standard library,
+// such as listing a directory or replacing a file atomically. Each function has a Windows implementation
+// and a POSIX implementation; the rest of the program calls only these functions. Performance counters are
+// only implemented on Linux; elsewhere none open.
+//*****************************************************************************************************
+
+
+// External inclusions
+#include <stddef.h> // NULL
+#include <stdio.h>  // remove, rename, snprintf
+#include <string.h> // strlen, memset
+
+#ifdef _WIN32
+#include <windows.h> // MoveFileExA, FindFirstFileA, GetFileAttributesExA, SetFileTime, CreateThread,
+                     // QueryPerformanceCounter, InterlockedIncrement
+#include <psapi.h>   // GetProcessMemoryInfo
+#else
+#include <dirent.h>       // opendir, readdir
+#include <fcntl.h>        // open
+#include <pthread.h>      // pthread_create, pthread_join
+#include <sys/mman.h>     // mmap, munmap
+#include <sys/resource.h> // getrusage
+#include <sys/stat.h>     // stat, fstat, mkdir
+#include <time.h>         // clock_gettime
+#include <unistd.h>       // getpid, close, sysconf
+#include <utime.h>        // utime
+#endif
+#ifdef __linux__
+#include <linux/perf_event.h> // perf_event_attr, PERF_COUNT_HW_CPU_CYCLES
+#include <sys/ioctl.h>        // ioctl
+#include <sys/syscall.h>      // SYS_perf_event_open
+#endif
+
+
+//*******
+// Files
+//*******
+
+// Rename a file, replacing the destination if it exists. Readers never see a partially written destination:
+// either the old file or the complete new file.
+int platform_rename_replace (
+    const char* fromPath, // Path of existing file, typically a completely written temporary file.
+    const char* toPath    // Path to rename to. Replaced if it exists.
+    // Returns 1 on success, otherwise 0.
+){
+#ifdef _WIN32
+    return MoveFileExA (fromPath, toPath, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    return rename (fromPath, toPath) == 0; // POSIX rename atomically replaces the destination
+#endif
+}
+
+
+// Set a file's last-modified time to now. The render cache uses this to record recent use.
+void platform_touch_file (
+    const char* path // Path of existing file.
+){
+#ifdef _WIN32
+    HANDLE file = CreateFileA (path, FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) return;
+    FILETIME now;
+    GetSystemTimeAsFileTime (&now);
+    SetFileTime (file, NULL, NULL, &now);
+    CloseHandle (file);
+#else
+    utime (path, NULL); // NULL sets access and modification times to now
+#endif
+}
+
+
+// Get a file's last-modified time.
+long long platform_file_modified_time (
+    const char* path // Path of existing file.
+    // Returns the time in seconds, which is only meaningful compared with others from this function or
+    // platform_list_dir, or -1 if the file can't be found.
+){
+#ifdef _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!GetFileAttributesExA (path, GetFileExInfoStandard, &data)) return -1;
+    return (long long)((((unsigned long long)data.ftLastWriteTime.dwHighDateTime << 32)
+        | data.ftLastWriteTime.dwLowDateTime) / 10000000); // 100ns units to seconds
+#else
+    struct stat st;
+    if (stat (path, &st) != 0) return -1;
+    return (long long)st.st_mtime;
+#endif
+}
+
+
+// Create a directory if it doesn't already exist.
+int platform_make_dir (
+    const char* path // Path of directory. Its parent must exist.
+    // Returns 1 if the directory exists afterwards, otherwise 0.
+){
+#ifdef _WIN32
+    if (CreateDirectoryA (path, NULL)) return 1;
+    return GetLastError () == ERROR_ALREADY_EXISTS;
+#else
+    if (mkdir (path, 0777) == 0) return 1;
+    struct stat st;
+    return stat (path, &st) == 0 && S_ISDIR (st.st_mode);
+#endif
+}
+
+
+// Call a function for each regular file in a directory (not recursive, "." and ".." skipped).
+int platform_list_dir (
+    const char* dirPath, // Path of directory to list.
+    void (*pCallback) (void* pContext, const char* name, unsigned long long size, long long modifiedTime),
+                         // Called once per file with the file's name (not path), size in bytes, and last-modified
+                         // time in seconds. Times are only meaningful relative to each other.
+    void*       pContext // Passed through to *pCallback.
+    // Returns 1 if the directory could be listed, otherwise 0.
+){
+    char path[1024];
+#ifdef _WIN32
+    if (snprintf (path, sizeof (path), "%s\\*", dirPath) >= (int)sizeof (path)) return 0;
+    WIN32_FIND_DATAA data;
+    HANDLE find = FindFirstFileA (path, &data);
+    if (find == INVALID_HANDLE_VALUE) return 0;
+    do {
+        if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) continue;
+        unsigned long long size = ((unsigned long long)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+        long long modifiedTime =
+            (long long)((((unsigned long long)data.ftLastWriteTime.dwHighDateTime << 32)
+            | data.ftLastWriteTime.dwLowDateTime) / 10000000); // 100ns units to seconds
+        pCallback (pContext, data.cFileName, size, modifiedTime);
+    } while (FindNextFileA (find, &data));
+    FindClose (find);
+    return 1;
+#else
+    DIR* dir = opendir (dirPath);
+    if (dir == NULL) return 0;
+    struct dirent* pEntry;
+    while ((pEntry = readdir (dir)) != NULL) {
+        if (snprintf (path, sizeof (path), "%s/%s", dirPath, pEntry->d_name) >= (int)sizeof (path)) continue;
+        struct stat st;
+        if (stat (path, &st) != 0 || !S_ISREG (st.st_mode)) continue;
+        pCallback (pContext, pEntry->d_name, (unsigned long long)st.st_size, (long long)st.st_mtime);
+    }
+    closedir (dir);
+    return 1;
+#endif
+}
+
+
+
+//*************
+// Mapped files
+//*************
+
+// A file mapped read-only into memory. Set by platform_map_file, released by platform_unmap_file.
+struct platform_mapping {
+    const unsigned char* pBytes; // Pointer to the file's bytes. Not 0-terminated.
+    size_t               size;   // Size of the file in bytes.
+    void*                pFile;  // Operating system handle(s), used only to release the mapping.
+    void*                pMap;
+};
+
+
+// Map a whole file read-only into memory. Pages are read from disk only when touched, so mapping a huge file
+// to read a small part of it is cheap.
+int platform_map_file (
+    const char*              path,    // Path of the file.
+    struct platform_mapping* pMapping // Output param, set to the mapping. Release with platform_unmap_file.
+    // Returns 1 on success, otherwise 0. Empty files can't be mapped.
+){
+    pMapping->pBytes = NULL; pMapping->size = 0; pMapping->pFile = NULL; pMapping->pMap = NULL;
+#ifdef _WIN32
+    HANDLE file = CreateFileA (path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) return 0;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx (file, &size) || size.QuadPart == 0) { CloseHandle (file); return 0; }
+    HANDLE map = CreateFileMappingA (file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (map == NULL) { CloseHandle (file); return 0; }
+    const void* pView = MapViewOfFile (map, FILE_MAP_READ, 0, 0, 0);
+    if (pView == NULL) { CloseHandle (map); CloseHandle (file); return 0; }
+    pMapping->pBytes = pView;
+    pMapping->size = (size_t)size.QuadPart;
+    pMapping->pFile = file;
+    pMapping->pMap = map;
+    return 1;
+#else
+    int fd = open (path, O_RDONLY);
+    if (fd < 0) return 0;
+    struct stat st;
+    if (fstat (fd, &st) != 0 || st.st_size == 0) { close (fd); return 0; }
+    void* pView = mmap (NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close (fd); // The mapping stays valid after the descriptor is closed
+    if (pView == MAP_FAILED) return 0;
+    pMapping->pBytes = pView;
+    pMapping->size = (size_t)st.st_size;
+    return 1;
+#endif
+}
+
+
+// Release a mapping from platform_map_file.
+void platform_unmap_file (
+    struct platform_mapping* pMapping // Mapping to release. Its fields are set to NULL and 0.
+){
+    if (pMapping->pBytes != NULL) {
+#ifdef _WIN32
+        UnmapViewOfFile (pMapping->pBytes);
+        CloseHandle (pMapping->pMap);
+        CloseHandle (pMapping->pFile);
+#else
+        munmap ((void*)pMapping->pBytes, pMapping->size);
+#endif
+    }
+    pMapping->pBytes = NULL; pMapping->size = 0; pMapping->pFile = NULL; pMapping->pMap = NULL;
+}
+
+
+
+//*********
+// Threads
+//*********
+
+// Most threads platform_run_parallel starts, including the calling thread
+#define PLATFORM_THREADS_MAX (64)
+
+// Get the number of processors available to run threads.
+unsigned int platform_cpu_count () {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo (&info);
+    return (info.dwNumberOfProcessors > 0) ? (unsigned int)info.dwNumberOfProcessors : 1;
+#else
+    long count = sysconf (_SC_NPROCESSORS_ONLN);
+    return (count > 0) ? (unsigned int)count : 1;
+#endif
+}
+
+
+// Tasks run by one thread of platform_run_parallel: task numbers first, first + stride, first + 2 * stride...
+struct platform_worker {
+    void (*pTask) (void* pContext, unsigned int task);
+    void*        pContext;
+    unsigned int countTasks;
+    unsigned int first;
+    unsigned int stride;
+};
+
+// Run one worker's tasks
+void platform_run_worker (
+    struct platform_worker* pWorker // Worker whose tasks to run
+){
+    for (unsigned int task = pWorker->first; task < pWorker->countTasks; task += pWorker->stride) {
+        pWorker->pTask (pWorker->pContext, task);
+    }
+}
+
+#ifdef _WIN32
+DWORD WINAPI platform_worker_thread (LPVOID pWorker) { platform_run_worker (pWorker); return 0; }
+#else
+void* platform_worker_thread (void* pWorker) { platform_run_worker (pWorker); return NULL; }
+#endif
+
+
+// Run numbered tasks on several threads and wait for all of them. Tasks must be independent of each other.
+// The calling thread runs a share of the tasks too. If a thread can't be started, the calling thread runs its
+// share instead, so every task always runs exactly once.
+void platform_run_parallel (
+    unsigned int countTasks,   // Number of tasks, numbered 0 to countTasks - 1.
+    unsigned int countThreads, // Most threads to use, including the calling thread. 0 means platform_cpu_count.
+    void (*pTask) (void* pContext, unsigned int task), // Function that runs one task.
+    void*        pContext      // Passed through to *pTask.
+){
+    if (countThreads == 0) { countThreads = platform_cpu_count (); }
+    if (countThreads > countTasks) { countThreads = countTasks; }
+    if (countThreads > PLATFORM_THREADS_MAX) { countThreads = PLATFORM_THREADS_MAX; }
+    if (countThreads <= 1) {
+        for (unsigned int task = 0; task < countTasks; ++task) { pTask (pContext, task); }
+        return;
+    }
+
+    struct platform_worker workers[PLATFORM_THREADS_MAX];
+    int started[PLATFORM_THREADS_MAX];
+#ifdef _WIN32
+    HANDLE threads[PLATFORM_THREADS_MAX];
+#else
+    pthread_t threads[PLATFORM_THREADS_MAX];
+#endif
+    for (unsigned int i = 0; i < countThreads; ++i) {
+        workers[i].pTask = pTask; workers[i].pContext = pContext; workers[i].countTasks = countTasks;
+        workers[i].first = i; workers[i].stride = countThreads;
+    }
+    for (unsigned int i = 1; i < countThreads; ++i) {
+#ifdef _WIN32
+        threads[i] = CreateThread (NULL, 0, platform_worker_thread, &(workers[i]), 0, NULL);
+        started[i] = (threads[i] != NULL);
+#else
+        started[i] = (pthread_create (&(threads[i]), NULL, platform_worker_thread, &(workers[i])) == 0);
+#endif
+    }
+    platform_run_worker (&(workers[0]));
+    for (unsigned int i = 1; i < countThreads; ++i) {
+        if (!started[i]) { platform_run_worker (&(workers[i])); continue; }
+#ifdef _WIN32
+        WaitForSingleObject (threads[i], INFINITE);
+        CloseHandle (threads[i]);
+#else
+        pthread_join (threads[i], NULL);
+#endif
+    }
+}
+
+
+// Number of threads that have called platform_thread_index
+volatile long platformCountThreadIndexes = 0;
+
+// Calling thread's number from platform_thread_index, or -1 before it first calls it
+#ifdef _WIN32
+__declspec(thread) long platformThreadIndex = -1;
+#else
+__thread long platformThreadIndex = -1;
+#endif
+
+// Get a number unique to the calling thread, counting from 0 in the order threads first call this, without
+// locking. Numbers aren't reused when threads end.
+unsigned int platform_thread_index () {
+    if (platformThreadIndex < 0) {
+#ifdef _WIN32
+        platformThreadIndex = InterlockedIncrement (&platformCountThreadIndexes) - 1;
+#else
+        platformThreadIndex = __atomic_fetch_add (&platformCountThreadIndexes, 1, __ATOMIC_RELAXED);
+#endif
+    }
+    return (unsigned int)platformThreadIndex;
+}
+
+
+
+//**********************
+// Performance counters
+//**********************
+
+// Most counters platform_counters_open opens
+#define PLATFORM_COUNTERS_MAX (5)
+
+// Open performance counters. Set by platform_counters_open, released by platform_counters_close.
+struct platform_counters {
+    int         countCounters;                // Number of counters open.
+    int         isSoftware;                   // 1 if they count software events, because no hardware event could be.
+    const char* names[PLATFORM_COUNTERS_MAX]; // Name of each counter's event.
+    int         fds[PLATFORM_COUNTERS_MAX];   // Operating system handle of each counter.
+};
+
+// Hardware events counted by platform_counters_open, with their names
+#ifdef __linux__
+const struct {
+    const char*        name;
+    unsigned int       type;
+    unsigned long long config;
+} PLATFORM_COUNTER_EVENTS[PLATFORM_COUNTERS_MAX] = {
+    { "cycles",          PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    { "instructions",    PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    { "branch-misses",   PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+    { "L1d-read-misses", PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                                             | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+    { "LLC-misses",      PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+};
+
+// Software events counted instead when no hardware event can be (virtual machines often have none)
+const struct {
+    const char*        name;
+    unsigned int       type;
+    unsigned long long config;
+} PLATFORM_COUNTER_SOFTWARE_EVENTS[] = {
+    { "task-clock-ns",    PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK },
+    { "page-faults",      PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS },
+    { "context-switches", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES },
+};
+#define PLATFORM_COUNTER_SOFTWARE_COUNT \
+    (sizeof (PLATFORM_COUNTER_SOFTWARE_EVENTS) / sizeof (PLATFORM_COUNTER_SOFTWARE_EVENTS[0]))
+
+
+// Open one counter of this thread's work.
+int platform_counter_open (
+    unsigned int       type,  // PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, or PERF_TYPE_SOFTWARE.
+    unsigned long long config // Event within the type.
+    // Returns the counter's file descriptor, or -1 if it can't be opened.
+){
+    struct perf_event_attr attr;
+    memset (&attr, 0, sizeof (attr));
+    attr.size = sizeof (attr);
+    attr.type = type;
+    attr.config = config;
+    // Hardware events are counted in user space only, which needs no privileges and is where the program's work
+    // is. Software events such as context switches only happen in the kernel.
+    attr.exclude_kernel = (type != PERF_TYPE_SOFTWARE);
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int)syscall (SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+#endif
+
+
+// Open performance counters for the calling thread: the hardware events that the processor and operating system
+// allow, or if there are none, some software events.
+int platform_counters_open (
+    struct platform_counters* pCounters // Output param, set to the counters. Close with platform_counters_close.
+    // Returns the number of counters opened, 0 if none could be.
+){
+    pCounters->countCounters = 0;
+    pCounters->isSoftware = 0;
+#ifdef __linux__
+    for (int i = 0; i < PLATFORM_COUNTERS_MAX; ++i) {
+        int fd = platform_counter_open (PLATFORM_COUNTER_EVENTS[i].type, PLATFORM_COUNTER_EVENTS[i].config);
+        if (fd < 0) continue;
+        pCounters->names[pCounters->countCounters] = PLATFORM_COUNTER_EVENTS[i].name;
+        pCounters->fds[pCounters->countCounters] = fd;
+        ++(pCounters->countCounters);
+    }
+    if (pCounters->countCounters == 0) {
+        pCounters->isSoftware = 1;
+        for (size_t i = 0; i < PLATFORM_COUNTER_SOFTWARE_COUNT; ++i) {
+            int fd = platform_counter_open (PLATFORM_COUNTER_SOFTWARE_EVENTS[i].type,
+                PLATFORM_COUNTER_SOFTWARE_EVENTS[i].config);
+            if (fd < 0) continue;
+            pCounters->names[pCounters->countCounters] = PLATFORM_COUNTER_SOFTWARE_EVENTS[i].name;
+            pCounters->fds[pCounters->countCounters] = fd;
+            ++(pCounters->countCounters);
+        }
+    }
+#endif
+    return pCounters->countCounters;
+}
+
+
+// Read each open counter's count so far. Only differences between readings are meaningful.
+void platform_counters_read (
+    const struct platform_counters* pCounters, // Counters from platform_counters_open.
+    unsigned long long*             pValues    // Output param, array set to a count per counter.
+){
+    for (int i = 0; i < pCounters->countCounters; ++i) {
+        pValues[i] = 0;
+#ifdef __linux__
+        // When there are more events than the processor has counters, the kernel takes turns counting them,
+        // so scale up by the share of time this one was counted
+        unsigned long long values[3]; // Count, time enabled, time running
+        if (read (pCounters->fds[i], values, sizeof (values)) != (ssize_t)sizeof (values)) continue;
+        pValues[i] = (values[2] == 0 || values[2] >= values[1]) ? values[0]
+                   : (unsigned long long)((double)values[0] * values[1] / values[2]);
+#endif
+    }
+}
+
+
+// Close counters from platform_counters_open.
+void platform_counters_close (
+    struct platform_counters* pCounters // Counters to close.
+){
+#ifdef __linux__
+    for (int i = 0; i < pCounters->countCounters; ++i) { close (pCounters->fds[i]); }
+#endif
+    pCounters->countCounters = 0;
+}
+
+
+
+//*******
+// Other
+//*******
+
+// Read a monotonic clock with nanosecond units, for timing. Only differences between readings are meaningful.
+unsigned long long platform_now_ns () {
+#ifdef _WIN32
+    LARGE_INTEGER counter, frequency;
+    QueryPerformanceCounter (&counter);
+    QueryPerformanceFrequency (&frequency);
+    unsigned long long ticks = (unsigned long long)counter.QuadPart;
+    unsigned long long perSecond = (unsigned long long)frequency.QuadPart;
+    // Split up so the multiplication can't overflow
+    return (ticks / perSecond) * 1000000000ULL + ((ticks % perSecond) * 1000000000ULL) / perSecond;
+#else
+    struct timespec now;
+    clock_gettime (CLOCK_MONOTONIC, &now);
+    return (unsigned long long)now.tv_sec * 1000000000ULL + (unsigned long long)now.tv_nsec;
+#endif
+}
+
+
+// Get the processor time the process has used, user and system, in nanoseconds.
+unsigned long long platform_cpu_time_ns () {
+#ifdef _WIN32
+    FILETIME creation, exit, kernel, user;
+    if (!GetProcessTimes (GetCurrentProcess (), &creation, &exit, &kernel, &user)) return 0;
+    unsigned long long ticks = ((unsigned long long)kernel.dwHighDateTime << 32) + kernel.dwLowDateTime
+                             + ((unsigned long long)user.dwHighDateTime << 32) + user.dwLowDateTime;
+    return ticks * 100; // 100 ns ticks
+#else
+    struct rusage usage;
+    if (getrusage (RUSAGE_SELF, &usage) != 0) return 0;
+    return ((unsigned long long)usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000000ULL
+         + ((unsigned long long)usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1000ULL;
+#endif
+}
+
+
+// Start measuring peak memory use again from the current use, where the operating system allows it (Linux).
+// Elsewhere, platform_peak_memory keeps reporting the peak since the process started.
+void platform_reset_peak_memory () {
+#ifdef __linux__
+    FILE* file = fopen ("/proc/self/clear_refs", "w");
+    if (file == NULL) return;
+    fputs ("5", file); // 5 resets the peak resident set size
+    fclose (file);
+#endif
+}
+
+
+// Get the process's peak resident memory (working set on Windows), in bytes.
+unsigned long long platform_peak_memory () {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo (GetCurrentProcess (), &counters, sizeof (counters))) return 0;
+    return (unsigned long long)counters.PeakWorkingSetSize;
+#else
+    struct rusage usage;
+    if (getrusage (RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+    return (unsigned long long)usage.ru_maxrss; // Already bytes
+#else
+    return (unsigned long long)usage.ru_maxrss * 1024; // Kilobytes
+#endif
+#endif
+}
+
+
+// Get a number that differs between processes, for naming temporary files.
+unsigned long platform_process_id () {
+#ifdef _WIN32
+    return (unsigned long)GetCurrentProcessId ();
+#else
+    return (unsigned long)getpid ();
+#endif
+}
@@ -0,0 +1,44 @@
+//*****************************************************************************
+// music2_platform.h.
+// Scope: Private to music2 program.
+// Bare-bones .h file to facilitate linking. See the .c file for descriptions.
+//*****************************************************************************
+
+#pragma once
+
+#include <stddef.h> // size_t
+
+int platform_rename_replace (const char* fromPath, const char* toPath);
+void platform_touch_file (const char* path);
+long long platform_file_modified_time (const char* path);
+int platform_make_dir (const char* path);
+int platform_list_dir (const char* dirPath,
+    void (*pCallback) (void* pContext, const char* name, unsigned long long size, long long modifiedTime),
+    void* pContext);
+struct platform_mapping {
+    const unsigned char* pBytes;
+    size_t               size;
+    void*                pFile;
+    void*                pMap;
+};
+int platform_map_file (const char* path, struct platform_mapping* pMapping);
+void platform_unmap_file (struct platform_mapping* pMapping);
+unsigned int platform_cpu_count ();
+void platform_run_parallel (unsigned int countTasks, unsigned int countThreads,
+    void (*pTask) (void* pContext, unsigned int task), void* pContext);
+unsigned int platform_thread_index ();
+unsigned long long platform_now_ns ();
+unsigned long long platform_cpu_time_ns ();
+void platform_reset_peak_memory ();
+unsigned long long platform_peak_memory ();
+#define PLATFORM_COUNTERS_MAX (5)
+struct platform_counters {
+    int         countCounters;
+    int         isSoftware;
+    const char* names[PLATFORM_COUNTERS_MAX];
+    int         fds[PLATFORM_COUNTERS_MAX];
+};
+int platform_counters_open (struct platform_counters* pCounters);
+void platform_counters_read (const struct platform_counters* pCounters, unsigned long long* pValues);
+void platform_counters_close (struct platform_counters* pCounters);
+unsigned long platform_process_id ();
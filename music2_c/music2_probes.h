@@ -0,0 +1,48 @@
+//*****************************************************************************
+// music2_probes.h.
+// Scope: Private to music2 program.
+// Static tracing probes (USDT) in the parse and render paths, for tracing a running program with bpftrace or
+// perf without rebuilding it. On Linux, where <sys/sdt.h> is installed (package systemtap-sdt-dev or
+// systemtap-sdt-devel), each probe compiles to a single nop plus a note in the executable; a tracer attached
+// to the probe replaces the nop. There is no library to link and no cost while nothing is attached.
+// Elsewhere the probes compile to nothing.
+//
+// Probes, provider music2:
+//   file__open     (path)                  read_file_bytes or read_large_file_bytes is about to open a file.
+//   file__read     (path, countBytes)      It read the file. Not fired if the file couldn't be read.
+//   parse__group   (byteGroupType, index)  parse_byte_group is about to parse the byte group at an index.
+//   noteblock__new (byteGroupType, count)  Noteblocks were made: count is 1, or more for a repeat or a
+//                                          measure copied from the memo (byteGroupType 0 for the memo).
+//   parse__error   (parseResult, errIndex) Parsing stopped at an error. parseResult is a PARSE_RESULT.
+//   staff__start   (staff)                 noteblocks_to_string is about to write a staff, counting from 0.
+//   staff__end     (staff, countChars)     It wrote the staff, and countChars characters so far.
+//
+// Examples, run as root while music2 runs:
+//   Histogram of the time per staff:
+//     bpftrace -e 'usdt:./music2:music2:staff__start { @t[tid] = nsecs; }
+//       usdt:./music2:music2:staff__end /@t[tid]/ { @ns = hist(nsecs - @t[tid]); delete(@t[tid]); }'
+//   Histogram of the time from opening a file to having its bytes:
+//     bpftrace -e 'usdt:./music2:music2:file__open { @t[tid] = nsecs; }
+//       usdt:./music2:music2:file__read /@t[tid]/ { @ns = hist(nsecs - @t[tid]); delete(@t[tid]); }'
+//   Byte groups parsed, by type:
+//     bpftrace -e 'usdt:./music2:music2:parse__group { @groups[arg0] = count(); }'
+//   Parse errors as they happen:
+//     bpftrace -e 'usdt:./music2:music2:parse__error { printf("result %d at byte %d\n", arg0, arg1); }'
+//   List the probes in a build:
+//     bpftrace -l 'usdt:./music2:*'
+//*****************************************************************************
+
+#pragma once
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h> // DTRACE_PROBE1, DTRACE_PROBE2
+#define MUSIC2_PROBE1(name, arg1)       DTRACE_PROBE1 (music2, name, arg1)
+#define MUSIC2_PROBE2(name, arg1, arg2) DTRACE_PROBE2 (music2, name, arg1, arg2)
+#endif
+#endif
+
+#ifndef MUSIC2_PROBE1
+#define MUSIC2_PROBE1(name, arg1)
+#define MUSIC2_PROBE2(name, arg1, arg2)
+#endif
@@ -0,0 +1,287 @@
+//*****************************************************************************************************
+// music2_push.c
+// This file contains a push parser, for encoded bytes that arrive in pieces, such as over a network, and the
+// cmd line option -pp that prints a file read a piece at a time with it. parse_byte_group needs each byte
+// group whole in one buffer; here the caller feeds slices of any size, split anywhere, and completed
+// noteblocks are handed to a callback as they're made.
+//   - State carried between slices lives in struct push_parser: parseInfo, the bytes of a byte group split
+//     across slices, and the most recent noteblock.
+//   - The most recent noteblock is held back until the next byte group that makes a noteblock, since
+//     dynamics text after it may still draw on it. Every other noteblock goes to the callback, which owns it.
+//   - Repeat byte groups copy the last PARSE_HISTORY_SIZE noteblocks, which the callback may have freed, so
+//     the parser keeps its own copy of each noteblock it hands over. The parser is a fixed size, and the
+//     only allocations are the noteblocks handed over.
+// The noteblocks, and any error and its index, are the same however the bytes are split, and the same as
+// parse_bytes_from gives for the whole bytes.
+//*****************************************************************************************************
+
+
+// External inclusions
+#include <stddef.h> // NULL, size_t
+#include <stdio.h>  // printf, fopen_s, fread
+#include <stdlib.h> // free, atoi
+#include <string.h> // memchr, memcpy
+
+// Internal inclusions
+#include "music2_container.h"
+#include "music2_general2.h"
+#include "music2_header.h"
+#include "music2_noteblock.h"
+#include "music2_rans.h"
+
+
+//***********
+// Constants
+//***********
+
+// Bytes read at a time by option -pp, unless given
+#define PUSH_CHUNK_SIZE_DEFAULT (4096)
+
+
+
+//*******
+// State
+//*******
+
+// A push parser. Set up with push_parser_init. Can be declared anywhere, since it allocates nothing itself.
+struct push_parser {
+    void                 (*pEmit) (void* pContext, struct noteblock* pNoteblock); // Called with each completed
+                                                 // noteblock, in order. Its pNext is NULL, and the callee owns it.
+    void*                pContext;               // Passed to pEmit.
+    unsigned int         parseInfo;              // parseInfo carried between byte groups - see update_parse_info.
+    unsigned char        partial[4];             // Bytes so far of a byte group split across slices.
+    int                  countPartial;           // Number of them, or 0.
+    struct noteblock*    pLast;                  // Most recent noteblock, held back for dynamics text, or NULL.
+    unsigned int         countEmitted;           // Noteblocks handed to pEmit.
+    long long            offset;                 // Bytes fed so far.
+    int                  parseResult;            // PARSE_RESULT_PARSED_NOTEBLOCK while more bytes are expected,
+                                                 // then the result: PARSE_RESULT_PARSED_ALL or an error.
+    long long            errIndex;               // Index of the error in all bytes fed, or -1.
+    unsigned char        errByte;                // Byte at errIndex.
+    struct parse_history history;                // Recent noteblocks, for repeat byte groups to copy.
+    struct noteblock     copies[PARSE_HISTORY_SIZE]; // Copies of the noteblocks handed over, by history slot.
+};
+
+
+
+//********
+// Parsing
+//********
+
+// Set up a push parser to parse from the start of some encoded bytes.
+void push_parser_init (
+    struct push_parser* pParser,  // Parser to set up.
+    void                (*pEmit) (void* pContext, struct noteblock* pNoteblock), // Called with each completed
+                                  // noteblock, which it then owns.
+    void*               pContext  // Passed to pEmit.
+){
+    pParser->pEmit = pEmit;
+    pParser->pContext = pContext;
+    pParser->parseInfo = 0;
+    pParser->countPartial = 0;
+    pParser->pLast = NULL;
+    pParser->countEmitted = 0;
+    pParser->offset = 0;
+    pParser->parseResult = PARSE_RESULT_PARSED_NOTEBLOCK;
+    pParser->errIndex = -1;
+    pParser->errByte = 0;
+    pParser->history.count = 0;
+}
+
+
+// Hand over the noteblocks after one, up to but not including another, keeping a copy of each for repeats.
+void push_parser_emit (
+    struct push_parser* pParser, // Parser.
+    struct noteblock*   pFirst,  // First noteblock to hand over.
+    struct noteblock*   pEnd     // Noteblock to stop before, or NULL to hand over the rest of the list.
+){
+    while (pFirst != pEnd) {
+        struct noteblock* pNext = pFirst->pNext;
+        unsigned int slot = pParser->countEmitted % PARSE_HISTORY_SIZE;
+        memcpy (&(pParser->copies[slot]), pFirst, sizeof (struct noteblock));
+        pParser->copies[slot].pNext = NULL;
+        pParser->history.pNoteblocks[slot] = &(pParser->copies[slot]);
+        ++(pParser->countEmitted);
+        pFirst->pNext = NULL;
+        pParser->pEmit (pParser->pContext, pFirst);
+        pFirst = pNext;
+    }
+}
+
+
+// Parse one whole byte group, handing over the noteblocks it completes.
+int push_parser_group (
+    struct push_parser*  pParser,    // Parser.
+    const unsigned char* pBytes,     // Pointer to the byte group. Only as many bytes as it needs are read.
+    long long            groupIndex  // Index of the byte group in all bytes fed.
+    // Returns one of the PARSE_RESULTs, as parse_byte_group.
+){
+    int index = 0;
+    struct noteblock* pPrevious = pParser->pLast;
+    int parseResult = parse_byte_group (pBytes, &index, &(pParser->pLast), &(pParser->parseInfo),
+        &(pParser->history));
+    if (parseResult == PARSE_RESULT_PARSED_NOTEBLOCK) {
+        if (pParser->pLast == pPrevious) return parseResult; // Dynamics text
+        // Everything before the newest noteblock is complete. A repeat byte group can make many.
+        struct noteblock* pFirst = (pPrevious == NULL) ? pParser->pLast : pPrevious;
+        push_parser_emit (pParser, pFirst, pParser->pLast);
+        return parseResult;
+    }
+    // At the terminator or an error, hand over everything, including any copies made before an error
+    if (pPrevious != NULL) { push_parser_emit (pParser, pPrevious, NULL); }
+    pParser->pLast = NULL;
+    if (parseResult != PARSE_RESULT_PARSED_ALL) {
+        pParser->errIndex = groupIndex + index - 1;
+        pParser->errByte = pBytes[index - 1];
+    }
+    return parseResult;
+}
+
+
+// Parse a slice of encoded bytes, following those fed before. Byte groups may be split across slices.
+int push_parser_feed (
+    struct push_parser*  pParser,    // Parser.
+    const unsigned char* pBytes,     // Pointer to the slice.
+    size_t               countBytes  // Number of bytes in the slice. Can be 0.
+    // Returns PARSE_RESULT_PARSED_NOTEBLOCK if more bytes are expected, PARSE_RESULT_PARSED_ALL once the
+    // terminator is parsed, or another PARSE_RESULT on an error, whose index is in pParser->errIndex. Once it
+    // returns anything else, later slices are ignored and it returns the same.
+){
+    size_t index = 0;
+    while (pParser->parseResult == PARSE_RESULT_PARSED_NOTEBLOCK && index < countBytes) {
+        // Finish a byte group split across slices. A 0 byte cuts it short, and parse_byte_group stops there, as
+        // it would reading the whole bytes.
+        if (pParser->countPartial > 0) {
+            int length = byte_group_length (byte_group_type (pParser->partial[0]));
+            int isCut = 0;
+            while (pParser->countPartial < length && index < countBytes && !isCut) {
+                isCut = (pBytes[index] == 0);
+                pParser->partial[pParser->countPartial++] = pBytes[index++];
+            }
+            if (pParser->countPartial < length && !isCut) break;
+            long long groupOffset = pParser->offset + (long long)index - pParser->countPartial;
+            pParser->countPartial = 0;
+            pParser->parseResult = push_parser_group (pParser, pParser->partial, groupOffset);
+            continue;
+        }
+        // Keep the start of a byte group that doesn't fit in the slice, unless a 0 byte in the slice cuts it
+        // short. Invalid byte groups have length 0.
+        int length = byte_group_length (byte_group_type (pBytes[index]));
+        if (index + length > countBytes && memchr (pBytes + index + 1, 0, countBytes - index - 1) == NULL) {
+            while (index < countBytes) { pParser->partial[pParser->countPartial++] = pBytes[index++]; }
+            break;
+        }
+        size_t groupIndex = index;
+        index += (length == 0) ? 1 : length;
+        long long groupOffset = pParser->offset + (long long)groupIndex;
+        pParser->parseResult = push_parser_group (pParser, pBytes + groupIndex, groupOffset);
+    }
+    pParser->offset += countBytes;
+    return pParser->parseResult;
+}
+
+
+// Finish parsing at the end of the bytes. As when parsing a file, a missing terminator is allowed, but a byte
+// group cut short is an error.
+int push_parser_finish (
+    struct push_parser* pParser // Parser.
+    // Returns PARSE_RESULT_PARSED_ALL, or another PARSE_RESULT on an error, whose index is in pParser->errIndex.
+){
+    const unsigned char terminator = 0;
+    push_parser_feed (pParser, &terminator, 1);
+    return pParser->parseResult;
+}
+
+
+
+//*****
+// IO
+//*****
+
+// Noteblocks collected into a list by push_collect
+struct push_list {
+    struct noteblock* pFirst;
+    struct noteblock* pLast;
+};
+
+
+// Push parser callback that adds each noteblock to a list
+void push_collect (void* pContext, struct noteblock* pNoteblock) {
+    struct push_list* pList = pContext;
+    if (pList->pLast == NULL) { pList->pFirst = pNoteblock; }
+    else                      { pList->pLast->pNext = pNoteblock; }
+    pList->pLast = pNoteblock;
+}
+
+
+// Print a file read a slice at a time and fed to a push parser, for cmd line option -pp.
+void try_read_file_push (
+    char* filepath,     // User-entered file path and name.
+    char* chunkSizeStr, // User-entered bytes to read at a time, or NULL for PUSH_CHUNK_SIZE_DEFAULT.
+    char* widthStr      // User-entered string for maximum staff width, or NULL if not entered.
+){
+    int widthInt;
+    if (!parse_width_arg (widthStr, &widthInt)) return;
+    int chunkSize = (chunkSizeStr == NULL) ? PUSH_CHUNK_SIZE_DEFAULT : atoi (chunkSizeStr);
+    if (chunkSize < 1) {
+        printf ("  Invalid chunk size %s\n", chunkSizeStr);
+        return;
+    }
+    unsigned char* pChunk = malloc (chunkSize > HEADER_SIZE ? chunkSize : HEADER_SIZE);
+    struct push_parser* pParser = malloc (sizeof (struct push_parser));
+    if (pChunk == NULL || pParser == NULL) {
+        printf ("  Memory allocation error\n");
+        free (pChunk); free (pParser);
+        return;
+    }
+    FILE* file;
+    errno_t fopenErr = fopen_s (&file, filepath, "rb");
+    if (fopenErr || file == NULL) {
+        printf ("  Unable to open file %s\n", filepath);
+        free (pChunk); free (pParser);
+        return;
+    }
+
+    // A header isn't encoded bytes, so it isn't fed. Containers and compressed files have their own formats.
+    struct push_list list = { NULL, NULL };
+    push_parser_init (pParser, push_collect, &list);
+    size_t countRead = fread (pChunk, 1, HEADER_SIZE, file);
+    long long bodyStart = 0;
+    if (countRead == 0) {
+        printf ("  File is empty: %s\n", filepath);
+        fclose (file); free (pChunk); free (pParser);
+        return;
+    }
+    if (container_is_container (pChunk, countRead) || rans_is_compressed (pChunk, countRead)) {
+        printf ("  Containers and compressed files can't be read a piece at a time\n");
+        fclose (file); free (pChunk); free (pParser);
+        return;
+    }
+    if (header_is_header (pChunk, countRead)) { bodyStart = HEADER_SIZE; }
+    else                                      { push_parser_feed (pParser, pChunk, countRead); }
+    while (pParser->parseResult == PARSE_RESULT_PARSED_NOTEBLOCK
+           && (countRead = fread (pChunk, 1, (size_t)chunkSize, file)) > 0) {
+        push_parser_feed (pParser, pChunk, countRead);
+    }
+    fclose (file);
+    int parseResult = push_parser_finish (pParser);
+    if (parseResult != PARSE_RESULT_PARSED_ALL) {
+        // Locations count from the start of the file, as for other options
+        long long errIndex = bodyStart + pParser->errIndex;
+        if (parseResult == PARSE_RESULT_INVALID_BYTE) {
+            char byteStr[11];
+            format_byte_0b (byteStr, pParser->errByte);
+            printf ("  Invalid byte %s at location #%lld\n", byteStr, errIndex);
+        }
+        else {
+            print_parse_error (parseResult, NULL, (int)errIndex); // Only invalid bytes need the bytes
+        }
+    }
+    else {
+        char* str = noteblocks_to_string (list.pFirst, widthInt);
+        if (str != NULL) { printf ("%s", str); free (str); }
+        else            { printf ("  Internal error while converting noteblocks to string\n"); }
+    }
+    free_noteblocks (list.pFirst);
+    free (pChunk); free (pParser);
+}
@@ -0,0 +1,33 @@
+//*****************************************************************************
+// music2_push.h.
+// Scope: Private to music2 program.
+// Bare-bones .h file to facilitate linking. See the .c file for descriptions.
+//*****************************************************************************
+
+#pragma once
+
+#include <stddef.h> // size_t
+
+#include "music2_general2.h"
+#include "music2_noteblock.h"
+
+struct push_parser {
+    void                 (*pEmit) (void* pContext, struct noteblock* pNoteblock);
+    void*                pContext;
+    unsigned int         parseInfo;
+    unsigned char        partial[4];
+    int                  countPartial;
+    struct noteblock*    pLast;
+    unsigned int         countEmitted;
+    long long            offset;
+    int                  parseResult;
+    long long            errIndex;
+    unsigned char        errByte;
+    struct parse_history history;
+    struct noteblock     copies[PARSE_HISTORY_SIZE];
+};
+void push_parser_init (struct push_parser* pParser, void (*pEmit) (void* pContext, struct noteblock* pNoteblock),
+    void* pContext);
+int push_parser_feed (struct push_parser* pParser, const unsigned char* pBytes, size_t countBytes);
+int push_parser_finish (struct push_parser* pParser);
+void try_read_file_push (char* filepath, char* chunkSizeStr, char* widthStr);
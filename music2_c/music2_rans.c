@@ -0,0 +1,646 @@
+//*****************************************************************************************************
+// music2_rans.c
+// This file contains an optional compressed storage format, using range asymmetric numeral systems (rANS)
+// entropy coding. The encoding is already dense, but across a catalog its byte groups are very skewed:
+// most are quarter and eighth notes on a few pitches, and the same dynamics text recurs. rANS codes each
+// byte in close to its information content under a model of how often each value occurs.
+// The model has a separate table of frequencies for each field a byte can be (a byte group's first byte,
+// an NN note's second byte, and so on), since their distributions have nothing to do with each other.
+// Knowing a byte group's first byte tells the decoder which tables the rest of the group uses.
+// The decoder streams: it decodes one byte group at a time into a few bytes on the stack and hands it to
+// a callback, such as parse_byte_group, so the plain encoding is never materialized.
+//*****************************************************************************************************
+
+
+// External inclusions
+#include <limits.h> // INT_MAX
+#include <stddef.h> // NULL, size_t
+#include <stdio.h>  // printf, fopen_s, fwrite
+#include <stdlib.h> // malloc, calloc, free, atoi
+#include <string.h> // memcmp, memcpy, memmove, memset, strlen
+#include <time.h>   // clock
+
+// Internal inclusions
+#include "music2_general2.h"
+#include "music2_hash.h"
+#include "music2_noteblock.h"
+#include "music2_platform.h"
+
+
+//************************
+// Compressed file format
+//************************
+
+// Header (16 bytes):
+//   Bytes 0-3:   RANS_MAGIC
+//   Bytes 4-7:   RANS_VERSION
+//   Bytes 8-11:  Count of plain encoded bytes, including the terminator, at most RANS_PLAIN_SIZE_MAX
+//   Bytes 12-15: CRC32C of the plain encoded bytes, including the terminator
+// Model, for each of the RANS_CONTEXT_COUNT contexts in order:
+//   2 bytes:     Count of byte values with nonzero frequency, n
+//   n * 3 bytes: Byte value (1 byte), then its frequency (2 bytes). Frequencies add up to RANS_SCALE.
+// Stream:
+//   4 bytes:     Count of bytes in the coded stream
+//   Coded stream, starting with the coder's 4-byte initial state
+// All numbers are little-endian.
+#define RANS_MAGIC       ("\x10M2R")
+#define RANS_VERSION     (1)
+#define RANS_HEADER_SIZE (16)
+
+// Frequencies are scaled to add up to RANS_SCALE = 2^RANS_SCALE_BITS
+#define RANS_SCALE_BITS (12)
+#define RANS_SCALE      (1 << RANS_SCALE_BITS)
+
+// Most plain encoded bytes a compressed file may hold, including the terminator: as many as a plain file that
+// can be read, so a header can't make the decoder run on without limit
+#define RANS_PLAIN_SIZE_MAX (FILE_SIZE_MAX + 1)
+
+// Lower bound of the coder's state, which is renormalized a byte at a time to stay in [RANS_L, 256 * RANS_L)
+#define RANS_L (1U << 23)
+
+// RANS_CONTEXTs, the fields a byte can be, each with its own table of frequencies
+#define RANS_CONTEXT_BYTE1    (0) // First byte of any byte group, including the terminator
+#define RANS_CONTEXT_NN_BYTE2 (1) // Duration and pitch of an unbeamed note
+#define RANS_CONTEXT_NB_BYTE2 (2) // Stem and pitch of a beamed note
+#define RANS_CONTEXT_NB_BYTE3 (3) // Beams of a beamed note
+#define RANS_CONTEXT_KEY      (4) // Bytes 2-4 of a key change, and byte 2 of a repeat
+#define RANS_CONTEXT_DYN_TEXT (5) // Bytes 2-3 of dynamics text
+#define RANS_CONTEXT_COUNT    (6)
+
+
+// Get the context of a byte in a byte group
+int rans_context (
+    int byteGroupType, // One of the BYTE_GROUP_TYPE constants.
+    int position       // Position of the byte in its group, from 0. Must be less than the group's length.
+    // Returns one of the RANS_CONTEXTs.
+){
+    if (position == 0) return RANS_CONTEXT_BYTE1;
+    switch (byteGroupType) {
+        case BYTE_GROUP_TYPE_NOTE_NN: return RANS_CONTEXT_NN_BYTE2;
+        case BYTE_GROUP_TYPE_NOTE_NB: return (position == 1) ? RANS_CONTEXT_NB_BYTE2 : RANS_CONTEXT_NB_BYTE3;
+        case BYTE_GROUP_TYPE_DYN_TEXT: return RANS_CONTEXT_DYN_TEXT;
+    }
+    return RANS_CONTEXT_KEY;
+}
+
+
+// Whether some bytes start with the compressed format's magic
+int rans_is_compressed (
+    const unsigned char* pBytes,    // Pointer to file bytes.
+    size_t               countBytes // Number of file bytes.
+){
+    return countBytes >= 4 && memcmp (pBytes, RANS_MAGIC, 4) == 0;
+}
+
+
+
+//*******
+// Model
+//*******
+
+// Frequencies of every byte value in every context, plus what the decoder needs to look them up quickly
+struct rans_model {
+    unsigned short freqs[RANS_CONTEXT_COUNT][256];             // Scaled frequency of each value; 0 if absent.
+    unsigned short starts[RANS_CONTEXT_COUNT][256];            // Sum of frequencies of smaller values.
+    unsigned char  slotValues[RANS_CONTEXT_COUNT][RANS_SCALE]; // Value whose range contains each slot.
+    int            isUsable[RANS_CONTEXT_COUNT];               // Whether frequencies add up to RANS_SCALE.
+};
+
+
+// Scale counts of byte values to frequencies that add up to RANS_SCALE. Every value that occurs keeps a
+// frequency of at least 1, so it can still be coded.
+void rans_normalize (
+    const unsigned int counts[256], // Count of occurrences of each value.
+    unsigned short     freqs[256]   // Output param, set to scaled frequencies, or all 0s if nothing occurs.
+){
+    unsigned long long total = 0;
+    for (int value = 0; value < 256; ++value) { total += counts[value]; }
+    memset (freqs, 0, 256 * sizeof (unsigned short));
+    if (total == 0) return;
+    int sum = 0;
+    for (int value = 0; value < 256; ++value) {
+        if (counts[value] == 0) continue;
+        unsigned long long freq = ((unsigned long long)counts[value] * RANS_SCALE) / total;
+        freqs[value] = (unsigned short)((freq == 0) ? 1 : freq);
+        sum += freqs[value];
+    }
+    // Rounding leaves the sum a little off; take up the difference in the most frequent values, where it costs least
+    while (sum != RANS_SCALE) {
+        int largest = 0;
+        for (int value = 1; value < 256; ++value) {
+            if (freqs[value] > freqs[largest]) largest = value;
+        }
+        if (sum > RANS_SCALE) { --(freqs[largest]); --sum; }
+        else                  { ++(freqs[largest]); ++sum; }
+    }
+}
+
+
+// Fill in starts and slotValues from freqs
+void rans_finish_model (
+    struct rans_model* pModel // Model whose freqs are set.
+){
+    for (int context = 0; context < RANS_CONTEXT_COUNT; ++context) {
+        unsigned int start = 0;
+        for (int value = 0; value < 256; ++value) {
+            pModel->starts[context][value] = (unsigned short)start;
+            unsigned int freq = pModel->freqs[context][value];
+            if (start + freq <= RANS_SCALE) { memset (&(pModel->slotValues[context][start]), value, freq); }
+            start += freq;
+        }
+        pModel->isUsable[context] = (start == RANS_SCALE);
+    }
+}
+
+
+
+//**********
+// Encoding
+//**********
+
+// Compress plain encoded bytes.
+unsigned char* rans_compress (
+    const unsigned char* pBytes,         // Pointer to plain encoded bytes. Read up to the terminator, or to
+                                         // countBytes; a missing terminator is added.
+    size_t               countBytes,     // Number of plain encoded bytes.
+    size_t*              pCompressedSize, // Output param, set to the size of the compressed bytes.
+    int*                 pErrIndex       // Output param, set to the index of an invalid byte, otherwise to -1.
+    // Returns the compressed bytes (caller must free), or NULL if the bytes are invalid or out of memory.
+){
+    *pErrIndex = -1;
+
+    // Find each byte's context, and count values in each context
+    unsigned char* pContexts = malloc (countBytes + 1);
+    struct rans_model* pModel = calloc (1, sizeof (struct rans_model));
+    unsigned int (*pCounts)[256] = calloc (RANS_CONTEXT_COUNT, sizeof (unsigned int[256]));
+    if (pContexts == NULL || pModel == NULL || pCounts == NULL) {
+        free (pContexts); free (pModel); free (pCounts);
+        return NULL;
+    }
+    size_t index = 0;
+    while (1) {
+        int length = scan_byte_group (pBytes, countBytes, index);
+        if (length == 0) break;
+        if (length < 0 || index > INT_MAX - 4) {
+            *pErrIndex = (int)index;
+            free (pContexts); free (pModel); free (pCounts);
+            return NULL;
+        }
+        int byteGroupType = byte_group_type (pBytes[index]);
+        for (int position = 0; position < length; ++position) {
+            int context = rans_context (byteGroupType, position);
+            pContexts[index + position] = (unsigned char)context;
+            ++(pCounts[context][pBytes[index + position]]);
+        }
+        index += length;
+    }
+    size_t countPlainBytes = index + 1; // Including the terminator, which is coded like any first byte
+    pContexts[index] = RANS_CONTEXT_BYTE1;
+    ++(pCounts[RANS_CONTEXT_BYTE1][0]);
+    for (int context = 0; context < RANS_CONTEXT_COUNT; ++context) {
+        rans_normalize (pCounts[context], pModel->freqs[context]);
+    }
+    free (pCounts);
+    rans_finish_model (pModel);
+
+    // Size the output: header, model, and at most 2 bytes per coded byte plus the final state
+    size_t modelSize = 0;
+    for (int context = 0; context < RANS_CONTEXT_COUNT; ++context) {
+        modelSize += 2;
+        for (int value = 0; value < 256; ++value) { modelSize += (pModel->freqs[context][value] > 0) ? 3 : 0; }
+    }
+    size_t streamCapacity = (2 * countPlainBytes) + 4;
+    unsigned char* pOut = malloc (RANS_HEADER_SIZE + modelSize + 4 + streamCapacity);
+    if (pOut == NULL) {
+        free (pContexts); free (pModel);
+        return NULL;
+    }
+
+    // Code bytes in reverse, since rANS decodes in the opposite order it encodes. The stream is written
+    // backwards from the end of its space.
+    unsigned char* pStreamEnd = pOut + RANS_HEADER_SIZE + modelSize + 4 + streamCapacity;
+    unsigned char* pStream = pStreamEnd;
+    unsigned int x = RANS_L;
+    for (size_t i = countPlainBytes; i-- > 0;) {
+        int context = pContexts[i];
+        unsigned char value = (i < countPlainBytes - 1) ? pBytes[i] : 0;
+        unsigned int freq = pModel->freqs[context][value];
+        unsigned int xMax = ((RANS_L >> RANS_SCALE_BITS) << 8) * freq;
+        while (x >= xMax) { *(--pStream) = (unsigned char)x; x >>= 8; }
+        x = ((x / freq) << RANS_SCALE_BITS) + (x % freq) + pModel->starts[context][value];
+    }
+    pStream -= 4;
+    le_put32 (pStream, x);
+    size_t streamSize = (size_t)(pStreamEnd - pStream);
+    free (pContexts);
+
+    // Header, model, and stream
+    memcpy (pOut, RANS_MAGIC, 4);
+    le_put32 (pOut + 4, RANS_VERSION);
+    le_put32 (pOut + 8, (unsigned int)countPlainBytes);
+    unsigned int crc = crc32c_bytes (pBytes, countPlainBytes - 1, 0);
+    const unsigned char terminator = 0;
+    le_put32 (pOut + 12, crc32c_bytes (&terminator, 1, crc));
+    unsigned char* p = pOut + RANS_HEADER_SIZE;
+    for (int context = 0; context < RANS_CONTEXT_COUNT; ++context) {
+        unsigned char* pCount = p;
+        unsigned int count = 0;
+        p += 2;
+        for (int value = 0; value < 256; ++value) {
+            unsigned int freq = pModel->freqs[context][value];
+            if (freq == 0) continue;
+            p[0] = (unsigned char)value; p[1] = (unsigned char)freq; p[2] = (unsigned char)(freq >> 8);
+            p += 3;
+            ++count;
+        }
+        pCount[0] = (unsigned char)count; pCount[1] = (unsigned char)(count >> 8);
+    }
+    free (pModel);
+    le_put32 (p, (unsigned int)streamSize);
+    memmove (p + 4, pStream, streamSize);
+    *pCompressedSize = (size_t)(p + 4 + streamSize - pOut);
+    return pOut;
+}
+
+
+
+//**********
+// Decoding
+//**********
+
+// Coder state while decoding
+struct rans_decoder {
+    unsigned int         x;         // Coder state.
+    const unsigned char* pStream;   // Next byte of coded stream.
+    const unsigned char* pStreamEnd; // End of coded stream.
+    int                  isOverrun; // Set if the coded stream ended early, meaning it's corrupt.
+};
+
+
+// Decode one byte.
+unsigned char rans_decode_byte (
+    const struct rans_model* pModel,   // Model read from the file.
+    int                      context,  // One of the RANS_CONTEXTs.
+    struct rans_decoder*     pDecoder  // Coder state. Updated.
+    // Returns the decoded byte.
+){
+    unsigned int slot = pDecoder->x & (RANS_SCALE - 1);
+    unsigned char value = pModel->slotValues[context][slot];
+    pDecoder->x = (pModel->freqs[context][value] * (pDecoder->x >> RANS_SCALE_BITS)) + slot
+        - pModel->starts[context][value];
+    while (pDecoder->x < RANS_L) {
+        if (pDecoder->pStream == pDecoder->pStreamEnd) { pDecoder->isOverrun = 1; return 0; }
+        pDecoder->x = (pDecoder->x << 8) | *(pDecoder->pStream);
+        ++(pDecoder->pStream);
+    }
+    return value;
+}
+
+
+// Read the model from a compressed file.
+const unsigned char* rans_read_model (
+    const unsigned char* pBytes,     // Pointer to compressed bytes, starting with the header.
+    size_t               countBytes, // Number of compressed bytes.
+    struct rans_model*   pModel      // Output param, model to set.
+    // Returns pointer to the stream length after the model, or NULL if the model is truncated or corrupt.
+){
+    memset (pModel->freqs, 0, sizeof (pModel->freqs));
+    const unsigned char* p = pBytes + RANS_HEADER_SIZE;
+    const unsigned char* pEnd = pBytes + countBytes;
+    for (int context = 0; context < RANS_CONTEXT_COUNT; ++context) {
+        if (pEnd - p < 2) return NULL;
+        unsigned int count = le_get16 (p);
+        p += 2;
+        if (count > 256 || (size_t)(pEnd - p) < count * 3) return NULL;
+        for (unsigned int i = 0; i < count; ++i, p += 3) {
+            unsigned int freq = le_get16 (p + 1);
+            if (freq == 0 || pModel->freqs[context][p[0]] != 0) return NULL;
+            pModel->freqs[context][p[0]] = (unsigned short)freq;
+        }
+    }
+    rans_finish_model (pModel);
+    return p;
+}
+
+
+// Decode compressed bytes one byte group at a time, passing each to a callback.
+int rans_decode (
+    const unsigned char* pBytes,     // Pointer to compressed bytes, for which rans_is_compressed is true.
+    size_t               countBytes, // Number of compressed bytes.
+    int (*pCallback) (void* pContext, const unsigned char* pGroup),
+                                     // Called with each byte group except the terminator, followed by a 0 byte.
+                                     // Returns a PARSE_RESULT; anything but PARSE_RESULT_PARSED_NOTEBLOCK stops
+                                     // decoding.
+    void*                pContext,   // Passed through to *pCallback.
+    int*                 pErrIndex   // If an error occurs, will be set to about where in the compressed bytes it
+                                     // was found, otherwise to -1.
+    // Returns one of the PARSE_RESULTs. PARSE_RESULT_PARSED_ALL if every byte group was decoded and checked.
+){
+    *pErrIndex = -1;
+    if (countBytes < RANS_HEADER_SIZE || le_get32 (pBytes + 4) != RANS_VERSION) {
+        *pErrIndex = 0;
+        return PARSE_RESULT_CORRUPT;
+    }
+    struct rans_model* pModel = malloc (sizeof (struct rans_model));
+    if (pModel == NULL) return PARSE_RESULT_INTERNAL_ERROR;
+    const unsigned char* p = rans_read_model (pBytes, countBytes, pModel);
+    if (p == NULL || (size_t)(pBytes + countBytes - p) < 8 || le_get32 (p) != (size_t)(pBytes + countBytes - p) - 4
+        || !pModel->isUsable[RANS_CONTEXT_BYTE1]) {
+        free (pModel);
+        *pErrIndex = RANS_HEADER_SIZE;
+        return PARSE_RESULT_CORRUPT;
+    }
+    struct rans_decoder decoder = { le_get32 (p + 4), p + 8, pBytes + countBytes, 0 };
+    unsigned int countPlainBytes = le_get32 (pBytes + 8);
+    if (countPlainBytes > RANS_PLAIN_SIZE_MAX) {
+        free (pModel);
+        *pErrIndex = 8;
+        return PARSE_RESULT_CORRUPT;
+    }
+
+    // Decode byte groups into a small buffer, each followed by a 0 so parse_byte_group can't read past it
+    unsigned char group[5];
+    unsigned int plainIndex = 0;
+    unsigned int crc = 0;
+    int parseResult = PARSE_RESULT_PARSED_NOTEBLOCK;
+    while (parseResult == PARSE_RESULT_PARSED_NOTEBLOCK) {
+        unsigned int xBefore = decoder.x;
+        const unsigned char* pStreamBefore = decoder.pStream;
+        group[0] = rans_decode_byte (pModel, RANS_CONTEXT_BYTE1, &decoder);
+        int byteGroupType = byte_group_type (group[0]);
+        int length = byte_group_length (byteGroupType);
+        if (length == 0) { length = 1; } // Invalid byte; the callback reports it
+        for (int position = 1; position < length; ++position) {
+            int context = rans_context (byteGroupType, position);
+            if (!pModel->isUsable[context]) { decoder.isOverrun = 1; break; }
+            group[position] = rans_decode_byte (pModel, context, &decoder);
+        }
+        group[length] = 0;
+        // A byte group other than the terminator that leaves the state as it was carries no information, and
+        // the same one would be decoded again and again. Only a model rans_compress never writes does that.
+        int isStuck = (decoder.x == xBefore && decoder.pStream == pStreamBefore
+                       && byteGroupType != BYTE_GROUP_TYPE_TERMINATOR);
+        if (decoder.isOverrun || isStuck || plainIndex + length > countPlainBytes) {
+            parseResult = PARSE_RESULT_CORRUPT;
+            *pErrIndex = (int)(decoder.pStream - pBytes);
+            break;
+        }
+        crc = crc32c_bytes (group, length, crc);
+        if (byteGroupType == BYTE_GROUP_TYPE_TERMINATOR) {
+            parseResult = PARSE_RESULT_PARSED_ALL;
+        }
+        else {
+            parseResult = pCallback (pContext, group);
+            // rans_compress only accepts valid byte groups, so one that doesn't parse was corrupted since
+            if (parseResult == PARSE_RESULT_INVALID_BYTE || parseResult == PARSE_RESULT_UNEXPECTED_TERMINATOR) {
+                parseResult = PARSE_RESULT_CORRUPT;
+            }
+            if (parseResult != PARSE_RESULT_PARSED_NOTEBLOCK) { *pErrIndex = (int)(decoder.pStream - pBytes); }
+        }
+        plainIndex += length;
+    }
+    free (pModel);
+
+    // Everything decoded; check it's what was compressed
+    if (parseResult == PARSE_RESULT_PARSED_ALL
+        && (plainIndex != countPlainBytes || crc != le_get32 (pBytes + 12))) {
+        parseResult = PARSE_RESULT_CORRUPT;
+        *pErrIndex = 12;
+    }
+    return parseResult;
+}
+
+
+// List being built by rans_parse_callback
+struct rans_parse {
+    struct noteblock*    p1stNoteblock;
+    struct noteblock*    pNoteblock;
+    unsigned int         parseInfo;
+    struct parse_history history; // For repeat byte groups
+};
+
+// rans_decode callback that parses each byte group into a list of noteblocks
+int rans_parse_callback (void* pContext, const unsigned char* pGroup) {
+    struct rans_parse* pParse = pContext;
+    int index = 0;
+    int parseResult = parse_byte_group (pGroup, &index, &(pParse->pNoteblock), &(pParse->parseInfo),
+        &(pParse->history));
+    if (pParse->p1stNoteblock == NULL) { pParse->p1stNoteblock = pParse->pNoteblock; }
+    return parseResult;
+}
+
+
+// Decode and parse compressed bytes to create list of noteblocks.
+int rans_parse (
+    const unsigned char* pBytes,         // Pointer to compressed bytes, for which rans_is_compressed is true.
+    size_t               countBytes,     // Number of compressed bytes.
+    struct noteblock**   pp1stNoteblock, // Will be set to pointer to first noteblock in list.
+    int*                 pErrIndex       // If an error occurs, will be set to its index - see rans_decode.
+    // Returns one of the PARSE_RESULTs
+){
+    struct rans_parse parse;
+    parse.p1stNoteblock = NULL;
+    parse.pNoteblock = NULL;
+    parse.parseInfo = 0;
+    parse.history.count = 0;
+    int parseResult = rans_decode (pBytes, countBytes, rans_parse_callback, &parse, pErrIndex);
+    *pp1stNoteblock = parse.p1stNoteblock;
+    return parseResult;
+}
+
+
+
+//*****
+// IO
+//*****
+
+// Compress a plain encoded file, for cmd line option -rw.
+void try_write_compressed (
+    char* filepath,   // User-entered path of plain encoded file.
+    char* outFilepath // User-entered path of compressed file to write.
+){
+    struct platform_mapping mapping;
+    if (!platform_map_file (filepath, &mapping)) {
+        printf ("  Unable to open file %s\n", filepath);
+        return;
+    }
+    if (mapping.size > FILE_SIZE_MAX) {
+        // The compressed file couldn't be read back
+        printf ("  File is too long (>%d bytes): %s\n", FILE_SIZE_MAX, filepath);
+        platform_unmap_file (&mapping);
+        return;
+    }
+    size_t compressedSize;
+    int errIndex;
+    unsigned char* pCompressed = rans_compress (mapping.pBytes, mapping.size, &compressedSize, &errIndex);
+    platform_unmap_file (&mapping);
+    if (pCompressed == NULL) {
+        if (errIndex >= 0) { printf ("  Invalid byte group at location #%d\n", errIndex); }
+        else               { printf ("  Memory allocation error\n"); }
+        return;
+    }
+    FILE* file;
+    errno_t fopenErr = fopen_s (&file, outFilepath, "wb");
+    if (fopenErr || file == NULL) {
+        printf ("  Unable to create file %s\n", outFilepath);
+    }
+    else {
+        size_t written = fwrite (pCompressed, 1, compressedSize, file);
+        fclose (file);
+        if (written != compressedSize) { printf ("  Unable to write file %s\n", outFilepath); }
+        else {
+            unsigned int countPlainBytes = le_get32 (pCompressed + 8);
+            printf ("  Wrote %s: %zu bytes from %u (%.2f:1)\n", outFilepath, compressedSize, countPlainBytes,
+                (double)countPlainBytes / compressedSize);
+        }
+    }
+    free (pCompressed);
+}
+
+
+
+//***********
+// Benchmark
+//***********
+
+// Generate a song with the skew seen in real catalogs: mostly quarter and eighth notes on a few pitches,
+// grouped into 4/4 measures, with occasional rests, accidentals, and recurring dynamics text.
+size_t rans_generate_song (
+    unsigned char*      pBytes,        // Output param, array to fill. Must hold countMeasures * 48 + 8 bytes.
+    int                 countMeasures, // Number of measures.
+    unsigned long long* pSeed          // Random number generator state. Updated.
+    // Returns the number of bytes, including the terminator.
+){
+    size_t index = 0;
+    pBytes[index++] = 0b00100000; // Treble clef
+    pBytes[index++] = 0b00111010; // 4/4 time
+    for (int measure = 0; measure < countMeasures; ++measure) {
+        int eighthsLeft = 8;
+        while (eighthsLeft > 0) {
+            *pSeed ^= *pSeed << 13; *pSeed ^= *pSeed >> 7; *pSeed ^= *pSeed << 17; // xorshift64
+            unsigned int r = (unsigned int)(*pSeed >> 32);
+            int isEighth = (eighthsLeft % 2 == 1) || ((r & 3) == 0);
+            int pitch = ((r >> 2) % 16 < 1) ? 0 : 6 + (int)((r >> 6) % 5); // Rest, or middle G to high D
+            int accidental = ((r >> 9) % 16 == 0) ? 3 : 0;
+            pBytes[index++] = (unsigned char)(0b001 | (accidental << 3));
+            pBytes[index++] = (unsigned char)(pitch | ((isEighth ? 6 : 5) << 4));
+            eighthsLeft -= isEighth ? 1 : 2;
+            if ((r >> 13) % 32 == 0) { // " mf " under the note
+                pBytes[index++] = 0b00101000; pBytes[index++] = 0b10011010; pBytes[index++] = 0b00010010;
+            }
+        }
+        pBytes[index++] = 0b00000100; // Single barline
+    }
+    pBytes[index++] = 0;
+    return index;
+}
+
+
+// rans_decode callback that does nothing, for timing decoding alone
+int rans_skip_callback (void* pContext, const unsigned char* pGroup) {
+    (void)pContext; (void)pGroup; // Part of the callback signature, not needed here
+    return PARSE_RESULT_PARSED_NOTEBLOCK;
+}
+
+
+// Report compression ratio and decoding speed on generated songs, for cmd line option -rb.
+void test_compression (
+    char* countStr // User-entered number of songs to generate.
+){
+    int countSongs = atoi (countStr);
+    if (countSongs < 1) {
+        printf ("  Invalid count\n");
+        return;
+    }
+
+    // Generate a corpus of songs of 4-64 measures, laid out back to back
+    unsigned long long seed = 0x9E3779B97F4A7C15ULL;
+    size_t* pOffsets = malloc (((size_t)countSongs + 1) * sizeof (size_t));
+    unsigned char* pCorpus = malloc ((size_t)countSongs * (64 * 48 + 8));
+    if (pOffsets == NULL || pCorpus == NULL) {
+        printf ("  Memory allocation error\n");
+        free (pOffsets); free (pCorpus);
+        return;
+    }
+    pOffsets[0] = 0;
+    for (int song = 0; song < countSongs; ++song) {
+        int countMeasures = 4 + (int)((seed >> 40) % 61);
+        pOffsets[song + 1] = pOffsets[song] + rans_generate_song (pCorpus + pOffsets[song], countMeasures, &seed);
+    }
+
+    // Compress each song on its own, as stored one per file, and the whole corpus as one model and stream
+    size_t plainSize = pOffsets[countSongs], compressedSize = 0, textSize = 0, corpusCompressedSize = 0;
+    unsigned char** ppCompressed = calloc ((size_t)countSongs, sizeof (unsigned char*));
+    size_t* pCompressedSizes = malloc ((size_t)countSongs * sizeof (size_t));
+    if (ppCompressed == NULL || pCompressedSizes == NULL) {
+        printf ("  Memory allocation error\n");
+        free (pOffsets); free (pCorpus); free (ppCompressed); free (pCompressedSizes);
+        return;
+    }
+    int errIndex;
+    for (int song = 0; song < countSongs; ++song) {
+        ppCompressed[song] = rans_compress (pCorpus + pOffsets[song], pOffsets[song + 1] - pOffsets[song],
+            &(pCompressedSizes[song]), &errIndex);
+        if (ppCompressed[song] != NULL) { compressedSize += pCompressedSizes[song]; }
+    }
+    {
+        // Songs without their terminators, as one long song
+        size_t countBytes = 0;
+        unsigned char* pJoined = malloc (plainSize);
+        for (int song = 0; pJoined != NULL && song < countSongs; ++song) {
+            size_t songSize = pOffsets[song + 1] - pOffsets[song] - 1;
+            memcpy (pJoined + countBytes, pCorpus + pOffsets[song], songSize);
+            countBytes += songSize;
+        }
+        unsigned char* pCompressed = (pJoined == NULL) ? NULL :
+            rans_compress (pJoined, countBytes, &corpusCompressedSize, &errIndex);
+        free (pCompressed); free (pJoined);
+    }
+
+    // Time parsing plain bytes, decoding and parsing compressed bytes, and decoding alone
+    clock_t clock0 = clock ();
+    for (int song = 0; song < countSongs; ++song) {
+        struct noteblock* p1stNoteblock;
+        parse_bytes_start_to_end (pCorpus + pOffsets[song], &p1stNoteblock, &errIndex);
+        free_noteblocks (p1stNoteblock);
+    }
+    clock_t clock1 = clock ();
+    int countFailed = 0;
+    for (int song = 0; song < countSongs; ++song) {
+        struct noteblock* p1stNoteblock;
+        int parseResult = (ppCompressed[song] == NULL) ? PARSE_RESULT_INTERNAL_ERROR :
+            rans_parse (ppCompressed[song], pCompressedSizes[song], &p1stNoteblock, &errIndex);
+        if (parseResult != PARSE_RESULT_PARSED_ALL) { ++countFailed; }
+        else {
+            char* str = noteblocks_to_string (p1stNoteblock, INT_MAX);
+            if (str != NULL) { textSize += strlen (str); free (str); }
+        }
+        free_noteblocks (p1stNoteblock);
+    }
+    clock_t clock2 = clock ();
+    for (int song = 0; song < countSongs; ++song) {
+        if (ppCompressed[song] != NULL) {
+            rans_decode (ppCompressed[song], pCompressedSizes[song], rans_skip_callback, NULL, &errIndex);
+        }
+    }
+    clock_t clock3 = clock ();
+
+    // Output
+    double parseSeconds = (double)(clock1 - clock0) / CLOCKS_PER_SEC;
+    double decodeParseSeconds = (double)(clock2 - clock1) / CLOCKS_PER_SEC; // Includes rendering to count text
+    double decodeSeconds = (double)(clock3 - clock2) / CLOCKS_PER_SEC;
+    printf ("  %d generated songs, %zu plain encoded bytes, %zu characters of rendered text\n",
+        countSongs, plainSize, textSize);
+    printf ("  Compressed one file per song: %zu bytes, %.2f:1 vs plain, %.1f:1 vs text\n",
+        compressedSize, (double)plainSize / compressedSize, (double)textSize / compressedSize);
+    printf ("  Compressed as one stream:     %zu bytes, %.2f:1 vs plain, %.1f:1 vs text\n",
+        corpusCompressedSize, (double)plainSize / corpusCompressedSize, (double)textSize / corpusCompressedSize);
+    printf ("  Decode only:                  %.3f s, %.1f MB/s of plain bytes\n",
+        decodeSeconds, plainSize / 1e6 / ((decodeSeconds > 0) ? decodeSeconds : 1e-9));
+    printf ("  Parse plain bytes:            %.3f s\n", parseSeconds);
+    printf ("  Decode, parse, and render:    %.3f s\n", decodeParseSeconds);
+    if (countFailed > 0) { printf ("  %d songs failed to round trip\n", countFailed); }
+
+    for (int song = 0; song < countSongs; ++song) { free (ppCompressed[song]); }
+    free (ppCompressed); free (pCompressedSizes); free (pOffsets); free (pCorpus);
+}
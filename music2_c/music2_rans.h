@@ -0,0 +1,20 @@
+//*****************************************************************************
+// music2_rans.h.
+// Scope: Private to music2 program.
+// Bare-bones .h file to facilitate linking. See the .c file for descriptions.
+//*****************************************************************************
+
+#pragma once
+
+#include <stddef.h> // size_t
+
+#include "music2_noteblock.h"
+
+int rans_is_compressed (const unsigned char* pBytes, size_t countBytes);
+unsigned char* rans_compress (const unsigned char* pBytes, size_t countBytes, size_t* pCompressedSize,
+    int* pErrIndex);
+int rans_decode (const unsigned char* pBytes, size_t countBytes,
+    int (*pCallback) (void* pContext, const unsigned char* pGroup), void* pContext, int* pErrIndex);
+int rans_parse (const unsigned char* pBytes, size_t countBytes, struct noteblock** pp1stNoteblock, int* pErrIndex);
+void try_write_compressed (char* filepath, char* outFilepath);
+void test_compression (char* countStr);
@@ -0,0 +1,552 @@
+//*****************************************************************************************************
+// music2_search.c
+// This file contains a search for the costliest inputs per byte (cmd line option -ws). Uploaded files are
+// untrusted, so it's worth knowing how much time and memory one byte of input can cost, and which byte
+// groups cost it. The search is a simple fuzzer:
+//   - It starts from the examples from option -v and a small generated file of each profile.
+//   - Each step picks a costly input and mutates it a byte group at a time: replacing, inserting, copying,
+//     or deleting byte groups, flipping bits, or splicing in byte groups from another input. Mutants that
+//     don't parse are dropped.
+//   - A mutant is timed as the fastest of a few renders, each from an empty measure memo, as a fresh process
+//     reading one upload would be. Its memory is the noteblocks plus the string noteblocks_to_string
+//     allocates, whose size is estimated from the noteblock count, so narrow noteblocks waste it.
+//   - Mutants that cost more per byte, or that reach byte group combinations no input has reached before
+//     (coverage), are kept for further mutation.
+// The worst inputs found for time and for memory are timed again more carefully and written to a directory.
+// Written to the cases directory of a gate directory (see music2_gate.c), they join the regression gate.
+//*****************************************************************************************************
+
+
+// External inclusions
+#include <stddef.h> // NULL, size_t
+#include <stdio.h>  // printf, fprintf, fopen_s, fwrite, snprintf
+#include <stdlib.h> // malloc, free, atoi, strtoull
+#include <string.h> // memcpy, strlen
+
+// Internal inclusions
+#include "music2_corpus.h"
+#include "music2_general2.h"
+#include "music2_memo.h"
+#include "music2_noteblock.h"
+#include "music2_platform.h"
+
+
+//***********
+// Constants
+//***********
+
+// Largest input tried, in bytes. Costs are per byte, so small inputs search faster and cost as much per byte.
+#define SEARCH_BYTES_MAX (4096)
+
+// Smallest input that can be among the worst. Rendering anything costs a few microseconds, which would make the
+// tiniest inputs the costliest per byte.
+#define SEARCH_BYTES_MIN (256)
+
+// Size of the generated inputs the search starts from
+#define SEARCH_SEED_BYTES (1024)
+
+// Inputs kept for mutation
+#define SEARCH_CORPUS_MAX (32)
+
+// Worst inputs written, for time and for memory each
+#define SEARCH_WORST_COUNT (4)
+
+// Default number of mutants tried
+#define SEARCH_ITERATIONS_DEFAULT (5000)
+
+// Renders per mutant, and per worst input when timing it again at the end. The fastest counts.
+#define SEARCH_RUNS       (5)
+#define SEARCH_RUNS_FINAL (50)
+
+// Staff width rendered at
+#define SEARCH_WIDTH (80)
+
+// Bits in the coverage map
+#define SEARCH_FEATURE_BITS (4096)
+
+// Generator profiles the search starts from
+const char* SEARCH_PROFILES[] = { "typical", "dense", "repetitive", "adversarial" };
+#define SEARCH_PROFILE_COUNT (sizeof (SEARCH_PROFILES) / sizeof (SEARCH_PROFILES[0]))
+
+// Example types the search starts from, as for option -v. "" is the general example song.
+const char* SEARCH_EXAMPLES[] = { "", "clef", "key", "time", "rest", "note", "beam", "text", "barline", "repeat" };
+#define SEARCH_EXAMPLE_COUNT (sizeof (SEARCH_EXAMPLES) / sizeof (SEARCH_EXAMPLES[0]))
+
+
+
+//*******
+// State
+//*******
+
+// An input and its cost
+struct search_entry {
+    unsigned char* pBytes;           // Encoded bytes, ending with the terminator, plus a 0 after them.
+    size_t         countBytes;       // Number of encoded bytes, including the terminator.
+    double         nsPerByte;        // Fastest render time divided by countBytes.
+    double         allocatedPerByte; // Bytes allocated to render, divided by countBytes.
+};
+
+// Everything the search keeps between steps
+struct search_state {
+    unsigned long long  random;                                     // xorshift64 state, never 0.
+    unsigned char       features[SEARCH_FEATURE_BITS / 8];          // Coverage map of byte group combinations.
+    struct search_entry corpus[SEARCH_CORPUS_MAX];                  // Inputs kept for mutation.
+    unsigned int        countCorpus;
+    struct search_entry worstTime[SEARCH_WORST_COUNT];              // Most ns per byte first. pBytes NULL if none.
+    struct search_entry worstMemory[SEARCH_WORST_COUNT];            // Most bytes allocated per byte first.
+    unsigned int        countTried;                                 // Mutants rendered.
+    unsigned int        countKept;                                  // Mutants added to the corpus.
+};
+
+
+// Get the next random number.
+unsigned long long search_random (
+    struct search_state* pState // Search state.
+){
+    unsigned long long x = pState->random;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    pState->random = x;
+    return x;
+}
+
+
+// Get a random number from 0 to count - 1.
+unsigned int search_random_below (
+    struct search_state* pState, // Search state.
+    unsigned int         count   // Number of possible results, at least 1.
+){
+    return (unsigned int)(search_random (pState) % count);
+}
+
+
+
+//*************
+// Measurement
+//*************
+
+// Mark the byte group combinations that some bytes reach in the coverage map. A combination is a byte group's
+// first byte, the high bits of its second byte (durations, beam lengths), and the previous byte group's type.
+int search_mark_features (
+    struct search_state* pState,     // Search state.
+    const unsigned char* pBytes,     // Encoded bytes.
+    size_t               countBytes  // Number of encoded bytes.
+    // Returns the number of combinations not reached before.
+){
+    int countNew = 0;
+    int prevType = BYTE_GROUP_TYPE_TERMINATOR;
+    for (size_t index = 0; ; ) {
+        int length = scan_byte_group (pBytes, countBytes, index);
+        if (length <= 0) break;
+        unsigned int feature = ((unsigned int)prevType * 257 + pBytes[index]) * 17;
+        if (length > 1) { feature += (pBytes[index + 1] >> 4) + 1; }
+        unsigned int bit = ((feature * 2654435761u) >> 20) % SEARCH_FEATURE_BITS;
+        if (!(pState->features[bit / 8] & (1 << (bit % 8)))) {
+            pState->features[bit / 8] |= (unsigned char)(1 << (bit % 8));
+            ++countNew;
+        }
+        prevType = byte_group_type (pBytes[index]);
+        index += length;
+    }
+    return countNew;
+}
+
+
+// Render bytes the way a fresh process would, with an empty measure memo.
+char* search_render (
+    const unsigned char* pBytes,           // Encoded bytes, plus a 0 after them.
+    size_t               countBytes,       // Number of encoded bytes.
+    unsigned int*        pCountNoteblocks  // Output param, set to the number of noteblocks.
+    // Returns the string (caller must free), or NULL if the bytes don't parse.
+){
+    if (memo_is_enabled ()) {
+        memo_set_enabled (0); // Frees the entries
+        memo_set_enabled (1);
+    }
+    struct noteblock* p1stNoteblock;
+    int errIndex;
+    int parseResult = parse_file_bytes (pBytes, countBytes, &p1stNoteblock, &errIndex);
+    *pCountNoteblocks = count_noteblocks (p1stNoteblock);
+    char* str = (parseResult == PARSE_RESULT_PARSED_ALL) ? noteblocks_to_string (p1stNoteblock, SEARCH_WIDTH) : NULL;
+    free_noteblocks (p1stNoteblock);
+    return str;
+}
+
+
+// Measure what rendering an input costs per byte.
+int search_measure (
+    struct search_entry* pEntry,  // Entry whose pBytes and countBytes are set. Its costs are set here.
+    int                  countRuns // Renders to time. The fastest counts.
+    // Returns 1 if the bytes parse, otherwise 0.
+){
+    unsigned int countNoteblocks;
+    char* str = search_render (pEntry->pBytes, pEntry->countBytes, &countNoteblocks);
+    if (str == NULL) return 0;
+    free (str);
+
+    // The string's size as noteblocks_to_string allocates it, assuming every noteblock is full width
+    unsigned int noteblocksPerStaff = (SEARCH_WIDTH - 1) / NOTEBLOCK_WIDTH;
+    unsigned long long countStaves = (countNoteblocks + noteblocksPerStaff - 1) / noteblocksPerStaff;
+    unsigned long long countAllocated = (unsigned long long)countNoteblocks * sizeof (struct noteblock)
+        + (unsigned long long)NOTEBLOCK_HEIGHT * NOTEBLOCK_WIDTH * countNoteblocks
+        + (NOTEBLOCK_HEIGHT + 1) * countStaves + 1;
+
+    unsigned long long bestNs = 0;
+    for (int run = 0; run < countRuns; ++run) {
+        unsigned long long time0 = platform_now_ns ();
+        str = search_render (pEntry->pBytes, pEntry->countBytes, &countNoteblocks);
+        unsigned long long ns = platform_now_ns () - time0;
+        free (str);
+        if (run == 0 || ns < bestNs) { bestNs = ns; }
+    }
+    pEntry->nsPerByte = (double)bestNs / pEntry->countBytes;
+    pEntry->allocatedPerByte = (double)countAllocated / pEntry->countBytes;
+    return 1;
+}
+
+
+// Record an input among the worst if it's worse than one of them.
+void search_record_worst (
+    struct search_entry*       pWorst,     // Array of SEARCH_WORST_COUNT entries, worst first.
+    const struct search_entry* pEntry,     // Input measured.
+    int                        isMemory    // 1 to rank by bytes allocated per byte, 0 by time per byte.
+){
+    if (pEntry->countBytes < SEARCH_BYTES_MIN) return;
+    double cost = isMemory ? pEntry->allocatedPerByte : pEntry->nsPerByte;
+    int rank = SEARCH_WORST_COUNT;
+    while (rank > 0 && (pWorst[rank - 1].pBytes == NULL
+        || cost > (isMemory ? pWorst[rank - 1].allocatedPerByte : pWorst[rank - 1].nsPerByte))) {
+        --rank;
+    }
+    if (rank == SEARCH_WORST_COUNT) return;
+    unsigned char* pCopy = malloc (pEntry->countBytes + 1);
+    if (pCopy == NULL) return;
+    memcpy (pCopy, pEntry->pBytes, pEntry->countBytes + 1);
+    free (pWorst[SEARCH_WORST_COUNT - 1].pBytes);
+    for (int i = SEARCH_WORST_COUNT - 1; i > rank; --i) { pWorst[i] = pWorst[i - 1]; }
+    pWorst[rank] = *pEntry;
+    pWorst[rank].pBytes = pCopy;
+}
+
+
+
+//**********
+// Mutation
+//**********
+
+// Find where each byte group starts.
+unsigned int search_find_groups (
+    const unsigned char* pBytes,     // Encoded bytes, ending with the terminator.
+    size_t               countBytes, // Number of encoded bytes.
+    size_t*              pStarts     // Output param, array of SEARCH_BYTES_MAX + 1 set to each byte group's first
+                                     // index, then the terminator's.
+    // Returns the number of byte groups, not counting the terminator.
+){
+    unsigned int count = 0;
+    size_t index = 0;
+    for (int length; count < SEARCH_BYTES_MAX && (length = scan_byte_group (pBytes, countBytes, index)) > 0;
+        index += length) {
+        pStarts[count++] = index;
+    }
+    pStarts[count] = index;
+    return count;
+}
+
+
+// Make a random byte group of a random type. Bits past the type bits are random, but never make a 0 byte,
+// which would end the byte group early.
+int search_random_group (
+    struct search_state* pState, // Search state.
+    unsigned char*       pGroup  // Output param, array of 4 set to the byte group.
+    // Returns the byte group's length.
+){
+    for (int i = 0; i < 4; ++i) { pGroup[i] = (unsigned char)(search_random (pState) | 1); }
+    unsigned char byte1 = (unsigned char)search_random (pState);
+    switch (search_random_below (pState, 9)) {
+        case 0:  pGroup[0] = (unsigned char)((byte1 & ~0b111) | 0b001); return 2;   // NN
+        case 1:                                                                     // NB, twice as likely, since
+        case 2:  pGroup[0] = (unsigned char)((byte1 & ~0b111) | 0b101); return 3;   // beams span noteblocks
+        case 3:  pGroup[0] = (unsigned char)((byte1 & ~0b1111) | 0b1000); return 3; // Dynamics text
+        case 4:  pGroup[0] = (unsigned char)((byte1 & ~0b1111) | 0b0100); return 1; // Barline
+        case 5:  pGroup[0] = (unsigned char)((byte1 & ~0b11) | 0b11); return 4;     // Key
+        case 6:  pGroup[0] = (unsigned char)((byte1 & ~0b11) | 0b10); return 1;     // Time
+        case 7:  pGroup[0] = BYTE_GROUP_TYPE_REPEAT; return 2;                      // Repeat
+        default: pGroup[0] = (unsigned char)((byte1 & ~0b111111) | 0b100000); return 1; // Clef
+    }
+}
+
+
+// Make a mutant of an input by one to three random changes to its byte groups.
+unsigned char* search_mutate (
+    struct search_state*       pState,     // Search state.
+    const struct search_entry* pParent,    // Input to mutate.
+    const struct search_entry* pOther,     // Input to splice byte groups from.
+    size_t*                    pCountBytes // Output param, set to the mutant's size, including the terminator.
+    // Returns the mutant (caller must free), ending with the terminator plus a 0, or NULL if it would be too
+    // large or out of memory.
+){
+    // Room for the largest input plus the largest change
+    size_t capacity = 2 * SEARCH_BYTES_MAX + 8;
+    unsigned char* pBytes = malloc (capacity);
+    unsigned char* pTemp = malloc (capacity);
+    size_t* pStarts = malloc (sizeof (size_t) * (SEARCH_BYTES_MAX + 1));
+    size_t* pOtherStarts = malloc (sizeof (size_t) * (SEARCH_BYTES_MAX + 1));
+    if (pBytes == NULL || pTemp == NULL || pStarts == NULL || pOtherStarts == NULL) {
+        free (pBytes); free (pTemp); free (pStarts); free (pOtherStarts);
+        return NULL;
+    }
+    size_t countBytes = pParent->countBytes;
+    memcpy (pBytes, pParent->pBytes, countBytes);
+    unsigned int countOtherGroups = search_find_groups (pOther->pBytes, pOther->countBytes, pOtherStarts);
+
+    int countChanges = 1 + search_random_below (pState, 3);
+    for (int change = 0; change < countChanges && countBytes <= SEARCH_BYTES_MAX; ++change) {
+        unsigned int countGroups = search_find_groups (pBytes, countBytes, pStarts);
+        unsigned int at = search_random_below (pState, countGroups + 1); // Byte group changed, or inserted before
+        size_t atIndex = pStarts[at];
+        size_t removeCount = 0;   // Bytes removed at atIndex
+        unsigned char insert[4];
+        const unsigned char* pInsert = insert;
+        size_t insertCount = 0;   // Bytes inserted at atIndex
+        switch (search_random_below (pState, 6)) {
+            case 0: // Replace a byte group with a random one
+                if (at == countGroups) continue;
+                removeCount = pStarts[at + 1] - atIndex;
+                insertCount = (size_t)search_random_group (pState, insert);
+                break;
+            case 1: // Insert a random byte group
+                insertCount = (size_t)search_random_group (pState, insert);
+                break;
+            case 2: // Flip a bit. The type bits may change too; mutants that no longer parse are dropped.
+                if (at == countGroups) continue;
+                pBytes[atIndex + search_random_below (pState, (unsigned int)(pStarts[at + 1] - atIndex))]
+                    ^= (unsigned char)(1 << search_random_below (pState, 8));
+                continue;
+            case 3: { // Copy a run of byte groups to just after it
+                if (at == countGroups) continue;
+                unsigned int end = at + 1 + search_random_below (pState, 8);
+                if (end > countGroups) { end = countGroups; }
+                pInsert = pBytes + atIndex;
+                insertCount = pStarts[end] - atIndex;
+                atIndex = pStarts[end];
+                break;
+            }
+            case 4: { // Delete a run of byte groups
+                if (at == countGroups) continue;
+                unsigned int end = at + 1 + search_random_below (pState, 4);
+                if (end > countGroups) { end = countGroups; }
+                removeCount = pStarts[end] - atIndex;
+                break;
+            }
+            default: { // Splice in a run of byte groups from the other input
+                if (countOtherGroups == 0) continue;
+                unsigned int from = search_random_below (pState, countOtherGroups);
+                unsigned int end = from + 1 + search_random_below (pState, 16);
+                if (end > countOtherGroups) { end = countOtherGroups; }
+                pInsert = pOther->pBytes + pOtherStarts[from];
+                insertCount = pOtherStarts[end] - pOtherStarts[from];
+                break;
+            }
+        }
+        if (countBytes - removeCount + insertCount > capacity - 1) continue;
+
+        // Rebuild through pTemp, since what's inserted may come from pBytes itself
+        memcpy (pTemp, pBytes, atIndex);
+        memcpy (pTemp + atIndex, pInsert, insertCount);
+        memcpy (pTemp + atIndex + insertCount, pBytes + atIndex + removeCount, countBytes - atIndex - removeCount);
+        countBytes = countBytes - removeCount + insertCount;
+        unsigned char* pSwap = pBytes; pBytes = pTemp; pTemp = pSwap;
+    }
+    free (pTemp); free (pStarts); free (pOtherStarts);
+    if (countBytes > SEARCH_BYTES_MAX || countBytes < 2) {
+        free (pBytes);
+        return NULL;
+    }
+    pBytes[countBytes] = 0;
+    *pCountBytes = countBytes;
+    return pBytes;
+}
+
+
+
+//********
+// Corpus
+//********
+
+// Score an entry for keeping it in the corpus: its time and memory per byte, relative to the worst found.
+double search_score (
+    const struct search_state* pState, // Search state.
+    const struct search_entry* pEntry  // Entry to score.
+){
+    double worstNs = (pState->worstTime[0].pBytes == NULL) ? 1 : pState->worstTime[0].nsPerByte;
+    double worstAllocated = (pState->worstMemory[0].pBytes == NULL) ? 1 : pState->worstMemory[0].allocatedPerByte;
+    return pEntry->nsPerByte / worstNs + pEntry->allocatedPerByte / worstAllocated;
+}
+
+
+// Offer a measured input to the corpus. It's kept if there's room, if it scores above the lowest scoring entry,
+// or if it reached new coverage, replacing the lowest scoring entry.
+void search_offer (
+    struct search_state* pState,    // Search state.
+    struct search_entry* pEntry,    // Measured input. Its bytes are taken over, or freed if not kept.
+    int                  isNewCoverage // 1 if it reached byte group combinations no input reached before.
+){
+    search_record_worst (pState->worstTime, pEntry, 0);
+    search_record_worst (pState->worstMemory, pEntry, 1);
+    if (pState->countCorpus < SEARCH_CORPUS_MAX) {
+        pState->corpus[pState->countCorpus++] = *pEntry;
+        ++(pState->countKept);
+        return;
+    }
+    unsigned int lowest = 0;
+    for (unsigned int i = 1; i < pState->countCorpus; ++i) {
+        if (search_score (pState, &(pState->corpus[i])) < search_score (pState, &(pState->corpus[lowest]))) {
+            lowest = i;
+        }
+    }
+    if (!isNewCoverage && search_score (pState, pEntry) <= search_score (pState, &(pState->corpus[lowest]))) {
+        free (pEntry->pBytes);
+        return;
+    }
+    free (pState->corpus[lowest].pBytes);
+    pState->corpus[lowest] = *pEntry;
+    ++(pState->countKept);
+}
+
+
+// Pick an input to mutate: the costlier of two random ones, by time on even steps and memory on odd steps.
+const struct search_entry* search_pick_parent (
+    struct search_state* pState, // Search state.
+    unsigned int         step    // Step number.
+){
+    const struct search_entry* pA = &(pState->corpus[search_random_below (pState, pState->countCorpus)]);
+    const struct search_entry* pB = &(pState->corpus[search_random_below (pState, pState->countCorpus)]);
+    if (step % 2 == 0) { return (pA->nsPerByte >= pB->nsPerByte) ? pA : pB; }
+    return (pA->allocatedPerByte >= pB->allocatedPerByte) ? pA : pB;
+}
+
+
+// Add the inputs the search starts from.
+int search_add_seeds (
+    struct search_state* pState // Search state.
+    // Returns 1 on success, 0 if out of memory.
+){
+    for (size_t i = 0; i < SEARCH_EXAMPLE_COUNT + SEARCH_PROFILE_COUNT; ++i) {
+        struct search_entry entry;
+        if (i < SEARCH_EXAMPLE_COUNT) {
+            unsigned char* pExampleBytes;
+            int width;
+            get_example_bytes_width ((char*)SEARCH_EXAMPLES[i], &pExampleBytes, &width);
+            entry.countBytes = strlen ((char*)pExampleBytes) + 1;
+            entry.pBytes = malloc (entry.countBytes + 1);
+            if (entry.pBytes == NULL) return 0;
+            memcpy (entry.pBytes, pExampleBytes, entry.countBytes);
+            entry.pBytes[entry.countBytes] = 0;
+        }
+        else {
+            struct corpus_profile profile;
+            unsigned long long countNoteblocks;
+            corpus_parse_profile (SEARCH_PROFILES[i - SEARCH_EXAMPLE_COUNT], &profile);
+            entry.pBytes = corpus_generate (SEARCH_SEED_BYTES, &profile, 1, &(entry.countBytes), &countNoteblocks);
+            if (entry.pBytes == NULL) return 0;
+        }
+        if (!search_measure (&entry, SEARCH_RUNS)) {
+            free (entry.pBytes);
+            continue;
+        }
+        search_offer (pState, &entry, search_mark_features (pState, entry.pBytes, entry.countBytes) > 0);
+    }
+    return 1;
+}
+
+
+
+//*****
+// IO
+//*****
+
+// Write the worst inputs of one kind, after timing them again more carefully, and print their costs.
+void search_write_worst (
+    struct search_entry* pWorst,  // Array of SEARCH_WORST_COUNT entries, worst first.
+    const char*          kind,    // "time" or "memory", for the file names.
+    char*                dirPath  // Directory to write to.
+){
+    for (int i = 0; i < SEARCH_WORST_COUNT && pWorst[i].pBytes != NULL; ++i) {
+        search_measure (&(pWorst[i]), SEARCH_RUNS_FINAL);
+        char path[1024];
+        FILE* file = NULL;
+        if (snprintf (path, sizeof (path), "%s/worst-%s-%d.jwl", dirPath, kind, i + 1) >= (int)sizeof (path)
+            || fopen_s (&file, path, "wb") || file == NULL) {
+            printf ("  Unable to create file %s/worst-%s-%d.jwl\n", dirPath, kind, i + 1);
+            continue;
+        }
+        size_t written = fwrite (pWorst[i].pBytes, 1, pWorst[i].countBytes, file);
+        fclose (file);
+        if (written != pWorst[i].countBytes) {
+            printf ("  Unable to write file %s\n", path);
+            continue;
+        }
+        printf ("  %-40s %8zu %14.2f %22.2f\n", path, pWorst[i].countBytes, pWorst[i].nsPerByte,
+            pWorst[i].allocatedPerByte);
+    }
+}
+
+
+// Search for the inputs that cost the most time and memory per byte, for cmd line option -ws.
+void try_search_worst_case (
+    char* dirPath,       // User-entered directory to write the worst inputs to, created if needed.
+    char* iterationsStr, // User-entered number of mutants to try, or NULL for SEARCH_ITERATIONS_DEFAULT.
+    char* seedStr        // User-entered seed, or NULL for the default.
+){
+    int countIterations = (iterationsStr == NULL) ? SEARCH_ITERATIONS_DEFAULT : atoi (iterationsStr);
+    if (countIterations < 1) {
+        printf ("  Invalid count\n");
+        return;
+    }
+    if (!platform_make_dir (dirPath)) {
+        printf ("  Unable to create directory %s\n", dirPath);
+        return;
+    }
+    struct search_state* pState = calloc (1, sizeof (struct search_state));
+    if (pState == NULL) {
+        printf ("  Memory allocation error\n");
+        return;
+    }
+    pState->random = (seedStr == NULL) ? 0 : strtoull (seedStr, NULL, 10);
+    if (pState->random == 0) { pState->random = 0x9E3779B97F4A7C15ULL; }
+
+    int isOk = search_add_seeds (pState);
+    double seedNs = pState->worstTime[0].nsPerByte, seedAllocated = pState->worstMemory[0].allocatedPerByte;
+    for (int step = 0; isOk && step < countIterations && pState->countCorpus > 0; ++step) {
+        const struct search_entry* pParent = search_pick_parent (pState, (unsigned int)step);
+        const struct search_entry* pOther = &(pState->corpus[search_random_below (pState, pState->countCorpus)]);
+        struct search_entry entry;
+        entry.pBytes = search_mutate (pState, pParent, pOther, &(entry.countBytes));
+        if (entry.pBytes == NULL) continue;
+        ++(pState->countTried);
+        if (!search_measure (&entry, SEARCH_RUNS)) {
+            free (entry.pBytes);
+            continue;
+        }
+        search_offer (pState, &entry, search_mark_features (pState, entry.pBytes, entry.countBytes) > 0);
+        if ((step + 1) % (countIterations / 10 + 1) == 0) {
+            fprintf (stderr, "  Step %d: worst %.2f ns/byte, %.2f bytes allocated/byte\n", step + 1,
+                pState->worstTime[0].nsPerByte, pState->worstMemory[0].allocatedPerByte);
+        }
+    }
+    if (!isOk) { printf ("  Memory allocation error\n"); }
+
+    printf ("  %u mutants parsed, %u kept. Worst of the starting inputs: %.2f ns/byte, %.2f bytes allocated/byte\n",
+        pState->countTried, pState->countKept, seedNs, seedAllocated);
+    printf ("  %-40s %8s %14s %22s\n", "File", "Bytes", "ns/byte", "Bytes allocated/byte");
+    search_write_worst (pState->worstTime, "time", dirPath);
+    search_write_worst (pState->worstMemory, "memory", dirPath);
+
+    for (unsigned int i = 0; i < pState->countCorpus; ++i) { free (pState->corpus[i].pBytes); }
+    for (int i = 0; i < SEARCH_WORST_COUNT; ++i) {
+        free (pState->worstTime[i].pBytes);
+        free (pState->worstMemory[i].pBytes);
+    }
+    free (pState);
+}
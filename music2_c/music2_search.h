@@ -0,0 +1,9 @@
+//*****************************************************************************
+// music2_search.h.
+// Scope: Private to music2 program.
+// Bare-bones .h file to facilitate linking. See the .c file for descriptions.
+//*****************************************************************************
+
+#pragma once
+
+void try_search_worst_case (char* dirPath, char* iterationsStr, char* seedStr);
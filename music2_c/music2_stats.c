@@ -0,0 +1,244 @@
+//*****************************************************************************************************
+// music2_stats.c
+// This file contains render statistics (--stats), for finding out what an input held and where the time
+// went when rendering it was slow. The counters are compiled in and cost a flag check while off; while on,
+// they cost a clock read per stage and a pass over the bytes, noteblocks, and string of each render.
+//   - Byte groups are counted by type, over what parse_bytes_from parsed. Containers and compressed files
+//     are parsed elsewhere and aren't broken down.
+//   - Noteblocks, bytes allocated for noteblocks and strings, staves, and output bytes are counted for each
+//     render by render_bytes.
+//   - Wall time is summed per stage: reading the file, parsing, converting to a string, and freeing.
+//   - The parse result and error position are those of the latest render.
+// Counters are totals for the current process, like the memo's, and for the main thread only: threaded
+// benchmarks turn them off, and the printed counters say so.
+//*****************************************************************************************************
+
+
+// External inclusions
+#include <stddef.h> // NULL, size_t
+#include <stdio.h>  // fprintf
+#include <string.h> // memset
+
+// Internal inclusions
+#include "music2_general2.h"
+#include "music2_noteblock.h"
+#include "music2_platform.h"
+
+
+//***********
+// Constants
+//***********
+
+// Byte group types counted, and their names as printed
+const int STATS_GROUP_TYPES[] = {
+    BYTE_GROUP_TYPE_CLEF, BYTE_GROUP_TYPE_KEY_CHANGE, BYTE_GROUP_TYPE_TIME_CHANGE, BYTE_GROUP_TYPE_NOTE_NN,
+    BYTE_GROUP_TYPE_NOTE_NB, BYTE_GROUP_TYPE_DYN_TEXT, BYTE_GROUP_TYPE_BARLINE, BYTE_GROUP_TYPE_REPEAT
+};
+const char* STATS_GROUP_NAMES[] = { "clef", "key", "time", "note", "beamed note", "text", "barline", "repeat" };
+#define STATS_GROUP_COUNT (8)
+
+// Stages timed
+#define STATS_STAGE_READ      (0)
+#define STATS_STAGE_PARSE     (1)
+#define STATS_STAGE_TO_STRING (2)
+#define STATS_STAGE_FREE      (3)
+#define STATS_STAGE_COUNT     (4)
+const char* STATS_STAGE_NAMES[] = { "read", "parse", "to_string", "free" };
+
+// PARSE_RESULT names, as printed
+const char* STATS_RESULT_NAMES[] = {
+    "parsed noteblock", "parsed all", "unexpected terminator", "invalid byte", "internal error", "corrupt",
+    "archive"
+};
+#define STATS_RESULT_COUNT (7)
+
+
+
+//*******
+// State
+//*******
+
+// Counters for the current process. Returned by stats_get.
+struct render_stats {
+    unsigned long long groups[STATS_GROUP_COUNT];  // Byte groups parsed, by type in STATS_GROUP_TYPES order.
+    unsigned long long renders;                    // Renders, including cache hits.
+    unsigned long long noteblocks;                 // Noteblocks allocated for rendered lists.
+    unsigned long long noteblockBytes;             // Bytes allocated for those noteblocks.
+    unsigned long long stringBytes;                // Bytes allocated for rendered strings.
+    unsigned long long staves;                     // Staves in rendered strings.
+    unsigned long long outputBytes;                // Characters in rendered strings, not counting the '\0'.
+    unsigned long long stageNs[STATS_STAGE_COUNT]; // Wall time per stage, in STATS_STAGE order.
+    int                parseResult;                // PARSE_RESULT of the latest render, or -1 if none.
+    int                errIndex;                   // Error index of the latest render, or -1 if none.
+};
+
+// Whether counters are collected.
+int statsIsEnabled = 0;
+
+// Whether counters were turned off for renders on several threads.
+int statsSkippedThreads = 0;
+
+// Counters for the current process.
+struct render_stats renderStats = { { 0 }, 0, 0, 0, 0, 0, 0, { 0 }, -1, -1 };
+
+
+
+//*************************
+// Configuration and stats
+//*************************
+
+// Turn the counters on or off for the rest of the process.
+void stats_set_enabled (
+    int isEnabled // 1 to collect counters, 0 not to.
+){
+    statsIsEnabled = isEnabled;
+}
+
+
+// Whether counters are collected.
+int stats_is_enabled () {
+    return statsIsEnabled;
+}
+
+
+// Turn the counters off for renders on several threads at once, which they aren't safe for, and say so when
+// they're printed.
+void stats_skip_threads () {
+    statsSkippedThreads = statsIsEnabled;
+    statsIsEnabled = 0;
+}
+
+
+// Get the counters for the current process.
+struct render_stats stats_get () {
+    return renderStats;
+}
+
+
+// Set the counters back to zero, for callers that want the counters of one render.
+void stats_reset () {
+    memset (&renderStats, 0, sizeof (renderStats));
+    renderStats.parseResult = -1;
+    renderStats.errIndex = -1;
+}
+
+
+
+//************
+// Collection
+//************
+
+// Start timing a stage. Returns the time in ns, or 0 if counters are off.
+unsigned long long stats_now () {
+    return statsIsEnabled ? platform_now_ns () : 0;
+}
+
+
+// Finish timing a stage, adding its time since stats_now or the previous stage.
+unsigned long long stats_end_stage (
+    int                stage,  // One of the STATS_STAGEs.
+    unsigned long long startNs // From stats_now or stats_end_stage.
+    // Returns the time in ns, to start timing the next stage, or 0 if counters are off.
+){
+    if (!statsIsEnabled) return 0;
+    unsigned long long nowNs = platform_now_ns ();
+    renderStats.stageNs[stage] += nowNs - startNs;
+    return nowNs;
+}
+
+
+// Count the byte groups in a range of parsed bytes by type.
+void stats_count_groups (
+    const unsigned char* pBytes,     // Pointer to encoded bytes.
+    size_t               startIndex, // Index of the first byte group parsed.
+    size_t               endIndex    // Index past the last byte parsed. A byte group cut short there isn't counted.
+){
+    if (!statsIsEnabled) return;
+    int length;
+    for (size_t index = startIndex; (length = scan_byte_group (pBytes, endIndex, index)) > 0; index += length) {
+        int byteGroupType = byte_group_type (pBytes[index]);
+        for (int i = 0; i < STATS_GROUP_COUNT; ++i) {
+            if (STATS_GROUP_TYPES[i] == byteGroupType) {
+                ++(renderStats.groups[i]);
+                break;
+            }
+        }
+    }
+}
+
+
+// Count a rendered list's noteblocks.
+void stats_count_noteblocks (
+    struct noteblock* p1stNoteblock // Initial noteblock.
+){
+    if (!statsIsEnabled) return;
+    unsigned int countNoteblocks = count_noteblocks (p1stNoteblock);
+    renderStats.noteblocks += countNoteblocks;
+    renderStats.noteblockBytes += (unsigned long long)countNoteblocks * sizeof (struct noteblock);
+}
+
+
+// Count the bytes allocated for a rendered string.
+void stats_add_string_bytes (
+    unsigned long long countBytes // Size of the allocation.
+){
+    if (statsIsEnabled) { renderStats.stringBytes += countBytes; }
+}
+
+
+// Record the outcome of a render.
+void stats_record_render (
+    int         parseResult, // One of the PARSE_RESULTs.
+    int         errIndex,    // Error index, or -1 if none.
+    const char* str          // Rendered string, or NULL if none.
+){
+    if (!statsIsEnabled) return;
+    ++(renderStats.renders);
+    renderStats.parseResult = parseResult;
+    renderStats.errIndex = errIndex;
+    if (str == NULL) return;
+    // Every staff ends with an empty row
+    unsigned long long countNewlines = 0;
+    size_t len = 0;
+    for (; str[len] != '\0'; ++len) { countNewlines += (str[len] == '\n'); }
+    renderStats.outputBytes += len;
+    renderStats.staves += countNewlines / (NOTEBLOCK_HEIGHT + 1);
+}
+
+
+
+//**********
+// Printing
+//**********
+
+// Print the counters to stderr, so they don't mix with printed music.
+void stats_print () {
+    const struct render_stats* pStats = &renderStats;
+    unsigned long long countGroups = 0;
+    for (int i = 0; i < STATS_GROUP_COUNT; ++i) { countGroups += pStats->groups[i]; }
+    fprintf (stderr, "  Stats: %llu renders, %llu byte groups (", pStats->renders, countGroups);
+    for (int i = 0; i < STATS_GROUP_COUNT; ++i) {
+        fprintf (stderr, "%s%s %llu", (i == 0) ? "" : ", ", STATS_GROUP_NAMES[i], pStats->groups[i]);
+    }
+    fprintf (stderr, ")\n");
+    fprintf (stderr, "  Stats: %llu noteblocks (%llu bytes), %llu string bytes allocated, %llu staves, "
+        "%llu output bytes\n", pStats->noteblocks, pStats->noteblockBytes, pStats->stringBytes, pStats->staves,
+        pStats->outputBytes);
+    if (pStats->parseResult < 0 || pStats->parseResult >= STATS_RESULT_COUNT) {
+        fprintf (stderr, "  Stats: no parse result\n");
+    }
+    else if (pStats->errIndex < 0) {
+        fprintf (stderr, "  Stats: %s\n", STATS_RESULT_NAMES[pStats->parseResult]);
+    }
+    else {
+        fprintf (stderr, "  Stats: %s at byte %d\n", STATS_RESULT_NAMES[pStats->parseResult], pStats->errIndex);
+    }
+    unsigned long long totalNs = 0;
+    fprintf (stderr, "  Stats:");
+    for (int stage = 0; stage < STATS_STAGE_COUNT; ++stage) {
+        fprintf (stderr, " %s %.3f ms,", STATS_STAGE_NAMES[stage], pStats->stageNs[stage] / 1e6);
+        totalNs += pStats->stageNs[stage];
+    }
+    fprintf (stderr, " total %.3f ms\n", totalNs / 1e6);
+    if (statsSkippedThreads) { fprintf (stderr, "  Stats: renders on threads for --threads aren't counted\n"); }
+}
@@ -0,0 +1,42 @@
+//*****************************************************************************
+// music2_stats.h.
+// Scope: Private to music2 program.
+// Bare-bones .h file to facilitate linking. See the .c file for descriptions.
+//*****************************************************************************
+
+#pragma once
+
+#include <stddef.h> // size_t
+
+#include "music2_noteblock.h"
+
+#define STATS_GROUP_COUNT (8)
+#define STATS_STAGE_READ      (0)
+#define STATS_STAGE_PARSE     (1)
+#define STATS_STAGE_TO_STRING (2)
+#define STATS_STAGE_FREE      (3)
+#define STATS_STAGE_COUNT     (4)
+struct render_stats {
+    unsigned long long groups[STATS_GROUP_COUNT];
+    unsigned long long renders;
+    unsigned long long noteblocks;
+    unsigned long long noteblockBytes;
+    unsigned long long stringBytes;
+    unsigned long long staves;
+    unsigned long long outputBytes;
+    unsigned long long stageNs[STATS_STAGE_COUNT];
+    int                parseResult;
+    int                errIndex;
+};
+void stats_set_enabled (int isEnabled);
+int stats_is_enabled ();
+void stats_skip_threads ();
+struct render_stats stats_get ();
+void stats_reset ();
+unsigned long long stats_now ();
+unsigned long long stats_end_stage (int stage, unsigned long long startNs);
+void stats_count_groups (const unsigned char* pBytes, size_t startIndex, size_t endIndex);
+void stats_count_noteblocks (struct noteblock* p1stNoteblock);
+void stats_add_string_bytes (unsigned long long countBytes);
+void stats_record_render (int parseResult, int errIndex, const char* str);
+void stats_print ();
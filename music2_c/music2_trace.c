@@ -0,0 +1,173 @@
+//*****************************************************************************************************
+// music2_trace.c
+// This file contains timeline tracing (--trace <filepath>). Spans around the main stages of reading and
+// rendering - the file as a whole, parsing, each staff, printing, and each file, chunk, or thread's work
+// in options that do several at once - are written at exit as a Chrome trace-event JSON file, which
+// chrome://tracing and ui.perfetto.dev open as a timeline with a row per thread.
+//   - Each thread records its spans in its own buffer, found by platform_thread_index, so recording takes no
+//     lock and threads don't contend. Buffers are allocated on a thread's first span and only read at exit,
+//     once every other thread has finished.
+//   - A buffer holds TRACE_EVENTS_MAX spans. Later spans are dropped and counted, so a long run can't use
+//     unbounded memory.
+//   - While tracing is off, a span costs a flag check.
+//*****************************************************************************************************
+
+
+// External inclusions
+#include <stddef.h> // NULL
+#include <stdio.h>  // fprintf, fopen_s
+#include <stdlib.h> // malloc, free
+
+// Internal inclusions
+#include "music2_platform.h"
+
+
+//***********
+// Constants
+//***********
+
+// Most threads traced. Spans of later threads are dropped.
+#define TRACE_THREADS_MAX (256)
+
+// Most spans recorded per thread
+#define TRACE_EVENTS_MAX (65536)
+
+
+
+//*******
+// State
+//*******
+
+// A finished span
+struct trace_event {
+    const char*        name;       // Span name, a string literal. Not escaped when written.
+    unsigned long long startNs;    // When it started, from platform_now_ns.
+    unsigned long long durationNs; // How long it took.
+    long long          arg;        // Number shown with the span, such as a staff index, or -1 for none.
+};
+
+// One thread's spans
+struct trace_buffer {
+    unsigned int       countEvents;
+    unsigned long long countDropped;
+    struct trace_event events[TRACE_EVENTS_MAX];
+};
+
+// File to write at exit, or NULL if tracing is off.
+const char* traceFilepath = NULL;
+
+// When tracing started. Written timestamps count from here.
+unsigned long long traceStartNs = 0;
+
+// Each thread's buffer by platform_thread_index, or NULL before its first span.
+struct trace_buffer* traceBuffers[TRACE_THREADS_MAX] = { NULL };
+
+// Spans dropped because their thread's number was too high.
+unsigned long long traceCountDropped = 0;
+
+
+
+//***********
+// Recording
+//***********
+
+// Start tracing, for the rest of the process. Call from the main thread before starting other threads.
+void trace_start (
+    const char* filepath // File to write at trace_finish.
+){
+    traceFilepath = filepath;
+    traceStartNs = platform_now_ns ();
+    platform_thread_index (); // So the main thread is thread 0
+}
+
+
+// Start a span. Returns the time in ns, or 0 if tracing is off.
+unsigned long long trace_begin () {
+    return (traceFilepath == NULL) ? 0 : platform_now_ns ();
+}
+
+
+// Finish a span, recording it in the calling thread's buffer.
+void trace_end (
+    const char*        name,    // Span name, a string literal.
+    unsigned long long startNs, // From trace_begin.
+    long long          arg      // Number shown with the span, or -1 for none.
+){
+    if (traceFilepath == NULL) return;
+    unsigned long long endNs = platform_now_ns ();
+    unsigned int thread = platform_thread_index ();
+    if (thread >= TRACE_THREADS_MAX) {
+        ++traceCountDropped; // Only a count, so a lost increment between threads does no harm
+        return;
+    }
+    struct trace_buffer* pBuffer = traceBuffers[thread];
+    if (pBuffer == NULL) {
+        pBuffer = malloc (sizeof (struct trace_buffer));
+        if (pBuffer == NULL) return;
+        pBuffer->countEvents = 0;
+        pBuffer->countDropped = 0;
+        traceBuffers[thread] = pBuffer;
+    }
+    if (pBuffer->countEvents == TRACE_EVENTS_MAX) {
+        ++(pBuffer->countDropped);
+        return;
+    }
+    struct trace_event* pEvent = &(pBuffer->events[pBuffer->countEvents++]);
+    pEvent->name = name;
+    pEvent->startNs = startNs;
+    pEvent->durationNs = endNs - startNs;
+    pEvent->arg = arg;
+}
+
+
+
+//*********
+// Writing
+//*********
+
+// Write the trace file and free the buffers. Call from the main thread at exit, after other threads finish.
+void trace_finish () {
+    if (traceFilepath == NULL) return;
+    FILE* file = NULL;
+    if (fopen_s (&file, traceFilepath, "wb") || file == NULL) {
+        fprintf (stderr, "  Unable to create file %s\n", traceFilepath);
+    }
+    unsigned long pid = platform_process_id ();
+    unsigned long long countEvents = 0, countDropped = traceCountDropped;
+    if (file != NULL) { fprintf (file, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n"); }
+    const char* separator = "";
+    for (unsigned int thread = 0; thread < TRACE_THREADS_MAX; ++thread) {
+        struct trace_buffer* pBuffer = traceBuffers[thread];
+        if (pBuffer == NULL) continue;
+        if (file != NULL) {
+            fprintf (file, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": %lu, \"tid\": %u, "
+                "\"args\": {\"name\": \"%s %u\"}}", separator, pid, thread, (thread == 0) ? "main" : "thread",
+                thread);
+            separator = ",\n";
+            for (unsigned int i = 0; i < pBuffer->countEvents; ++i) {
+                const struct trace_event* pEvent = &(pBuffer->events[i]);
+                // Timestamps are in microseconds
+                fprintf (file, ",\n{\"name\": \"%s\", \"cat\": \"music2\", \"ph\": \"X\", \"pid\": %lu, \"tid\": %u, "
+                    "\"ts\": %.3f, \"dur\": %.3f", pEvent->name, pid, thread, (pEvent->startNs - traceStartNs) / 1e3,
+                    pEvent->durationNs / 1e3);
+                if (pEvent->arg >= 0) { fprintf (file, ", \"args\": {\"n\": %lld}", pEvent->arg); }
+                fprintf (file, "}");
+            }
+        }
+        countEvents += pBuffer->countEvents;
+        countDropped += pBuffer->countDropped;
+        free (pBuffer);
+        traceBuffers[thread] = NULL;
+    }
+    if (file != NULL) {
+        fprintf (file, "\n]}\n");
+        if (fclose (file) != 0) {
+            fprintf (stderr, "  Unable to write file %s\n", traceFilepath);
+        }
+        else {
+            fprintf (stderr, "  Trace: %llu spans written to %s, %llu dropped\n", countEvents, traceFilepath,
+                countDropped);
+        }
+    }
+    traceFilepath = NULL;
+}
@@ -0,0 +1,12 @@
+//*****************************************************************************
+// music2_trace.h.
+// Scope: Private to music2 program.
+// Bare-bones .h file to facilitate linking. See the .c file for descriptions.
+//*****************************************************************************
+
+#pragma once
+
+void trace_start (const char* filepath);
+unsigned long long trace_begin ();
+void trace_end (const char* name, unsigned long long startNs, long long arg);
+void trace_finish ();